@@ -21,6 +21,16 @@
 #include "tuya_transporter.h"
 #include "tcp_transporter.h"
 #include "tal_network.h"
+#include "tal_dns_cache.h"
+
+/* addresses of one host that are raced */
+#define TCP_CONNECT_ADDR_MAX 4
+/* delay before the next address joins the race, the connection attempt delay of RFC 8305 */
+#define TCP_CONNECT_ATTEMPT_DELAY_MS 250
+/* connect deadline when the caller gives none */
+#define TCP_CONNECT_TIMEOUT_MS 10000
+/* how long a write waits for send buffer space when the caller gives no timeout */
+#define TCP_WRITE_WAIT_MS 30
 
 typedef struct tcp_transporter_inter_t {
     struct tuya_transporter_inter_t base;
@@ -49,52 +59,45 @@ typedef struct tcp_transporter_inter_t {
  *         - OPRT_TCP_CONNECT_CLOSED: TCP connection closed.
  *         - OPRT_TCP_CONNECT_UNKNOWN: Unknown TCP connection error.
  */
-OPERATE_RET tuya_tcp_transporter_connect(tuya_transporter_t t, const char *host, int port, int timeout_ms)
+/**
+ * @brief Creates a socket for one connect attempt and applies the transporter
+ * config to it.
+ *
+ * @param tcp_transporter The TCP transporter.
+ * @param fd The created socket, -1 on failure.
+ *
+ * @return OPRT_OK on success, the transport error code otherwise.
+ */
+static OPERATE_RET __tcp_socket_open(tuya_tcp_transporter_t tcp_transporter, int *fd)
 {
-
     OPERATE_RET op_ret = OPRT_OK;
-    tuya_tcp_transporter_t tcp_transporter = (tuya_tcp_transporter_t)t;
-
-    /*resolve ip addr of host*/
-    TUYA_IP_ADDR_T hostaddr;
-    op_ret = tal_net_gethostbyname(host, &hostaddr);
-    if (op_ret != OPRT_OK) {
-        PR_ERR("DNS parser host %s failed %d", host, op_ret);
-        return OPRT_MID_TRANSPORT_DNS_PARSED_FAILED;
-    }
 
-    tcp_transporter->socket_fd = tal_net_socket_create(PROTOCOL_TCP);
-    if (tcp_transporter->socket_fd < 0) {
-        op_ret = OPRT_MID_TRANSPORT_SOCK_CREAT_FAILED;
-        goto err_out;
+    *fd = tal_net_socket_create(PROTOCOL_TCP);
+    if (*fd < 0) {
+        return OPRT_MID_TRANSPORT_SOCK_CREAT_FAILED;
     }
     // reuse socket port
-    if (tcp_transporter->config.isReuse && (OPRT_OK != tal_net_set_reuse(tcp_transporter->socket_fd))) {
+    if (tcp_transporter->config.isReuse && (OPRT_OK != tal_net_set_reuse(*fd))) {
         op_ret = OPRT_MID_TRANSPORT_SOCK_SET_REUSE_FAILED;
         goto err_out;
     }
     // disable Nagle Algorithm
-    if (tcp_transporter->config.isDisableNagle && (OPRT_OK != tal_net_disable_nagle(tcp_transporter->socket_fd))) {
+    if (tcp_transporter->config.isDisableNagle && (OPRT_OK != tal_net_disable_nagle(*fd))) {
         op_ret = OPRT_MID_TRANSPORT_SOCK_SET_DISABLE_NAGLE_FAILED;
         goto err_out;
     }
     // keepalive ,idle time, interval, count setting
     if (tcp_transporter->config.isKeepAlive &&
-        (OPRT_OK != tal_net_set_keepalive(tcp_transporter->socket_fd, TRUE, tcp_transporter->config.keepAliveIdleTime,
+        (OPRT_OK != tal_net_set_keepalive(*fd, TRUE, tcp_transporter->config.keepAliveIdleTime,
                                           tcp_transporter->config.keepAliveInterval,
                                           tcp_transporter->config.keepAliveCount))) {
         op_ret = OPRT_MID_TRANSPORT_SOCK_SET_KEEP_ALIVE_FAILED;
         goto err_out;
     }
-    // block socket port
-    if (tcp_transporter->config.isBlock && (OPRT_OK != tal_net_set_block(tcp_transporter->socket_fd, TRUE))) {
-        op_ret = OPRT_MID_TRANSPORT_SOCK_SET_BLOCK_FAILED;
-        goto err_out;
-    }
 
     // socket bind random port
     if ((tcp_transporter->config.bindPort || tcp_transporter->config.bindAddr) &&
-        (OPRT_OK != tal_net_bind(tcp_transporter->socket_fd, tcp_transporter->config.bindAddr,
+        (OPRT_OK != tal_net_bind(*fd, tcp_transporter->config.bindAddr,
                                  tcp_transporter->config.bindPort))) { // socket bind port
         op_ret = OPRT_MID_TRANSPORT_SOCK_NET_BIND_FAILED;
         goto err_out;
@@ -103,32 +106,215 @@ OPERATE_RET tuya_tcp_transporter_connect(tuya_transporter_t t, const char *host,
     }
 
     if (tcp_transporter->config.sendTimeoutMs &&
-        (OPRT_OK !=
-         tal_net_set_timeout(tcp_transporter->socket_fd, tcp_transporter->config.sendTimeoutMs, TRANS_SEND))) {
+        (OPRT_OK != tal_net_set_timeout(*fd, tcp_transporter->config.sendTimeoutMs, TRANS_SEND))) {
         // PR_DEBUG("socket fd set sendTimeout:%d
         // failed",tcp_transporter->config.sendTimeoutMs); op_ret =
         // OPRT_MID_TRANSPORT_SOCK_SET_TIMEOUT_FAILED; goto err_out;
     }
 
     if (tcp_transporter->config.recvTimeoutMs &&
-        (OPRT_OK !=
-         tal_net_set_timeout(tcp_transporter->socket_fd, tcp_transporter->config.recvTimeoutMs, TRANS_RECV))) {
+        (OPRT_OK != tal_net_set_timeout(*fd, tcp_transporter->config.recvTimeoutMs, TRANS_RECV))) {
         // op_ret = OPRT_MID_TRANSPORT_SOCK_SET_TIMEOUT_FAILED;
         // goto err_out;
     }
 
-    if (tal_net_connect(tcp_transporter->socket_fd, hostaddr, port) < 0) {
-        op_ret = OPRT_MID_TRANSPORT_TCP_CONNECD_FAILED;
+    // connect without blocking, the caller waits with its own deadline
+    if (OPRT_OK != tal_net_set_block(*fd, FALSE)) {
+        op_ret = OPRT_MID_TRANSPORT_SOCK_SET_BLOCK_FAILED;
         goto err_out;
     }
 
     return OPRT_OK;
 err_out:
-    if (tcp_transporter->socket_fd >= 0) {
+    tal_net_close(*fd);
+    *fd = -1;
+    return op_ret;
+}
+
+/**
+ * @brief Starts a non-blocking connect to one address.
+ *
+ * @param tcp_transporter The TCP transporter.
+ * @param addr The address to connect to.
+ * @param port The port to connect to.
+ * @param done Set if the connect completed at once.
+ * @param op_ret The transport error code if the attempt failed.
+ *
+ * @return The socket while the connect is in progress or done, -1 if the
+ * attempt failed.
+ */
+static int __tcp_connect_start(tuya_tcp_transporter_t tcp_transporter, TUYA_IP_ADDR_T addr, int port, BOOL_T *done,
+                               OPERATE_RET *op_ret)
+{
+    int fd = -1;
+    TUYA_ERRNO err;
+
+    *op_ret = __tcp_socket_open(tcp_transporter, &fd);
+    if (fd < 0) {
+        return -1;
+    }
+
+    *done = FALSE;
+    if (0 == tal_net_connect(fd, addr, port)) {
+        *done = TRUE;
+        return fd;
+    }
+
+    err = tal_net_get_errno();
+    if (UNW_EINPROGRESS == err || UNW_EALREADY == err || UNW_EAGAIN == err || UNW_EWOULDBLOCK == err) {
+        return fd;
+    }
+
+    PR_DEBUG("connect %s:%d failed %d", tal_net_addr2str(addr), port, err);
+    *op_ret = OPRT_MID_TRANSPORT_TCP_CONNECD_FAILED;
+    tal_net_close(fd);
+    return -1;
+}
+
+/**
+ * @brief Connects to a TCP server using the Tuya transporter.
+ *
+ * This function establishes a TCP connection to the specified host and port
+ * using the Tuya transporter. When the host resolves to several addresses the
+ * attempts are raced: the next address is tried when the previous one failed
+ * or has not connected within TCP_CONNECT_ATTEMPT_DELAY_MS, and the first
+ * connection to succeed is kept. All attempts share the timeout.
+ *
+ * @param t The Tuya transporter object.
+ * @param host The host address to connect to.
+ * @param port The port number to connect to.
+ * @param timeout_ms The timeout value in milliseconds for the connection
+ * attempt, TCP_CONNECT_TIMEOUT_MS if not positive.
+ *
+ * @return The result of the connection attempt.
+ *         Possible return values:
+ *         - OPRT_OK: Connection successful.
+ *         - OPRT_INVALID_PARM: Invalid parameter(s) passed.
+ *         - OPRT_TIMEOUT: Connection attempt timed out.
+ *         - OPRT_TCP_CONNECT_FAILED: TCP connection failed.
+ *         - OPRT_TCP_CONNECT_CLOSED: TCP connection closed.
+ *         - OPRT_TCP_CONNECT_UNKNOWN: Unknown TCP connection error.
+ */
+OPERATE_RET tuya_tcp_transporter_connect(tuya_transporter_t t, const char *host, int port, int timeout_ms)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    tuya_tcp_transporter_t tcp_transporter = (tuya_tcp_transporter_t)t;
+    TUYA_IP_ADDR_T hostaddr[TCP_CONNECT_ADDR_MAX];
+    int fd[TCP_CONNECT_ADDR_MAX];
+    uint8_t num = TCP_CONNECT_ADDR_MAX, started = 0, i;
+    int pending = 0, maxfd, ret;
+    BOOL_T exclusive, done = FALSE;
+    SYS_TIME_T start, elapsed, next_attempt = 0, wait_ms;
+    SYS_TIME_T timeout = (timeout_ms > 0) ? (SYS_TIME_T)timeout_ms : TCP_CONNECT_TIMEOUT_MS;
+    TUYA_FD_SET_T writefds, errfds;
+
+    tcp_transporter->socket_fd = -1;
+
+    /*resolve ip addrs of host*/
+    op_ret = tal_net_gethostbyname_all(host, hostaddr, &num);
+    if (op_ret != OPRT_OK) {
+        PR_ERR("DNS parser host %s failed %d", host, op_ret);
+        return OPRT_MID_TRANSPORT_DNS_PARSED_FAILED;
+    }
+
+    for (i = 0; i < TCP_CONNECT_ADDR_MAX; i++) {
+        fd[i] = -1;
+    }
+    // a fixed local port can be bound by one attempt at a time only
+    exclusive = (0 != tcp_transporter->config.bindPort);
+    op_ret = OPRT_MID_TRANSPORT_TCP_CONNECD_FAILED;
+    start = tal_system_get_millisecond();
+
+    while (tcp_transporter->socket_fd < 0) {
+        elapsed = tal_system_get_millisecond() - start;
+        if (elapsed >= timeout) {
+            PR_ERR("connect %s:%d timeout, %d of %d addrs tried", host, port, started, num);
+            op_ret = OPRT_TIMEOUT;
+            break;
+        }
+
+        if (started < num && (0 == pending || (!exclusive && elapsed >= next_attempt))) {
+            fd[started] = __tcp_connect_start(tcp_transporter, hostaddr[started], port, &done, &op_ret);
+            if (fd[started] >= 0) {
+                if (done) {
+                    tcp_transporter->socket_fd = fd[started];
+                    fd[started] = -1;
+                    break;
+                }
+                pending++;
+            }
+            started++;
+            next_attempt = elapsed + TCP_CONNECT_ATTEMPT_DELAY_MS;
+            continue;
+        }
+
+        if (0 == pending) {
+            break;
+        }
+
+        wait_ms = timeout - elapsed;
+        if (started < num && !exclusive && next_attempt - elapsed < wait_ms) {
+            wait_ms = next_attempt - elapsed;
+        }
+        wait_ms = wait_ms ? wait_ms : 1; // 0 waits forever
+
+        maxfd = -1;
+        tal_net_fd_zero(&writefds);
+        tal_net_fd_zero(&errfds);
+        for (i = 0; i < started; i++) {
+            if (fd[i] >= 0) {
+                tal_net_fd_set(fd[i], &writefds);
+                tal_net_fd_set(fd[i], &errfds);
+                maxfd = (fd[i] > maxfd) ? fd[i] : maxfd;
+            }
+        }
+
+        ret = tal_net_select(maxfd + 1, NULL, &writefds, &errfds, wait_ms);
+        if (ret < 0 && UNW_EINTR != tal_net_get_errno()) {
+            op_ret = OPRT_MID_TRANSPORT_TCP_CONNECD_FAILED;
+            break;
+        }
+        if (ret <= 0) {
+            continue;
+        }
+
+        for (i = 0; i < started && tcp_transporter->socket_fd < 0; i++) {
+            if (fd[i] < 0 || (!tal_net_fd_isset(fd[i], &writefds) && !tal_net_fd_isset(fd[i], &errfds))) {
+                continue;
+            }
+            if (!tal_net_fd_isset(fd[i], &errfds) && UNW_SUCCESS == tal_net_get_socket_error(fd[i])) {
+                tcp_transporter->socket_fd = fd[i];
+            } else {
+                PR_DEBUG("connect %s:%d failed", tal_net_addr2str(hostaddr[i]), port);
+                op_ret = OPRT_MID_TRANSPORT_TCP_CONNECD_FAILED;
+                tal_net_close(fd[i]);
+            }
+            fd[i] = -1;
+            pending--;
+        }
+    }
+
+    // drop the attempts that lost the race
+    for (i = 0; i < started; i++) {
+        if (fd[i] >= 0) {
+            tal_net_close(fd[i]);
+        }
+    }
+
+    if (tcp_transporter->socket_fd < 0) {
+        // the addresses may be stale cached ones, resolve again on retry
+        tal_dns_cache_flush(host);
+        return op_ret;
+    }
+
+    // sockets are blocking by default, restore that after the raced connect
+    if (OPRT_OK != tal_net_set_block(tcp_transporter->socket_fd, TRUE)) {
         tal_net_close(tcp_transporter->socket_fd);
         tcp_transporter->socket_fd = -1;
+        return OPRT_MID_TRANSPORT_SOCK_SET_BLOCK_FAILED;
     }
-    return op_ret; // tbd
+
+    return OPRT_OK;
 }
 
 /**
@@ -167,6 +353,11 @@ OPERATE_RET tuya_tcp_transporter_ctrl(tuya_transporter_t t, uint32_t cmd, void *
         }
         break;
     }
+    case TUYA_TRANSPORTER_GET_READ_PENDING: {
+        // nothing is buffered above the socket
+        *(int *)args = 0;
+        break;
+    }
     default: {
         break;
     }
@@ -217,8 +408,6 @@ OPERATE_RET tuya_tcp_transporter_close(tuya_transporter_t t)
 OPERATE_RET tuya_tcp_transporter_poll_read(tuya_transporter_t t, int timeout_ms)
 {
     int ret = 0;
-    TUYA_FD_SET_T readfd;
-    TUYA_FD_SET_T errfd;
     tuya_tcp_transporter_t tcp_transporter = (tuya_tcp_transporter_t)t;
     int socket_fd = tcp_transporter->socket_fd;
 
@@ -227,13 +416,8 @@ OPERATE_RET tuya_tcp_transporter_poll_read(tuya_transporter_t t, int timeout_ms)
         return OPRT_INVALID_PARM;
     }
 
-    tal_net_fd_zero(&readfd);
-    tal_net_fd_zero(&errfd);
-    tal_net_fd_set(socket_fd, &readfd);
-    tal_net_fd_set(socket_fd, &errfd);
-
-    ret = tal_net_select(socket_fd + 1, &readfd, NULL, &errfd, timeout_ms);
-    if ((ret > 0) && tal_net_fd_isset(socket_fd, &errfd)) {
+    ret = tal_net_poll(socket_fd, TAL_NET_POLL_READ, timeout_ms);
+    if ((ret > 0) && (ret & TAL_NET_POLL_ERR)) {
         ret = -1; // socket is fault
         PR_ERR("socket fd %d is fault", socket_fd);
     }
@@ -255,14 +439,15 @@ OPERATE_RET tuya_tcp_transporter_poll_read(tuya_transporter_t t, int timeout_ms)
  */
 OPERATE_RET tuya_tcp_transporter_poll_write(tuya_transporter_t t, int timeout_ms)
 {
-
-    TUYA_FD_SET_T writefd;
+    int ret = 0;
     tuya_tcp_transporter_t tcp_transporter = (tuya_tcp_transporter_t)t;
 
-    tal_net_fd_zero(&writefd);
-    tal_net_fd_set(tcp_transporter->socket_fd, &writefd);
+    ret = tal_net_poll(tcp_transporter->socket_fd, TAL_NET_POLL_WRITE, timeout_ms);
+    if ((ret > 0) && (ret & TAL_NET_POLL_ERR)) {
+        ret = -1; // socket is fault
+    }
 
-    return tal_net_select(tcp_transporter->socket_fd + 1, NULL, &writefd, NULL, timeout_ms);
+    return ret;
 }
 
 /**
@@ -315,21 +500,34 @@ OPERATE_RET tuya_tcp_transporter_read(tuya_transporter_t t, uint8_t *buf, int le
 OPERATE_RET tuya_tcp_transporter_write(tuya_transporter_t t, uint8_t *buf, int len, int timeout_ms)
 {
     int ret = OPRT_COM_ERROR;
+    SYS_TIME_T deadline = 0;
     tuya_tcp_transporter_t tcp_transporter = (tuya_tcp_transporter_t)t;
     if (tcp_transporter->socket_fd < 0) {
         PR_ERR("socket fd:%d", tcp_transporter->socket_fd);
         return OPRT_INVALID_PARM;
     }
 
+    deadline = tal_system_get_millisecond() + ((timeout_ms > 0) ? timeout_ms : TCP_WRITE_WAIT_MS);
     if (timeout_ms > 0 && tuya_tcp_transporter_poll_write(t, timeout_ms) <= 0) {
         return OPRT_RESOURCE_NOT_READY;
     }
 
-    ret = tal_net_send(tcp_transporter->socket_fd, buf, len);
-    if (ret < 0) {
-        if ((tal_net_get_errno() == UNW_EINTR) || (tal_net_get_errno() == UNW_EAGAIN)) {
-            tal_system_sleep(30);
-            ret = tal_net_send(tcp_transporter->socket_fd, buf, len);
+    // a full send buffer waits for space until the deadline instead of sleeping
+    for (;;) {
+        ret = tal_net_send(tcp_transporter->socket_fd, buf, len);
+        if (ret >= 0) {
+            break;
+        }
+        if (tal_net_get_errno() == UNW_EINTR) {
+            continue;
+        }
+        if (tal_net_get_errno() != UNW_EAGAIN) {
+            break;
+        }
+
+        SYS_TIME_T now = tal_system_get_millisecond();
+        if ((now >= deadline) || (tuya_tcp_transporter_poll_write(t, (int)(deadline - now)) <= 0)) {
+            break;
         }
     }
 
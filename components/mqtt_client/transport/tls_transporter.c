@@ -200,9 +200,28 @@ OPERATE_RET tuya_tls_transporter_poll_read(tuya_transporter_t t, int timeout_ms)
 
     tuya_tls_transporter_t tls_transporter = (tuya_tls_transporter_t)t;
 
+    // records already buffered by tls do not make the socket readable
+    if (tuya_tls_read_pending(tls_transporter->tls_handler) > 0) {
+        return 1;
+    }
+
     return tuya_transporter_poll_read(tls_transporter->tcp_transporter, timeout_ms);
 }
 
+/**
+ * @brief Polls for write availability on the TLS transporter.
+ *
+ * @param t The TLS transporter to poll.
+ * @param timeout_ms The timeout value in milliseconds.
+ * @return > 0 if writable, 0 on timeout, < 0 on error.
+ */
+OPERATE_RET tuya_tls_transporter_poll_write(tuya_transporter_t t, int timeout_ms)
+{
+    tuya_tls_transporter_t tls_transporter = (tuya_tls_transporter_t)t;
+
+    return tuya_transporter_poll_write(tls_transporter->tcp_transporter, timeout_ms);
+}
+
 /**
  * @brief Controls the TLS transporter.
  *
@@ -239,6 +258,10 @@ OPERATE_RET tuya_tls_transporter_ctrl(tuya_transporter_t t, uint32_t cmd, void *
         *s = (void *)config;
         break;
     }
+    case TUYA_TRANSPORTER_GET_READ_PENDING: {
+        *(int *)args = tuya_tls_read_pending(tls_transporter->tls_handler);
+        break;
+    }
 
     default: {
         ret = tuya_transporter_ctrl(tls_transporter->tcp_transporter, cmd, args);
@@ -269,7 +292,8 @@ tuya_transporter_t tuya_tls_transporter_create(void)
 
     tuya_transporter_set_func((tuya_transporter_t)&t->base, tuya_tls_transporter_connect, tuya_tls_transporter_close,
                               tuya_tls_transporter_read, tuya_tls_transporter_write, tuya_tls_transporter_poll_read,
-                              NULL, tuya_tls_transporter_destroy, tuya_tls_transporter_ctrl);
+                              tuya_tls_transporter_poll_write, tuya_tls_transporter_destroy,
+                              tuya_tls_transporter_ctrl);
     t->tcp_transporter = tuya_tcp_transporter_create();
     t->tls_handler = tuya_tls_connect_create();
     if (t->tls_handler == NULL) {
@@ -253,6 +253,41 @@ OPERATE_RET tuya_transporter_poll_write(tuya_transporter_t t, int timeout_ms)
     return OPRT_INVALID_PARM;
 }
 
+/**
+ * @brief Gets the socket fd under the transporter, for waiting on readiness.
+ *
+ * @param t The transport object.
+ * @return The socket fd, or < 0 if the transporter is not connected.
+ */
+int tuya_transporter_get_fd(tuya_transporter_t t)
+{
+    int fd = -1;
+
+    if (OPRT_OK != tuya_transporter_ctrl(t, TUYA_TRANSPORTER_GET_TCP_SOCKET, &fd)) {
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Checks for data buffered by the transporter above the socket.
+ *
+ * @param t The transport object.
+ * @return > 0 if a read can return data without waiting on the socket, 0
+ * otherwise.
+ */
+int tuya_transporter_read_pending(tuya_transporter_t t)
+{
+    int pending = 0;
+
+    if (OPRT_OK != tuya_transporter_ctrl(t, TUYA_TRANSPORTER_GET_READ_PENDING, &pending)) {
+        return 0;
+    }
+
+    return pending;
+}
+
 /**
  * @brief Connects the Tuya transporter to the specified host and port.
  *
@@ -36,6 +36,7 @@ extern "C" {
 #define TUYA_TRANSPORTER_SET_WEBSOCKET_CONFIG 0x0004
 #define TUYA_TRANSPORTER_SET_TLS_CONFIG       0x0005
 #define TUYA_TRANSPORTER_GET_TLS_CONFIG       0x0006
+#define TUYA_TRANSPORTER_GET_READ_PENDING     0x0007
 
 struct socket_config_t {
     uint8_t isBlock;
@@ -250,6 +251,36 @@ OPERATE_RET tuya_transporter_write(tuya_transporter_t transporter, uint8_t *buf,
  */
 OPERATE_RET tuya_transporter_poll_read(tuya_transporter_t transporter, int timeout_ms);
 
+/**
+ * @brief Polls the transporter until it can be written.
+ *
+ * @param transporter The transporter to poll.
+ * @param timeout_ms The timeout period (in milliseconds) to wait.
+ * @return > 0 if writable, 0 on timeout, < 0 on error.
+ */
+OPERATE_RET tuya_transporter_poll_write(tuya_transporter_t transporter, int timeout_ms);
+
+/**
+ * @brief Gets the socket fd under the transporter.
+ *
+ * The fd can be waited on together with other fds, e.g. by tal_net_poll() or
+ * tal_net_select(). Data buffered above the socket does not make it readable,
+ * so tuya_transporter_read_pending() has to be checked before waiting.
+ *
+ * @param transporter The transporter.
+ * @return The socket fd, or < 0 if the transporter is not connected.
+ */
+int tuya_transporter_get_fd(tuya_transporter_t transporter);
+
+/**
+ * @brief Checks for data buffered by the transporter above the socket.
+ *
+ * @param transporter The transporter.
+ * @return > 0 if a read can return data without waiting on the socket, 0
+ * otherwise.
+ */
+int tuya_transporter_read_pending(tuya_transporter_t transporter);
+
 /**
  * @brief Closes the specified transporter.
  *
@@ -235,6 +235,12 @@ OPERATE_RET websocket_transporter_ctrl(tuya_transporter_t t, uint32_t cmd, void
         }
         break;
     }
+    case TUYA_TRANSPORTER_GET_TCP_SOCKET:
+    case TUYA_TRANSPORTER_GET_READ_PENDING: {
+        websocket_client_t *t_client = (websocket_client_t *)wst->ws_client;
+        ret = tuya_transporter_ctrl((tuya_transporter_t)(t_client->transporter), cmd, args);
+        break;
+    }
     default: {
         break;
     }
@@ -0,0 +1,159 @@
+/**
+ * @file tkl_ble_loopback.h
+ * @brief Loopback BLE link for host builds.
+ *
+ * With ENABLE_BLE_LOOPBACK the tkl_ble_xxx interface is served by an
+ * emulated peripheral instead of a radio. A peer in the same process, e.g. a
+ * benchmark playing the app, connects, writes the write characteristic and
+ * receives the notifications through the functions below.
+ *
+ * The link is driven by connection events: every conn_interval_ms each
+ * direction delivers up to pkts_per_event packets that have been in flight for
+ * latency_ms. A lost packet is resent at the next connection event as the link
+ * layer does, so loss shows up as delay and never as missing data. The ATT MTU
+ * is 23 until the device side starts an MTU exchange, which settles on the
+ * smaller of both MTUs one round trip later.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __TKL_BLE_LOOPBACK_H__
+#define __TKL_BLE_LOOPBACK_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* default ATT MTU before the exchange */
+#define TKL_BLE_LOOPBACK_MTU_MIN 23
+
+/* largest ATT MTU, an attribute value is at most 512 bytes */
+#define TKL_BLE_LOOPBACK_MTU_MAX 515
+
+/* packets queued per direction, beyond it sends fail with OPRT_OS_ADAPTER_BLE_BUSY */
+#ifndef TKL_BLE_LOOPBACK_QUEUE_NUM
+#define TKL_BLE_LOOPBACK_QUEUE_NUM 16
+#endif
+
+/* upper bound of pkts_per_event */
+#define TKL_BLE_LOOPBACK_PKTS_PER_EVENT_MAX 8
+
+typedef struct {
+    /** ATT MTU of the peer, TKL_BLE_LOOPBACK_MTU_MIN to TKL_BLE_LOOPBACK_MTU_MAX */
+    uint16_t mtu;
+    /** connection interval in ms */
+    uint16_t conn_interval_ms;
+    /** one-way latency added to every packet in ms */
+    uint16_t latency_ms;
+    /** chance in percent that a packet is lost and resent at the next event */
+    uint8_t loss_percent;
+    /** packets each direction carries in one connection event */
+    uint8_t pkts_per_event;
+} TKL_BLE_LOOPBACK_CFG_T;
+
+typedef enum {
+    /** the peer is connected */
+    TKL_BLE_LOOPBACK_EVT_CONNECTED,
+    /** the MTU exchange finished, len is the ATT MTU */
+    TKL_BLE_LOOPBACK_EVT_MTU,
+    /** a notification of the device arrived */
+    TKL_BLE_LOOPBACK_EVT_NOTIFY,
+    /** the link is gone, len is the HCI reason */
+    TKL_BLE_LOOPBACK_EVT_DISCONNECTED,
+} TKL_BLE_LOOPBACK_EVT_E;
+
+/**
+ * @brief peer event callback, runs on the link thread
+ *
+ * @param[in] evt the event
+ * @param[in] data the notification, only valid during the call
+ * @param[in] len the notification length, or the value noted in
+ * TKL_BLE_LOOPBACK_EVT_E
+ * @param[in] arg the registered argument
+ */
+typedef void (*TKL_BLE_LOOPBACK_PEER_CB)(TKL_BLE_LOOPBACK_EVT_E evt, uint8_t *data, uint16_t len, void *arg);
+
+typedef struct {
+    /** packets written by the peer and delivered */
+    uint32_t write_pkts;
+    uint32_t write_bytes;
+    /** notifications delivered to the peer */
+    uint32_t notify_pkts;
+    uint32_t notify_bytes;
+    /** notifications refused because the queue was full */
+    uint32_t notify_busy;
+    /** packets lost and resent */
+    uint32_t retrans;
+    /** connection events run */
+    uint32_t conn_events;
+} TKL_BLE_LOOPBACK_STAT_T;
+
+/**
+ * @brief Configure the link, applies to the next connection
+ *
+ * @param[in] cfg the link config
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tkl_ble_loopback_config(const TKL_BLE_LOOPBACK_CFG_T *cfg);
+
+/**
+ * @brief Register the peer callback
+ *
+ * @param[in] cb the callback, NULL to unregister
+ * @param[in] arg passed to cb
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tkl_ble_loopback_peer_register(TKL_BLE_LOOPBACK_PEER_CB cb, void *arg);
+
+/**
+ * @brief Connect the peer, the device must be advertising
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tkl_ble_loopback_connect(void);
+
+/**
+ * @brief Disconnect from the peer side
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tkl_ble_loopback_disconnect(void);
+
+/**
+ * @brief Write without response to the write characteristic
+ *
+ * @param[in] data the value
+ * @param[in] len the length, at most the ATT MTU - 3
+ *
+ * @return OPRT_OK on success, OPRT_OS_ADAPTER_BLE_BUSY while the queue is full.
+ * Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tkl_ble_loopback_write(const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Get the ATT MTU of the link
+ *
+ * @return the ATT MTU, TKL_BLE_LOOPBACK_MTU_MIN before the exchange
+ */
+uint16_t tkl_ble_loopback_mtu_get(void);
+
+/**
+ * @brief Get the link counters, they are cleared on connect
+ *
+ * @param[out] stat the counters
+ */
+void tkl_ble_loopback_stat_get(TKL_BLE_LOOPBACK_STAT_T *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TKL_BLE_LOOPBACK_H__
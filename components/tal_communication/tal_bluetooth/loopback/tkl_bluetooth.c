@@ -0,0 +1,856 @@
+/**
+ * @file tkl_bluetooth.c
+ * @brief Loopback implementation of the tkl_ble interface.
+ *
+ * The device side sees a peripheral stack: the tal layer adds its service,
+ * advertises, gets connect, write and MTU events and sends notifications. The
+ * other end of the link is driven through tkl_ble_loopback.h. Central role
+ * operations are not emulated.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "tkl_bluetooth.h"
+#include "tkl_ble_loopback.h"
+#include "tal_api.h"
+#include "uni_random.h"
+
+/* the only connection of the link */
+#define LOOPBACK_CONN_HANDLE 1
+
+#define LOOPBACK_ATT_HEADER_LEN 3
+#define LOOPBACK_PKT_DATA_MAX   (TKL_BLE_LOOPBACK_MTU_MAX - LOOPBACK_ATT_HEADER_LEN)
+
+/* written values handed to the stack callback, the tal layer reads them later
+ * from the workqueue so each one stays untouched for this many writes */
+#define LOOPBACK_RX_BUF_NUM 32
+
+#define LOOPBACK_STACK_SIZE 4096
+
+typedef enum {
+    LOOPBACK_PKT_DATA,    // write or notification
+    LOOPBACK_PKT_MTU_REQ, // ATT exchange MTU request, len is the MTU
+    LOOPBACK_PKT_MTU_RSP, // ATT exchange MTU response, len is the settled MTU
+} LOOPBACK_PKT_TYPE_E;
+
+typedef struct {
+    SYS_TIME_T due;
+    uint8_t type;
+    uint16_t len;
+    uint8_t data[LOOPBACK_PKT_DATA_MAX];
+} LOOPBACK_PKT_T;
+
+typedef struct {
+    LOOPBACK_PKT_T pkt[TKL_BLE_LOOPBACK_QUEUE_NUM];
+    uint8_t head;
+    uint8_t num;
+} LOOPBACK_QUEUE_T;
+
+typedef void (*LOOPBACK_RECV_CB)(LOOPBACK_PKT_T *pkt, uint32_t conn_id);
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    THREAD_HANDLE thread;
+    TKL_BLE_GAP_EVT_FUNC_CB gap_cb;
+    TKL_BLE_GATT_EVT_FUNC_CB gatt_cb;
+    TKL_BLE_LOOPBACK_PEER_CB peer_cb;
+    void *peer_arg;
+    TKL_BLE_LOOPBACK_CFG_T cfg;  // applied on the next connect
+    TKL_BLE_LOOPBACK_CFG_T link; // of the current connection
+    TKL_BLE_GAP_ADDR_T addr;
+    uint16_t handle_num; // last attribute handle given out
+    uint16_t write_handle;
+    uint16_t notify_handle;
+    BOOL_T advertising;
+    BOOL_T connected;
+    uint32_t conn_id; // changes on connect and disconnect, drops deliveries of an old link
+    uint16_t mtu;
+    LOOPBACK_QUEUE_T down; // peer to device
+    LOOPBACK_QUEUE_T up;   // device to peer
+    LOOPBACK_PKT_T cur;    // the packet being delivered
+    uint8_t rx_buf[LOOPBACK_RX_BUF_NUM][LOOPBACK_PKT_DATA_MAX];
+    uint8_t rx_pos;
+    TKL_BLE_LOOPBACK_STAT_T stat;
+} LOOPBACK_LINK_T;
+
+static LOOPBACK_LINK_T s_lb = {
+    .cfg =
+        {
+            .mtu = 247,
+            .conn_interval_ms = 30,
+            .latency_ms = 0,
+            .loss_percent = 0,
+            .pkts_per_event = 4,
+        },
+    .addr =
+        {
+            .type = TKL_BLE_GAP_ADDR_TYPE_RANDOM,
+            .addr = {0x01, 0x00, 0x00, 0x00, 0xB1, 0xDC},
+        },
+    .mtu = TKL_BLE_LOOPBACK_MTU_MIN,
+};
+
+/* address the device sees the peer connect from */
+static const uint8_t s_peer_addr[6] = {0x02, 0x00, 0x00, 0x00, 0xB1, 0xDC};
+
+static void __loopback_gap_event(TKL_BLE_GAP_PARAMS_EVT_T *evt)
+{
+    if (s_lb.gap_cb) {
+        s_lb.gap_cb(evt);
+    }
+}
+
+static void __loopback_gatt_event(TKL_BLE_GATT_PARAMS_EVT_T *evt)
+{
+    if (s_lb.gatt_cb) {
+        s_lb.gatt_cb(evt);
+    }
+}
+
+static void __loopback_peer_event(TKL_BLE_LOOPBACK_EVT_E evt, uint8_t *data, uint16_t len)
+{
+    if (s_lb.peer_cb) {
+        s_lb.peer_cb(evt, data, len, s_lb.peer_arg);
+    }
+}
+
+static void __loopback_queue_reset(void)
+{
+    s_lb.down.head = 0;
+    s_lb.down.num = 0;
+    s_lb.up.head = 0;
+    s_lb.up.num = 0;
+}
+
+/* called with the mutex held */
+static OPERATE_RET __loopback_push(LOOPBACK_QUEUE_T *queue, uint8_t type, const uint8_t *data, uint16_t len)
+{
+    LOOPBACK_PKT_T *pkt = NULL;
+
+    if (queue->num >= TKL_BLE_LOOPBACK_QUEUE_NUM) {
+        return OPRT_OS_ADAPTER_BLE_BUSY;
+    }
+
+    pkt = &queue->pkt[(queue->head + queue->num) % TKL_BLE_LOOPBACK_QUEUE_NUM];
+    pkt->due = tal_system_get_millisecond() + s_lb.link.latency_ms;
+    pkt->type = type;
+    pkt->len = len;
+    if (data) {
+        memcpy(pkt->data, data, len);
+    }
+    queue->num++;
+
+    return OPRT_OK;
+}
+
+/* peer to device */
+static void __loopback_device_recv(LOOPBACK_PKT_T *pkt, uint32_t conn_id)
+{
+    TKL_BLE_GATT_PARAMS_EVT_T gatt_event;
+    uint8_t *buf = NULL;
+
+    memset(&gatt_event, 0, sizeof(gatt_event));
+    gatt_event.conn_handle = LOOPBACK_CONN_HANDLE;
+
+    tal_mutex_lock(s_lb.mutex);
+    if (conn_id != s_lb.conn_id) {
+        tal_mutex_unlock(s_lb.mutex);
+        return;
+    }
+    if (LOOPBACK_PKT_MTU_RSP == pkt->type) {
+        s_lb.mtu = pkt->len;
+    } else {
+        buf = s_lb.rx_buf[s_lb.rx_pos];
+        s_lb.rx_pos = (s_lb.rx_pos + 1) % LOOPBACK_RX_BUF_NUM;
+        memcpy(buf, pkt->data, pkt->len);
+        s_lb.stat.write_pkts++;
+        s_lb.stat.write_bytes += pkt->len;
+    }
+    tal_mutex_unlock(s_lb.mutex);
+
+    if (LOOPBACK_PKT_MTU_RSP == pkt->type) {
+        // reported like the exchange result of a real stack
+        gatt_event.type = TKL_BLE_GATT_EVT_MTU_REQUEST;
+        gatt_event.gatt_event.exchange_mtu = pkt->len;
+        __loopback_gatt_event(&gatt_event);
+        __loopback_peer_event(TKL_BLE_LOOPBACK_EVT_MTU, NULL, pkt->len);
+        return;
+    }
+
+    gatt_event.type = TKL_BLE_GATT_EVT_WRITE_REQ;
+    gatt_event.gatt_event.write_report.char_handle = s_lb.write_handle;
+    gatt_event.gatt_event.write_report.report.p_data = buf;
+    gatt_event.gatt_event.write_report.report.length = pkt->len;
+    __loopback_gatt_event(&gatt_event);
+}
+
+/* device to peer */
+static void __loopback_peer_recv(LOOPBACK_PKT_T *pkt, uint32_t conn_id)
+{
+    TKL_BLE_GATT_PARAMS_EVT_T gatt_event;
+
+    if (LOOPBACK_PKT_MTU_REQ == pkt->type) {
+        uint16_t mtu = pkt->len;
+
+        // the peer answers at once, both sides use the smaller MTU
+        tal_mutex_lock(s_lb.mutex);
+        if (conn_id == s_lb.conn_id) {
+            if (mtu > s_lb.link.mtu) {
+                mtu = s_lb.link.mtu;
+            }
+            if (OPRT_OK != __loopback_push(&s_lb.down, LOOPBACK_PKT_MTU_RSP, NULL, mtu)) {
+                PR_ERR("ble loopback mtu rsp dropped, queue full");
+            }
+        }
+        tal_mutex_unlock(s_lb.mutex);
+        return;
+    }
+
+    tal_mutex_lock(s_lb.mutex);
+    if (conn_id != s_lb.conn_id) {
+        tal_mutex_unlock(s_lb.mutex);
+        return;
+    }
+    s_lb.stat.notify_pkts++;
+    s_lb.stat.notify_bytes += pkt->len;
+    tal_mutex_unlock(s_lb.mutex);
+
+    __loopback_peer_event(TKL_BLE_LOOPBACK_EVT_NOTIFY, pkt->data, pkt->len);
+
+    memset(&gatt_event, 0, sizeof(gatt_event));
+    gatt_event.type = TKL_BLE_GATT_EVT_NOTIFY_TX;
+    gatt_event.conn_handle = LOOPBACK_CONN_HANDLE;
+    gatt_event.gatt_event.notify_result.char_handle = s_lb.notify_handle;
+    gatt_event.gatt_event.notify_result.result = 0;
+    __loopback_gatt_event(&gatt_event);
+}
+
+/**
+ * @brief Runs one direction of a connection event.
+ *
+ * Packets leave in order. A lost packet stays at the head and ends the event
+ * for its direction, the link layer resends it at the next one.
+ */
+static void __loopback_event_run(LOOPBACK_QUEUE_T *queue, LOOPBACK_RECV_CB recv)
+{
+    uint8_t i;
+    uint32_t conn_id;
+    LOOPBACK_PKT_T *pkt = NULL;
+
+    for (i = 0; i < s_lb.link.pkts_per_event; i++) {
+        tal_mutex_lock(s_lb.mutex);
+        pkt = &queue->pkt[queue->head];
+        if (!s_lb.connected || 0 == queue->num || pkt->due > tal_system_get_millisecond()) {
+            tal_mutex_unlock(s_lb.mutex);
+            return;
+        }
+        if (s_lb.link.loss_percent && uni_random_range(100) < s_lb.link.loss_percent) {
+            s_lb.stat.retrans++;
+            tal_mutex_unlock(s_lb.mutex);
+            return;
+        }
+        s_lb.cur.type = pkt->type;
+        s_lb.cur.len = pkt->len;
+        if (LOOPBACK_PKT_DATA == pkt->type) {
+            memcpy(s_lb.cur.data, pkt->data, pkt->len);
+        }
+        queue->head = (queue->head + 1) % TKL_BLE_LOOPBACK_QUEUE_NUM;
+        queue->num--;
+        conn_id = s_lb.conn_id;
+        tal_mutex_unlock(s_lb.mutex);
+
+        // delivered unlocked, the callbacks send and write back
+        recv(&s_lb.cur, conn_id);
+    }
+}
+
+static void __loopback_link_thread(void *arg)
+{
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(s_lb.thread)) {
+        tal_system_sleep(s_lb.connected ? s_lb.link.conn_interval_ms : s_lb.cfg.conn_interval_ms);
+        if (!s_lb.connected) {
+            continue;
+        }
+
+        tal_mutex_lock(s_lb.mutex);
+        s_lb.stat.conn_events++;
+        tal_mutex_unlock(s_lb.mutex);
+
+        __loopback_event_run(&s_lb.down, __loopback_device_recv);
+        __loopback_event_run(&s_lb.up, __loopback_peer_recv);
+    }
+}
+
+static void __loopback_link_down(uint8_t reason)
+{
+    TKL_BLE_GAP_PARAMS_EVT_T gap_event;
+
+    tal_mutex_lock(s_lb.mutex);
+    if (!s_lb.connected) {
+        tal_mutex_unlock(s_lb.mutex);
+        return;
+    }
+    s_lb.connected = FALSE;
+    s_lb.conn_id++;
+    s_lb.mtu = TKL_BLE_LOOPBACK_MTU_MIN;
+    __loopback_queue_reset();
+    tal_mutex_unlock(s_lb.mutex);
+
+    memset(&gap_event, 0, sizeof(gap_event));
+    gap_event.type = TKL_BLE_GAP_EVT_DISCONNECT;
+    gap_event.conn_handle = LOOPBACK_CONN_HANDLE;
+    gap_event.result = 0;
+    gap_event.gap_event.disconnect.role = TKL_BLE_ROLE_SERVER;
+    gap_event.gap_event.disconnect.reason = reason;
+    __loopback_gap_event(&gap_event);
+    __loopback_peer_event(TKL_BLE_LOOPBACK_EVT_DISCONNECTED, NULL, reason);
+}
+
+static OPERATE_RET __loopback_mtu_exchange(uint16_t conn_handle, uint16_t mtu)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (NULL == s_lb.mutex || LOOPBACK_CONN_HANDLE != conn_handle) {
+        return OPRT_OS_ADAPTER_BLE_HANDLE_ERROR;
+    }
+    if (mtu < TKL_BLE_LOOPBACK_MTU_MIN) {
+        mtu = TKL_BLE_LOOPBACK_MTU_MIN;
+    } else if (mtu > TKL_BLE_LOOPBACK_MTU_MAX) {
+        mtu = TKL_BLE_LOOPBACK_MTU_MAX;
+    }
+
+    tal_mutex_lock(s_lb.mutex);
+    if (s_lb.connected) {
+        rt = __loopback_push(&s_lb.up, LOOPBACK_PKT_MTU_REQ, NULL, mtu);
+    } else {
+        rt = OPRT_OS_ADAPTER_BLE_HANDLE_ERROR;
+    }
+    tal_mutex_unlock(s_lb.mutex);
+
+    return rt;
+}
+
+/******************************************************************************************************************************/
+/** @brief Define All Stack Interface
+ */
+/**
+ * @brief   Function for initializing the ble stack, starts the link thread
+ * @param   role                 Indicate the role for ble stack.
+ * @return  SUCCESS              Initialized successfully.
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_stack_init(uint8_t role)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TKL_BLE_GAP_PARAMS_EVT_T gap_event;
+
+    if (NULL == s_lb.mutex) {
+        TUYA_CALL_ERR_RETURN(tal_mutex_create_init(&s_lb.mutex));
+    }
+
+    if (NULL == s_lb.thread) {
+        THREAD_CFG_T thread_cfg = {
+            .stackDepth = LOOPBACK_STACK_SIZE, .priority = THREAD_PRIO_1, .thrdname = "ble_loopback"};
+        TUYA_CALL_ERR_RETURN(
+            tal_thread_create_and_start(&s_lb.thread, NULL, NULL, __loopback_link_thread, NULL, &thread_cfg));
+    }
+
+    memset(&gap_event, 0, sizeof(gap_event));
+    gap_event.type = TKL_BLE_EVT_STACK_INIT;
+    gap_event.result = 0;
+    __loopback_gap_event(&gap_event);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief   Function for de-initializing the ble stack, drops the link
+ * @param   role                 Indicate the role for ble stack.
+ * @return  SUCCESS              Deinitialized successfully.
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_stack_deinit(uint8_t role)
+{
+    TKL_BLE_GAP_PARAMS_EVT_T gap_event;
+
+    if (s_lb.mutex) {
+        __loopback_link_down(TKL_BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION);
+        s_lb.advertising = FALSE;
+    }
+
+    if (s_lb.thread) {
+        tal_thread_delete(s_lb.thread);
+        while (THREAD_STATE_DELETE != tal_thread_get_state(s_lb.thread)) {
+            tal_system_sleep(10);
+        }
+        s_lb.thread = NULL;
+    }
+
+    memset(&gap_event, 0, sizeof(gap_event));
+    gap_event.type = TKL_BLE_EVT_STACK_DEINIT;
+    gap_event.result = 0;
+    __loopback_gap_event(&gap_event);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief   Function for getting the GATT Link-Support.
+ * @param   p_link              return gatt link
+ * @return  SUCCESS             Support Gatt Link
+ * */
+OPERATE_RET tkl_ble_stack_gatt_link(uint16_t *p_link)
+{
+    *p_link = 1;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief   Register GAP Event Callback
+ * @param   TKL_BLE_GAP_EVT_FUNC_CB Refer to @TKL_BLE_GAP_EVT_FUNC_CB
+ * @return  SUCCESS              Register successfully.
+ * */
+OPERATE_RET tkl_ble_gap_callback_register(const TKL_BLE_GAP_EVT_FUNC_CB gap_evt)
+{
+    s_lb.gap_cb = gap_evt;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief   Register GATT Event Callback
+ * @param   TKL_BLE_GATT_EVT_FUNC_CB Refer to @TKL_BLE_GATT_EVT_FUNC_CB
+ * @return  SUCCESS              Register successfully.
+ * */
+OPERATE_RET tkl_ble_gatt_callback_register(const TKL_BLE_GATT_EVT_FUNC_CB gatt_evt)
+{
+    s_lb.gatt_cb = gatt_evt;
+
+    return OPRT_OK;
+}
+
+/******************************************************************************************************************************/
+/** @brief Define All GAP Interface
+ */
+OPERATE_RET tkl_ble_gap_addr_set(TKL_BLE_GAP_ADDR_T const *p_peer_addr)
+{
+    if (NULL == p_peer_addr) {
+        return OPRT_INVALID_PARM;
+    }
+    s_lb.addr = *p_peer_addr;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_address_get(TKL_BLE_GAP_ADDR_T *p_peer_addr)
+{
+    if (NULL == p_peer_addr) {
+        return OPRT_INVALID_PARM;
+    }
+    *p_peer_addr = s_lb.addr;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief   Start advertising, the peer can connect from now on
+ * @param   [in] p_adv_params : pointer to advertising parameters
+ * @return  SUCCESS
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_gap_adv_start(TKL_BLE_GAP_ADV_PARAMS_T const *p_adv_params)
+{
+    if (s_lb.connected) {
+        return OPRT_OS_ADAPTER_BLE_ADV_START_FAILED;
+    }
+    s_lb.advertising = TRUE;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_adv_stop(void)
+{
+    s_lb.advertising = FALSE;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_adv_rsp_data_set(TKL_BLE_DATA_T const *p_adv, TKL_BLE_DATA_T const *p_scan_rsp)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_adv_rsp_data_update(TKL_BLE_DATA_T const *p_adv, TKL_BLE_DATA_T const *p_scan_rsp)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_scan_start(TKL_BLE_GAP_SCAN_PARAMS_T const *p_scan_params)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gap_scan_stop(void)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gap_connect(TKL_BLE_GAP_ADDR_T const *p_peer_addr, TKL_BLE_GAP_SCAN_PARAMS_T const *p_scan_params,
+                                TKL_BLE_GAP_CONN_PARAMS_T const *p_conn_params)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+/**
+ * @brief   Disconnect from peer
+ * @param   [in] conn_handle: the connection handle
+ *          [in] hci_reason: terminate reason
+ * @return  SUCCESS
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_reason)
+{
+    if (NULL == s_lb.mutex || LOOPBACK_CONN_HANDLE != conn_handle || !s_lb.connected) {
+        return OPRT_OS_ADAPTER_BLE_GATT_DISCONN_FAILED;
+    }
+
+    // the local host learns its own termination with this reason
+    __loopback_link_down(TKL_BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief   Update the connection parameters, the link runs at the new maximum
+ *          interval from the next connection event
+ * @param   [in] conn_handle: the connection handle
+ *          [in] p_conn_params: the connection parameters
+ * @return  SUCCESS
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_gap_conn_param_update(uint16_t conn_handle, TKL_BLE_GAP_CONN_PARAMS_T const *p_conn_params)
+{
+    TKL_BLE_GAP_PARAMS_EVT_T gap_event;
+
+    if (NULL == p_conn_params) {
+        return OPRT_INVALID_PARM;
+    }
+    if (NULL == s_lb.mutex || LOOPBACK_CONN_HANDLE != conn_handle || !s_lb.connected) {
+        return OPRT_OS_ADAPTER_BLE_CONN_PARAM_UPDATE_FAILED;
+    }
+
+    tal_mutex_lock(s_lb.mutex);
+    // 1.25 ms units
+    s_lb.link.conn_interval_ms = p_conn_params->conn_interval_max * 5 / 4;
+    if (0 == s_lb.link.conn_interval_ms) {
+        s_lb.link.conn_interval_ms = 1;
+    }
+    tal_mutex_unlock(s_lb.mutex);
+
+    memset(&gap_event, 0, sizeof(gap_event));
+    gap_event.type = TKL_BLE_GAP_EVT_CONN_PARAM_UPDATE;
+    gap_event.conn_handle = conn_handle;
+    gap_event.result = 0;
+    gap_event.gap_event.conn_param = *p_conn_params;
+    __loopback_gap_event(&gap_event);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_tx_power_set(uint8_t role, int tx_power)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gap_rssi_get(uint16_t conn_handle)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gap_name_set(char *p_name)
+{
+    return OPRT_OK;
+}
+
+/******************************************************************************************************************************/
+/** @brief Define All Gatt Server Interface
+ */
+/**
+ * @brief   Add Ble Gatt Service, the handles are given out in attribute table
+ *          order and written back into p_service
+ * @param   [in] p_service: define the ble service
+ * @return  SUCCESS
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_gatts_service_add(TKL_BLE_GATTS_PARAMS_T *p_service)
+{
+    uint8_t i, j;
+
+    if (NULL == p_service || NULL == p_service->p_service) {
+        return OPRT_INVALID_PARM;
+    }
+
+    s_lb.handle_num = 0;
+    s_lb.write_handle = TKL_BLE_GATT_INVALID_HANDLE;
+    s_lb.notify_handle = TKL_BLE_GATT_INVALID_HANDLE;
+
+    for (i = 0; i < p_service->svc_num; i++) {
+        TKL_BLE_SERVICE_PARAMS_T *svc = &p_service->p_service[i];
+
+        svc->handle = ++s_lb.handle_num;
+        for (j = 0; j < svc->char_num && svc->p_char; j++) {
+            TKL_BLE_CHAR_PARAMS_T *chr = &svc->p_char[j];
+
+            // declaration, then the value
+            s_lb.handle_num++;
+            chr->handle = ++s_lb.handle_num;
+            if (chr->property & (TKL_BLE_GATT_CHAR_PROP_NOTIFY | TKL_BLE_GATT_CHAR_PROP_INDICATE)) {
+                s_lb.handle_num++; // cccd
+            }
+
+            if (TKL_BLE_GATT_INVALID_HANDLE == s_lb.write_handle &&
+                (chr->property & (TKL_BLE_GATT_CHAR_PROP_WRITE | TKL_BLE_GATT_CHAR_PROP_WRITE_NO_RSP))) {
+                s_lb.write_handle = chr->handle;
+            }
+            if (TKL_BLE_GATT_INVALID_HANDLE == s_lb.notify_handle && (chr->property & TKL_BLE_GATT_CHAR_PROP_NOTIFY)) {
+                s_lb.notify_handle = chr->handle;
+            }
+        }
+    }
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gatts_value_set(uint16_t conn_handle, uint16_t char_handle, uint8_t *p_data, uint16_t length)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_gatts_value_get(uint16_t conn_handle, uint16_t char_handle, uint8_t *p_data, uint16_t length)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+/**
+ * @brief   Notify an attribute value, queued for the next connection events
+ * @param   [in] conn_handle    Connection handle.
+ * @param   [in] char_handle    Attribute handle.
+ *          [in] p_data         Notify Values
+ *          [in] length         Value Length, at most the ATT MTU - 3
+ * @return  SUCCESS
+ *          OPRT_OS_ADAPTER_BLE_BUSY while the queue is full
+ * */
+OPERATE_RET tkl_ble_gatts_value_notify(uint16_t conn_handle, uint16_t char_handle, uint8_t *p_data, uint16_t length)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (NULL == s_lb.mutex || NULL == p_data) {
+        return OPRT_OS_ADAPTER_BLE_NOTIFY_FAILED;
+    }
+
+    tal_mutex_lock(s_lb.mutex);
+    if (!s_lb.connected || LOOPBACK_CONN_HANDLE != conn_handle || char_handle != s_lb.notify_handle) {
+        rt = OPRT_OS_ADAPTER_BLE_HANDLE_ERROR;
+    } else if (length > s_lb.mtu - LOOPBACK_ATT_HEADER_LEN) {
+        PR_ERR("ble loopback notify len %d over mtu %d", length, s_lb.mtu);
+        rt = OPRT_OS_ADAPTER_BLE_NOTIFY_FAILED;
+    } else {
+        rt = __loopback_push(&s_lb.up, LOOPBACK_PKT_DATA, p_data, length);
+        if (OPRT_OK != rt) {
+            s_lb.stat.notify_busy++;
+        }
+    }
+    tal_mutex_unlock(s_lb.mutex);
+
+    return rt;
+}
+
+OPERATE_RET tkl_ble_gatts_value_indicate(uint16_t conn_handle, uint16_t char_handle, uint8_t *p_data, uint16_t length)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+/**
+ * @brief   Start an ATT_MTU exchange, the result is reported by
+ *          TKL_BLE_GATT_EVT_MTU_REQUEST one round trip later
+ * @param   [in] conn_handle    Connection handle.
+ *          [in] server_rx_mtu  mtu size.
+ * @return  SUCCESS
+ *          ERROR
+ * */
+OPERATE_RET tkl_ble_gatts_exchange_mtu_reply(uint16_t conn_handle, uint16_t server_rx_mtu)
+{
+    return __loopback_mtu_exchange(conn_handle, server_rx_mtu);
+}
+
+/******************************************************************************************************************************/
+/** @brief Define All Gatt Client Interface, not emulated
+ */
+OPERATE_RET tkl_ble_gattc_all_service_discovery(uint16_t conn_handle)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gattc_all_char_discovery(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gattc_char_desc_discovery(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gattc_write_without_rsp(uint16_t conn_handle, uint16_t char_handle, uint8_t *p_data,
+                                            uint16_t length)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gattc_write(uint16_t conn_handle, uint16_t char_handle, uint8_t *p_data, uint16_t length)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gattc_read(uint16_t conn_handle, uint16_t char_handle)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tkl_ble_gattc_exchange_mtu_request(uint16_t conn_handle, uint16_t client_rx_mtu)
+{
+    return __loopback_mtu_exchange(conn_handle, client_rx_mtu);
+}
+
+OPERATE_RET tkl_ble_vendor_command_control(uint16_t opcode, void *user_data, uint16_t data_len)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+/******************************************************************************************************************************/
+/** @brief Peer side of the link, see tkl_ble_loopback.h
+ */
+OPERATE_RET tkl_ble_loopback_config(const TKL_BLE_LOOPBACK_CFG_T *cfg)
+{
+    if (NULL == cfg || cfg->mtu < TKL_BLE_LOOPBACK_MTU_MIN || cfg->mtu > TKL_BLE_LOOPBACK_MTU_MAX ||
+        0 == cfg->conn_interval_ms || cfg->loss_percent >= 100 || 0 == cfg->pkts_per_event ||
+        cfg->pkts_per_event > TKL_BLE_LOOPBACK_PKTS_PER_EVENT_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (s_lb.mutex) {
+        tal_mutex_lock(s_lb.mutex);
+    }
+    s_lb.cfg = *cfg;
+    if (s_lb.mutex) {
+        tal_mutex_unlock(s_lb.mutex);
+    }
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_loopback_peer_register(TKL_BLE_LOOPBACK_PEER_CB cb, void *arg)
+{
+    s_lb.peer_cb = cb;
+    s_lb.peer_arg = arg;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_loopback_connect(void)
+{
+    TKL_BLE_GAP_PARAMS_EVT_T gap_event;
+
+    if (NULL == s_lb.mutex) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    tal_mutex_lock(s_lb.mutex);
+    if (s_lb.connected || !s_lb.advertising || TKL_BLE_GATT_INVALID_HANDLE == s_lb.write_handle) {
+        tal_mutex_unlock(s_lb.mutex);
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    // a connectable advertising set stops once connected
+    s_lb.advertising = FALSE;
+    s_lb.connected = TRUE;
+    s_lb.conn_id++;
+    s_lb.link = s_lb.cfg;
+    s_lb.mtu = TKL_BLE_LOOPBACK_MTU_MIN;
+    __loopback_queue_reset();
+    memset(&s_lb.stat, 0, sizeof(s_lb.stat));
+    tal_mutex_unlock(s_lb.mutex);
+
+    memset(&gap_event, 0, sizeof(gap_event));
+    gap_event.type = TKL_BLE_GAP_EVT_CONNECT;
+    gap_event.conn_handle = LOOPBACK_CONN_HANDLE;
+    gap_event.result = 0;
+    gap_event.gap_event.connect.role = TKL_BLE_ROLE_SERVER;
+    gap_event.gap_event.connect.peer_addr.type = TKL_BLE_GAP_ADDR_TYPE_RANDOM;
+    memcpy(gap_event.gap_event.connect.peer_addr.addr, s_peer_addr, sizeof(s_peer_addr));
+    // 1.25 ms units
+    gap_event.gap_event.connect.conn_params.conn_interval_min = s_lb.link.conn_interval_ms * 4 / 5;
+    gap_event.gap_event.connect.conn_params.conn_interval_max = s_lb.link.conn_interval_ms * 4 / 5;
+    __loopback_gap_event(&gap_event);
+    __loopback_peer_event(TKL_BLE_LOOPBACK_EVT_CONNECTED, NULL, 0);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_loopback_disconnect(void)
+{
+    if (NULL == s_lb.mutex || !s_lb.connected) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    __loopback_link_down(TKL_BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_ble_loopback_write(const uint8_t *data, uint16_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (NULL == data || 0 == len) {
+        return OPRT_INVALID_PARM;
+    }
+    if (NULL == s_lb.mutex) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    tal_mutex_lock(s_lb.mutex);
+    if (!s_lb.connected) {
+        rt = OPRT_RESOURCE_NOT_READY;
+    } else if (len > s_lb.mtu - LOOPBACK_ATT_HEADER_LEN) {
+        rt = OPRT_INVALID_PARM;
+    } else {
+        rt = __loopback_push(&s_lb.down, LOOPBACK_PKT_DATA, data, len);
+    }
+    tal_mutex_unlock(s_lb.mutex);
+
+    return rt;
+}
+
+uint16_t tkl_ble_loopback_mtu_get(void)
+{
+    return s_lb.mtu;
+}
+
+void tkl_ble_loopback_stat_get(TKL_BLE_LOOPBACK_STAT_T *stat)
+{
+    if (NULL == stat) {
+        return;
+    }
+
+    if (s_lb.mutex) {
+        tal_mutex_lock(s_lb.mutex);
+    }
+    *stat = s_lb.stat;
+    if (s_lb.mutex) {
+        tal_mutex_unlock(s_lb.mutex);
+    }
+}
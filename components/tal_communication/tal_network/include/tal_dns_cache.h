@@ -0,0 +1,160 @@
+/**
+ * @file tal_dns_cache.h
+ * @brief Domain name resolution cache for Tuya SDK.
+ *
+ * tal_net_gethostbyname() answers from this cache. Resolved addresses are
+ * kept for a TTL and failed lookups for a shorter negative TTL. Once an
+ * entry has expired it is still served for a stale window while a refresh
+ * runs on the system workqueue, so reconnects do not wait for DNS. The
+ * resolved entries can be persisted through tal_kv; after a reboot they are
+ * loaded as stale, used right away and refreshed in the background.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __TAL_DNS_CACHE_H__
+#define __TAL_DNS_CACHE_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* number of cached domains */
+#ifndef TAL_DNS_CACHE_NUM
+#define TAL_DNS_CACHE_NUM 8
+#endif
+
+/* addresses kept per domain */
+#ifndef TAL_DNS_CACHE_ADDR_NUM
+#define TAL_DNS_CACHE_ADDR_NUM 4
+#endif
+
+/* default lifetimes in seconds */
+#ifndef TAL_DNS_CACHE_TTL_S
+#define TAL_DNS_CACHE_TTL_S 300
+#endif
+
+#ifndef TAL_DNS_CACHE_NEGATIVE_TTL_S
+#define TAL_DNS_CACHE_NEGATIVE_TTL_S 5
+#endif
+
+#ifndef TAL_DNS_CACHE_STALE_S
+#define TAL_DNS_CACHE_STALE_S 3600
+#endif
+
+/* least seconds between two automatic saves of changed addresses */
+#ifndef TAL_DNS_CACHE_SAVE_INTERVAL_S
+#define TAL_DNS_CACHE_SAVE_INTERVAL_S 600
+#endif
+
+/* longest domain that is cached, longer ones are always resolved */
+#define TAL_DNS_CACHE_NAME_MAX 63
+
+/* tal_kv key of the persisted cache */
+#define TAL_DNS_CACHE_KV_KEY "dns_cache"
+
+/**
+ * @brief resolver used on a cache miss or refresh
+ *
+ * @param[in] domain the domain name
+ * @param[out] addr the resolved addresses
+ * @param[in,out] num capacity of addr, number of addresses resolved
+ *
+ * @return OPRT_OK on success, others on error
+ */
+typedef OPERATE_RET (*TAL_DNS_RESOLVE_CB)(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num);
+
+typedef struct {
+    /** lifetime of a resolved address in seconds, 0 disables the cache */
+    uint32_t ttl_s;
+    /** lifetime of a failed lookup in seconds */
+    uint32_t negative_ttl_s;
+    /** how long an expired address is still served while it is refreshed */
+    uint32_t stale_s;
+    /** save changed addresses through tal_kv, at most once per TAL_DNS_CACHE_SAVE_INTERVAL_S, and load them now */
+    BOOL_T persist;
+} TAL_DNS_CACHE_CFG_T;
+
+typedef struct {
+    /** answered from a valid entry */
+    uint32_t hit;
+    /** answered from an expired entry while it was refreshed */
+    uint32_t stale_hit;
+    /** failure answered from a negative entry */
+    uint32_t negative_hit;
+    /** resolved by the caller */
+    uint32_t miss;
+    /** background refreshes */
+    uint32_t refresh;
+} TAL_DNS_CACHE_STAT_T;
+
+/**
+ * @brief Configure the cache, the defaults apply until it is called
+ *
+ * @param[in] cfg the cache config
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_dns_cache_config(const TAL_DNS_CACHE_CFG_T *cfg);
+
+/**
+ * @brief Replace the resolver behind the cache
+ *
+ * @param[in] cb the resolver, NULL restores the system resolver
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_dns_cache_set_resolver(TAL_DNS_RESOLVE_CB cb);
+
+/**
+ * @brief Resolve a domain through the cache
+ *
+ * @param[in] domain the domain name
+ * @param[out] addr the resolved addresses, in resolver order
+ * @param[in,out] num capacity of addr, number of addresses returned
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_dns_cache_resolve(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num);
+
+/**
+ * @brief Drop cached entries, e.g. after the address failed to connect
+ *
+ * @param[in] domain the domain to drop, NULL drops all
+ */
+void tal_dns_cache_flush(const char *domain);
+
+/**
+ * @brief Save the resolved entries through tal_kv
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_dns_cache_save(void);
+
+/**
+ * @brief Load the entries saved by tal_dns_cache_save, they are loaded as
+ * stale
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_dns_cache_load(void);
+
+/**
+ * @brief Get the cache statistics
+ *
+ * @param[out] stat the statistics
+ */
+void tal_dns_cache_stat_get(TAL_DNS_CACHE_STAT_T *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TAL_DNS_CACHE_H__
@@ -0,0 +1,157 @@
+/**
+ * @file tal_net_reactor.h
+ * @brief Shared single-thread I/O reactor for Tuya SDK.
+ *
+ * Connections that would otherwise own a thread blocking in select() or
+ * sleeping between reads can register their socket here instead. One reactor
+ * thread waits on all of them and calls back when a socket is ready, runs
+ * timers, and runs calls posted from other threads, so idle connections cost
+ * neither a stack nor periodic wakeups.
+ *
+ * Callbacks run on the reactor thread and must not block, a registered
+ * socket should be non-blocking or only be read once per readiness callback.
+ * Sources may be added and removed from any thread; once
+ * tal_net_reactor_del() returns, the callback of that fd is not running and
+ * will not be called again.
+ *
+ * The reactor is built on epoll, timerfd and eventfd and is only available
+ * on Linux, elsewhere tal_net_reactor_start() returns OPRT_NOT_SUPPORTED and
+ * callers keep their own threads.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __TAL_NET_REACTOR_H__
+#define __TAL_NET_REACTOR_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NET_REACTOR_STACK_SIZE
+#define NET_REACTOR_STACK_SIZE (4 * 1024)
+#endif
+
+/* events handled in one wakeup */
+#define NET_REACTOR_EVENT_NUM 16
+
+/* calls posted and not yet run, tal_net_reactor_call fails beyond it */
+#ifndef NET_REACTOR_CALL_NUM
+#define NET_REACTOR_CALL_NUM 32
+#endif
+
+/**
+ * @brief socket ready callback
+ *
+ * @param[in] fd the registered socket
+ * @param[in] events the ready TAL_NET_POLL_xxx events
+ * @param[in] arg the registered argument
+ */
+typedef void (*TAL_NET_REACTOR_CB)(int fd, uint8_t events, void *arg);
+
+/**
+ * @brief timer or posted call callback
+ *
+ * @param[in] arg the registered argument
+ */
+typedef void (*TAL_NET_REACTOR_FUNC)(void *arg);
+
+/**
+ * @brief Start the reactor thread, starting it again does nothing
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_start(void);
+
+/**
+ * @brief Stop the reactor thread, registered sources are dropped
+ */
+void tal_net_reactor_stop(void);
+
+/**
+ * @brief Check whether the reactor thread is running
+ *
+ * @return TRUE when running
+ */
+BOOL_T tal_net_reactor_is_running(void);
+
+/**
+ * @brief Watch a socket
+ *
+ * @param[in] fd the socket
+ * @param[in] events TAL_NET_POLL_READ and/or TAL_NET_POLL_WRITE, errors are
+ * always reported
+ * @param[in] cb called on the reactor thread while the socket is ready
+ * @param[in] arg passed to cb
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_add(int fd, uint8_t events, TAL_NET_REACTOR_CB cb, void *arg);
+
+/**
+ * @brief Change the events watched on a socket
+ *
+ * @param[in] fd the socket
+ * @param[in] events TAL_NET_POLL_READ and/or TAL_NET_POLL_WRITE
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_mod(int fd, uint8_t events);
+
+/**
+ * @brief Stop watching a socket, must be called before the socket is closed
+ *
+ * @param[in] fd the socket
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_del(int fd);
+
+/**
+ * @brief Start a timer on the reactor thread
+ *
+ * @param[in] interval_ms the timeout
+ * @param[in] periodic TRUE to fire every interval_ms
+ * @param[in] cb called on the reactor thread
+ * @param[in] arg passed to cb
+ * @param[out] timer_id the timer, for tal_net_reactor_timer_stop
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_timer_start(uint32_t interval_ms, BOOL_T periodic, TAL_NET_REACTOR_FUNC cb, void *arg,
+                                        int *timer_id);
+
+/**
+ * @brief Stop and free a timer, one-shot timers are freed after firing
+ *
+ * @param[in] timer_id the timer
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_timer_stop(int timer_id);
+
+/**
+ * @brief Run a function on the reactor thread
+ *
+ * @param[in] cb the function, calls run in the order they were posted
+ * @param[in] arg passed to cb
+ *
+ * @return OPRT_OK on success, OPRT_EXCEED_UPPER_LIMIT when NET_REACTOR_CALL_NUM
+ * calls are already pending. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_call(TAL_NET_REACTOR_FUNC cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TAL_NET_REACTOR_H__
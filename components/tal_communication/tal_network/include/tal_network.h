@@ -37,6 +37,11 @@ extern "C" {
 /* tuya sdk definition of 255.255.255.255 */
 #define TY_IPADDR_BROADCAST ((uint32_t)0xffffffffUL)
 
+/* events of tal_net_poll */
+#define TAL_NET_POLL_READ  0x01
+#define TAL_NET_POLL_WRITE 0x02
+#define TAL_NET_POLL_ERR   0x04
+
 /**
  * @brief Get error code of network
  *
@@ -49,6 +54,19 @@ extern "C" {
  */
 TUYA_ERRNO tal_net_get_errno(void);
 
+/**
+ * @brief Get the pending error of socket fd
+ *
+ * @param[in] fd: file descriptor
+ *
+ * @note This API is used to get the result of a non-blocking connect once the
+ * socket is writable.
+ *
+ * @return UNW_SUCCESS if there is no error. Others on error, please refer to
+ * UNW_xxx
+ */
+TUYA_ERRNO tal_net_get_socket_error(const int fd);
+
 /**
  * @brief Add file descriptor to set
  *
@@ -124,6 +142,20 @@ OPERATE_RET tal_net_fd_zero(TUYA_FD_SET_T *fds);
 int tal_net_select(const int maxfd, TUYA_FD_SET_T *readfds, TUYA_FD_SET_T *writefds, TUYA_FD_SET_T *errorfds,
                    const uint32_t ms_timeout);
 
+/**
+ * @brief Wait for socket fd to become ready
+ *
+ * @param[in] fd: file descriptor
+ * @param[in] events: TAL_NET_POLL_READ and/or TAL_NET_POLL_WRITE
+ * @param[in] timeout_ms: time to wait, negative waits forever
+ *
+ * @note This API is used to block on the readiness of one socket instead of
+ * sleeping and retrying, a closed peer is reported as readable.
+ *
+ * @return the ready TAL_NET_POLL_xxx events, 0 on timeout, < 0 on error
+ */
+int tal_net_poll(const int fd, const uint8_t events, const int timeout_ms);
+
 /**
  * @brief Get no block file descriptors
  *
@@ -392,6 +424,35 @@ OPERATE_RET tal_net_set_broadcast(const int fd);
  */
 OPERATE_RET tal_net_gethostbyname(const char *domain, TUYA_IP_ADDR_T *addr);
 
+/**
+ * @brief Get all addresses of a domain
+ *
+ * @param[in] domain: domain information
+ * @param[out] addr: address list
+ * @param[in,out] num: capacity of the list, number of addresses returned
+ *
+ * @note This API is used for getting all addresses of a domain, the answer
+ * comes from the dns cache when it is valid.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_gethostbyname_all(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num);
+
+/**
+ * @brief Get all addresses of a domain, bypassing the dns cache
+ *
+ * @param[in] domain: domain information
+ * @param[out] addr: address list
+ * @param[in,out] num: capacity of the list, number of addresses returned
+ *
+ * @note This API is used for getting address information by domain.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_gethostbyname_nocache(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num);
+
 /**
  * @brief Set keepalive option of socket fd to monitor the connection
  *
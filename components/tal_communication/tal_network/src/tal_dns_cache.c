@@ -0,0 +1,494 @@
+/**
+ * @file tal_dns_cache.c
+ * @brief Domain name resolution cache for Tuya SDK.
+ *
+ * The system resolvers do not report the record TTL, so entries live for a
+ * configured TTL. The cache is a small LRU table protected by one mutex
+ * which is never held while resolving.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <string.h>
+
+#include "tal_api.h"
+#include "tal_kv.h"
+#include "tal_network.h"
+#include "tal_dns_cache.h"
+
+typedef struct {
+    char domain[TAL_DNS_CACHE_NAME_MAX + 1];
+    TUYA_IP_ADDR_T addr[TAL_DNS_CACHE_ADDR_NUM];
+    uint8_t addr_num;
+    OPERATE_RET err;
+    SYS_TIME_T stamp;  // time of the last resolution
+    SYS_TIME_T failed; // time of the last failed refresh, 0 if none
+    SYS_TIME_T used;
+    uint8_t valid;
+    uint8_t negative;
+    uint8_t refreshing;
+} DNS_ENTRY_T;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    TAL_DNS_RESOLVE_CB resolve;
+    SYS_TIME_T ttl_ms;
+    SYS_TIME_T negative_ttl_ms;
+    SYS_TIME_T stale_ms;
+    BOOL_T persist;
+    BOOL_T dirty;     // persisted addresses changed since the last save
+    SYS_TIME_T saved; // time of the last save, 0 before the first one
+    TAL_DNS_CACHE_STAT_T stat;
+    DNS_ENTRY_T entry[TAL_DNS_CACHE_NUM];
+} DNS_CACHE_T;
+
+static DNS_CACHE_T s_dns_cache = {
+    .ttl_ms = TAL_DNS_CACHE_TTL_S * 1000,
+    .negative_ttl_ms = TAL_DNS_CACHE_NEGATIVE_TTL_S * 1000,
+    .stale_ms = TAL_DNS_CACHE_STALE_S * 1000,
+};
+
+static OPERATE_RET __dns_cache_lock(void)
+{
+    MUTEX_HANDLE mutex = __atomic_load_n(&s_dns_cache.mutex, __ATOMIC_ACQUIRE);
+    MUTEX_HANDLE expected = NULL;
+
+    if (NULL == mutex) {
+        if (OPRT_OK != tal_mutex_create_init(&mutex)) {
+            return OPRT_COM_ERROR;
+        }
+        // first caller wins, the others drop their mutex
+        if (!__atomic_compare_exchange_n(&s_dns_cache.mutex, &expected, mutex, FALSE, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            tal_mutex_release(mutex);
+            mutex = expected;
+        }
+    }
+
+    return tal_mutex_lock(mutex);
+}
+
+static void __dns_cache_unlock(void)
+{
+    tal_mutex_unlock(s_dns_cache.mutex);
+}
+
+static DNS_ENTRY_T *__dns_cache_find(const char *domain)
+{
+    int i;
+
+    for (i = 0; i < TAL_DNS_CACHE_NUM; i++) {
+        if (s_dns_cache.entry[i].valid && 0 == strcmp(s_dns_cache.entry[i].domain, domain)) {
+            return &s_dns_cache.entry[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* entry of the domain, a free one or the least recently used one */
+static DNS_ENTRY_T *__dns_cache_slot(const char *domain, SYS_TIME_T now)
+{
+    DNS_ENTRY_T *entry = __dns_cache_find(domain);
+    DNS_ENTRY_T *lru = NULL;
+    int i;
+
+    if (entry) {
+        return entry;
+    }
+
+    for (i = 0; i < TAL_DNS_CACHE_NUM; i++) {
+        entry = &s_dns_cache.entry[i];
+        if (!entry->valid) {
+            lru = entry;
+            break;
+        }
+        if (NULL == lru || (SYS_TIME_T)(now - entry->used) > (SYS_TIME_T)(now - lru->used)) {
+            lru = entry;
+        }
+    }
+
+    memset(lru, 0, sizeof(DNS_ENTRY_T));
+    strcpy(lru->domain, domain);
+    lru->valid = 1;
+
+    return lru;
+}
+
+/* address lists are equal as sets, resolvers may rotate the order on every lookup */
+static BOOL_T __dns_addr_same(const TUYA_IP_ADDR_T *a, uint8_t a_num, const TUYA_IP_ADDR_T *b, uint8_t b_num)
+{
+    uint8_t i, j;
+
+    if (a_num != b_num) {
+        return FALSE;
+    }
+
+    for (i = 0; i < a_num; i++) {
+        for (j = 0; j < b_num && a[i] != b[j]; j++) {
+        }
+        if (j == b_num) {
+            return FALSE;
+        }
+    }
+    for (j = 0; j < b_num; j++) {
+        for (i = 0; i < a_num && a[i] != b[j]; i++) {
+        }
+        if (i == a_num) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief store a resolution result
+ *
+ * @return TRUE if persisted addresses changed and the save interval has passed
+ */
+static BOOL_T __dns_cache_store(const char *domain, OPERATE_RET err, const TUYA_IP_ADDR_T *addr, uint8_t num)
+{
+    DNS_ENTRY_T *entry;
+    BOOL_T changed = FALSE;
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        return FALSE;
+    }
+
+    entry = __dns_cache_find(domain);
+    if (OPRT_OK != err && entry && !entry->negative) {
+        // keep the address, back off a negative TTL before resolving it again
+        entry->err = err;
+        entry->failed = now ? now : 1;
+        entry->refreshing = 0;
+        __dns_cache_unlock();
+        return FALSE;
+    }
+
+    if (NULL == entry) {
+        entry = __dns_cache_slot(domain, now);
+        entry->used = now;
+    }
+
+    if (OPRT_OK == err) {
+        changed = entry->negative || 0 == entry->stamp || !__dns_addr_same(entry->addr, entry->addr_num, addr, num);
+        memcpy(entry->addr, addr, num * sizeof(TUYA_IP_ADDR_T));
+        entry->addr_num = num;
+        entry->negative = 0;
+        entry->failed = 0;
+    } else {
+        entry->err = err;
+        entry->negative = 1;
+    }
+    entry->stamp = now;
+    entry->refreshing = 0;
+
+    // a change within the interval is written along with the first result stored after it
+    if (changed && s_dns_cache.persist) {
+        s_dns_cache.dirty = TRUE;
+    }
+    changed = s_dns_cache.dirty &&
+              (0 == s_dns_cache.saved || now - s_dns_cache.saved >= (SYS_TIME_T)TAL_DNS_CACHE_SAVE_INTERVAL_S * 1000);
+    __dns_cache_unlock();
+
+    return changed;
+}
+
+static OPERATE_RET __dns_resolve(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num)
+{
+    TAL_DNS_RESOLVE_CB resolve = __atomic_load_n(&s_dns_cache.resolve, __ATOMIC_ACQUIRE);
+    OPERATE_RET rt;
+
+    if (resolve) {
+        rt = resolve(domain, addr, num);
+    } else {
+        rt = tal_net_gethostbyname_nocache(domain, addr, num);
+    }
+
+    if (OPRT_OK == rt && 0 == *num) {
+        rt = OPRT_NOT_FOUND;
+    }
+
+    return rt;
+}
+
+static uint8_t __dns_addr_copy(TUYA_IP_ADDR_T *addr, uint8_t num, const DNS_ENTRY_T *entry)
+{
+    num = (num < entry->addr_num) ? num : entry->addr_num;
+    memcpy(addr, entry->addr, num * sizeof(TUYA_IP_ADDR_T));
+
+    return num;
+}
+
+static void __dns_cache_refresh(void *data)
+{
+    char *domain = (char *)data;
+    TUYA_IP_ADDR_T addr[TAL_DNS_CACHE_ADDR_NUM];
+    uint8_t num = TAL_DNS_CACHE_ADDR_NUM;
+    OPERATE_RET rt;
+
+    rt = __dns_resolve(domain, addr, &num);
+    PR_DEBUG("dns refresh %s %d", domain, rt);
+    if (__dns_cache_store(domain, rt, addr, num)) {
+        tal_dns_cache_save();
+    }
+
+    tal_free(domain);
+}
+
+OPERATE_RET tal_dns_cache_config(const TAL_DNS_CACHE_CFG_T *cfg)
+{
+    if (NULL == cfg) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        return OPRT_COM_ERROR;
+    }
+    s_dns_cache.ttl_ms = (SYS_TIME_T)cfg->ttl_s * 1000;
+    s_dns_cache.negative_ttl_ms = (SYS_TIME_T)cfg->negative_ttl_s * 1000;
+    s_dns_cache.stale_ms = (SYS_TIME_T)cfg->stale_s * 1000;
+    s_dns_cache.persist = cfg->persist;
+    __dns_cache_unlock();
+
+    if (cfg->persist) {
+        tal_dns_cache_load();
+    }
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_dns_cache_set_resolver(TAL_DNS_RESOLVE_CB cb)
+{
+    __atomic_store_n(&s_dns_cache.resolve, cb, __ATOMIC_RELEASE);
+    tal_dns_cache_flush(NULL);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_dns_cache_resolve(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num)
+{
+    OPERATE_RET rt = OPRT_OK;
+    DNS_ENTRY_T *entry;
+    SYS_TIME_T now, age;
+    BOOL_T backoff;
+    TUYA_IP_ADDR_T resolved[TAL_DNS_CACHE_ADDR_NUM];
+    uint8_t resolved_num = TAL_DNS_CACHE_ADDR_NUM;
+    char *refresh = NULL;
+
+    if (NULL == domain || NULL == addr || NULL == num || 0 == *num) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (0 == s_dns_cache.ttl_ms || strlen(domain) > TAL_DNS_CACHE_NAME_MAX) {
+        return __dns_resolve(domain, addr, num);
+    }
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        return __dns_resolve(domain, addr, num);
+    }
+
+    now = tal_system_get_millisecond();
+    entry = __dns_cache_find(domain);
+    if (entry) {
+        entry->used = now;
+        age = now - entry->stamp;
+        backoff = entry->failed && now - entry->failed < s_dns_cache.negative_ttl_ms;
+        if (entry->negative) {
+            if (age < s_dns_cache.negative_ttl_ms) {
+                s_dns_cache.stat.negative_hit++;
+                rt = entry->err;
+                __dns_cache_unlock();
+                return rt;
+            }
+        } else if (age < s_dns_cache.ttl_ms) {
+            s_dns_cache.stat.hit++;
+            *num = __dns_addr_copy(addr, *num, entry);
+            __dns_cache_unlock();
+            return OPRT_OK;
+        } else if (age < s_dns_cache.ttl_ms + s_dns_cache.stale_ms) {
+            s_dns_cache.stat.stale_hit++;
+            *num = __dns_addr_copy(addr, *num, entry);
+            if (!entry->refreshing && !backoff) {
+                entry->refreshing = 1;
+                s_dns_cache.stat.refresh++;
+                refresh = tal_malloc(strlen(domain) + 1);
+                if (refresh) {
+                    strcpy(refresh, domain);
+                } else {
+                    entry->refreshing = 0;
+                }
+            }
+            __dns_cache_unlock();
+
+            if (refresh && OPRT_OK != tal_workq_schedule(WORKQ_SYSTEM, __dns_cache_refresh, refresh)) {
+                __dns_cache_store(domain, OPRT_COM_ERROR, NULL, 0);
+                tal_free(refresh);
+            }
+            return OPRT_OK;
+        } else if (backoff) {
+            s_dns_cache.stat.negative_hit++;
+            rt = entry->err;
+            __dns_cache_unlock();
+            return rt;
+        }
+    }
+    s_dns_cache.stat.miss++;
+    __dns_cache_unlock();
+
+    rt = __dns_resolve(domain, resolved, &resolved_num);
+    if (OPRT_OK == rt) {
+        *num = (*num < resolved_num) ? *num : resolved_num;
+        memcpy(addr, resolved, *num * sizeof(TUYA_IP_ADDR_T));
+    }
+    if (__dns_cache_store(domain, rt, resolved, resolved_num)) {
+        tal_dns_cache_save();
+    }
+
+    return rt;
+}
+
+void tal_dns_cache_flush(const char *domain)
+{
+    DNS_ENTRY_T *entry;
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        return;
+    }
+
+    if (NULL == domain) {
+        memset(s_dns_cache.entry, 0, sizeof(s_dns_cache.entry));
+    } else if (NULL != (entry = __dns_cache_find(domain))) {
+        // a pending refresh finds no entry and stores a fresh one
+        memset(entry, 0, sizeof(DNS_ENTRY_T));
+    }
+    __dns_cache_unlock();
+}
+
+/*
+ * persisted format, per resolved entry:
+ * | len(1) | domain(len) | num(1) | num * addr(4, big endian) |
+ */
+OPERATE_RET tal_dns_cache_save(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *buf = NULL;
+    uint32_t len = 0, name_len;
+    DNS_ENTRY_T *entry;
+    int i, j;
+
+    buf = tal_malloc(TAL_DNS_CACHE_NUM * (1 + TAL_DNS_CACHE_NAME_MAX + 1 + TAL_DNS_CACHE_ADDR_NUM * 4));
+    if (NULL == buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        tal_free(buf);
+        return OPRT_COM_ERROR;
+    }
+    for (i = 0; i < TAL_DNS_CACHE_NUM; i++) {
+        entry = &s_dns_cache.entry[i];
+        if (!entry->valid || entry->negative) {
+            continue;
+        }
+        name_len = strlen(entry->domain);
+        buf[len++] = name_len;
+        memcpy(buf + len, entry->domain, name_len);
+        len += name_len;
+        buf[len++] = entry->addr_num;
+        for (j = 0; j < entry->addr_num; j++) {
+            buf[len++] = entry->addr[j] >> 24;
+            buf[len++] = entry->addr[j] >> 16;
+            buf[len++] = entry->addr[j] >> 8;
+            buf[len++] = entry->addr[j];
+        }
+    }
+    s_dns_cache.dirty = FALSE;
+    s_dns_cache.saved = tal_system_get_millisecond();
+    __dns_cache_unlock();
+
+    if (len) {
+        rt = tal_kv_set(TAL_DNS_CACHE_KV_KEY, buf, len);
+    } else {
+        tal_kv_del(TAL_DNS_CACHE_KV_KEY);
+    }
+    tal_free(buf);
+
+    // retried with the next result stored after the interval
+    if (OPRT_OK != rt && OPRT_OK == __dns_cache_lock()) {
+        s_dns_cache.dirty = TRUE;
+        __dns_cache_unlock();
+    }
+
+    return rt;
+}
+
+OPERATE_RET tal_dns_cache_load(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *buf = NULL;
+    size_t len = 0, pos = 0;
+    uint32_t name_len, num, i;
+    char domain[TAL_DNS_CACHE_NAME_MAX + 1];
+    DNS_ENTRY_T *entry;
+    SYS_TIME_T now;
+
+    rt = tal_kv_get(TAL_DNS_CACHE_KV_KEY, &buf, &len);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        tal_kv_free(buf);
+        return OPRT_COM_ERROR;
+    }
+    now = tal_system_get_millisecond();
+    while (pos < len) {
+        name_len = buf[pos++];
+        if (0 == name_len || name_len > TAL_DNS_CACHE_NAME_MAX || pos + name_len + 1 > len) {
+            rt = OPRT_COM_ERROR;
+            break;
+        }
+        memcpy(domain, buf + pos, name_len);
+        domain[name_len] = 0;
+        pos += name_len;
+        num = buf[pos++];
+        if (0 == num || num > TAL_DNS_CACHE_ADDR_NUM || pos + num * 4 > len) {
+            rt = OPRT_COM_ERROR;
+            break;
+        }
+
+        entry = __dns_cache_slot(domain, now);
+        if (0 == entry->stamp) {
+            // loaded entries start out expired: served at once and refreshed in the background
+            for (i = 0; i < num; i++) {
+                entry->addr[i] = ((uint32_t)buf[pos + i * 4] << 24) | ((uint32_t)buf[pos + i * 4 + 1] << 16) |
+                                 ((uint32_t)buf[pos + i * 4 + 2] << 8) | buf[pos + i * 4 + 3];
+            }
+            entry->addr_num = num;
+            entry->stamp = now - s_dns_cache.ttl_ms;
+            entry->used = now;
+        }
+        pos += num * 4;
+    }
+    __dns_cache_unlock();
+    tal_kv_free(buf);
+
+    return rt;
+}
+
+void tal_dns_cache_stat_get(TAL_DNS_CACHE_STAT_T *stat)
+{
+    if (NULL == stat) {
+        return;
+    }
+
+    if (OPRT_OK != __dns_cache_lock()) {
+        memset(stat, 0, sizeof(TAL_DNS_CACHE_STAT_T));
+        return;
+    }
+    *stat = s_dns_cache.stat;
+    __dns_cache_unlock();
+}
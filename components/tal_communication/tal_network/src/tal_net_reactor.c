@@ -0,0 +1,646 @@
+/**
+ * @file tal_net_reactor.c
+ * @brief Shared single-thread I/O reactor for Tuya SDK.
+ *
+ * Sockets, timerfd timers and an eventfd for posted calls are watched by one
+ * epoll instance. Every source carries a sequence number in its epoll data so
+ * an event that was already fetched for a source removed meanwhile, or for a
+ * reused fd, is dropped. The reactor mutex is recursive and is held while
+ * callbacks run, which lets callbacks change sources and lets other threads
+ * wait for a running callback before removing its source.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <string.h>
+
+#include "tuya_iot_config.h"
+#include "tal_api.h"
+#include "tal_network.h"
+#include "tuya_queue.h"
+#include "tal_net_reactor.h"
+
+#if 100 == OPERATING_SYSTEM
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+/* epoll data of the eventfd, sources start at sequence 1 */
+#define REACTOR_WAKEUP_DATA 0
+
+typedef struct {
+    LIST_HEAD node;
+    int fd;
+    uint32_t seq;
+    uint8_t is_timer;
+    uint8_t periodic;
+    TAL_NET_REACTOR_CB cb;
+    TAL_NET_REACTOR_FUNC func;
+    void *arg;
+} REACTOR_SRC_T;
+
+typedef struct {
+    TAL_NET_REACTOR_FUNC func;
+    void *arg;
+} REACTOR_CALL_T;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    THREAD_HANDLE thread;
+    BOOL_T running;
+    int epfd;
+    int evfd;
+    uint32_t seq;
+    LIST_HEAD srcs;
+    TUYA_QUEUE_HANDLE calls;
+} NET_REACTOR_T;
+
+static NET_REACTOR_T s_reactor = {
+    .epfd = -1,
+    .evfd = -1,
+};
+
+static OPERATE_RET __reactor_lock(void)
+{
+    MUTEX_HANDLE mutex = __atomic_load_n(&s_reactor.mutex, __ATOMIC_ACQUIRE);
+    MUTEX_HANDLE expected = NULL;
+
+    if (NULL == mutex) {
+        if (OPRT_OK != tal_mutex_create_init(&mutex)) {
+            return OPRT_COM_ERROR;
+        }
+        // first caller wins, the others drop their mutex
+        if (!__atomic_compare_exchange_n(&s_reactor.mutex, &expected, mutex, FALSE, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            tal_mutex_release(mutex);
+            mutex = expected;
+        }
+    }
+
+    return tal_mutex_lock(mutex);
+}
+
+static void __reactor_unlock(void)
+{
+    tal_mutex_unlock(s_reactor.mutex);
+}
+
+static uint32_t __reactor_to_epoll(uint8_t events)
+{
+    return ((events & TAL_NET_POLL_READ) ? EPOLLIN : 0) | ((events & TAL_NET_POLL_WRITE) ? EPOLLOUT : 0);
+}
+
+static uint8_t __reactor_from_epoll(uint32_t events)
+{
+    return ((events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) ? TAL_NET_POLL_READ : 0) |
+           ((events & EPOLLOUT) ? TAL_NET_POLL_WRITE : 0) | ((events & EPOLLERR) ? TAL_NET_POLL_ERR : 0);
+}
+
+static void __reactor_wakeup(void)
+{
+    uint64_t one = 1;
+
+    if (write(s_reactor.evfd, &one, sizeof(one)) < 0) {
+        PR_ERR("reactor wakeup err:%d", errno);
+    }
+}
+
+static REACTOR_SRC_T *__reactor_src_find(int fd, uint32_t seq)
+{
+    LIST_HEAD *pos = NULL;
+
+    tuya_list_for_each(pos, &s_reactor.srcs)
+    {
+        REACTOR_SRC_T *src = tuya_list_entry(pos, REACTOR_SRC_T, node);
+        if ((src->fd == fd) && ((0 == seq) || (src->seq == seq))) {
+            return src;
+        }
+    }
+
+    return NULL;
+}
+
+static OPERATE_RET __reactor_src_add(REACTOR_SRC_T *src, uint32_t events)
+{
+    struct epoll_event ev;
+
+    if (!s_reactor.running) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    if (__reactor_src_find(src->fd, 0)) {
+        return OPRT_COM_ERROR;
+    }
+
+    if (0 == ++s_reactor.seq) {
+        s_reactor.seq = 1;
+    }
+    src->seq = s_reactor.seq;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = ((uint64_t)src->seq << 32) | (uint32_t)src->fd;
+    if (epoll_ctl(s_reactor.epfd, EPOLL_CTL_ADD, src->fd, &ev) < 0) {
+        PR_ERR("reactor add fd %d err:%d", src->fd, errno);
+        return OPRT_COM_ERROR;
+    }
+    tuya_list_add_tail(&src->node, &s_reactor.srcs);
+
+    return OPRT_OK;
+}
+
+static void __reactor_src_free(REACTOR_SRC_T *src)
+{
+    epoll_ctl(s_reactor.epfd, EPOLL_CTL_DEL, src->fd, NULL);
+    if (src->is_timer) {
+        close(src->fd);
+    }
+    tuya_list_del(&src->node);
+    tal_free(src);
+}
+
+static void __reactor_dispatch(struct epoll_event *ev)
+{
+    int fd = (int)(uint32_t)ev->data.u64;
+    uint32_t seq = (uint32_t)(ev->data.u64 >> 32);
+    REACTOR_SRC_T *src = NULL;
+    uint64_t cnt = 0;
+
+    if (REACTOR_WAKEUP_DATA == seq) {
+        if (read(s_reactor.evfd, &cnt, sizeof(cnt)) < 0) {
+            PR_ERR("reactor wakeup read err:%d", errno);
+        }
+        return;
+    }
+
+    // dropped when removed after the event was fetched
+    src = __reactor_src_find(fd, seq);
+    if (NULL == src) {
+        return;
+    }
+
+    if (src->is_timer) {
+        TAL_NET_REACTOR_FUNC func = src->func;
+        void *arg = src->arg;
+
+        if (read(fd, &cnt, sizeof(cnt)) < 0) {
+            return;
+        }
+        if (!src->periodic) {
+            __reactor_src_free(src);
+        }
+        func(arg);
+        return;
+    }
+
+    src->cb(fd, __reactor_from_epoll(ev->events), src->arg);
+}
+
+static void __reactor_run_calls(void)
+{
+    REACTOR_CALL_T calls[NET_REACTOR_EVENT_NUM];
+    uint32_t num = 0, i;
+
+    // calls posted by a running call land behind this batch and are picked up by the next one
+    while (OPRT_OK == tuya_queue_output_batch(s_reactor.calls, calls, NET_REACTOR_EVENT_NUM, &num)) {
+        for (i = 0; i < num; i++) {
+            calls[i].func(calls[i].arg);
+        }
+    }
+}
+
+static void __reactor_cleanup(void)
+{
+    LIST_HEAD *pos = NULL, *n = NULL;
+
+    tuya_list_for_each_safe(pos, n, &s_reactor.srcs)
+    {
+        __reactor_src_free(tuya_list_entry(pos, REACTOR_SRC_T, node));
+    }
+    if (s_reactor.calls) {
+        tuya_queue_release(s_reactor.calls);
+        s_reactor.calls = NULL;
+    }
+
+    if (s_reactor.evfd >= 0) {
+        close(s_reactor.evfd);
+        s_reactor.evfd = -1;
+    }
+    if (s_reactor.epfd >= 0) {
+        close(s_reactor.epfd);
+        s_reactor.epfd = -1;
+    }
+}
+
+static void __reactor_thread(void *arg)
+{
+    struct epoll_event ev[NET_REACTOR_EVENT_NUM];
+    int num, i;
+
+    while (__atomic_load_n(&s_reactor.running, __ATOMIC_ACQUIRE)) {
+        num = epoll_wait(s_reactor.epfd, ev, NET_REACTOR_EVENT_NUM, -1);
+        if (num < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            PR_ERR("reactor wait err:%d", errno);
+            break;
+        }
+
+        __reactor_lock();
+        for (i = 0; i < num; i++) {
+            __reactor_dispatch(&ev[i]);
+        }
+        __reactor_run_calls();
+        __reactor_unlock();
+    }
+
+    __reactor_lock();
+    s_reactor.running = FALSE;
+    __reactor_cleanup();
+    __reactor_unlock();
+    PR_DEBUG("net reactor exit");
+}
+
+/**
+ * @brief Start the reactor thread, starting it again does nothing
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_start(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    struct epoll_event ev;
+
+    if (OPRT_OK != __reactor_lock()) {
+        return OPRT_COM_ERROR;
+    }
+    if (s_reactor.running) {
+        __reactor_unlock();
+        return OPRT_OK;
+    }
+    // a stopped reactor thread may still be on its way out
+    if (s_reactor.epfd >= 0) {
+        __reactor_unlock();
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    INIT_LIST_HEAD(&s_reactor.srcs);
+    // producers and the consumer all hold the reactor mutex, so the queue needs no lock of its own
+    rt = tuya_queue_create_ex(NET_REACTOR_CALL_NUM, sizeof(REACTOR_CALL_T), TUYA_QUEUE_SPSC, &s_reactor.calls);
+    if (OPRT_OK != rt) {
+        goto __exit;
+    }
+    s_reactor.epfd = epoll_create1(EPOLL_CLOEXEC);
+    s_reactor.evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((s_reactor.epfd < 0) || (s_reactor.evfd < 0)) {
+        PR_ERR("reactor create err:%d", errno);
+        rt = OPRT_COM_ERROR;
+        goto __exit;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_WAKEUP_DATA;
+    if (epoll_ctl(s_reactor.epfd, EPOLL_CTL_ADD, s_reactor.evfd, &ev) < 0) {
+        rt = OPRT_COM_ERROR;
+        goto __exit;
+    }
+
+    s_reactor.running = TRUE;
+    THREAD_CFG_T thread_cfg = {
+        .priority = THREAD_PRIO_2, .stackDepth = NET_REACTOR_STACK_SIZE, .thrdname = "net_reactor"};
+    rt = tal_thread_create_and_start(&s_reactor.thread, NULL, NULL, __reactor_thread, NULL, &thread_cfg);
+    if (OPRT_OK != rt) {
+        s_reactor.running = FALSE;
+        goto __exit;
+    }
+    __reactor_unlock();
+
+    PR_DEBUG("net reactor start");
+    return OPRT_OK;
+
+__exit:
+    __reactor_cleanup();
+    __reactor_unlock();
+    return rt;
+}
+
+/**
+ * @brief Stop the reactor thread, registered sources are dropped
+ */
+void tal_net_reactor_stop(void)
+{
+    THREAD_HANDLE thread = NULL;
+
+    if (OPRT_OK != __reactor_lock()) {
+        return;
+    }
+    if (s_reactor.running) {
+        __atomic_store_n(&s_reactor.running, FALSE, __ATOMIC_RELEASE);
+        __reactor_wakeup();
+        thread = s_reactor.thread;
+        s_reactor.thread = NULL;
+    }
+    __reactor_unlock();
+
+    if (thread) {
+        tal_thread_delete(thread);
+    }
+}
+
+/**
+ * @brief Check whether the reactor thread is running
+ *
+ * @return TRUE when running
+ */
+BOOL_T tal_net_reactor_is_running(void)
+{
+    return __atomic_load_n(&s_reactor.running, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Watch a socket
+ *
+ * @param[in] fd the socket
+ * @param[in] events TAL_NET_POLL_READ and/or TAL_NET_POLL_WRITE, errors are
+ * always reported
+ * @param[in] cb called on the reactor thread while the socket is ready
+ * @param[in] arg passed to cb
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_add(int fd, uint8_t events, TAL_NET_REACTOR_CB cb, void *arg)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REACTOR_SRC_T *src = NULL;
+
+    if ((fd < 0) || (NULL == cb)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    src = tal_malloc(sizeof(REACTOR_SRC_T));
+    if (NULL == src) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(src, 0, sizeof(REACTOR_SRC_T));
+    src->fd = fd;
+    src->cb = cb;
+    src->arg = arg;
+
+    if (OPRT_OK != __reactor_lock()) {
+        tal_free(src);
+        return OPRT_COM_ERROR;
+    }
+    rt = __reactor_src_add(src, __reactor_to_epoll(events) | EPOLLRDHUP);
+    __reactor_unlock();
+
+    if (OPRT_OK != rt) {
+        tal_free(src);
+    }
+
+    return rt;
+}
+
+/**
+ * @brief Change the events watched on a socket
+ *
+ * @param[in] fd the socket
+ * @param[in] events TAL_NET_POLL_READ and/or TAL_NET_POLL_WRITE
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_mod(int fd, uint8_t events)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REACTOR_SRC_T *src = NULL;
+    struct epoll_event ev;
+
+    if (OPRT_OK != __reactor_lock()) {
+        return OPRT_COM_ERROR;
+    }
+
+    src = __reactor_src_find(fd, 0);
+    if ((NULL == src) || src->is_timer) {
+        rt = OPRT_NOT_FOUND;
+    } else {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = __reactor_to_epoll(events) | EPOLLRDHUP;
+        ev.data.u64 = ((uint64_t)src->seq << 32) | (uint32_t)src->fd;
+        if (epoll_ctl(s_reactor.epfd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            rt = OPRT_COM_ERROR;
+        }
+    }
+    __reactor_unlock();
+
+    return rt;
+}
+
+/**
+ * @brief Stop watching a socket, must be called before the socket is closed
+ *
+ * @param[in] fd the socket
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_del(int fd)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REACTOR_SRC_T *src = NULL;
+
+    if (OPRT_OK != __reactor_lock()) {
+        return OPRT_COM_ERROR;
+    }
+
+    src = __reactor_src_find(fd, 0);
+    if ((NULL == src) || src->is_timer) {
+        rt = OPRT_NOT_FOUND;
+    } else {
+        __reactor_src_free(src);
+    }
+    __reactor_unlock();
+
+    return rt;
+}
+
+/**
+ * @brief Start a timer on the reactor thread
+ *
+ * @param[in] interval_ms the timeout
+ * @param[in] periodic TRUE to fire every interval_ms
+ * @param[in] cb called on the reactor thread
+ * @param[in] arg passed to cb
+ * @param[out] timer_id the timer, for tal_net_reactor_timer_stop
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_timer_start(uint32_t interval_ms, BOOL_T periodic, TAL_NET_REACTOR_FUNC cb, void *arg,
+                                        int *timer_id)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REACTOR_SRC_T *src = NULL;
+    struct itimerspec its;
+
+    if ((NULL == cb) || (0 == interval_ms)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    src = tal_malloc(sizeof(REACTOR_SRC_T));
+    if (NULL == src) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(src, 0, sizeof(REACTOR_SRC_T));
+    src->is_timer = 1;
+    src->periodic = periodic ? 1 : 0;
+    src->func = cb;
+    src->arg = arg;
+
+    src->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (src->fd < 0) {
+        PR_ERR("reactor timer create err:%d", errno);
+        tal_free(src);
+        return OPRT_COM_ERROR;
+    }
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = interval_ms / 1000;
+    its.it_value.tv_nsec = (interval_ms % 1000) * 1000000;
+    if (periodic) {
+        its.it_interval = its.it_value;
+    }
+    timerfd_settime(src->fd, 0, &its, NULL);
+
+    if (OPRT_OK != __reactor_lock()) {
+        rt = OPRT_COM_ERROR;
+    } else {
+        rt = __reactor_src_add(src, EPOLLIN);
+        if ((OPRT_OK == rt) && timer_id) {
+            *timer_id = src->fd;
+        }
+        __reactor_unlock();
+    }
+
+    if (OPRT_OK != rt) {
+        close(src->fd);
+        tal_free(src);
+    }
+
+    return rt;
+}
+
+/**
+ * @brief Stop and free a timer, one-shot timers are freed after firing
+ *
+ * @param[in] timer_id the timer
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_timer_stop(int timer_id)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REACTOR_SRC_T *src = NULL;
+
+    if (OPRT_OK != __reactor_lock()) {
+        return OPRT_COM_ERROR;
+    }
+
+    src = __reactor_src_find(timer_id, 0);
+    if ((NULL == src) || !src->is_timer) {
+        rt = OPRT_NOT_FOUND;
+    } else {
+        __reactor_src_free(src);
+    }
+    __reactor_unlock();
+
+    return rt;
+}
+
+/**
+ * @brief Run a function on the reactor thread
+ *
+ * @param[in] cb the function, calls run in the order they were posted
+ * @param[in] arg passed to cb
+ *
+ * @return OPRT_OK on success, OPRT_EXCEED_UPPER_LIMIT when NET_REACTOR_CALL_NUM
+ * calls are already pending. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_reactor_call(TAL_NET_REACTOR_FUNC cb, void *arg)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REACTOR_CALL_T call = {.func = cb, .arg = arg};
+
+    if (NULL == cb) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (OPRT_OK != __reactor_lock()) {
+        return OPRT_COM_ERROR;
+    }
+    if (!s_reactor.running) {
+        __reactor_unlock();
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    rt = tuya_queue_input(s_reactor.calls, &call);
+    if (OPRT_OK == rt) {
+        __reactor_wakeup();
+    }
+    __reactor_unlock();
+
+    return rt;
+}
+
+#else
+
+OPERATE_RET tal_net_reactor_start(void)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+void tal_net_reactor_stop(void)
+{
+}
+
+BOOL_T tal_net_reactor_is_running(void)
+{
+    return FALSE;
+}
+
+OPERATE_RET tal_net_reactor_add(int fd, uint8_t events, TAL_NET_REACTOR_CB cb, void *arg)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tal_net_reactor_mod(int fd, uint8_t events)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tal_net_reactor_del(int fd)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tal_net_reactor_timer_start(uint32_t interval_ms, BOOL_T periodic, TAL_NET_REACTOR_FUNC cb, void *arg,
+                                        int *timer_id)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tal_net_reactor_timer_stop(int timer_id)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tal_net_reactor_call(TAL_NET_REACTOR_FUNC cb, void *arg)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+#endif
@@ -31,6 +31,8 @@
  */
 #include "tuya_iot_config.h"
 #include "tal_api.h"
+#include "tal_network.h"
+#include "tal_dns_cache.h"
 
 #if 100 == OPERATING_SYSTEM
 #include <unistd.h>
@@ -45,6 +47,7 @@
 #include <sys/time.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #define ENABLE_BIND_INTERFACE 1
 
@@ -69,7 +72,9 @@ typedef struct NETWORK_ERRNO_TRANS {
     int priv_err;
 } NETWORK_ERRNO_TRANS_S;
 
-const NETWORK_ERRNO_TRANS_S unw_errno_trans[] = {{EINTR, UNW_EINTR},
+const NETWORK_ERRNO_TRANS_S unw_errno_trans[] = {{EINPROGRESS, UNW_EINPROGRESS},
+                                                 {EALREADY, UNW_EALREADY},
+                                                 {EINTR, UNW_EINTR},
                                                  {EBADF, UNW_EBADF},
                                                  {EAGAIN, UNW_EAGAIN},
                                                  {EFAULT, UNW_EFAULT},
@@ -109,13 +114,10 @@ const NETWORK_ERRNO_TRANS_S unw_errno_trans[] = {{EINTR, UNW_EINTR},
  * @return 0 on success. Others on error, please refer to the error no of the
  * target system
  */
-TUYA_ERRNO tal_net_get_errno(void)
+#if NET_USING_POSIX
+static TUYA_ERRNO __net_errno_trans(int sys_err)
 {
     int i = 0;
-    int sys_err;
-
-#if NET_USING_POSIX
-    sys_err = errno;
 
     for (i = 0; i < sizeof(unw_errno_trans) / sizeof(unw_errno_trans[0]); i++) {
         if (unw_errno_trans[i].sys_err == sys_err) {
@@ -123,6 +125,18 @@ TUYA_ERRNO tal_net_get_errno(void)
         }
     }
 
+    return -100 - sys_err;
+}
+#endif
+
+TUYA_ERRNO tal_net_get_errno(void)
+{
+    int sys_err;
+
+#if NET_USING_POSIX
+    sys_err = errno;
+
+    return __net_errno_trans(sys_err);
 #else
     //! TODO:
     sys_err = tkl_net_get_errno();
@@ -131,6 +145,38 @@ TUYA_ERRNO tal_net_get_errno(void)
     return -100 - sys_err;
 }
 
+/**
+ * @brief Get the pending error of socket fd
+ *
+ * @param[in] fd: file descriptor
+ *
+ * @note This API is used to get the result of a non-blocking connect once the
+ * socket is writable. Without SO_ERROR on the tkl layer, a writable socket is
+ * reported as connected.
+ *
+ * @return UNW_SUCCESS if there is no error. Others on error, please refer to
+ * UNW_xxx
+ */
+TUYA_ERRNO tal_net_get_socket_error(const int fd)
+{
+    if (fd < 0) {
+        return UNW_EBADF;
+    }
+
+#if NET_USING_POSIX
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        return tal_net_get_errno();
+    }
+
+    return err ? __net_errno_trans(err) : UNW_SUCCESS;
+#else
+    return UNW_SUCCESS;
+#endif
+}
+
 /**
  * @brief Add file descriptor to set
  *
@@ -270,6 +316,67 @@ int tal_net_select(const int maxfd, TUYA_FD_SET_T *readfds, TUYA_FD_SET_T *write
     return ret;
 }
 
+/**
+ * @brief Wait for socket fd to become ready
+ *
+ * @param[in] fd: file descriptor
+ * @param[in] events: TAL_NET_POLL_READ and/or TAL_NET_POLL_WRITE
+ * @param[in] timeout_ms: time to wait, negative waits forever
+ *
+ * @note This API is used to block on the readiness of one socket instead of
+ * sleeping and retrying, a closed peer is reported as readable.
+ *
+ * @return the ready TAL_NET_POLL_xxx events, 0 on timeout, < 0 on error
+ */
+int tal_net_poll(const int fd, const uint8_t events, const int timeout_ms)
+{
+    int ret = -1;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+#if 100 == OPERATING_SYSTEM
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = ((events & TAL_NET_POLL_READ) ? POLLIN : 0) | ((events & TAL_NET_POLL_WRITE) ? POLLOUT : 0);
+    pfd.revents = 0;
+    do {
+        ret = poll(&pfd, 1, (timeout_ms < 0) ? -1 : timeout_ms);
+    } while (ret < 0 && EINTR == errno);
+
+    if (ret > 0) {
+        ret = ((pfd.revents & (POLLIN | POLLHUP)) ? TAL_NET_POLL_READ : 0) |
+              ((pfd.revents & POLLOUT) ? TAL_NET_POLL_WRITE : 0) |
+              ((pfd.revents & (POLLERR | POLLNVAL)) ? TAL_NET_POLL_ERR : 0);
+    }
+#else
+    TUYA_FD_SET_T readfds, writefds, errfds;
+
+    tal_net_fd_zero(&readfds);
+    tal_net_fd_zero(&writefds);
+    tal_net_fd_zero(&errfds);
+    if (events & TAL_NET_POLL_READ) {
+        tal_net_fd_set(fd, &readfds);
+    }
+    if (events & TAL_NET_POLL_WRITE) {
+        tal_net_fd_set(fd, &writefds);
+    }
+    tal_net_fd_set(fd, &errfds);
+
+    // select takes 0 as forever
+    ret = tal_net_select(fd + 1, &readfds, &writefds, &errfds, (timeout_ms < 0) ? 0 : (timeout_ms ? timeout_ms : 1));
+    if (ret > 0) {
+        ret = (tal_net_fd_isset(fd, &readfds) ? TAL_NET_POLL_READ : 0) |
+              (tal_net_fd_isset(fd, &writefds) ? TAL_NET_POLL_WRITE : 0) |
+              (tal_net_fd_isset(fd, &errfds) ? TAL_NET_POLL_ERR : 0);
+    }
+#endif
+
+    return ret;
+}
+
 /**
  * @brief Get no block file descriptors
  *
@@ -709,8 +816,8 @@ TUYA_ERRNO tal_net_recv(const int fd, void *buf, const uint32_t nbytes)
 #if NET_USING_POSIX
     ret = recv(fd, buf, nbytes, 0);
     if (ret <= 0) {
-        if ((UNW_EINTR == tal_net_get_errno()) || (UNW_EAGAIN == tal_net_get_errno())) {
-            tal_system_sleep(10);
+        if ((UNW_EINTR == tal_net_get_errno()) ||
+            ((UNW_EAGAIN == tal_net_get_errno()) && (tal_net_poll(fd, TAL_NET_POLL_READ, 10) > 0))) {
             ret = recv(fd, buf, nbytes, 0);
         }
     }
@@ -745,10 +852,16 @@ int tal_net_recv_nd_size(const int fd, void *buf, const uint32_t buf_size, const
 
     while (rd_size < nd_size) {
         ret = recv(fd, ((uint8_t *)buf + rd_size), nd_size - rd_size, 0);
-        if (ret <= 0) {
-            if (UNW_EWOULDBLOCK == tal_net_get_errno() || UNW_EINTR == tal_net_get_errno() ||
-                UNW_EAGAIN == tal_net_get_errno()) {
-                tal_system_sleep(10);
+        if (0 == ret) {
+            // peer closed, errno is stale here
+            break;
+        }
+        if (ret < 0) {
+            if (UNW_EINTR == tal_net_get_errno()) {
+                continue;
+            }
+            if ((UNW_EWOULDBLOCK == tal_net_get_errno() || UNW_EAGAIN == tal_net_get_errno()) &&
+                (tal_net_poll(fd, TAL_NET_POLL_READ, -1) > 0)) {
                 continue;
             }
             break;
@@ -1021,29 +1134,104 @@ OPERATE_RET tal_net_set_broadcast(const int fd)
  * @param[in] domain: domain information
  * @param[in] addr: address information
  *
- * @note This API is used for getting address information by domain.
+ * @note This API is used for getting address information by domain, the
+ * answer comes from the dns cache when it is valid.
  *
  * @return OPRT_OK on success. Others on error, please refer to
  * tuya_error_code.h
  */
 OPERATE_RET tal_net_gethostbyname(const char *domain, TUYA_IP_ADDR_T *addr)
 {
-    int ret = -1;
+    uint8_t num = 1;
 
     if ((domain == NULL) || (addr == NULL)) {
         return -2;
     }
 
-#if NET_USING_POSIX
+    return tal_dns_cache_resolve(domain, addr, &num);
+}
+
+/**
+ * @brief Get all addresses of a domain
+ *
+ * @param[in] domain: domain information
+ * @param[out] addr: address list
+ * @param[in,out] num: capacity of the list, number of addresses returned
+ *
+ * @note This API is used for getting all addresses of a domain, the answer
+ * comes from the dns cache when it is valid.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_gethostbyname_all(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num)
+{
+    if ((domain == NULL) || (addr == NULL) || (num == NULL)) {
+        return -2;
+    }
+
+    return tal_dns_cache_resolve(domain, addr, num);
+}
+
+/**
+ * @brief Get all addresses of a domain, bypassing the dns cache
+ *
+ * @param[in] domain: domain information
+ * @param[out] addr: address list
+ * @param[in,out] num: capacity of the list, number of addresses returned
+ *
+ * @note This API is used for getting address information by domain.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_net_gethostbyname_nocache(const char *domain, TUYA_IP_ADDR_T *addr, uint8_t *num)
+{
+    int ret = -1;
+    uint8_t cnt = 0;
+
+    if ((domain == NULL) || (addr == NULL) || (num == NULL) || (*num == 0)) {
+        return -2;
+    }
+
+#if 100 == OPERATING_SYSTEM
+    struct addrinfo hints;
+    struct addrinfo *res = NULL, *ai;
+    TUYA_IP_ADDR_T ip;
+    uint8_t i;
+
+    // getaddrinfo is reentrant, gethostbyname is not
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (0 == getaddrinfo(domain, NULL, &hints, &res)) {
+        for (ai = res; ai && cnt < *num; ai = ai->ai_next) {
+            ip = ntohl(((struct sockaddr_in *)ai->ai_addr)->sin_addr.s_addr);
+            for (i = 0; i < cnt && addr[i] != ip; i++) {
+            }
+            if (i == cnt) {
+                addr[cnt++] = ip;
+            }
+        }
+        ret = cnt ? OPRT_OK : -1;
+    }
+    if (res) {
+        freeaddrinfo(res);
+    }
+#elif NET_USING_POSIX
     struct hostent *h = NULL;
     h = gethostbyname(domain);
     if (h) {
-        *addr = ntohl(((struct in_addr *)(h->h_addr_list[0]))->s_addr);
-        ret = OPRT_OK;
+        for (; h->h_addr_list[cnt] && cnt < *num; cnt++) {
+            addr[cnt] = ntohl(((struct in_addr *)(h->h_addr_list[cnt]))->s_addr);
+        }
+        ret = cnt ? OPRT_OK : -1;
     }
 #else
     ret = tkl_net_gethostbyname(domain, addr);
+    cnt = (OPRT_OK == ret) ? 1 : 0;
 #endif
+    *num = cnt;
 
     return ret;
 }
@@ -60,6 +60,12 @@ typedef struct {
     char key[TAL_LV_KEY_LEN + 1];
 } tal_kv_cfg_t;
 
+/**
+ * @brief handle of a staged multi-key transaction, see tal_kv_batch_begin
+ *
+ */
+typedef void *KV_BATCH_HANDLE;
+
 /**
  * @brief Initializes the TAL Key-Value (KV) module.
  *
@@ -153,6 +159,84 @@ int tal_kv_serialize_set(const char *key, kv_db_t *db, size_t dbcnt);
  */
 int tal_kv_serialize_get(const char *key, kv_db_t *db, size_t dbcnt);
 
+/**
+ * @brief Starts a new multi-key transaction.
+ *
+ * Sets and deletes staged on the returned handle are not visible until
+ * tal_kv_batch_commit is called, which applies all of them under a single
+ * lock acquisition. A power loss during commit leaves either all or none of
+ * the staged operations applied once tal_kv_init has run again.
+ *
+ * The batch is crash consistent, not a single flash commit: littlefs has no
+ * multi-file commit, so each staged value, the journal, each rename or
+ * delete and the journal removal are separate metadata commits.
+ *
+ * @param batch A pointer to store the new batch handle.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_begin(KV_BATCH_HANDLE *batch);
+
+/**
+ * @brief Stages a key-value set in a transaction.
+ *
+ * The value is encrypted when staged, so the caller's buffer may be released
+ * right after this call. Staging the same key again replaces the previous
+ * operation on that key.
+ *
+ * @param batch The batch handle.
+ * @param key The key to set.
+ * @param value A pointer to the value to be set.
+ * @param length The length of the value in bytes.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_set(KV_BATCH_HANDLE batch, const char *key, const uint8_t *value, size_t length);
+
+/**
+ * @brief Stages a key deletion in a transaction.
+ *
+ * Deleting a key which does not exist is not an error at commit time.
+ *
+ * @param batch The batch handle.
+ * @param key The key to delete.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_del(KV_BATCH_HANDLE batch, const char *key);
+
+/**
+ * @brief Serializes a key-value database and stages it in a transaction.
+ *
+ * @param batch The batch handle.
+ * @param key The key to set.
+ * @param db A pointer to the key-value database.
+ * @param dbcnt The size of the key-value database.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_serialize_set(KV_BATCH_HANDLE batch, const char *key, kv_db_t *db, size_t dbcnt);
+
+/**
+ * @brief Applies all operations staged in a transaction, crash consistently.
+ *
+ * The batch handle is released whether the commit succeeds or not. The
+ * commit is not atomic for concurrent readers, keys become visible one by one
+ * while it runs.
+ *
+ * @param batch The batch handle.
+ * @return OPRT_OK on success, or a negative error code on failure. A failure
+ * before the journal is written leaves no staged operation applied. A failure
+ * after it may leave some keys applied, the journal stays on flash and the
+ * remaining operations are retried before the next write or by the next
+ * tal_kv_init, operations that fail again are dropped.
+ */
+int tal_kv_batch_commit(KV_BATCH_HANDLE batch);
+
+/**
+ * @brief Discards a transaction without applying it.
+ *
+ * @param batch The batch handle, released by this call.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_abort(KV_BATCH_HANDLE batch);
+
 /**
  * @brief Executes the TAL KV command.
  *
@@ -29,16 +29,49 @@
 #include "tkl_flash.h"
 #include "tal_api.h"
 #include "tal_security.h"
+#include "mix_method.h"
 
 // variables used by the filesystem
 static lfs_t lfs;
 static lfs_size_t lfs_flash_addr;
 static tal_kv_cfg_t lfs_kv_cfg;
+static TAL_AES_KEY_T lfs_kv_aes;
 static MUTEX_HANDLE lfs_mutex;
 
 extern int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
 extern int kv_deserialize(const char *in, kv_db_t *db, const uint32_t dbcnt);
 
+/**
+ * @brief multi-key transaction layout on flash
+ *
+ * On commit every staged value is first written to "<key>" KV_BATCH_TMP_SUFFIX,
+ * then the journal listing all operations is written. Closing the journal is
+ * the commit point: littlefs file updates are atomic, so after a power loss
+ * either the journal exists and is replayed on the next init, or it does not
+ * and the leftover temporary files are discarded.
+ */
+#define KV_BATCH_JOURNAL    ".kv_journal"
+#define KV_BATCH_TMP_SUFFIX ".~tx"
+
+#define KV_BATCH_OP_SET 0
+#define KV_BATCH_OP_DEL 1
+
+typedef struct kv_batch_op {
+    struct kv_batch_op *next;
+    uint8_t op;
+    char *key;
+    uint8_t *data; // encrypted value, NULL for delete
+    uint32_t len;
+} kv_batch_op_t;
+
+typedef struct {
+    kv_batch_op_t *head;
+    uint32_t count;
+} kv_batch_t;
+
+/* a commit could not apply its journal, it is replayed before the next write */
+static BOOL_T lfs_kv_journal_pending = FALSE;
+
 /**
  * Reads data from a user-provided block device.
  *
@@ -126,6 +159,172 @@ int user_provided_block_device_sync(const struct lfs_config *c)
     return LFS_ERR_OK;
 }
 
+/**
+ * @brief Encrypts a value with the KV key, the result must be released with
+ * tal_free.
+ *
+ * @param value The plain value.
+ * @param length The length of the plain value.
+ * @param ec_data A pointer to store the encrypted data.
+ * @param ec_len A pointer to store the length of the encrypted data.
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+static int __kv_value_encrypt(const uint8_t *value, size_t length, uint8_t **ec_data, uint32_t *ec_len)
+{
+    int result;
+    uint8_t iv[16];
+    uint32_t ec_size = TAL_AES_PKCS7_LEN(length);
+
+    *ec_data = tal_malloc(ec_size);
+    if (NULL == *ec_data) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    memcpy(iv, lfs_kv_cfg.seed, 16);
+    result = tal_aes_key_cbc_encode(&lfs_kv_aes, iv, value, length, *ec_data, ec_size, ec_len);
+    if (OPRT_OK != result) {
+        tal_free(*ec_data);
+        *ec_data = NULL;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Builds the temporary file name used to stage a key during commit.
+ *
+ * @param key The key.
+ * @param name The buffer to store the name, LFS_NAME_MAX + 1 bytes.
+ * @return OPRT_OK on success, OPRT_INVALID_PARM if the name is too long.
+ */
+static int __kv_batch_tmp_name(const char *key, char *name)
+{
+    size_t key_len = strlen(key);
+
+    if (key_len + sizeof(KV_BATCH_TMP_SUFFIX) > LFS_NAME_MAX + 1) {
+        return OPRT_INVALID_PARM;
+    }
+    memcpy(name, key, key_len);
+    memcpy(name + key_len, KV_BATCH_TMP_SUFFIX, sizeof(KV_BATCH_TMP_SUFFIX));
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Applies one journaled operation, must be called with lfs_mutex held.
+ *
+ * Replaying an operation that has already been applied is harmless: a set
+ * whose temporary file is gone and a delete of a missing key are skipped.
+ *
+ * @param op KV_BATCH_OP_SET or KV_BATCH_OP_DEL.
+ * @param key The key.
+ * @return LFS_ERR_OK on success, or a littlefs error code on failure.
+ */
+static int __kv_batch_apply(uint8_t op, const char *key)
+{
+    int result;
+    char tmp_name[LFS_NAME_MAX + 1];
+
+    if (KV_BATCH_OP_DEL == op) {
+        result = lfs_remove(&lfs, key);
+        return (LFS_ERR_NOENT == result) ? LFS_ERR_OK : result;
+    }
+
+    if (OPRT_OK != __kv_batch_tmp_name(key, tmp_name)) {
+        return LFS_ERR_NAMETOOLONG;
+    }
+    result = lfs_rename(&lfs, tmp_name, key);
+    return (LFS_ERR_NOENT == result) ? LFS_ERR_OK : result;
+}
+
+/**
+ * @brief Replays the journal of a committed transaction and removes it, must
+ * be called with lfs_mutex held.
+ *
+ * Operations that still fail are dropped together with their temporary
+ * files, so a later write of the same key is never overwritten by stale
+ * staged data.
+ */
+static void __kv_batch_journal_replay(void)
+{
+    int result;
+    lfs_file_t file;
+    char tmp_name[LFS_NAME_MAX + 1];
+
+    lfs_kv_journal_pending = FALSE;
+    if (LFS_ERR_OK != lfs_file_open(&lfs, &file, KV_BATCH_JOURNAL, LFS_O_RDONLY)) {
+        return;
+    }
+
+    lfs_soff_t size = lfs_file_size(&lfs, &file);
+    uint8_t *journal = (size > 0) ? tal_malloc(size) : NULL;
+    if (NULL != journal && lfs_file_read(&lfs, &file, journal, size) == size) {
+        lfs_soff_t offset = 0;
+        char key[LFS_NAME_MAX + 1];
+        while (offset + 2 <= size) {
+            uint8_t op = journal[offset];
+            uint8_t key_len = journal[offset + 1];
+            offset += 2;
+            if (0 == key_len || offset + key_len > size) {
+                break;
+            }
+            memcpy(key, journal + offset, key_len);
+            key[key_len] = 0;
+            offset += key_len;
+            result = __kv_batch_apply(op, key);
+            PR_DEBUG("kv journal replay %s %d", key, result);
+            if (LFS_ERR_OK != result && KV_BATCH_OP_SET == op &&
+                OPRT_OK == __kv_batch_tmp_name(key, tmp_name)) {
+                lfs_remove(&lfs, tmp_name);
+            }
+        }
+    }
+    lfs_file_close(&lfs, &file);
+    if (NULL != journal) {
+        tal_free(journal);
+    }
+    if (LFS_ERR_OK != lfs_remove(&lfs, KV_BATCH_JOURNAL)) {
+        lfs_kv_journal_pending = TRUE;
+    }
+}
+
+/**
+ * @brief Completes or rolls back a transaction interrupted by a power loss.
+ *
+ * A journal on flash means the transaction was committed, so it is replayed
+ * and removed. Temporary files left without a journal belong to a commit that
+ * never reached its commit point and are discarded.
+ */
+static void __kv_batch_recover(void)
+{
+    __kv_batch_journal_replay();
+
+    lfs_dir_t dir;
+    struct lfs_info info;
+    char path[LFS_NAME_MAX + 1];
+    size_t suffix_len = sizeof(KV_BATCH_TMP_SUFFIX) - 1;
+
+    if (LFS_ERR_OK != lfs_dir_open(&lfs, &dir, "/")) {
+        return;
+    }
+    while (lfs_dir_read(&lfs, &dir, &info) > 0) {
+        size_t name_len = strlen(info.name);
+        if (LFS_TYPE_REG != info.type || name_len <= suffix_len ||
+            0 != strcmp(info.name + name_len - suffix_len, KV_BATCH_TMP_SUFFIX)) {
+            continue;
+        }
+        /* removing while iterating is not supported by littlefs, restart */
+        strcpy(path, info.name);
+        lfs_dir_close(&lfs, &dir);
+        PR_DEBUG("kv discard uncommitted %s", path);
+        lfs_remove(&lfs, path);
+        if (LFS_ERR_OK != lfs_dir_open(&lfs, &dir, "/")) {
+            return;
+        }
+    }
+    lfs_dir_close(&lfs, &dir);
+}
+
 /**
  * @brief Initializes the TAL Key-Value (KV) module.
  *
@@ -145,6 +344,11 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
     memcpy(lfs_kv_cfg.seed, sha256_ret, TAL_LV_KEY_LEN);
     tal_sha256_ret((const uint8_t *)kv_cfg->key, TAL_LV_KEY_LEN, sha256_ret, 0);
     memcpy(lfs_kv_cfg.key, sha256_ret, TAL_LV_KEY_LEN);
+    tal_aes_key_deinit(&lfs_kv_aes);
+    if (OPRT_OK != tal_aes_key_init(&lfs_kv_aes, (const uint8_t *)lfs_kv_cfg.key, 128)) {
+        PR_ERR("kv aes key init fail");
+        return OPRT_COM_ERROR;
+    }
 
     tal_mutex_create_init(&lfs_mutex);
 
@@ -178,6 +382,10 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
         err = lfs_mount(&lfs, &lfs_cfg);
     }
 
+    if (LFS_ERR_OK == err) {
+        __kv_batch_recover();
+    }
+
     return err;
 }
 
@@ -205,31 +413,31 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
         return OPRT_INVALID_PARM;
     }
 
-    tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
-    if (LFS_ERR_OK != result) {
-        tal_mutex_unlock(lfs_mutex);
-        PR_ERR("lfs open %s err", key);
-        return result;
-    }
     uint8_t *ec_data = NULL;
     uint32_t ec_len = 0;
-    uint8_t iv[16];
 
-    memcpy(iv, lfs_kv_cfg.seed, 16);
-    result =
-        tal_aes128_cbc_encode((uint8_t *)value, length, (uint8_t *)lfs_kv_cfg.key, iv, &ec_data, (uint32_t *)&ec_len);
+    result = __kv_value_encrypt(value, length, &ec_data, &ec_len);
     if (OPRT_OK != result) {
-        lfs_file_close(&lfs, &file);
-        tal_mutex_unlock(lfs_mutex);
         PR_DEBUG("key %s encrypt failed", key);
         return result;
     }
-    lfs_file_rewind(&lfs, &file);
+
+    tal_mutex_lock(lfs_mutex);
+    /* a pending journal must not rename its staged value over this one later */
+    if (lfs_kv_journal_pending) {
+        __kv_batch_journal_replay();
+    }
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != result) {
+        tal_mutex_unlock(lfs_mutex);
+        tal_free(ec_data);
+        PR_ERR("lfs open %s err", key);
+        return result;
+    }
     result = lfs_file_write(&lfs, &file, ec_data, ec_len);
     lfs_file_close(&lfs, &file);
-    tal_aes_free_data(ec_data);
     tal_mutex_unlock(lfs_mutex);
+    tal_free(ec_data);
     if (result != ec_len) {
         PR_ERR("kv write fail %d", result);
         return OPRT_KVS_WR_FAIL;
@@ -276,6 +484,7 @@ int tal_kv_get(const char *key, uint8_t **value, size_t *length)
     ec_data = (uint8_t *)tal_malloc(ec_len + 1);
     if (NULL == ec_data) {
         result = OPRT_MALLOC_FAILED;
+        lfs_file_close(&lfs, &file);
         tal_mutex_unlock(lfs_mutex);
         return result;
     }
@@ -289,21 +498,23 @@ int tal_kv_get(const char *key, uint8_t **value, size_t *length)
         PR_ERR("kv read error %d", result);
         return OPRT_KVS_RD_FAIL;
     }
-    uint8_t *dec_data = NULL;
+    /* decrypt in place, the read buffer is handed out as the value */
     uint32_t dec_len = 0;
     uint8_t iv[16];
 
     memcpy(iv, lfs_kv_cfg.seed, 16);
-    result = tal_aes128_cbc_decode(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, &dec_data, (uint32_t *)&dec_len);
-    dec_len = tal_aes_get_actual_length(dec_data, dec_len);
-    tal_free((void *)ec_data);
+    result = tal_aes_key_cbc_decode(&lfs_kv_aes, iv, ec_data, ec_len, ec_data);
+    if (OPRT_OK == result) {
+        dec_len = tal_aes_get_actual_length(ec_data, ec_len);
+    }
     if (OPRT_OK != result || dec_len > ec_len) {
         PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
+        tal_free((void *)ec_data);
         return OPRT_BUFFER_NOT_ENOUGH;
     }
-    *value = dec_data;
+    *value = ec_data;
     *length = (size_t)dec_len;
-    dec_data[dec_len] = 0;
+    ec_data[dec_len] = 0;
 
     return OPRT_OK;
 }
@@ -322,6 +533,9 @@ int tal_kv_del(const char *key)
     PR_DEBUG("key:%s", key);
 
     tal_mutex_lock(lfs_mutex);
+    if (lfs_kv_journal_pending) {
+        __kv_batch_journal_replay();
+    }
     int result = lfs_remove(&lfs, key);
     tal_mutex_unlock(lfs_mutex);
     if (LFS_ERR_OK == result) {
@@ -467,6 +681,325 @@ int tal_kv_serialize_get(const char *key, kv_db_t *db, size_t dbcnt)
     return ret;
 }
 
+/**
+ * @brief Releases a staged operation.
+ *
+ * @param node The operation to release.
+ */
+static void __kv_batch_op_free(kv_batch_op_t *node)
+{
+    if (NULL != node->data) {
+        tal_free(node->data);
+    }
+    tal_free(node->key);
+    tal_free(node);
+}
+
+/**
+ * @brief Stages an operation, replacing any earlier operation on the same key.
+ *
+ * @param batch The batch.
+ * @param op KV_BATCH_OP_SET or KV_BATCH_OP_DEL.
+ * @param key The key.
+ * @param data The encrypted value, owned by the batch from now on.
+ * @param len The length of the encrypted value.
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+static int __kv_batch_stage(kv_batch_t *batch, uint8_t op, const char *key, uint8_t *data, uint32_t len)
+{
+    kv_batch_op_t *node = NULL;
+    kv_batch_op_t **pos = NULL;
+
+    for (pos = &batch->head; *pos != NULL; pos = &(*pos)->next) {
+        if (0 == strcmp((*pos)->key, key)) {
+            break;
+        }
+    }
+
+    if (NULL != *pos) {
+        node = *pos;
+        if (NULL != node->data) {
+            tal_free(node->data);
+        }
+    } else {
+        node = tal_malloc(sizeof(kv_batch_op_t));
+        if (NULL == node) {
+            return OPRT_MALLOC_FAILED;
+        }
+        memset(node, 0, sizeof(kv_batch_op_t));
+        node->key = mm_strdup(key);
+        if (NULL == node->key) {
+            tal_free(node);
+            return OPRT_MALLOC_FAILED;
+        }
+        /* keep staging order, operations are applied in the same order */
+        *pos = node;
+        batch->count++;
+    }
+
+    node->op = op;
+    node->data = data;
+    node->len = len;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Starts a new multi-key transaction.
+ *
+ * @param batch A pointer to store the new batch handle.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_begin(KV_BATCH_HANDLE *batch)
+{
+    if (NULL == batch) {
+        return OPRT_INVALID_PARM;
+    }
+
+    kv_batch_t *kv_batch = tal_malloc(sizeof(kv_batch_t));
+    if (NULL == kv_batch) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(kv_batch, 0, sizeof(kv_batch_t));
+    *batch = kv_batch;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Stages a key-value set in a transaction.
+ *
+ * @param batch The batch handle.
+ * @param key The key to set.
+ * @param value A pointer to the value to be set.
+ * @param length The length of the value in bytes.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_set(KV_BATCH_HANDLE batch, const char *key, const uint8_t *value, size_t length)
+{
+    int result;
+    char tmp_name[LFS_NAME_MAX + 1];
+
+    if (NULL == batch || NULL == key || NULL == value || 0 == length) {
+        return OPRT_INVALID_PARM;
+    }
+    if (OPRT_OK != __kv_batch_tmp_name(key, tmp_name)) {
+        PR_ERR("kv key %s too long", key);
+        return OPRT_INVALID_PARM;
+    }
+
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
+
+    result = __kv_value_encrypt(value, length, &ec_data, &ec_len);
+    if (OPRT_OK != result) {
+        PR_DEBUG("key %s encrypt failed", key);
+        return result;
+    }
+
+    result = __kv_batch_stage((kv_batch_t *)batch, KV_BATCH_OP_SET, key, ec_data, ec_len);
+    if (OPRT_OK != result) {
+        tal_free(ec_data);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Stages a key deletion in a transaction.
+ *
+ * @param batch The batch handle.
+ * @param key The key to delete.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_del(KV_BATCH_HANDLE batch, const char *key)
+{
+    if (NULL == batch || NULL == key || strlen(key) > LFS_NAME_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return __kv_batch_stage((kv_batch_t *)batch, KV_BATCH_OP_DEL, key, NULL, 0);
+}
+
+/**
+ * @brief Serializes a key-value database and stages it in a transaction.
+ *
+ * @param batch The batch handle.
+ * @param key The key to set.
+ * @param db A pointer to the key-value database.
+ * @param dbcnt The size of the key-value database.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_serialize_set(KV_BATCH_HANDLE batch, const char *key, kv_db_t *db, size_t dbcnt)
+{
+    if (NULL == db || 0 == dbcnt) {
+        return OPRT_INVALID_PARM;
+    }
+
+    char *buf = NULL;
+    uint32_t len = 0;
+    int ret = OPRT_OK;
+
+    ret = kv_serialize(db, dbcnt, &buf, &len);
+    if (OPRT_OK != ret) {
+        PR_ERR("kv_serialize  fail. %d", ret);
+        return ret;
+    }
+    ret = tal_kv_batch_set(batch, key, (const uint8_t *)buf, len);
+    tal_free((void *)buf);
+
+    return ret;
+}
+
+/**
+ * @brief Applies all operations staged in a transaction, crash consistently.
+ *
+ * @param batch The batch handle, released by this call.
+ * @return OPRT_OK on success, or a negative error code on failure, see
+ * tal_kv.h for what is applied after a failure.
+ */
+int tal_kv_batch_commit(KV_BATCH_HANDLE batch)
+{
+    int result = OPRT_OK;
+    kv_batch_t *kv_batch = (kv_batch_t *)batch;
+    kv_batch_op_t *node = NULL;
+    lfs_file_t file;
+    char tmp_name[LFS_NAME_MAX + 1];
+    uint8_t *journal = NULL;
+    uint32_t journal_len = 0;
+
+    if (NULL == kv_batch) {
+        return OPRT_INVALID_PARM;
+    }
+    if (0 == kv_batch->count) {
+        return tal_kv_batch_abort(batch);
+    }
+
+    for (node = kv_batch->head; node != NULL; node = node->next) {
+        journal_len += 2 + strlen(node->key);
+    }
+    journal = tal_malloc(journal_len);
+    if (NULL == journal) {
+        tal_kv_batch_abort(batch);
+        return OPRT_MALLOC_FAILED;
+    }
+    journal_len = 0;
+    for (node = kv_batch->head; node != NULL; node = node->next) {
+        uint8_t key_len = (uint8_t)strlen(node->key);
+        journal[journal_len++] = node->op;
+        journal[journal_len++] = key_len;
+        memcpy(journal + journal_len, node->key, key_len);
+        journal_len += key_len;
+    }
+
+    PR_DEBUG("kv batch commit %d ops", kv_batch->count);
+
+    tal_mutex_lock(lfs_mutex);
+
+    /* the journal is rewritten below, finish the one an earlier commit left first */
+    if (lfs_kv_journal_pending) {
+        __kv_batch_journal_replay();
+    }
+
+    /* stage every value next to its key, nothing visible changes yet */
+    for (node = kv_batch->head; node != NULL; node = node->next) {
+        if (KV_BATCH_OP_SET != node->op) {
+            continue;
+        }
+        __kv_batch_tmp_name(node->key, tmp_name);
+        result = lfs_file_open(&lfs, &file, tmp_name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+        if (LFS_ERR_OK != result) {
+            PR_ERR("lfs open %s err %d", tmp_name, result);
+            goto ROLLBACK;
+        }
+        result = lfs_file_write(&lfs, &file, node->data, node->len);
+        lfs_file_close(&lfs, &file);
+        if (result != node->len) {
+            PR_ERR("kv write fail %d", result);
+            goto ROLLBACK;
+        }
+    }
+
+    /* commit point */
+    result = lfs_file_open(&lfs, &file, KV_BATCH_JOURNAL, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != result) {
+        PR_ERR("lfs open journal err %d", result);
+        goto ROLLBACK;
+    }
+    result = lfs_file_write(&lfs, &file, journal, journal_len);
+    if (result != journal_len) {
+        lfs_file_close(&lfs, &file);
+        lfs_remove(&lfs, KV_BATCH_JOURNAL);
+        PR_ERR("kv journal write fail %d", result);
+        goto ROLLBACK;
+    }
+    result = lfs_file_close(&lfs, &file);
+    if (LFS_ERR_OK != result) {
+        lfs_remove(&lfs, KV_BATCH_JOURNAL);
+        PR_ERR("kv journal close fail %d", result);
+        goto ROLLBACK;
+    }
+
+    /* past the commit point, roll forward as far as possible */
+    int apply_err = LFS_ERR_OK;
+    for (node = kv_batch->head; node != NULL; node = node->next) {
+        result = __kv_batch_apply(node->op, node->key);
+        if (LFS_ERR_OK != result) {
+            PR_ERR("kv apply %s fail %d", node->key, result);
+            apply_err = result;
+        }
+    }
+    if (LFS_ERR_OK == apply_err) {
+        lfs_remove(&lfs, KV_BATCH_JOURNAL);
+    } else {
+        /* the journal stays on flash, the next write or init replays it */
+        lfs_kv_journal_pending = TRUE;
+    }
+
+    tal_mutex_unlock(lfs_mutex);
+    tal_free(journal);
+    tal_kv_batch_abort(batch);
+
+    return (LFS_ERR_OK == apply_err) ? OPRT_OK : OPRT_KVS_WR_FAIL;
+
+ROLLBACK:
+    for (node = kv_batch->head; node != NULL; node = node->next) {
+        if (KV_BATCH_OP_SET == node->op) {
+            __kv_batch_tmp_name(node->key, tmp_name);
+            lfs_remove(&lfs, tmp_name);
+        }
+    }
+    tal_mutex_unlock(lfs_mutex);
+    tal_free(journal);
+    tal_kv_batch_abort(batch);
+
+    return OPRT_KVS_WR_FAIL;
+}
+
+/**
+ * @brief Discards a transaction without applying it.
+ *
+ * @param batch The batch handle, released by this call.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tal_kv_batch_abort(KV_BATCH_HANDLE batch)
+{
+    kv_batch_t *kv_batch = (kv_batch_t *)batch;
+
+    if (NULL == kv_batch) {
+        return OPRT_INVALID_PARM;
+    }
+
+    while (kv_batch->head) {
+        kv_batch_op_t *node = kv_batch->head;
+        kv_batch->head = node->next;
+        __kv_batch_op_free(node);
+    }
+    tal_free(kv_batch);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Get the LFS handle, can be used for file system opeation
  * 
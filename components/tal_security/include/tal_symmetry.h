@@ -37,6 +37,27 @@ typedef enum {
     SYMMETRY_ENCRYPT = 1,
 } TAL_SYMMETRY_CRYPT_MODE;
 
+/**
+ * @brief length of the output of a PKCS7 padded AES encode, a full padding
+ * block is added when the input is already block aligned
+ *
+ */
+#define TAL_AES_PKCS7_LEN(len) ((((len) / 16) + 1) * 16)
+
+/**
+ * @brief AES key context, the key schedules are expanded once by
+ * tal_aes_key_init and reused by every tal_aes_key_* call.
+ *
+ * The context is not modified by encode/decode calls, the chaining state
+ * (iv, nonce counter) is always passed by the caller, so one context may be
+ * shared by several threads.
+ */
+typedef struct {
+    TKL_SYMMETRY_HANDLE enc;
+    TKL_SYMMETRY_HANDLE dec;
+    uint32_t keybits;
+} TAL_AES_KEY_T;
+
 /**
  * @brief This function Create&initializes a aes context.
  *
@@ -395,6 +416,120 @@ OPERATE_RET tal_aes128_cbc_encode(uint8_t *data, uint32_t len, uint8_t *key, uin
 OPERATE_RET tal_aes128_cbc_decode(uint8_t *data, uint32_t len, uint8_t *key, uint8_t *iv, uint8_t **dec_data,
                                   uint32_t *dec_len);
 
+/**
+ * @brief Expands an AES key into a reusable key context.
+ *
+ * @param[out] aes_key The key context to initialize.
+ * @param[in] key The key.
+ * @param[in] keybits 128 or 256.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_init(TAL_AES_KEY_T *aes_key, const uint8_t *key, uint32_t keybits);
+
+/**
+ * @brief Releases a key context created by tal_aes_key_init.
+ *
+ * @param[in] aes_key The key context.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_deinit(TAL_AES_KEY_T *aes_key);
+
+/**
+ * @brief PKCS7 pads and encrypts data in ECB mode into a caller buffer.
+ *
+ * Same padding as tal_aes128_ecb_encode. \p output may be equal to \p data
+ * for in-place operation.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] data The plain data.
+ * @param[in] len The length of the plain data.
+ * @param[out] output The output buffer.
+ * @param[in] out_size The size of the output buffer, at least
+ * TAL_AES_PKCS7_LEN(len).
+ * @param[out] out_len The length of the encrypted data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_ecb_encode(TAL_AES_KEY_T *aes_key, const uint8_t *data, uint32_t len, uint8_t *output,
+                                   uint32_t out_size, uint32_t *out_len);
+
+/**
+ * @brief Decrypts full blocks in ECB mode into a caller buffer.
+ *
+ * Same semantics as tal_aes128_ecb_decode, the padding is kept, use
+ * tal_aes_get_actual_length to strip it. \p output may be equal to \p data.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] data The encrypted data.
+ * @param[in] len The length of the encrypted data, multiple of 16.
+ * @param[out] output The output buffer, at least \p len bytes.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_ecb_decode(TAL_AES_KEY_T *aes_key, const uint8_t *data, uint32_t len, uint8_t *output);
+
+/**
+ * @brief PKCS7 pads and encrypts data in CBC mode into a caller buffer.
+ *
+ * Same padding as tal_aes128_cbc_encode. \p output may be equal to \p data
+ * for in-place operation.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] iv The initialization vector, updated after use.
+ * @param[in] data The plain data.
+ * @param[in] len The length of the plain data.
+ * @param[out] output The output buffer.
+ * @param[in] out_size The size of the output buffer, at least
+ * TAL_AES_PKCS7_LEN(len).
+ * @param[out] out_len The length of the encrypted data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_cbc_encode(TAL_AES_KEY_T *aes_key, uint8_t iv[16], const uint8_t *data, uint32_t len,
+                                   uint8_t *output, uint32_t out_size, uint32_t *out_len);
+
+/**
+ * @brief Decrypts full blocks in CBC mode into a caller buffer.
+ *
+ * Same semantics as tal_aes128_cbc_decode, the padding is kept, use
+ * tal_aes_get_actual_length to strip it. \p output may be equal to \p data.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] iv The initialization vector, updated after use.
+ * @param[in] data The encrypted data.
+ * @param[in] len The length of the encrypted data, multiple of 16.
+ * @param[out] output The output buffer, at least \p len bytes.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_cbc_decode(TAL_AES_KEY_T *aes_key, uint8_t iv[16], const uint8_t *data, uint32_t len,
+                                   uint8_t *output);
+
+/**
+ * @brief Encrypts or decrypts data in CTR mode into a caller buffer.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] data The input data.
+ * @param[in] len The length of the input data.
+ * @param[in,out] nc_off The offset in the current stream block.
+ * @param[in,out] nonce_counter The 128-bit nonce and counter.
+ * @param[in,out] stream_block The saved stream block for resuming.
+ * @param[out] output The output buffer, may be equal to \p data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_ctr(TAL_AES_KEY_T *aes_key, const uint8_t *data, size_t len, size_t *nc_off,
+                            uint8_t nonce_counter[16], uint8_t stream_block[16], uint8_t *output);
+
 /**
  * @brief Frees the memory allocated for AES data.
  *
@@ -423,6 +558,19 @@ OPERATE_RET tal_aes_free_data(uint8_t *data);
  */
 OPERATE_RET tal_aes_self_test(int32_t verbose);
 
+/**
+ * @brief Measures the per-call cost of the one-shot wrappers against the key
+ * context API for payloads from 16 bytes to 4 KB.
+ *
+ * Results are printed through the log, only available with
+ * ENABLE_TAL_SECURITY_SELF_TEST.
+ *
+ * @param rounds The number of calls per payload size.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET tal_aes_perf_test(uint32_t rounds);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
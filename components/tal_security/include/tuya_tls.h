@@ -120,6 +120,14 @@ int tuya_tls_register_x509_crt_der(void *p_ctx, uint8_t *p_der, uint32_t der_len
  */
 void tuya_tls_register_pre_conn_cb(tuya_tls_pre_conn_cb pre_conn);
 
+/**
+ * @brief register cb invoked on tls events of connections that do not set
+ * their own exception_cb, e.g. TUYA_TLS_CERT_EXPIRED with "host[:port]"
+ *
+ * @param[in] event_cb callback
+ */
+void tuya_tls_register_event_cb(tuya_tls_event_cb event_cb);
+
 /**
  * @brief tls init
  *
@@ -198,6 +206,16 @@ int tuya_tls_write(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
  */
 int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
 
+/**
+ * @brief tls read pending, data buffered by tls that the socket does not
+ * report as readable
+ *
+ * @param[in] tls_handler refer to tuya_tls_hander
+ *
+ * @return bytes ready to read, 0 if nothing is buffered
+ */
+int tuya_tls_read_pending(tuya_tls_hander tls_handler);
+
 /**
  * @brief generated random
  *
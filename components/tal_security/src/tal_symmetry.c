@@ -15,6 +15,7 @@
 #include "tal_symmetry.h"
 #include "tal_log.h"
 #include "tal_memory.h"
+#include "tal_system.h"
 
 /**
  * @brief This function Create&initializes a aes context.
@@ -710,6 +711,218 @@ OPERATE_RET tal_aes128_cbc_decode(uint8_t *data, uint32_t len, uint8_t *key, uin
     return OPRT_OK;
 }
 
+/**
+ * @brief Expands an AES key into a reusable key context.
+ *
+ * @param[out] aes_key The key context to initialize.
+ * @param[in] key The key.
+ * @param[in] keybits 128 or 256.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_init(TAL_AES_KEY_T *aes_key, const uint8_t *key, uint32_t keybits)
+{
+    OPERATE_RET ret;
+
+    if (NULL == aes_key || NULL == key || (128 != keybits && 256 != keybits)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    memset(aes_key, 0, sizeof(TAL_AES_KEY_T));
+    aes_key->keybits = keybits;
+
+    if ((ret = tal_aes_create_init(&aes_key->enc)) != OPRT_OK) {
+        goto exit;
+    }
+    if ((ret = tal_aes_setkey_enc(aes_key->enc, (uint8_t *)key, keybits)) != OPRT_OK) {
+        goto exit;
+    }
+    if ((ret = tal_aes_create_init(&aes_key->dec)) != OPRT_OK) {
+        goto exit;
+    }
+    if ((ret = tal_aes_setkey_dec(aes_key->dec, (uint8_t *)key, keybits)) != OPRT_OK) {
+        goto exit;
+    }
+
+    return OPRT_OK;
+
+exit:
+    tal_aes_key_deinit(aes_key);
+    return ret;
+}
+
+/**
+ * @brief Releases a key context created by tal_aes_key_init.
+ *
+ * @param[in] aes_key The key context.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_deinit(TAL_AES_KEY_T *aes_key)
+{
+    if (NULL == aes_key) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (aes_key->enc) {
+        tal_aes_free(aes_key->enc);
+        aes_key->enc = NULL;
+    }
+    if (aes_key->dec) {
+        tal_aes_free(aes_key->dec);
+        aes_key->dec = NULL;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Moves the plain data into the output buffer and appends the PKCS7
+ * padding.
+ *
+ * @return the padded length, 0 if the output buffer is too small
+ */
+static uint32_t __aes_pkcs7_prepare(const uint8_t *data, uint32_t len, uint8_t *output, uint32_t out_size)
+{
+    if (out_size < TAL_AES_PKCS7_LEN(len)) {
+        return 0;
+    }
+
+    if (output != data) {
+        memmove(output, data, len);
+    }
+
+    return __Add_Pkcs(output, len);
+}
+
+/**
+ * @brief PKCS7 pads and encrypts data in ECB mode into a caller buffer.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] data The plain data.
+ * @param[in] len The length of the plain data.
+ * @param[out] output The output buffer.
+ * @param[in] out_size The size of the output buffer.
+ * @param[out] out_len The length of the encrypted data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_ecb_encode(TAL_AES_KEY_T *aes_key, const uint8_t *data, uint32_t len, uint8_t *output,
+                                   uint32_t out_size, uint32_t *out_len)
+{
+    if (NULL == aes_key || NULL == aes_key->enc || NULL == data || NULL == output || NULL == out_len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    uint32_t pkcs7_len = __aes_pkcs7_prepare(data, len, output, out_size);
+    if (0 == pkcs7_len) {
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+    *out_len = pkcs7_len;
+
+    return tal_aes_crypt_ecb(aes_key->enc, SYMMETRY_ENCRYPT, pkcs7_len, output, output);
+}
+
+/**
+ * @brief Decrypts full blocks in ECB mode into a caller buffer.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] data The encrypted data.
+ * @param[in] len The length of the encrypted data, multiple of 16.
+ * @param[out] output The output buffer, at least \p len bytes.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_ecb_decode(TAL_AES_KEY_T *aes_key, const uint8_t *data, uint32_t len, uint8_t *output)
+{
+    if (NULL == aes_key || NULL == aes_key->dec || NULL == data || NULL == output || 0 == len || len % 16) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return tal_aes_crypt_ecb(aes_key->dec, SYMMETRY_DECRYPT, len, (uint8_t *)data, output);
+}
+
+/**
+ * @brief PKCS7 pads and encrypts data in CBC mode into a caller buffer.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] iv The initialization vector, updated after use.
+ * @param[in] data The plain data.
+ * @param[in] len The length of the plain data.
+ * @param[out] output The output buffer.
+ * @param[in] out_size The size of the output buffer.
+ * @param[out] out_len The length of the encrypted data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_cbc_encode(TAL_AES_KEY_T *aes_key, uint8_t iv[16], const uint8_t *data, uint32_t len,
+                                   uint8_t *output, uint32_t out_size, uint32_t *out_len)
+{
+    if (NULL == aes_key || NULL == aes_key->enc || NULL == iv || NULL == data || NULL == output || NULL == out_len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    uint32_t pkcs7_len = __aes_pkcs7_prepare(data, len, output, out_size);
+    if (0 == pkcs7_len) {
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+    *out_len = pkcs7_len;
+
+    return tal_aes_crypt_cbc(aes_key->enc, SYMMETRY_ENCRYPT, pkcs7_len, iv, output, output);
+}
+
+/**
+ * @brief Decrypts full blocks in CBC mode into a caller buffer.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] iv The initialization vector, updated after use.
+ * @param[in] data The encrypted data.
+ * @param[in] len The length of the encrypted data, multiple of 16.
+ * @param[out] output The output buffer, at least \p len bytes.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_cbc_decode(TAL_AES_KEY_T *aes_key, uint8_t iv[16], const uint8_t *data, uint32_t len,
+                                   uint8_t *output)
+{
+    if (NULL == aes_key || NULL == aes_key->dec || NULL == iv || NULL == data || NULL == output || 0 == len ||
+        len % 16) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return tal_aes_crypt_cbc(aes_key->dec, SYMMETRY_DECRYPT, len, iv, (uint8_t *)data, output);
+}
+
+/**
+ * @brief Encrypts or decrypts data in CTR mode into a caller buffer.
+ *
+ * @param[in] aes_key The key context.
+ * @param[in] data The input data.
+ * @param[in] len The length of the input data.
+ * @param[in,out] nc_off The offset in the current stream block.
+ * @param[in,out] nonce_counter The 128-bit nonce and counter.
+ * @param[in,out] stream_block The saved stream block for resuming.
+ * @param[out] output The output buffer, may be equal to \p data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_aes_key_ctr(TAL_AES_KEY_T *aes_key, const uint8_t *data, size_t len, size_t *nc_off,
+                            uint8_t nonce_counter[16], uint8_t stream_block[16], uint8_t *output)
+{
+    if (NULL == aes_key || NULL == aes_key->enc || NULL == data || NULL == output) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return tal_aes_crypt_ctr(aes_key->enc, len, nc_off, nonce_counter, stream_block, (uint8_t *)data, output);
+}
+
 /**
  * @brief Frees the memory allocated for AES data.
  *
@@ -988,4 +1201,72 @@ exit:
     return (ret);
 }
 
+/*
+ * Per-call cost of the one-shot wrappers, which expand the key on every call,
+ * against the key context API on the same payload
+ */
+OPERATE_RET tal_aes_perf_test(uint32_t rounds)
+{
+    OPERATE_RET ret = OPRT_OK;
+    static const uint32_t sizes[] = {16, 64, 256, 1024, 4096};
+    uint8_t key[16] = {0};
+    uint8_t iv[16];
+    uint8_t *buf = NULL;
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
+    TAL_AES_KEY_T aes_key;
+    uint32_t i, j;
+
+    if (0 == rounds) {
+        return OPRT_INVALID_PARM;
+    }
+
+    buf = tal_malloc(TAL_AES_PKCS7_LEN(4096));
+    if (NULL == buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+    if ((ret = tal_aes_key_init(&aes_key, key, 128)) != OPRT_OK) {
+        tal_free(buf);
+        return ret;
+    }
+
+    PR_DEBUG("AES-128-CBC encode, %u rounds, us per call", rounds);
+    PR_DEBUG("%6s %10s %10s", "size", "one-shot", "key ctx");
+
+    for (i = 0; i < CNTSOF(sizes); i++) {
+        SYS_TIME_T start, oneshot_ms, ctx_ms;
+
+        memset(buf, 0x5A, sizes[i]);
+
+        start = tal_system_get_millisecond();
+        for (j = 0; j < rounds; j++) {
+            memset(iv, 0, sizeof(iv));
+            if ((ret = tal_aes128_cbc_encode(buf, sizes[i], key, iv, &ec_data, &ec_len)) != OPRT_OK) {
+                goto exit;
+            }
+            tal_aes_free_data(ec_data);
+        }
+        oneshot_ms = tal_system_get_millisecond() - start;
+
+        start = tal_system_get_millisecond();
+        for (j = 0; j < rounds; j++) {
+            memset(iv, 0, sizeof(iv));
+            ret = tal_aes_key_cbc_encode(&aes_key, iv, buf, sizes[i], buf, TAL_AES_PKCS7_LEN(4096), &ec_len);
+            if (ret != OPRT_OK) {
+                goto exit;
+            }
+        }
+        ctx_ms = tal_system_get_millisecond() - start;
+
+        PR_DEBUG("%6u %10u %10u", sizes[i], (uint32_t)(oneshot_ms * 1000 / rounds),
+                 (uint32_t)(ctx_ms * 1000 / rounds));
+    }
+
+exit:
+    tal_aes_key_deinit(&aes_key);
+    tal_free(buf);
+
+    return ret;
+}
+
 #endif
\ No newline at end of file
@@ -38,14 +38,29 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/sha256.h"
 
 #define TLS_URL_LEN (128 + 16)
 
+/* parsed CA chains kept for reuse, keyed by the certificate content */
+#ifndef TUYA_TLS_CA_CACHE_NUM
+#define TUYA_TLS_CA_CACHE_NUM 4
+#endif
+
+typedef struct {
+    bool valid;
+    uint8_t digest[32];
+    uint32_t refcnt;
+    uint32_t last_used;
+    mbedtls_x509_crt chain;
+} tuya_tls_ca_cache_t;
+
 typedef struct {
     tuya_tls_config_t config;
     mbedtls_ssl_context ssl_ctx;
     mbedtls_ssl_config conf_ctx;
     mbedtls_x509_crt cacert;
+    tuya_tls_ca_cache_t *shared_ca;
     mbedtls_x509_crt client_cert;
     mbedtls_pk_context client_pkey;
     int socket_fd;
@@ -57,6 +72,10 @@ typedef struct {
 #define TLS_HANDSHAKE_TIMEOUT (18) // s
 
 static tuya_tls_pre_conn_cb s_pre_conn_cb = NULL;
+static tuya_tls_event_cb s_event_cb = NULL;
+static tuya_tls_ca_cache_t s_ca_cache[TUYA_TLS_CA_CACHE_NUM];
+static MUTEX_HANDLE s_ca_cache_mutex = NULL;
+static uint32_t s_ca_cache_tick = 0;
 static mbedtls_entropy_context ty_entropy;
 static mbedtls_ctr_drbg_context ty_ctr_drbg;
 
@@ -74,9 +93,10 @@ static void __tuya_tls_event_cb(tuya_tls_event_t event, void *p_args)
     }
     if (event == TUYA_TLS_CERT_EXPIRED) {
         PR_DEBUG("tls cert expired");
-        // tuya_iotdns_query_domain_certs(BAIDU_TOKEN_URL, &cacert,
-        // &cacert_len);
-        // TODO..
+        /* let the certificate owner drop the stale certificate of this host */
+        if (s_event_cb) {
+            s_event_cb(event, p_args);
+        }
         return;
     }
 }
@@ -265,6 +285,12 @@ static void __tuya_tls_log(void *ctx, int level, const char *file, int line, con
     }
 }
 
+/* how long a socket callback waits for readiness, 100ms when no timeout was given */
+static int __tuya_tls_wait_ms(tuya_mbedtls_context_t *tls_context)
+{
+    return (tls_context->overtime_s > 0) ? tls_context->overtime_s * 1000 : 100;
+}
+
 static int __tuya_tls_socket_send_cb(void *ctx, const unsigned char *buf, size_t len)
 {
     tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)ctx;
@@ -272,8 +298,9 @@ static int __tuya_tls_socket_send_cb(void *ctx, const unsigned char *buf, size_t
     int send_len = tal_net_send(tls_context->socket_fd, buf, len);
     if (send_len < 0) {
         PR_ERR("__tuya_tls_socket_send_cb errr %d %d", send_len, tal_net_get_errno());
-        if ((tal_net_get_errno() == UNW_EINTR) || (tal_net_get_errno() == UNW_EAGAIN)) {
-            tal_system_sleep(100);
+        if ((tal_net_get_errno() == UNW_EINTR) ||
+            ((tal_net_get_errno() == UNW_EAGAIN) &&
+             (tal_net_poll(tls_context->socket_fd, TAL_NET_POLL_WRITE, __tuya_tls_wait_ms(tls_context)) > 0))) {
             send_len = tal_net_send(tls_context->socket_fd, buf, len);
             if (send_len < 0) {
                 PR_ERR("__tuya_tls_socket_send_cb errr %d %d", send_len, tal_net_get_errno());
@@ -293,11 +320,8 @@ static int __tuya_tls_socket_recv_cb(void *ctx, unsigned char *buf, size_t len)
         tal_net_set_block(tls_context->socket_fd, FALSE);
     }
 
-    TUYA_FD_SET_T readfds;
-    memset(&readfds, 0, sizeof(TUYA_FD_SET_T));
-    tal_net_fd_set(tls_context->socket_fd, &readfds);
-    int activefds_cnt =
-        tal_net_select(tls_context->socket_fd + 1, &readfds, NULL, NULL, tls_context->overtime_s * 1000);
+    int activefds_cnt = tal_net_poll(tls_context->socket_fd, TAL_NET_POLL_READ,
+                                     (tls_context->overtime_s > 0) ? tls_context->overtime_s * 1000 : -1);
     if (activefds_cnt <= 0) {
         tal_net_set_block(tls_context->socket_fd, 1 - non_block);
         PR_ERR("select fail.%d", activefds_cnt);
@@ -312,6 +336,86 @@ static int __tuya_tls_socket_recv_cb(void *ctx, unsigned char *buf, size_t len)
 
 static int tuya_tls_ciphersuite_list_PSK[] = {MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256, 0};
 
+/**
+ * @brief Get the parsed chain of a CA certificate, parsing it on first use
+ *
+ * @param[in] cert the certificate, PEM or DER
+ * @param[in] cert_len the certificate length
+ * @param[out] entry the shared chain, NULL when every cached chain is in use
+ * and the caller has to parse its own copy
+ *
+ * @return 0 on success, mbedtls error code when the certificate does not parse
+ */
+static int __tuya_tls_ca_cache_get(const uint8_t *cert, size_t cert_len, tuya_tls_ca_cache_t **entry)
+{
+    int ret = 0;
+    uint8_t digest[32];
+    tuya_tls_ca_cache_t *slot = NULL;
+
+    *entry = NULL;
+    if (NULL == s_ca_cache_mutex) {
+        return 0;
+    }
+
+    ret = mbedtls_sha256(cert, cert_len, digest, 0);
+    if (ret != 0) {
+        return 0;
+    }
+
+    tal_mutex_lock(s_ca_cache_mutex);
+    s_ca_cache_tick++;
+    for (int i = 0; i < TUYA_TLS_CA_CACHE_NUM; i++) {
+        tuya_tls_ca_cache_t *cache = &s_ca_cache[i];
+        if (cache->valid && 0 == memcmp(cache->digest, digest, sizeof(digest))) {
+            cache->refcnt++;
+            cache->last_used = s_ca_cache_tick;
+            *entry = cache;
+            goto __exit;
+        }
+        /* an empty slot, or else the least recently used one that is not in use */
+        if (!cache->valid) {
+            if (NULL == slot || slot->valid) {
+                slot = cache;
+            }
+        } else if (0 == cache->refcnt && (NULL == slot || (slot->valid && cache->last_used < slot->last_used))) {
+            slot = cache;
+        }
+    }
+
+    if (NULL == slot) {
+        goto __exit;
+    }
+
+    if (slot->valid) {
+        mbedtls_x509_crt_free(&slot->chain);
+        slot->valid = false;
+    }
+    mbedtls_x509_crt_init(&slot->chain);
+    ret = mbedtls_x509_crt_parse(&slot->chain, (const unsigned char *)cert, cert_len);
+    if (ret != 0) {
+        mbedtls_x509_crt_free(&slot->chain);
+        goto __exit;
+    }
+    memcpy(slot->digest, digest, sizeof(digest));
+    slot->valid = true;
+    slot->refcnt = 1;
+    slot->last_used = s_ca_cache_tick;
+    *entry = slot;
+
+__exit:
+    tal_mutex_unlock(s_ca_cache_mutex);
+    return ret;
+}
+
+static void __tuya_tls_ca_cache_put(tuya_tls_ca_cache_t *entry)
+{
+    tal_mutex_lock(s_ca_cache_mutex);
+    if (entry->refcnt > 0) {
+        entry->refcnt--;
+    }
+    tal_mutex_unlock(s_ca_cache_mutex);
+}
+
 static void mbedtls_cert_pkey_free(tuya_tls_hander p_tls_handler)
 {
     tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)p_tls_handler;
@@ -319,6 +423,11 @@ static void mbedtls_cert_pkey_free(tuya_tls_hander p_tls_handler)
 
     PR_DEBUG("mbedtls_cert_pkey_free.");
 
+    if (tls_context->shared_ca) {
+        __tuya_tls_ca_cache_put(tls_context->shared_ca);
+        tls_context->shared_ca = NULL;
+    }
+
     if (config->ca_cert) {
         mbedtls_x509_crt_free(&tls_context->cacert);
     } else if (config->client_cert && config->client_pkey) {
@@ -346,14 +455,21 @@ static OPERATE_RET mbedtls_cert_pkey_parse(tuya_tls_hander p_tls_handler)
     mbedtls_x509_crt *p_cert_ctx = &(tls_context->cacert);
     mbedtls_x509_crt_init(p_cert_ctx);
 
-    // parse ca cert
+    // parse ca cert, the chain is shared by every connection using the same certificate
     if (config->ca_cert) {
         PR_DEBUG("load root ca cert.");
-        op_ret = mbedtls_x509_crt_parse(p_cert_ctx, (const unsigned char *)config->ca_cert, config->ca_cert_size);
+        op_ret = __tuya_tls_ca_cache_get((const uint8_t *)config->ca_cert, config->ca_cert_size,
+                                         &tls_context->shared_ca);
+        if (op_ret == OPRT_OK && NULL == tls_context->shared_ca) {
+            op_ret = mbedtls_x509_crt_parse(p_cert_ctx, (const unsigned char *)config->ca_cert, config->ca_cert_size);
+        }
         if (op_ret != OPRT_OK) {
             PR_ERR("mbedtls_x509_crt_parse Fail. 0x%x %d", -op_ret, op_ret);
             return op_ret;
         }
+        if (tls_context->shared_ca) {
+            p_cert_ctx = &tls_context->shared_ca->chain;
+        }
         mbedtls_ssl_conf_ca_chain(&(tls_context->conf_ctx), p_cert_ctx, NULL);
     }
 
@@ -426,6 +542,11 @@ OPERATE_RET tuya_tls_init(void)
     }
     mbedtls_ctr_drbg_set_prediction_resistance(&ty_ctr_drbg, MBEDTLS_CTR_DRBG_PR_OFF);
 
+    /* without the mutex CA chains are parsed per connection */
+    if (NULL == s_ca_cache_mutex && OPRT_OK != tal_mutex_create_init(&s_ca_cache_mutex)) {
+        s_ca_cache_mutex = NULL;
+    }
+
     PR_NOTICE("tuya_tls_init ok!");
 
     return OPRT_OK;
@@ -446,6 +567,17 @@ void tuya_tls_register_pre_conn_cb(tuya_tls_pre_conn_cb pre_conn)
     s_pre_conn_cb = pre_conn;
 }
 
+/**
+ * @brief register cb invoked on tls events of connections that do not set
+ * their own exception_cb
+ *
+ * @param[in] event_cb callback
+ */
+void tuya_tls_register_event_cb(tuya_tls_event_cb event_cb)
+{
+    s_event_cb = event_cb;
+}
+
 tuya_tls_hander *tuya_tls_connect_create(void)
 {
     OPERATE_RET ret = OPRT_OK;
@@ -734,8 +866,13 @@ int tuya_tls_write(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len)
             continue;
         }
 
+        // non-blocking socket, wait until it can make progress instead of spinning
         if ((ret == MBEDTLS_ERR_SSL_WANT_READ) || (ret == MBEDTLS_ERR_SSL_WANT_WRITE)) {
-            continue;
+            if (tal_net_poll(tls_context->socket_fd,
+                             (ret == MBEDTLS_ERR_SSL_WANT_READ) ? TAL_NET_POLL_READ : TAL_NET_POLL_WRITE,
+                             __tuya_tls_wait_ms(tls_context)) >= 0) {
+                continue;
+            }
         }
 
         // PR_ERR("mbedtls_ssl_write returned %d errno %d", ret,
@@ -784,6 +921,33 @@ int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len)
     return value;
 }
 
+/**
+ * @brief Checks whether data can be read without touching the socket.
+ *
+ * Records already received and decrypted, or received but not yet processed,
+ * are held by the TLS layer. The socket does not become readable for them, so
+ * a caller waiting on the socket fd has to check this first.
+ *
+ * @param[in] tls_handler The TLS handler.
+ *
+ * @return The number of decrypted bytes available, 1 if only undecrypted data
+ * is buffered, 0 if nothing is buffered.
+ */
+int tuya_tls_read_pending(tuya_tls_hander tls_handler)
+{
+    if (tls_handler == NULL) {
+        return 0;
+    }
+
+    tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)tls_handler;
+    int avail = (int)mbedtls_ssl_get_bytes_avail(&(tls_context->ssl_ctx));
+    if (avail > 0) {
+        return avail;
+    }
+
+    return mbedtls_ssl_check_pending(&(tls_context->ssl_ctx)) ? 1 : 0;
+}
+
 /**
  * @brief generated random
  *
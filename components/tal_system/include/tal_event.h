@@ -61,6 +61,33 @@ typedef uint8_t SUBSCRIBE_TYPE_E;
     2 // one time type, dispatch by the subscribe order, remove after first time
       // dispath
 
+/**
+ * @brief max number of distinct event names, ids are allocated in chunks of
+ * EVENT_ID_CHUNK_SIZE
+ *
+ */
+#ifndef EVENT_ID_MAX
+#define EVENT_ID_MAX (128)
+#endif
+
+#define EVENT_ID_CHUNK_SIZE (16)
+
+/**
+ * @brief event name hash buckets, must be a power of two
+ *
+ */
+#ifndef EVENT_HASH_SIZE
+#define EVENT_HASH_SIZE (32)
+#endif
+
+/**
+ * @brief interned event id, an event name maps to the same id for the whole
+ * run time
+ *
+ */
+typedef uint16_t EVENT_ID;
+#define EVENT_ID_INVALID 0
+
 /**
  * @brief the event dispatch raw data
  *
@@ -93,10 +120,13 @@ typedef struct {
  * @brief the event node
  *
  */
-typedef struct {
+typedef struct event_node {
     MUTEX_HANDLE mutex; // mutex, protection the event publish and subscribe
 
     char name[EVENT_NAME_MAX_LEN + 1];    // name, the event name
+    EVENT_ID id;                          // interned id of the name
+    uint32_t hash;                        // hash of the name
+    struct event_node *hash_next;         // next node in the same hash bucket
     struct tuya_list_head node;           // list node, used to attach to the event manage module
     struct tuya_list_head subscribe_root; // subscibe root, used to manage the subscriber
 } EVENT_NODE_T;
@@ -110,8 +140,8 @@ typedef struct {
     MUTEX_HANDLE mutex;                        // mutex, used to protection event manage node
     int event_cnt;                             // current event number
     struct tuya_list_head event_root;          // event root, used to manage the event
-    struct tuya_list_head free_subscribe_root; // free subscriber list, used to manage the
-                                               // subscribe which not found the event
+    EVENT_NODE_T *hash[EVENT_HASH_SIZE];       // name hash buckets, nodes are never removed
+    EVENT_NODE_T **id_chunk[(EVENT_ID_MAX + EVENT_ID_CHUNK_SIZE - 1) / EVENT_ID_CHUNK_SIZE]; // id to node
 } EVENT_MANAGE_T;
 
 /**
@@ -132,6 +162,53 @@ OPERATE_RET tal_event_init(void);
  */
 OPERATE_RET tal_event_publish(const char *name, void *data);
 
+/**
+ * @brief: get the interned id of an event, the event is created if needed
+ *
+ * @param[in] name: event name
+ * @return the event id, EVENT_ID_INVALID on invalid name or no memory
+ */
+EVENT_ID tal_event_id_get(const char *name);
+
+/**
+ * @brief: publish event by interned id, skips the name lookup
+ *
+ * @param[in] id: event id from tal_event_id_get
+ * @param[in] data: event data
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_by_id(EVENT_ID id, void *data);
+
+/**
+ * @brief: publish event from the system workqueue, the caller does not run
+ * any subscriber
+ *
+ * @param[in] name: event name
+ * @param[in] data: event data
+ * @param[in] len: 0 to pass data as is, it must stay valid until dispatched.
+ * Otherwise len bytes of data are copied and the subscribers get the copy.
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ *
+ * @note events of the same name are dispatched in publish order. Before
+ * tal_workq_init the event is dispatched synchronously. When the workqueue is
+ * full the event is dropped and an error returned, it is never dispatched
+ * ahead of the queued ones.
+ */
+OPERATE_RET tal_event_publish_async(const char *name, void *data, uint32_t len);
+
+/**
+ * @brief: publish event by interned id from the system workqueue
+ *
+ * @param[in] id: event id from tal_event_id_get
+ * @param[in] data: event data
+ * @param[in] len: 0 to pass data as is, otherwise the length of data to copy
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_async_by_id(EVENT_ID id, void *data, uint32_t len);
+
 /**
  * @brief: subscribe event
  *
@@ -81,6 +81,15 @@ typedef enum {
 
 typedef TAL_LOG_LEVEL_E LOG_LEVEL;
 
+/**
+ * @brief counters of the async log backend
+ */
+typedef struct {
+    uint32_t written;  // records output by the writer thread
+    uint32_t deferred; // of which formatted in the writer thread
+    uint32_t dropped;  // records lost because the ring was full
+} TAL_LOG_ASYNC_STAT_T;
+
 #if defined(MAX_SIZE_OF_DEBUG_BUF)
 #define DEF_LOG_BUF_LEN MAX_SIZE_OF_DEBUG_BUF
 #else
@@ -349,6 +358,32 @@ void tal_log_color_set(const TAL_LOG_LEVEL_E level, TAL_LOG_DISPLAY_MODE_E displ
 OPERATE_RET tal_log_color_print_raw(TAL_LOG_DISPLAY_MODE_E display_mode, TAL_LOG_FONT_COLOR_E font_color, 
                                     TAL_LOG_BACKGROUND_COLOR_E background_color, const char *pFmt, ...);
 
+/**
+ * @brief Moves log output to a background writer thread.
+ *
+ * Log calls copy the record into a lock-free ring and return, a low priority
+ * writer thread outputs it. Records that do not fit into the ring are dropped
+ * and counted instead of blocking the caller.
+ *
+ * @param[in] ring_size ring size in bytes
+ * @param[in] deferred_format TRUE to store the format and arguments and format
+ * in the writer thread. The format string and file name must stay valid, which
+ * holds for the PR_* macros.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_async_start(uint32_t ring_size, BOOL_T deferred_format);
+
+/**
+ * @brief Gets the counters of the async log backend.
+ *
+ * @param[out] stat counters
+ *
+ * @return OPRT_OK on success, OPRT_INVALID_PARM if the backend is not started
+ */
+OPERATE_RET tal_log_async_stat_get(TAL_LOG_ASYNC_STAT_T *stat);
+
 #ifdef __cplusplus
 }
 #endif /* __TAL_LOG_H__ */
@@ -27,6 +27,7 @@
 #define __TAL_SW_TIMER_H__
 
 #include "tuya_cloud_types.h"
+#include "tal_workq_service.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +44,14 @@ typedef enum {
     TAL_TIMER_CYCLE,
 } TIMER_TYPE;
 
+/**
+ * @brief where the timer callback runs
+ */
+typedef enum {
+    TAL_TIMER_DISPATCH_INLINE = 0, // on the timer thread, for short non-blocking callbacks
+    TAL_TIMER_DISPATCH_WORKQ,      // posted to a tal_workq_service workqueue
+} TIMER_DISPATCH_E;
+
 /***********************************************************************
  ********************* struct ******************************************
  **********************************************************************/
@@ -51,6 +60,20 @@ typedef void *TIMER_ID;
 
 typedef void (*TAL_TIMER_CB)(TIMER_ID timer_id, void *arg);
 
+/**
+ * @brief timer dispatch statistics
+ */
+typedef struct {
+    uint32_t fired;         // callbacks dispatched
+    uint32_t triggered;     // of fired, expired by tal_sw_timer_trigger, left out of the lateness stats
+    uint32_t late;          // dispatched more than TIMER_LATE_THRESHOLD_MS after expiry
+    uint32_t max_late_ms;   // worst lateness seen
+    uint64_t total_late_ms; // sum of lateness, for the average
+    uint32_t offloaded;     // callbacks posted to a workqueue
+    uint32_t coalesced;     // expiries dropped because the previous work was still pending
+    uint32_t offload_fail;  // posts that failed and ran inline instead
+} TAL_TIMER_STAT_T;
+
 /***********************************************************************
  ********************* variable ****************************************
  **********************************************************************/
@@ -180,6 +203,33 @@ OPERATE_RET tal_sw_timer_release(void);
  */
 int tal_sw_timer_get_num(void);
 
+/**
+ * @brief Set where the timer callback runs
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] mode: see TIMER_DISPATCH_E, inline by default
+ * @param[in] service: the workqueue used in TAL_TIMER_DISPATCH_WORKQ mode
+ *
+ * @note Callbacks that may block (kv, flash, network) should be posted to a
+ * workqueue so they do not delay the other timers. An expiry that happens while
+ * the previous work of the timer is still queued is coalesced into it.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_set_dispatch(TIMER_ID timer_id, TIMER_DISPATCH_E mode, WORKQ_SERVICE_E service);
+
+/**
+ * @brief Get the timer dispatch statistics
+ *
+ * @param[out] stat: the statistics
+ * @param[in] reset: clear the statistics after reading
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_get_stat(TAL_TIMER_STAT_T *stat, BOOL_T reset);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,7 +24,7 @@
 #include "tal_workqueue.h"
 
 /**
- * @brief TuyaOS provides developers with two workqueue service for convenience.
+ * @brief TuyaOS provides developers with three workqueue service for convenience.
  */
 typedef enum {
     /**
@@ -34,7 +34,12 @@ typedef enum {
     /**
      * high priority workqueue (block operations are not allowed)
      */
-    WORKQ_HIGHTPRI
+    WORKQ_HIGHTPRI,
+    /**
+     * blocking network io such as TLS sends, so a stalled peer does not hold
+     * up WORKQ_SYSTEM. Same as WORKQ_SYSTEM when WORKQ_NETWORK_WORKER_NUM is 0
+     */
+    WORKQ_NETWORK
 } WORKQ_SERVICE_E;
 
 /**
@@ -78,6 +83,19 @@ OPERATE_RET tal_workq_schedule(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *d
  */
 OPERATE_RET tal_workq_schedule_instant(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue, ordered with the work of the same key
+ *
+ * @param[in] service the workqueue service
+ * @param[in] key the ordering key, 0 for unordered work
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_ordered(WORKQ_SERVICE_E service, uint32_t key, WORKQUEUE_CB cb, void *data);
+
 /**
  * @brief cancel work task in workqueue
  *
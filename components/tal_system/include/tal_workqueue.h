@@ -52,6 +52,24 @@ typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle);
 
+/**
+ * @brief create and initialize a workqueue served by a pool of threads
+ *
+ * Unkeyed work goes to an idle worker and may be stolen by any worker that
+ * runs out of work, so it can run concurrently. Work scheduled with the same
+ * ordering key always runs on the same worker, in submission order.
+ *
+ * @param[in] queue_len the maximum number of items per worker
+ * @param[in] worker_num number of worker threads, 1 to WORKQUEUE_WORKER_MAX
+ * @param[in] thread_cfg thread param, shared by all workers
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint16_t queue_len, uint8_t worker_num, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle);
+
 /**
  * @brief put work task in workqueue
  *
@@ -76,6 +94,19 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue, ordered with the work of the same key
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] key the ordering key, 0 for unordered work
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_ordered(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data);
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -11,14 +11,15 @@
  * consumers, facilitating a more modular and maintainable codebase. It includes
  * mechanisms for validating event names and descriptions, creating and
  * initializing event nodes, managing subscriptions, and dispatching events to
- * subscribed listeners. Additionally, it supports the management of free
- * subscriptions to optimize memory usage.
+ * subscribed listeners. Event names are interned to integer ids the first time
+ * they are subscribed or published, so later lookups are a hash or an index.
  *
  * Key functionalities include:
  * - Event name and description validation
  * - Event node creation and initialization
  * - Subscription management (addition, deletion, retrieval)
- * - Event dispatching to subscribed listeners
+ * - Event dispatching to subscribed listeners, inline or from the system
+ *   workqueue
  * - Thread-safe operations through mutex locking
  * - Debugging utilities for event and subscription dumping
  *
@@ -62,46 +63,90 @@ BOOL_T _event_desc_is_valid(const char *desc)
     return TRUE;
 }
 
+static uint32_t _event_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static EVENT_NODE_T *_event_node_find(const char *name, uint32_t hash)
+{
+    // lock-free walk, pairs with the release stores in _event_node_create_init
+    EVENT_NODE_T *entry = __atomic_load_n(&g_event_manager.hash[hash & (EVENT_HASH_SIZE - 1)], __ATOMIC_ACQUIRE);
+
+    for (; entry; entry = __atomic_load_n(&entry->hash_next, __ATOMIC_ACQUIRE)) {
+        if (entry->hash == hash && 0 == strcmp(entry->name, name)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
 EVENT_NODE_T *_event_node_create_init(const char *name)
 {
+    uint32_t hash = _event_name_hash(name);
+    EVENT_NODE_T *event = NULL;
+    EVENT_NODE_T ***chunk = NULL;
+
+    tal_mutex_lock(g_event_manager.mutex);
+
+    // another thread may have interned the name meanwhile
+    event = _event_node_find(name, hash);
+    if (event) {
+        goto __exit;
+    }
+
+    if (g_event_manager.event_cnt >= EVENT_ID_MAX) {
+        PR_ERR("event id full, %s", name);
+        goto __exit;
+    }
+
+    // ids start from 1, EVENT_ID_INVALID is 0
+    chunk = &g_event_manager.id_chunk[g_event_manager.event_cnt / EVENT_ID_CHUNK_SIZE];
+    if (NULL == *chunk) {
+        EVENT_NODE_T **slots = (EVENT_NODE_T **)tal_malloc(EVENT_ID_CHUNK_SIZE * sizeof(EVENT_NODE_T *));
+        if (NULL == slots) {
+            goto __exit;
+        }
+        memset(slots, 0, EVENT_ID_CHUNK_SIZE * sizeof(EVENT_NODE_T *));
+        __atomic_store_n(chunk, slots, __ATOMIC_RELEASE);
+    }
+
     // allocate memory
-    EVENT_NODE_T *event = tal_malloc(sizeof(EVENT_NODE_T));
-    TUYA_CHECK_NULL_RETURN(event, NULL);
+    event = tal_malloc(sizeof(EVENT_NODE_T));
+    if (NULL == event) {
+        goto __exit;
+    }
     memset(event, 0, sizeof(EVENT_NODE_T));
 
     // initialze the event node
     memcpy(event->name, name, strlen(name));
     event->name[strlen(name)] = '\0';
+    event->hash = hash;
     INIT_LIST_HEAD(&event->subscribe_root);
-    tal_mutex_create_init(&event->mutex);
-
-    tal_mutex_lock(g_event_manager.mutex);
-
-    // need check if there have free subscriber which subscribe this event
-    struct tuya_list_head *free_pos = NULL;
-    struct tuya_list_head *free_next = NULL;
-    SUBSCRIBE_NODE_T *free_entry = NULL;
-    tuya_list_for_each_safe(free_pos, free_next, &g_event_manager.free_subscribe_root)
-    {
-        // find by event name, and add it to subscribe list
-        free_entry = tuya_list_entry(free_pos, SUBSCRIBE_NODE_T, node);
-        if (0 == strcmp(free_entry->name, name)) {
-            // del from free subscrbe list
-            tuya_list_del(&free_entry->node);
-
-            // add to different position according to the emergence flag
-            if (free_entry->type == SUBSCRIBE_TYPE_EMERGENCY) {
-                tuya_list_add(&free_entry->node, &event->subscribe_root);
-            } else {
-                tuya_list_add_tail(&free_entry->node, &event->subscribe_root);
-            }
-        }
+    if (OPRT_OK != tal_mutex_create_init(&event->mutex)) {
+        tal_free(event);
+        event = NULL;
+        goto __exit;
     }
 
-    // at last, need add this event to event manage root
+    // publish the node last, lookups by id and by name run without the lock
+    event->id = g_event_manager.event_cnt + 1;
+    __atomic_store_n(&(*chunk)[g_event_manager.event_cnt % EVENT_ID_CHUNK_SIZE], event, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_event_manager.event_cnt, event->id, __ATOMIC_RELEASE);
+
+    event->hash_next = g_event_manager.hash[hash & (EVENT_HASH_SIZE - 1)];
+    __atomic_store_n(&g_event_manager.hash[hash & (EVENT_HASH_SIZE - 1)], event, __ATOMIC_RELEASE);
     tuya_list_add_tail(&event->node, &g_event_manager.event_root);
-    g_event_manager.event_cnt++;
 
+__exit:
     tal_mutex_unlock(g_event_manager.mutex);
 
     return event;
@@ -109,36 +154,20 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
 
 EVENT_NODE_T *_event_node_get(const char *name)
 {
-    // try to get event from event root
-    EVENT_NODE_T *entry = NULL;
-    struct tuya_list_head *pos = NULL;
-    tuya_list_for_each(pos, &g_event_manager.event_root)
-    {
-        // find by name
-        entry = tuya_list_entry(pos, EVENT_NODE_T, node);
-        if (0 == strcmp(entry->name, name)) {
-            return entry;
-        }
-    }
-
-    return NULL;
+    return _event_node_find(name, _event_name_hash(name));
 }
 
-SUBSCRIBE_NODE_T *_event_node_get_free_subscribe(SUBSCRIBE_NODE_T *subscribe)
+EVENT_NODE_T *_event_node_get_by_id(EVENT_ID id)
 {
-    struct tuya_list_head *pos = NULL;
-    SUBSCRIBE_NODE_T *entry = NULL;
-    tuya_list_for_each(pos, &g_event_manager.free_subscribe_root)
-    {
-        // find by desc
-        entry = tuya_list_entry(pos, SUBSCRIBE_NODE_T, node);
-        if (0 == strcmp(entry->name, subscribe->name) && 0 == strcmp(entry->desc, subscribe->desc) &&
-            entry->cb == subscribe->cb) {
-            return entry;
-        }
+    EVENT_NODE_T **chunk = NULL;
+
+    if (EVENT_ID_INVALID == id || id > __atomic_load_n(&g_event_manager.event_cnt, __ATOMIC_ACQUIRE)) {
+        return NULL;
     }
 
-    return NULL;
+    id--;
+    chunk = __atomic_load_n(&g_event_manager.id_chunk[id / EVENT_ID_CHUNK_SIZE], __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&chunk[id % EVENT_ID_CHUNK_SIZE], __ATOMIC_ACQUIRE);
 }
 
 SUBSCRIBE_NODE_T *_event_node_get_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *subscribe)
@@ -184,22 +213,19 @@ OPERATE_RET _event_node_dispatch(EVENT_NODE_T *event, void *data)
     return rt;
 }
 
-OPERATE_RET _event_node_add_free_subscribe(SUBSCRIBE_NODE_T *subscribe)
+OPERATE_RET _event_node_publish(EVENT_NODE_T *event, void *data)
 {
     OPERATE_RET rt = OPRT_OK;
 
-    // existed, return ok, dont care, pretend to success
-    SUBSCRIBE_NODE_T *new_entry = _event_node_get_free_subscribe(subscribe);
-    if (new_entry) {
-        return OPRT_OK;
-    }
+    // to keep the consistency, dispatch will done in mutex lock
+    tal_mutex_lock(event->mutex);
+    // try to dispatch event to all subscribe
+    // if one of the subscribe failed, it will continue but will return failed
+    // to record the execute status
+    TUYA_CALL_ERR_LOG(_event_node_dispatch(event, data));
 
-    // malloc a new entry and prepare to add
-    new_entry = (SUBSCRIBE_NODE_T *)tal_malloc(sizeof(SUBSCRIBE_NODE_T));
-    TUYA_CHECK_NULL_RETURN(new_entry, OPRT_MALLOC_FAILED);
-    memcpy(new_entry, subscribe, sizeof(SUBSCRIBE_NODE_T));
+    tal_mutex_unlock(event->mutex);
 
-    tuya_list_add_tail(&new_entry->node, &g_event_manager.free_subscribe_root);
     return rt;
 }
 
@@ -228,11 +254,12 @@ OPERATE_RET _event_node_add_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *sub
     return rt;
 }
 
-OPERATE_RET _event_node_del_free_subscribe(SUBSCRIBE_NODE_T *subscribe)
+OPERATE_RET _event_node_del_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *subscribe)
 {
     OPERATE_RET rt = OPRT_OK;
+    SUBSCRIBE_NODE_T *new_entry = NULL;
     // not existed, return ok, dont care, pretend to success
-    SUBSCRIBE_NODE_T *new_entry = _event_node_get_free_subscribe(subscribe);
+    new_entry = _event_node_get_subscribe(event, subscribe);
     if (new_entry == NULL) {
         return OPRT_OK;
     }
@@ -241,25 +268,24 @@ OPERATE_RET _event_node_del_free_subscribe(SUBSCRIBE_NODE_T *subscribe)
     tuya_list_del(&new_entry->node);
     tal_free((void *)new_entry);
     new_entry = NULL;
-
     return rt;
 }
 
-OPERATE_RET _event_node_del_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *subscribe)
+typedef struct {
+    EVENT_ID id;
+    void *data;
+    uint8_t buf[]; // copy of the data when published with a length
+} EVENT_ASYNC_T;
+
+static void _event_async_cb(void *data)
 {
-    OPERATE_RET rt = OPRT_OK;
-    SUBSCRIBE_NODE_T *new_entry = NULL;
-    // not existed, return ok, dont care, pretend to success
-    new_entry = _event_node_get_subscribe(event, subscribe);
-    if (new_entry == NULL) {
-        return OPRT_OK;
-    }
+    EVENT_ASYNC_T *async = (EVENT_ASYNC_T *)data;
+    EVENT_NODE_T *event = _event_node_get_by_id(async->id);
 
-    // dont forget remove and free
-    tuya_list_del(&new_entry->node);
-    tal_free((void *)new_entry);
-    new_entry = NULL;
-    return rt;
+    if (event) {
+        _event_node_publish(event, async->data);
+    }
+    tal_free(async);
 }
 
 #if 0
@@ -292,18 +318,6 @@ int _ty_event_dump()
         }
     }
 
-    // free subscribe
-    PR_DEBUG("------------------------free--------------------------------------");
-    PR_DEBUG("name                desc                                cb");
-    PR_DEBUG("------------------------------------------------------------------");
-    SUBSCRIBE_NODE_T * subscribe = NULL;
-    tuya_list_for_each(s_pos, &g_event_manager.free_subscribe_root) {
-        subscribe = tuya_list_entry(s_pos, SUBSCRIBE_NODE_T, node);
-        if (subscribe) {
-            PR_DEBUG("%-16s    %-32s    0x%08x", subscribe->name, subscribe->desc, subscribe->cb);
-        }
-    }
-
     PR_DEBUG("\n");
 
     return OPRT_OK;
@@ -317,7 +331,7 @@ int _ty_event_dump()
  * steps:
  * 1. Checks if the event manager is already initialized. If it is, the function
  * returns OPRT_OK.
- * 2. Initializes the event root and free subscribe root lists.
+ * 2. Initializes the event root list.
  * 3. Creates and initializes the event manager mutex.
  * 4. Sets the event count to 0 and marks the event manager as initialized.
  *
@@ -336,7 +350,6 @@ OPERATE_RET tal_event_init(void)
     // we will add os adapter and base layer init here to make it success
 
     INIT_LIST_HEAD(&g_event_manager.event_root);
-    INIT_LIST_HEAD(&g_event_manager.free_subscribe_root);
     tal_mutex_create_init(&g_event_manager.mutex);
     g_event_manager.event_cnt = 0;
     g_event_manager.inited = TRUE;
@@ -374,7 +387,6 @@ OPERATE_RET tal_event_publish(const char *name, void *data)
         return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
     }
 
-    OPERATE_RET rt = OPRT_OK;
     // try to get event, if not exist, create and init.
     EVENT_NODE_T *event = _event_node_get(name);
     if (!event) {
@@ -382,16 +394,125 @@ OPERATE_RET tal_event_publish(const char *name, void *data)
         TUYA_CHECK_NULL_RETURN(event, OPRT_MALLOC_FAILED);
     }
 
-    // to keep the consistency, dispatch will done in mutex lock
-    tal_mutex_lock(event->mutex);
-    // try to dispatch event to all subscribe
-    // if one of the subscribe failed, it will continue but will return failed
-    // to record the execute status
-    TUYA_CALL_ERR_LOG(_event_node_dispatch(event, data));
+    return _event_node_publish(event, data);
+}
 
-    tal_mutex_unlock(event->mutex);
+/**
+ * @brief Gets the interned id of an event.
+ *
+ * The name is looked up once and the event node is created if it does not
+ * exist yet, so the id stays valid for the whole run time. Publishing by id
+ * skips the name hashing and comparison.
+ *
+ * @param[in] name The name of the event.
+ * @return The event id, or EVENT_ID_INVALID if the name is invalid or the
+ * event could not be created.
+ */
+EVENT_ID tal_event_id_get(const char *name)
+{
+    if (g_event_manager.inited != TRUE) {
+        tal_event_init();
+    }
 
-    return rt;
+    if (!_event_name_is_valid(name)) {
+        return EVENT_ID_INVALID;
+    }
+
+    EVENT_NODE_T *event = _event_node_get(name);
+    if (!event) {
+        event = _event_node_create_init(name);
+    }
+
+    return event ? event->id : EVENT_ID_INVALID;
+}
+
+/**
+ * @brief Publishes an event by its interned id.
+ *
+ * @param[in] id The event id returned by tal_event_id_get().
+ * @param[in] data The data associated with the event.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_by_id(EVENT_ID id, void *data)
+{
+    EVENT_NODE_T *event = _event_node_get_by_id(id);
+    if (!event) {
+        return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
+    }
+
+    return _event_node_publish(event, data);
+}
+
+/**
+ * @brief Publishes an event from the system workqueue.
+ *
+ * The subscribers run in the workqueue thread, so a publisher such as a
+ * network thread never runs subscriber code. Events sharing a name are
+ * dispatched in publish order.
+ *
+ * @param[in] name The name of the event to publish.
+ * @param[in] data The data associated with the event.
+ * @param[in] len 0 to pass data as is, it must stay valid until dispatched.
+ * Otherwise len bytes of data are copied and the copy is freed after dispatch.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_async(const char *name, void *data, uint32_t len)
+{
+    EVENT_ID id = tal_event_id_get(name);
+    if (EVENT_ID_INVALID == id) {
+        return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
+    }
+
+    return tal_event_publish_async_by_id(id, data, len);
+}
+
+/**
+ * @brief Publishes an event by its interned id from the system workqueue.
+ *
+ * @param[in] id The event id returned by tal_event_id_get().
+ * @param[in] data The data associated with the event.
+ * @param[in] len 0 to pass data as is, otherwise the length of data to copy.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_async_by_id(EVENT_ID id, void *data, uint32_t len)
+{
+    EVENT_NODE_T *event = _event_node_get_by_id(id);
+    if (!event) {
+        return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
+    }
+
+    if (len && NULL == data) {
+        return OPRT_INVALID_PARM;
+    }
+
+    EVENT_ASYNC_T *async = (EVENT_ASYNC_T *)tal_malloc(sizeof(EVENT_ASYNC_T) + len);
+    TUYA_CHECK_NULL_RETURN(async, OPRT_MALLOC_FAILED);
+    async->id = id;
+    async->data = data;
+    if (len) {
+        memcpy(async->buf, data, len);
+        async->data = async->buf;
+    }
+
+    // nothing can be queued before the workqueue exists, so running inline keeps the order
+    if (NULL == tal_workq_get_handle(WORKQ_SYSTEM)) {
+        _event_async_cb(async);
+        return OPRT_OK;
+    }
+
+    // keyed by the event id, the same event keeps its order on a multi-worker queue
+    OPERATE_RET rt = tal_workq_schedule_ordered(WORKQ_SYSTEM, id, _event_async_cb, async);
+    if (OPRT_OK != rt) {
+        // earlier events of this id may still be queued, running this one inline would overtake them
+        PR_ERR("event %d async queue fail %d", id, rt);
+        tal_free(async);
+        return rt;
+    }
+
+    return OPRT_OK;
 }
 
 /**
@@ -432,19 +553,17 @@ OPERATE_RET tal_event_subscribe(const char *name, const char *desc, const EVENT_
     memcpy(subscribe.desc, desc, strlen(desc));
     subscribe.desc[strlen(desc)] = '\0';
 
+    // intern the name now, publishers later find the subscriber directly
     EVENT_NODE_T *event = _event_node_get(name);
     if (!event) {
-        // if not found the event, add to the free list
-        tal_mutex_lock(g_event_manager.mutex);
-        TUYA_CALL_ERR_LOG(_event_node_add_free_subscribe(&subscribe));
-        tal_mutex_unlock(g_event_manager.mutex);
-    } else {
-        // if found the event, add to the subscribe list
-        tal_mutex_lock(event->mutex);
-        TUYA_CALL_ERR_LOG(_event_node_add_subscribe(event, &subscribe));
-        tal_mutex_unlock(event->mutex);
+        event = _event_node_create_init(name);
+        TUYA_CHECK_NULL_RETURN(event, OPRT_MALLOC_FAILED);
     }
 
+    tal_mutex_lock(event->mutex);
+    TUYA_CALL_ERR_LOG(_event_node_add_subscribe(event, &subscribe));
+    tal_mutex_unlock(event->mutex);
+
     return rt;
 }
 
@@ -455,8 +574,7 @@ OPERATE_RET tal_event_subscribe(const char *name, const char *desc, const EVENT_
  * description, and callback function. If the event manager is not initialized,
  * it will be initialized before unsubscribing. The function checks if the event
  * description and name are valid before proceeding with the unsubscribe
- * operation. If the event is found, it is removed from the subscribe list. If
- * the event is not found, the subscription is removed from the free list.
+ * operation. If the event is found, it is removed from the subscribe list.
  *
  * @param[in] name The name of the event to unsubscribe from.
  * @param[in] desc The description of the event to unsubscribe from.
@@ -487,14 +605,9 @@ OPERATE_RET tal_event_unsubscribe(const char *name, const char *desc, EVENT_SUBS
     memcpy(subscribe.desc, desc, strlen(desc));
     subscribe.desc[strlen(desc)] = '\0';
 
+    // not interned means never subscribed, nothing to remove
     EVENT_NODE_T *event = _event_node_get(name);
-    if (!event) {
-        // if not found the event, del from the free list
-        tal_mutex_lock(g_event_manager.mutex);
-        TUYA_CALL_ERR_LOG(_event_node_del_free_subscribe(&subscribe));
-        tal_mutex_unlock(g_event_manager.mutex);
-    } else {
-        // if found the event, del from the subscribe list
+    if (event) {
         tal_mutex_lock(event->mutex);
         TUYA_CALL_ERR_LOG(_event_node_del_subscribe(event, &subscribe));
         tal_mutex_unlock(event->mutex);
@@ -37,6 +37,8 @@
 #include "tal_system.h"
 #include "tal_time_service.h"
 #include "tal_memory.h"
+#include "tal_thread.h"
+#include "tal_semaphore.h"
 
 /***********************************************************
 *************************micro define***********************
@@ -61,6 +63,8 @@ typedef struct {
     LOG_TEXT_STYLE_S style[LOG_LEVEL_MAX+1];
 } LOG_COLOR_S;
 
+typedef struct log_async LOG_ASYNC_T;
+
 typedef struct {
     LOG_LEVEL curLogLevel;
     LIST_HEAD listHead;
@@ -72,6 +76,9 @@ typedef struct {
     int log_buf_len;
     BOOL_T ms_level;
     char *log_buf;
+
+    LOG_ASYNC_T *async;    // NULL: format and output in the caller
+    uint32_t async_users; // callers holding async, stop waits for zero
 } LOG_MANAGE, *P_LOG_MANAGE;
 
 #define DEF_OUTPUT_NAME "def_output"
@@ -134,6 +141,7 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
         INIT_LIST_HEAD(&(tmp_log_mng->log_list));
         tmp_log_mng->curLogLevel = level;
         tmp_log_mng->ms_level = FALSE;
+        tmp_log_mng->async = NULL;
         pLogManage = tmp_log_mng;
 
         // set default log style
@@ -153,7 +161,7 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
     return OPRT_OK;
 }
 
-void __output_logManage_buf(void)
+static void __output_log_str(const char *str)
 {
     P_LIST_HEAD pPos;
     LOG_OUT_NODE_S *output_node;
@@ -161,11 +169,16 @@ void __output_logManage_buf(void)
     {
         output_node = tuya_list_entry(pPos, LOG_OUT_NODE_S, node);
         if (output_node->out_term) {
-            output_node->out_term(pLogManage->log_buf);
+            output_node->out_term(str);
         }
     }
 }
 
+void __output_logManage_buf(void)
+{
+    __output_log_str(pLogManage->log_buf);
+}
+
 OPERATE_RET __find_out_term_node(const char *name, LOG_OUT_NODE_S **node)
 {
     P_LIST_HEAD pPos;
@@ -336,6 +349,745 @@ OPERATE_RET tal_log_get_level(TAL_LOG_LEVEL_E *level)
     return OPRT_OK;
 }
 
+static int __log_prefix_format(char *buf, int size, LOG_LEVEL level, const char *file, uint32_t line,
+                               SYS_TICK_T time_ms)
+{
+    const char *pTmpModuleName = "ty";
+    int len = 0;
+    int cnt = 0;
+    POSIX_TM_S tm;
+
+    // color prefix
+    if (pLogManage->log_color.enable_color) {
+        cnt = snprintf(buf, size, "\033[%d;%d;%dm", pLogManage->log_color.style[level].display_mode,
+                       pLogManage->log_color.style[level].font_color,
+                       pLogManage->log_color.style[level].background_color);
+        if (cnt <= 0) {
+            return -1;
+        }
+        len += cnt;
+    }
+
+    memset(&tm, 0, sizeof(tm));
+    if (pLogManage->ms_level == FALSE && 0 == time_ms) {
+        tal_time_get_local_time_custom(0, &tm);
+        cnt = snprintf(buf + len, size - len, "[%02d-%02d %02d:%02d:%02d %s %s][%s:%d] ", tm.tm_mon + 1, tm.tm_mday,
+                       tm.tm_hour, tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[level], file, line);
+    } else {
+        // time_ms is set when the record was taken earlier than it is formatted
+        if (0 == time_ms) {
+            time_ms = tal_time_get_posix_ms();
+        }
+        tal_time_get_local_time_custom((TIME_T)(time_ms / 1000), &tm);
+        if (pLogManage->ms_level) {
+            cnt = snprintf(buf + len, size - len, "[%02d-%02d %02d:%02d:%02d:%d %s %s][%s:%d] ", tm.tm_mon + 1,
+                           tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (uint32_t)(time_ms % 1000), pTmpModuleName,
+                           sLevelStr[level], file, line);
+        } else {
+            cnt = snprintf(buf + len, size - len, "[%02d-%02d %02d:%02d:%02d %s %s][%s:%d] ", tm.tm_mon + 1,
+                           tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[level], file, line);
+        }
+    }
+    if (cnt <= 0) {
+        return -1;
+    }
+    len += cnt;
+
+    return (len >= size) ? size - 1 : len;
+}
+
+static const char *__log_suffix(void)
+{
+    return (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
+}
+
+/***********************************************************
+*************************async backend**********************
+***********************************************************/
+/*
+ * Log records go into a lock-free multi-producer ring of fixed-size slots
+ * and a low-priority writer thread formats (deferred mode) and outputs them.
+ * A producer claims all slots of a record with one CAS on enq_pos, which is
+ * only possible once the writer has released the last of them, and the
+ * writer releases slots strictly in order, so the earlier ones are free too.
+ * A full ring drops the record and counts it, producers never block.
+ */
+#ifndef LOG_ASYNC_SLOT_SIZE
+#define LOG_ASYNC_SLOT_SIZE 32
+#endif
+
+#ifndef LOG_ASYNC_STACK_SIZE
+#define LOG_ASYNC_STACK_SIZE (4 * 1024)
+#endif
+
+#ifndef LOG_ASYNC_PRIORITY
+#define LOG_ASYNC_PRIORITY THREAD_PRIO_5
+#endif
+
+#define LOG_ASYNC_WAIT_MS 100
+
+// deferred mode copies at most this much of each %s argument
+#ifndef LOG_ASYNC_STR_MAX
+#define LOG_ASYNC_STR_MAX 256
+#endif
+
+typedef struct {
+    uint16_t slots;     // slots taken by the record
+    uint8_t level;
+    uint8_t deferred;   // payload is the arguments of fmt, not text
+    uint32_t len;       // payload bytes
+    uint32_t line;
+    const char *file;
+    const char *fmt;
+    SYS_TICK_T time_ms;
+} LOG_REC_T;
+
+struct log_async {
+    uint32_t slot_num; // power of two
+    uint32_t mask;
+    uint32_t *seq;     // a slot is free for position p when seq == p, filled when seq == p + 1
+    uint8_t *data;     // slot_num slots, followed by room for one record that wraps
+
+    BOOL_T deferred;
+    uint32_t writer_idle;
+    THREAD_HANDLE thread;
+    SEM_HANDLE sem;
+    char *out_buf;
+    char *rec_buf;
+
+    uint32_t written;
+    uint32_t deferred_cnt;
+    uint32_t dropped;
+    uint32_t dropped_reported;
+
+    uint8_t pad0[64];
+    uint32_t enq_pos;
+    uint8_t pad1[64];
+    uint32_t deq_pos; // writer only
+};
+
+typedef enum {
+    LOG_ARG_NONE, // %%
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_PTR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STR,
+    LOG_ARG_BAD, // not deferrable, format in the caller
+} LOG_ARG_E;
+
+/* largest record, in whole slots */
+static uint32_t __log_rec_max(void)
+{
+    uint32_t size = sizeof(LOG_REC_T) + pLogManage->log_buf_len + 1;
+
+    return (size + LOG_ASYNC_SLOT_SIZE - 1) / LOG_ASYNC_SLOT_SIZE * LOG_ASYNC_SLOT_SIZE;
+}
+
+/* parse the conversion at p ('%'), returns its length, precision is -1 if not given */
+static int __log_fmt_spec(const char *p, LOG_ARG_E *type, int *precision)
+{
+    const char *s = p + 1;
+    int lng = 0;
+
+    *precision = -1;
+    if ('%' == *s) {
+        *type = LOG_ARG_NONE;
+        return 2;
+    }
+
+    while (*s && strchr("-+ #0", *s)) {
+        s++;
+    }
+    while (isdigit((uint8_t)*s)) {
+        s++;
+    }
+    if ('.' == *s) {
+        s++;
+        *precision = 0;
+        while (isdigit((uint8_t)*s)) {
+            *precision = *precision * 10 + (*s++ - '0');
+        }
+    }
+    if ('*' == *s) {
+        *type = LOG_ARG_BAD;
+        return 1;
+    }
+
+    if ('h' == *s) {
+        s += ('h' == s[1]) ? 2 : 1;
+    } else if ('l' == *s) {
+        lng = ('l' == s[1]) ? 2 : 1;
+        s += lng;
+    } else if ('z' == *s || 't' == *s) {
+        // size_t and ptrdiff_t are long sized on ILP32 and LP64
+        lng = 1;
+        s++;
+    } else if ('j' == *s) {
+        lng = 2;
+        s++;
+    }
+
+    switch (*s) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        *type = (2 == lng) ? LOG_ARG_LLONG : (1 == lng) ? LOG_ARG_LONG : LOG_ARG_INT;
+        break;
+    case 'c':
+        *type = LOG_ARG_INT;
+        break;
+    case 'p':
+        *type = LOG_ARG_PTR;
+        break;
+    case 's':
+        *type = lng ? LOG_ARG_BAD : LOG_ARG_STR;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        *type = LOG_ARG_DOUBLE;
+        break;
+    default:
+        *type = LOG_ARG_BAD;
+        return 1;
+    }
+
+    return (int)(s - p) + 1;
+}
+
+/*
+ * walk the arguments of fmt, write them to out if not NULL
+ * returns the payload size, or -1 if fmt can not be deferred
+ */
+static int __log_args_pack(const char *fmt, va_list ap, uint8_t *out, int limit)
+{
+    const char *p = fmt;
+    LOG_ARG_E type;
+    int precision = 0;
+    int len = 0;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        union {
+            long long ll;
+            double d;
+            void *ptr;
+        } value = {0};
+        const char *str = NULL;
+        int size = sizeof(value);
+
+        p += __log_fmt_spec(p, &type, &precision);
+        switch (type) {
+        case LOG_ARG_NONE:
+            continue;
+        case LOG_ARG_INT:
+            value.ll = va_arg(ap, int);
+            break;
+        case LOG_ARG_LONG:
+            value.ll = va_arg(ap, long);
+            break;
+        case LOG_ARG_LLONG:
+            value.ll = va_arg(ap, long long);
+            break;
+        case LOG_ARG_PTR:
+            value.ptr = va_arg(ap, void *);
+            break;
+        case LOG_ARG_DOUBLE:
+            value.d = va_arg(ap, double);
+            break;
+        case LOG_ARG_STR:
+            str = va_arg(ap, const char *);
+            if (NULL == str) {
+                str = "(null)";
+            }
+            // the argument may not be null terminated when a precision is given
+            for (size = 0; size < LOG_ASYNC_STR_MAX && (precision < 0 || size < precision) && str[size]; size++) {
+            }
+            size += 1;
+            break;
+        default:
+            return -1;
+        }
+
+        if (len + size > limit) {
+            return -1;
+        }
+        if (out) {
+            if (str) {
+                memcpy(out + len, str, size - 1);
+                out[len + size - 1] = '\0';
+            } else {
+                memcpy(out + len, &value, size);
+            }
+        }
+        len += size;
+    }
+
+    return len;
+}
+
+/* format a deferred record, one conversion at a time */
+static int __log_args_format(char *buf, int size, const char *fmt, const uint8_t *args)
+{
+    const char *p = fmt;
+    const char *pct = NULL;
+    char spec[24];
+    LOG_ARG_E type;
+    int precision = 0;
+    int len = 0;
+    int cnt = 0;
+
+    while (len < size - 1 && (pct = strchr(p, '%')) != NULL) {
+        cnt = (int)(pct - p);
+        if (cnt > size - 1 - len) {
+            cnt = size - 1 - len;
+        }
+        memcpy(buf + len, p, cnt);
+        len += cnt;
+
+        int spec_len = __log_fmt_spec(pct, &type, &precision);
+        p = pct + spec_len;
+        if (spec_len >= (int)sizeof(spec)) {
+            continue;
+        }
+        memcpy(spec, pct, spec_len);
+        spec[spec_len] = '\0';
+
+        union {
+            long long ll;
+            double d;
+            void *ptr;
+        } value;
+        if (LOG_ARG_STR != type && LOG_ARG_NONE != type) {
+            memcpy(&value, args, sizeof(value));
+            args += sizeof(value);
+        }
+
+        switch (type) {
+        case LOG_ARG_NONE:
+            cnt = snprintf(buf + len, size - len, "%%");
+            break;
+        case LOG_ARG_INT:
+            cnt = snprintf(buf + len, size - len, spec, (int)value.ll);
+            break;
+        case LOG_ARG_LONG:
+            cnt = snprintf(buf + len, size - len, spec, (long)value.ll);
+            break;
+        case LOG_ARG_LLONG:
+            cnt = snprintf(buf + len, size - len, spec, value.ll);
+            break;
+        case LOG_ARG_PTR:
+            cnt = snprintf(buf + len, size - len, spec, value.ptr);
+            break;
+        case LOG_ARG_DOUBLE:
+            cnt = snprintf(buf + len, size - len, spec, value.d);
+            break;
+        case LOG_ARG_STR:
+            cnt = snprintf(buf + len, size - len, spec, (const char *)args);
+            args += strlen((const char *)args) + 1;
+            break;
+        default:
+            cnt = 0;
+            break;
+        }
+        if (cnt > 0) {
+            len += cnt;
+        }
+        if (len > size - 1) {
+            len = size - 1;
+        }
+    }
+
+    if (NULL == pct && len < size - 1) {
+        cnt = snprintf(buf + len, size - len, "%s", p);
+        if (cnt > 0) {
+            len += cnt;
+        }
+    }
+
+    return (len > size - 1) ? size - 1 : len;
+}
+
+/* claim the slots for a record of len payload bytes, NULL when the ring is full */
+static LOG_REC_T *__log_async_reserve(LOG_ASYNC_T *async, uint32_t len, uint32_t *pos_out)
+{
+    uint32_t slots = (sizeof(LOG_REC_T) + len + LOG_ASYNC_SLOT_SIZE - 1) / LOG_ASYNC_SLOT_SIZE;
+    uint32_t pos = __atomic_load_n(&async->enq_pos, __ATOMIC_RELAXED);
+
+    if (slots > async->slot_num) {
+        return NULL;
+    }
+
+    for (;;) {
+        uint32_t last = pos + slots - 1;
+        int32_t diff = (int32_t)(__atomic_load_n(&async->seq[last & async->mask], __ATOMIC_ACQUIRE) - last);
+        if (0 == diff) {
+            if (__atomic_compare_exchange_n(&async->enq_pos, &pos, pos + slots, TRUE, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&async->dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&async->enq_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    *pos_out = pos;
+    LOG_REC_T *rec = (LOG_REC_T *)(async->data + (pos & async->mask) * LOG_ASYNC_SLOT_SIZE);
+    memset(rec, 0, sizeof(LOG_REC_T));
+    rec->slots = slots;
+    rec->len = len;
+
+    return rec;
+}
+
+static void __log_async_commit(LOG_ASYNC_T *async, uint32_t pos, LOG_REC_T *rec)
+{
+    uint32_t first = pos & async->mask;
+    uint32_t i = 0;
+
+    // a record crossing the ring end was written contiguously past it, move the tail to the front
+    if (first + rec->slots > async->slot_num) {
+        memcpy(async->data, async->data + async->slot_num * LOG_ASYNC_SLOT_SIZE,
+               (first + rec->slots - async->slot_num) * LOG_ASYNC_SLOT_SIZE);
+    }
+
+    // mark the first slot last, the writer only checks it
+    for (i = rec->slots; i > 0; i--) {
+        __atomic_store_n(&async->seq[(pos + i - 1) & async->mask], pos + i, __ATOMIC_RELEASE);
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&async->writer_idle, __ATOMIC_RELAXED)) {
+        tal_semaphore_post(async->sem);
+    }
+}
+
+static OPERATE_RET __log_async_text(LOG_ASYNC_T *async, LOG_LEVEL level, const char *prefix, int prefix_len,
+                                    const char *suffix, const char *pFmt, va_list ap)
+{
+    uint32_t pos = 0;
+    int suffix_len = suffix ? strlen(suffix) : 0;
+    int max = pLogManage->log_buf_len;
+    va_list cp;
+
+    va_copy(cp, ap);
+    int msg_len = vsnprintf(NULL, 0, pFmt, cp);
+    va_end(cp);
+    if (msg_len < 0) {
+        return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+    }
+
+    // same truncation as the synchronous path, the suffix always fits
+    if (prefix_len + msg_len + suffix_len > max) {
+        msg_len = max - prefix_len - suffix_len;
+        if (msg_len < 0) {
+            return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+        }
+    }
+
+    LOG_REC_T *rec = __log_async_reserve(async, prefix_len + msg_len + suffix_len + 1, &pos);
+    if (NULL == rec) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    rec->level = level;
+
+    char *text = (char *)(rec + 1);
+    if (prefix_len) {
+        memcpy(text, prefix, prefix_len);
+    }
+    vsnprintf(text + prefix_len, msg_len + 1, pFmt, ap);
+    if (suffix_len) {
+        memcpy(text + prefix_len + msg_len, suffix, suffix_len);
+    }
+    text[prefix_len + msg_len + suffix_len] = '\0';
+
+    __log_async_commit(async, pos, rec);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __log_async_print(LOG_ASYNC_T *async, LOG_LEVEL level, const char *file, uint32_t line,
+                                     const char *pFmt, va_list ap)
+{
+    char prefix[128];
+    uint32_t pos = 0;
+
+    if (async->deferred) {
+        va_list cp;
+        va_copy(cp, ap);
+        int len = __log_args_pack(pFmt, cp, NULL, pLogManage->log_buf_len);
+        va_end(cp);
+
+        // %n, %* and wide strings still go through the formatted path
+        if (len >= 0) {
+            LOG_REC_T *rec = __log_async_reserve(async, len, &pos);
+            if (NULL == rec) {
+                return OPRT_EXCEED_UPPER_LIMIT;
+            }
+            rec->level = level;
+            rec->deferred = TRUE;
+            rec->file = file;
+            rec->line = line;
+            rec->fmt = pFmt;
+            rec->time_ms = tal_time_get_posix_ms();
+            __log_args_pack(pFmt, ap, (uint8_t *)(rec + 1), len);
+            __log_async_commit(async, pos, rec);
+            return OPRT_OK;
+        }
+    }
+
+    int prefix_len = __log_prefix_format(prefix, sizeof(prefix), level, file, line, 0);
+    if (prefix_len < 0) {
+        return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+    }
+
+    return __log_async_text(async, level, prefix, prefix_len, __log_suffix(), pFmt, ap);
+}
+
+/* output the record at deq_pos, FALSE if there is none yet */
+static BOOL_T __log_async_drain_one(LOG_ASYNC_T *async)
+{
+    uint32_t pos = async->deq_pos;
+    uint32_t first = pos & async->mask;
+    uint32_t i = 0;
+
+    if (__atomic_load_n(&async->seq[first], __ATOMIC_ACQUIRE) != pos + 1) {
+        return FALSE;
+    }
+
+    // copy out so the slots can be released before the slow output
+    LOG_REC_T *rec = (LOG_REC_T *)async->rec_buf;
+    memcpy(rec, async->data + first * LOG_ASYNC_SLOT_SIZE, sizeof(LOG_REC_T));
+    uint32_t bytes = rec->slots * LOG_ASYNC_SLOT_SIZE;
+    uint32_t head = (async->slot_num - first) * LOG_ASYNC_SLOT_SIZE;
+    if (bytes <= head) {
+        memcpy(rec, async->data + first * LOG_ASYNC_SLOT_SIZE, bytes);
+    } else {
+        memcpy(rec, async->data + first * LOG_ASYNC_SLOT_SIZE, head);
+        memcpy((uint8_t *)rec + head, async->data, bytes - head);
+    }
+
+    for (i = 0; i < rec->slots; i++) {
+        __atomic_store_n(&async->seq[(pos + i) & async->mask], pos + i + async->slot_num, __ATOMIC_RELEASE);
+    }
+    async->deq_pos = pos + rec->slots;
+
+    const char *str = (const char *)(rec + 1);
+    if (rec->deferred) {
+        int size = pLogManage->log_buf_len + 1;
+        const char *suffix = __log_suffix();
+        int suffix_len = strlen(suffix);
+        int len = __log_prefix_format(async->out_buf, size, rec->level, rec->file, rec->line, rec->time_ms);
+        if (len < 0) {
+            len = 0;
+        }
+        len += __log_args_format(async->out_buf + len, size - suffix_len - len, rec->fmt, (const uint8_t *)str);
+        memcpy(async->out_buf + len, suffix, suffix_len + 1);
+        str = async->out_buf;
+        __atomic_fetch_add(&async->deferred_cnt, 1, __ATOMIC_RELAXED);
+    }
+
+    tal_mutex_lock(pLogManage->mutex);
+    __output_log_str(str);
+    tal_mutex_unlock(pLogManage->mutex);
+    __atomic_fetch_add(&async->written, 1, __ATOMIC_RELAXED);
+
+    return TRUE;
+}
+
+static void __log_async_report_drop(LOG_ASYNC_T *async)
+{
+    uint32_t dropped = __atomic_load_n(&async->dropped, __ATOMIC_RELAXED);
+
+    if (dropped != async->dropped_reported) {
+        snprintf(async->out_buf, pLogManage->log_buf_len + 1, "[log] %u records dropped\r\n",
+                 dropped - async->dropped_reported);
+        async->dropped_reported = dropped;
+        tal_mutex_lock(pLogManage->mutex);
+        __output_log_str(async->out_buf);
+        tal_mutex_unlock(pLogManage->mutex);
+    }
+}
+
+static void __log_async_thread(void *arg)
+{
+    LOG_ASYNC_T *async = (LOG_ASYNC_T *)arg;
+
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(async->thread)) {
+        while (__log_async_drain_one(async)) {
+        }
+        __log_async_report_drop(async);
+
+        __atomic_store_n(&async->writer_idle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        // a record committed before we went idle did not post
+        if (__atomic_load_n(&async->seq[async->deq_pos & async->mask], __ATOMIC_ACQUIRE) != async->deq_pos + 1) {
+            tal_semaphore_wait(async->sem, LOG_ASYNC_WAIT_MS);
+        }
+        __atomic_store_n(&async->writer_idle, 0, __ATOMIC_RELAXED);
+    }
+
+    // flush what is left on stop
+    while (__log_async_drain_one(async)) {
+    }
+}
+
+static void __log_async_free(LOG_ASYNC_T *async)
+{
+    if (async->sem) {
+        tal_semaphore_release(async->sem);
+    }
+    tal_free(async);
+}
+
+/**
+ * @brief Moves log output to a background writer thread.
+ *
+ * Log calls only copy the record into a lock-free ring and return, the
+ * writer thread formats and outputs it. When the ring is full the record is
+ * dropped and counted, the writer reports drops in the output.
+ *
+ * In deferred mode the caller stores the format pointer and the arguments
+ * (strings are copied) and all formatting happens in the writer. The format
+ * string and file name must therefore be string literals, as with PR_*.
+ *
+ * @param ring_size The ring size in bytes, rounded up to a power of two slots.
+ * @param deferred_format TRUE to format in the writer thread.
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET tal_log_async_start(uint32_t ring_size, BOOL_T deferred_format)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t slot_num = 1;
+    uint32_t i = 0;
+
+    if (NULL == pLogManage) {
+        return OPRT_INVALID_PARM;
+    }
+    if (pLogManage->async) {
+        return OPRT_OK;
+    }
+
+    while (slot_num * LOG_ASYNC_SLOT_SIZE < ring_size || slot_num * LOG_ASYNC_SLOT_SIZE < 2 * __log_rec_max()) {
+        slot_num <<= 1;
+    }
+
+    // seq array, slots, the wrap area and two record buffers for the writer
+    uint32_t rec_max = slot_num * LOG_ASYNC_SLOT_SIZE; // a record never exceeds the ring
+    LOG_ASYNC_T *async = (LOG_ASYNC_T *)tal_malloc(sizeof(LOG_ASYNC_T) + slot_num * sizeof(uint32_t) +
+                                                   slot_num * LOG_ASYNC_SLOT_SIZE + __log_rec_max() + rec_max +
+                                                   pLogManage->log_buf_len + 1);
+    if (NULL == async) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(async, 0, sizeof(LOG_ASYNC_T));
+    async->slot_num = slot_num;
+    async->mask = slot_num - 1;
+    async->seq = (uint32_t *)(async + 1);
+    async->data = (uint8_t *)(async->seq + slot_num);
+    async->rec_buf = (char *)async->data + slot_num * LOG_ASYNC_SLOT_SIZE + __log_rec_max();
+    async->out_buf = async->rec_buf + rec_max;
+    async->deferred = deferred_format;
+    for (i = 0; i < slot_num; i++) {
+        async->seq[i] = i;
+    }
+
+    rt = tal_semaphore_create_init(&async->sem, 0, 1);
+    if (OPRT_OK != rt) {
+        __log_async_free(async);
+        return rt;
+    }
+
+    THREAD_CFG_T thread_cfg = {
+        .stackDepth = LOG_ASYNC_STACK_SIZE, .priority = LOG_ASYNC_PRIORITY, .thrdname = "log_writer"};
+    rt = tal_thread_create_and_start(&async->thread, NULL, NULL, __log_async_thread, async, &thread_cfg);
+    if (OPRT_OK != rt) {
+        __log_async_free(async);
+        return rt;
+    }
+
+    __atomic_store_n(&pLogManage->async, async, __ATOMIC_RELEASE);
+
+    return OPRT_OK;
+}
+
+/* pins the async backend for one call, NULL if it is not running */
+static LOG_ASYNC_T *__log_async_get(void)
+{
+    // count first, so stop either sees us or we see its NULL
+    __atomic_fetch_add(&pLogManage->async_users, 1, __ATOMIC_SEQ_CST);
+    LOG_ASYNC_T *async = __atomic_load_n(&pLogManage->async, __ATOMIC_SEQ_CST);
+    if (NULL == async) {
+        __atomic_fetch_sub(&pLogManage->async_users, 1, __ATOMIC_RELEASE);
+    }
+
+    return async;
+}
+
+static void __log_async_put(void)
+{
+    __atomic_fetch_sub(&pLogManage->async_users, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Gets the counters of the async log backend.
+ *
+ * @param[out] stat The counters.
+ * @return OPRT_OK on success, OPRT_INVALID_PARM if the backend is not started.
+ */
+OPERATE_RET tal_log_async_stat_get(TAL_LOG_ASYNC_STAT_T *stat)
+{
+    if (NULL == pLogManage || NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    LOG_ASYNC_T *async = __log_async_get();
+    if (NULL == async) {
+        return OPRT_INVALID_PARM;
+    }
+
+    stat->written = __atomic_load_n(&async->written, __ATOMIC_RELAXED);
+    stat->deferred = __atomic_load_n(&async->deferred_cnt, __ATOMIC_RELAXED);
+    stat->dropped = __atomic_load_n(&async->dropped, __ATOMIC_RELAXED);
+    __log_async_put();
+
+    return OPRT_OK;
+}
+
+static void __log_async_stop(void)
+{
+    LOG_ASYNC_T *async = pLogManage->async;
+
+    if (NULL == async) {
+        return;
+    }
+
+    // callers logging from here on go back to the synchronous path
+    __atomic_store_n(&pLogManage->async, NULL, __ATOMIC_SEQ_CST);
+    // callers that got the ring before the store finish their record, the writer flushes it below
+    while (__atomic_load_n(&pLogManage->async_users, __ATOMIC_ACQUIRE)) {
+        tal_system_sleep(1);
+    }
+    tal_thread_delete(async->thread);
+    tal_semaphore_post(async->sem);
+    while (THREAD_STATE_DELETE != tal_thread_get_state(async->thread)) {
+        tal_system_sleep(10);
+    }
+    __log_async_free(async);
+}
+
 /**
  * @brief Prints a log message with the specified log level, file name, line
  * number, and format string.
@@ -378,7 +1130,6 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, char *pFmt
     if (logLevel > tmpLogLevel) {
         return OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER;
     }
-    const char *pTmpModuleName = "ty";
     const char *pTmpFilename = NULL;
 
     if (NULL == pFile) {
@@ -396,38 +1147,18 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, char *pFmt
             pTmpFilename = pFile + pos + 1;
         }
     }
-    tal_mutex_lock(pLogManage->mutex);
 
-    // color prefix
-    if (pLogManage->log_color.enable_color) {
-        cnt = snprintf(pLogManage->log_buf, pLogManage->log_buf_len, "\033[%d;%d;%dm",
-                        pLogManage->log_color.style[logLevel].display_mode,
-                        pLogManage->log_color.style[logLevel].font_color,
-                        pLogManage->log_color.style[logLevel].background_color);
-        if (cnt <= 0) {
-            goto ERR_EXIT;
-        }
-        len += cnt;
+    LOG_ASYNC_T *async = __log_async_get();
+    if (async) {
+        OPERATE_RET rt = __log_async_print(async, logLevel, pTmpFilename, line, pFmt, ap);
+        __log_async_put();
+        return rt;
     }
 
-    POSIX_TM_S tm;
-    memset(&tm, 0, sizeof(tm));
+    tal_mutex_lock(pLogManage->mutex);
 
-    if (pLogManage->ms_level == FALSE) {
-        tal_time_get_local_time_custom(0, &tm);
-        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "[%02d-%02d %02d:%02d:%02d %s %s][%s:%d] ",
-                       tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[logLevel],
-                       pTmpFilename, line);
-    } else {
-        SYS_TICK_T time_ms = tal_time_get_posix_ms();
-        TIME_T sec = (TIME_T)(time_ms / 1000);
-        uint32_t ms = (uint32_t)(time_ms % 1000);
-        tal_time_get_local_time_custom(sec, &tm);
-        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len + len, "[%02d-%02d %02d:%02d:%02d:%d %s %s][%s:%d] ",
-                       tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, ms, pTmpModuleName,
-                       sLevelStr[logLevel], pTmpFilename, line);
-    }
-    if (cnt <= 0) {
+    cnt = __log_prefix_format(pLogManage->log_buf, pLogManage->log_buf_len, logLevel, pTmpFilename, line, 0);
+    if (cnt < 0) {
         goto ERR_EXIT;
     }
     len += cnt;
@@ -437,7 +1168,7 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, char *pFmt
     }
     len += cnt;
 
-    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
+    const char *p_suffix = __log_suffix();
     if (len > (int)(pLogManage->log_buf_len - strlen(p_suffix) - 1)) { // 1 -> "\0"
         len = pLogManage->log_buf_len - strlen(p_suffix) - 1;
     }
@@ -521,12 +1252,18 @@ OPERATE_RET tal_log_print_raw(const char *pFmt, ...)
 
     OPERATE_RET opRet = 0;
     va_list ap;
+    LOG_ASYNC_T *async = __log_async_get();
 
-    tal_mutex_lock(pLogManage->mutex);
     va_start(ap, pFmt);
-    opRet = __PrintLogVRaw(pFmt, ap);
+    if (async) {
+        opRet = __log_async_text(async, TAL_LOG_LEVEL_ERR, NULL, 0, NULL, pFmt, ap);
+        __log_async_put();
+    } else {
+        tal_mutex_lock(pLogManage->mutex);
+        opRet = __PrintLogVRaw(pFmt, ap);
+        tal_mutex_unlock(pLogManage->mutex);
+    }
     va_end(ap);
-    tal_mutex_unlock(pLogManage->mutex);
 
     return opRet;
 }
@@ -545,9 +1282,11 @@ void tal_log_release(void)
         return;
     }
 
+    __log_async_stop();
+
     while (!tuya_list_empty(&(pLogManage->log_list))) {
         LOG_OUT_NODE_S *log_out_nd = NULL;
-        log_out_nd = tuya_list_entry(&(pLogManage->log_list.next), LOG_OUT_NODE_S, node);
+        log_out_nd = tuya_list_entry(pLogManage->log_list.next, LOG_OUT_NODE_S, node);
         tuya_list_del(&(log_out_nd->node));
         if (log_out_nd->name) {
             tal_free(log_out_nd->name);
@@ -693,6 +1432,19 @@ OPERATE_RET tal_log_color_print_raw(TAL_LOG_DISPLAY_MODE_E display_mode, TAL_LOG
         return OPRT_INVALID_PARM;
     }
 
+    LOG_ASYNC_T *async = __log_async_get();
+    if (async) {
+        char prefix[16] = {0};
+        if (pLogManage->log_color.enable_color) {
+            cnt = snprintf(prefix, sizeof(prefix), "\033[%d;%d;%dm", display_mode, font_color, background_color);
+        }
+        va_start(ap, pFmt);
+        opRet = __log_async_text(async, TAL_LOG_LEVEL_ERR, prefix, cnt, cnt ? "\033[0m" : NULL, pFmt, ap);
+        va_end(ap);
+        __log_async_put();
+        return opRet;
+    }
+
     tal_mutex_lock(pLogManage->mutex);
     va_start(ap, pFmt);
     if (pLogManage->log_color.enable_color) {
@@ -7,11 +7,28 @@
 #include "tal_semaphore.h"
 #include "tal_sw_timer.h"
 #include "tal_time_service.h"
+#include "tal_workq_service.h"
 
 #ifndef STACK_SIZE_TIMERQ
 #define STACK_SIZE_TIMERQ (4 * 1024)
 #endif
 
+// dispatches later than this are counted as late
+#ifndef TIMER_LATE_THRESHOLD_MS
+#define TIMER_LATE_THRESHOLD_MS 20
+#endif
+
+// hashed hierarchical timer wheel, 1 ms tick, covers 2^(TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS) ms
+// before long timers are clamped and re-cascaded
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 4
+#endif
+#define TIMER_WHEEL_BITS  6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK  (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN  (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+#define TIMER_WHEEL_NONE  UINT64_MAX
+
 typedef struct {
     LIST_HEAD node;
 
@@ -23,10 +40,23 @@ typedef struct {
     BOOL_T is_running;
     TIMER_ID timer_id;
     TIMER_TYPE type;
+
+    BOOL_T in_wheel;
+    uint8_t level;
+    uint8_t slot;
+
+    TIMER_DISPATCH_E dispatch;
+    WORKQ_SERVICE_E service;
+    BOOL_T triggered;    // expired by tal_sw_timer_trigger, no deadline to be late on
+    BOOL_T work_pending; // posted to the workqueue and not run yet
+    BOOL_T deleted;      // deleted while work_pending, freed by the work
 } TIMER_T;
 
 typedef struct {
-    LIST_HEAD list_active;
+    LIST_HEAD wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t wheel_bitmap[TIMER_WHEEL_LEVELS]; // non-empty slots
+    uint64_t wheel_time;                       // next tick to process, ms
+    LIST_HEAD list_expired;
     LIST_HEAD list_standby;
     MUTEX_HANDLE mutex;
     uint16_t total_cnt;
@@ -36,42 +66,203 @@ typedef struct {
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
     TAL_TIMER_CB last_cb; // used to debug which cb is blocked
+    TAL_TIMER_STAT_T stat;
 } SW_TIMER_MGR_T;
 
 static SW_TIMER_MGR_T s_timer_mgr;
 
-static void __timer_attach(TIMER_T *timer)
+static uint64_t __timer_now_ms(void)
+{
+    TIME_S secTime = 0;
+    TIME_MS msTime = 0;
+
+    tal_time_get_system_time(&secTime, &msTime);
+
+    return (uint64_t)secTime * 1000 + (uint64_t)msTime;
+}
+
+static uint32_t __bitmap_first(uint64_t bitmap)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_ctzll(bitmap);
+#else
+    uint32_t i = 0;
+    while (0 == (bitmap & 1)) {
+        bitmap >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+static void __timer_detach(TIMER_T *timer)
 {
     tuya_list_del(&(timer->node));
 
-    if (tuya_list_empty(&(s_timer_mgr.list_active))) {
-        tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_active));
-    } else {
-        TIMER_T *timer_tmp = NULL;
-        struct tuya_list_head *p = NULL;
-        tuya_list_for_each(p, &(s_timer_mgr.list_active))
-        {
-            timer_tmp = tuya_list_entry(p, TIMER_T, node);
+    if (timer->in_wheel) {
+        timer->in_wheel = FALSE;
+        if (tuya_list_empty(&(s_timer_mgr.wheel[timer->level][timer->slot]))) {
+            s_timer_mgr.wheel_bitmap[timer->level] &= ~(1ULL << timer->slot);
+        }
+    }
+}
 
-            if (timer_tmp->expire_time >= timer->expire_time) {
-                tuya_list_add(&(timer->node), (&(timer_tmp->node))->prev);
-                break;
-            }
+static void __timer_attach(TIMER_T *timer)
+{
+    uint64_t expire = timer->expire_time;
+    uint64_t delta = 0;
+    uint8_t level = 0;
+    uint8_t slot = 0;
+
+    __timer_detach(timer);
+
+    // already expired, fire on the next tick
+    if (expire < s_timer_mgr.wheel_time) {
+        expire = s_timer_mgr.wheel_time;
+    }
+
+    delta = expire - s_timer_mgr.wheel_time;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    // beyond the wheel span, park in the top level and re-cascade later
+    if (delta >= TIMER_WHEEL_SPAN) {
+        expire = s_timer_mgr.wheel_time + TIMER_WHEEL_SPAN - 1;
+    }
+
+    slot = (expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.wheel[level][slot]));
+    s_timer_mgr.wheel_bitmap[level] |= 1ULL << slot;
+
+    timer->in_wheel = TRUE;
+    timer->level = level;
+    timer->slot = slot;
+}
+
+/**
+ * @brief Returns the next tick at which the wheel has work to do.
+ *
+ * For level 0 this is the exact expiry. For higher levels it is the tick at
+ * which the first non-empty slot is cascaded down, which is never later than
+ * the expiry of the timers in it.
+ */
+static uint64_t __timer_wheel_next(void)
+{
+    uint64_t next = TIMER_WHEEL_NONE;
+    uint8_t level;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t bitmap = s_timer_mgr.wheel_bitmap[level];
+        if (0 == bitmap) {
+            continue;
         }
 
-        if (p == &(s_timer_mgr.list_active)) {
-            tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_active));
+        uint32_t shift = TIMER_WHEEL_BITS * level;
+        uint64_t base = s_timer_mgr.wheel_time >> shift;
+        uint32_t cur = base & TIMER_WHEEL_MASK;
+        uint64_t rot = cur ? ((bitmap >> cur) | (bitmap << (TIMER_WHEEL_SLOTS - cur))) : bitmap;
+        uint64_t ahead = 0;
+        uint64_t tick = 0;
+
+        if (level && (s_timer_mgr.wheel_time & ((1ULL << shift) - 1))) {
+            // mid period, the current slot is only cascaded once the level wraps around
+            ahead = rot & ~1ULL;
+            tick = (base + (ahead ? __bitmap_first(ahead) : TIMER_WHEEL_SLOTS)) << shift;
+        } else {
+            tick = (base + __bitmap_first(rot)) << shift;
+        }
+
+        if (tick < next) {
+            next = tick;
         }
     }
+
+    return next;
 }
 
-static void __timer_dump(void)
+static void __timer_wheel_cascade(uint8_t level, uint8_t slot)
 {
+    LIST_HEAD tmp;
     struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
     TIMER_T *timer = NULL;
-    TAL_TIMER_CB *cb = NULL;
+
+    INIT_LIST_HEAD(&tmp);
+    tuya_list_for_each_safe(p, n, &(s_timer_mgr.wheel[level][slot]))
+    {
+        timer = tuya_list_entry(p, TIMER_T, node);
+        tuya_list_del(p);
+        tuya_list_add_tail(p, &tmp);
+        timer->in_wheel = FALSE;
+    }
+    s_timer_mgr.wheel_bitmap[level] &= ~(1ULL << slot);
+
+    tuya_list_for_each_safe(p, n, &tmp)
+    {
+        __timer_attach(tuya_list_entry(p, TIMER_T, node));
+    }
+}
+
+static void __timer_wheel_advance(uint64_t nowMS)
+{
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    uint8_t level, slot;
+
+    while (s_timer_mgr.wheel_time <= nowMS) {
+        uint64_t next = __timer_wheel_next();
+        if (next > nowMS) {
+            s_timer_mgr.wheel_time = nowMS + 1;
+            break;
+        }
+        // nothing to do on the ticks in between
+        if (next > s_timer_mgr.wheel_time) {
+            s_timer_mgr.wheel_time = next;
+        }
+
+        slot = s_timer_mgr.wheel_time & TIMER_WHEEL_MASK;
+        if (0 == slot) {
+            for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                uint8_t idx = (s_timer_mgr.wheel_time >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+                __timer_wheel_cascade(level, idx);
+                if (idx) {
+                    break;
+                }
+            }
+        }
+
+        tuya_list_for_each_safe(p, n, &(s_timer_mgr.wheel[0][slot]))
+        {
+            tuya_list_entry(p, TIMER_T, node)->in_wheel = FALSE;
+            tuya_list_del(p);
+            tuya_list_add_tail(p, &(s_timer_mgr.list_expired));
+        }
+        s_timer_mgr.wheel_bitmap[0] &= ~(1ULL << slot);
+
+        s_timer_mgr.wheel_time++;
+    }
+}
+
+static void __timer_dump_one(TIMER_T *timer)
+{
+    TAL_TIMER_CB *cb = &(timer->cb);
     TIMER_ID *timer_id = NULL;
 
+    if (timer->data) {
+        timer_id = timer->data;
+        if (*timer_id == timer->timer_id) {
+            cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
+        }
+    }
+    PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+}
+
+static void __timer_dump(void)
+{
+    struct tuya_list_head *p = NULL;
+    uint8_t level;
+    uint32_t slot;
+
     TIME_S nowSecTime = 0;
     TIME_MS nowMsTime = 0;
 
@@ -86,87 +277,134 @@ static void __timer_dump(void)
     tal_mutex_lock(s_timer_mgr.mutex);
 
     PR_NOTICE("running timers count:%d", s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_active))
+    tuya_list_for_each(p, &(s_timer_mgr.list_expired))
     {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
+        __timer_dump_one(tuya_list_entry(p, TIMER_T, node));
+    }
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            tuya_list_for_each(p, &(s_timer_mgr.wheel[level][slot]))
+            {
+                __timer_dump_one(tuya_list_entry(p, TIMER_T, node));
             }
         }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
     }
 
     PR_NOTICE("standby timers count:%d", s_timer_mgr.total_cnt - s_timer_mgr.running_cnt);
     tuya_list_for_each(p, &(s_timer_mgr.list_standby))
     {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
-        }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+        __timer_dump_one(tuya_list_entry(p, TIMER_T, node));
     }
 
     tal_mutex_unlock(s_timer_mgr.mutex);
 }
 
+static void __timer_workq_cb(void *data)
+{
+    TIMER_T *timer = (TIMER_T *)data;
+    TAL_TIMER_CB timer_cb = NULL;
+    TIMER_ID timer_id = NULL;
+    void *timer_data = NULL;
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    timer->work_pending = FALSE;
+    if (timer->deleted) {
+        tal_mutex_unlock(s_timer_mgr.mutex);
+        tal_free((void *)timer);
+        return;
+    }
+    timer_cb = timer->cb;
+    timer_id = timer->timer_id;
+    timer_data = timer->data;
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    timer_cb(timer_id, timer_data);
+}
+
+static void __timer_stat_update(TIMER_T *timer, uint64_t nowMS)
+{
+    s_timer_mgr.stat.fired++;
+    if (timer->triggered) {
+        timer->triggered = FALSE;
+        s_timer_mgr.stat.triggered++;
+        return;
+    }
+
+    uint32_t late = (nowMS > timer->expire_time) ? (uint32_t)(nowMS - timer->expire_time) : 0;
+
+    s_timer_mgr.stat.total_late_ms += late;
+    if (late > s_timer_mgr.stat.max_late_ms) {
+        s_timer_mgr.stat.max_late_ms = late;
+    }
+    if (late > TIMER_LATE_THRESHOLD_MS) {
+        s_timer_mgr.stat.late++;
+    }
+}
+
 static void __timer_dispatch(SYS_TIME_T *next_expired)
 {
-    TIME_S nowSecTime = 0;
-    TIME_MS nowMsTime = 0;
     uint64_t nowMS = 0;
+    uint64_t next = 0;
     TIMER_T *timer = NULL;
     TAL_TIMER_CB timer_cb = NULL;
-    struct tuya_list_head *p = NULL;
+    TIMER_ID timer_id = NULL;
+    void *timer_data = NULL;
+    BOOL_T expired = FALSE;
 
     *next_expired = SEM_WAIT_FOREVER;
 
     do {
-        tal_time_get_system_time(&nowSecTime, &nowMsTime);
-        nowMS = (uint64_t)nowSecTime * 1000 + (uint64_t)nowMsTime;
+        nowMS = __timer_now_ms();
 
         tal_mutex_lock(s_timer_mgr.mutex);
 
-        timer_cb = NULL;
-        tuya_list_for_each(p, &(s_timer_mgr.list_active))
-        {
-            timer = tuya_list_entry(p, TIMER_T, node);
+        __timer_wheel_advance(nowMS);
 
-            if (timer->expire_time > nowMS) {
-                p = &(s_timer_mgr.list_active);
-                *next_expired = timer->expire_time - nowMS;
+        timer_cb = NULL;
+        expired = FALSE;
+        if (!tuya_list_empty(&(s_timer_mgr.list_expired))) {
+            expired = TRUE;
+            timer = tuya_list_entry(s_timer_mgr.list_expired.next, TIMER_T, node);
+            timer_id = timer->timer_id;
+            timer_data = timer->data;
+            __timer_stat_update(timer, nowMS);
+
+            if (TAL_TIMER_DISPATCH_WORKQ != timer->dispatch) {
+                timer_cb = timer->cb;
+            } else if (timer->work_pending) {
+                s_timer_mgr.stat.coalesced++;
+            } else if (OPRT_OK == tal_workq_schedule(timer->service, __timer_workq_cb, timer)) {
+                timer->work_pending = TRUE;
+                s_timer_mgr.stat.offloaded++;
             } else {
+                s_timer_mgr.stat.offload_fail++;
                 timer_cb = timer->cb;
-
-                if (TAL_TIMER_ONCE == timer->type) {
-                    timer->is_running = FALSE;
-                    s_timer_mgr.running_cnt--;
-                    tuya_list_del(&(timer->node));
-                    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
-                } else {
-                    timer->expire_time = nowMS + timer->interval;
-                    __timer_attach(timer);
-                }
             }
 
-            break;
+            if (TAL_TIMER_ONCE == timer->type) {
+                timer->is_running = FALSE;
+                s_timer_mgr.running_cnt--;
+                __timer_detach(timer);
+                tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
+            } else {
+                timer->expire_time = nowMS + timer->interval;
+                __timer_attach(timer);
+            }
+        } else {
+            next = __timer_wheel_next();
+            if (TIMER_WHEEL_NONE != next) {
+                *next_expired = next - nowMS;
+            }
         }
 
         tal_mutex_unlock(s_timer_mgr.mutex);
 
         if (timer_cb) {
             s_timer_mgr.last_cb = timer_cb;
-            timer_cb(timer->timer_id, timer->data);
-            timer_cb = NULL;
+            timer_cb(timer_id, timer_data);
             s_timer_mgr.last_cb = NULL;
         }
-    } while (p != &(s_timer_mgr.list_active));
+    } while (expired);
 }
 
 static void __timer_thread_cb(void *data)
@@ -201,7 +439,15 @@ OPERATE_RET tal_sw_timer_init(void)
     tal_mutex_create_init(&s_timer_mgr.mutex);
     tal_semaphore_create_init(&s_timer_mgr.sem, 0, 2);
 
-    INIT_LIST_HEAD(&(s_timer_mgr.list_active));
+    uint8_t level;
+    uint32_t slot;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            INIT_LIST_HEAD(&(s_timer_mgr.wheel[level][slot]));
+        }
+    }
+    s_timer_mgr.wheel_time = __timer_now_ms();
+    INIT_LIST_HEAD(&(s_timer_mgr.list_expired));
     INIT_LIST_HEAD(&(s_timer_mgr.list_standby));
 
     THREAD_CFG_T thread_cfg = {.stackDepth = STACK_SIZE_TIMERQ, .priority = THREAD_PRIO_0, .thrdname = "sys_timer"};
@@ -269,15 +515,24 @@ OPERATE_RET tal_sw_timer_delete(TIMER_ID timer_id)
 
     TIMER_T *timer = (TIMER_T *)timer_id;
 
+    BOOL_T work_pending = FALSE;
+
     tal_mutex_lock(s_timer_mgr.mutex);
-    tuya_list_del(&(timer->node));
+    __timer_detach(timer);
+    INIT_LIST_HEAD(&(timer->node));
     s_timer_mgr.total_cnt--;
     if (timer->is_running) {
+        timer->is_running = FALSE;
         s_timer_mgr.running_cnt--;
     }
+    // queued work still references the timer, it frees it when it runs
+    work_pending = timer->work_pending;
+    timer->deleted = TRUE;
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
-    tal_free((void *)timer);
+    if (!work_pending) {
+        tal_free((void *)timer);
+    }
 
     return OPRT_OK;
 }
@@ -305,7 +560,7 @@ OPERATE_RET tal_sw_timer_stop(TIMER_ID timer_id)
         timer->is_running = FALSE;
 
         s_timer_mgr.running_cnt--;
-        tuya_list_del(&(timer->node));
+        __timer_detach(timer);
         tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -354,11 +609,7 @@ OPERATE_RET tal_sw_timer_remain_time_get(TIMER_ID timer_id, uint32_t *remain_tim
         return OPRT_INVALID_PARM;
     }
 
-    uint64_t nowMS = 0;
-    TIME_S secTime = 0;
-    TIME_MS msTime = 0;
-    tal_time_get_system_time(&secTime, &msTime);
-    nowMS = (uint64_t)secTime * 1000 + (uint64_t)msTime;
+    uint64_t nowMS = __timer_now_ms();
 
     TIMER_T *timer = (TIMER_T *)timer_id;
     if (!timer->is_running) {
@@ -396,9 +647,7 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
 
     TIMER_T *timer = (TIMER_T *)timer_id;
 
-    TIME_S secTime = 0;
-    TIME_MS msTime = 0;
-    tal_time_get_system_time(&secTime, &msTime);
+    uint64_t nowMS = __timer_now_ms();
 
     tal_mutex_lock(s_timer_mgr.mutex);
 
@@ -412,7 +661,8 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     }
 
     timer->type = timer_type;
-    timer->expire_time = (uint64_t)secTime * 1000 + (uint64_t)msTime + timer->interval;
+    timer->expire_time = nowMS + timer->interval;
+    timer->triggered = FALSE;
     __timer_attach(timer);
 
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -442,8 +692,8 @@ OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id)
     tal_mutex_lock(s_timer_mgr.mutex);
     timer->expire_time = 0;
     if (timer->is_running) {
-        tuya_list_del(&(timer->node));
-        tuya_list_add(&(timer->node), &(s_timer_mgr.list_active));
+        timer->triggered = TRUE;
+        __timer_attach(timer);
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
@@ -486,10 +736,69 @@ int tal_sw_timer_get_num(void)
     return s_timer_mgr.running_cnt;
 }
 
+/**
+ * @brief Set where the timer callback runs
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] mode: see TIMER_DISPATCH_E
+ * @param[in] service: the workqueue used in TAL_TIMER_DISPATCH_WORKQ mode
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_set_dispatch(TIMER_ID timer_id, TIMER_DISPATCH_E mode, WORKQ_SERVICE_E service)
+{
+    if (NULL == timer_id) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TIMER_T *timer = (TIMER_T *)timer_id;
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    timer->dispatch = mode;
+    timer->service = service;
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Get the timer dispatch statistics
+ *
+ * @param[out] stat: the statistics
+ * @param[in] reset: clear the statistics after reading
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_get_stat(TAL_TIMER_STAT_T *stat, BOOL_T reset)
+{
+    if (NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    *stat = s_timer_mgr.stat;
+    if (reset) {
+        memset(&s_timer_mgr.stat, 0, sizeof(s_timer_mgr.stat));
+    }
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    return OPRT_OK;
+}
+
 // used for debug
 void tal_sw_timer_dump(void)
 {
+    TAL_TIMER_STAT_T *stat = &s_timer_mgr.stat;
+
     PR_NOTICE("---------timer queue dump begin---------");
+    uint32_t timed = stat->fired - stat->triggered;
+
+    PR_NOTICE("fired:%u triggered:%u late:%u max_late:%ums avg_late:%ums offloaded:%u coalesced:%u offload_fail:%u",
+              stat->fired, stat->triggered, stat->late, stat->max_late_ms,
+              timed ? (uint32_t)(stat->total_late_ms / timed) : 0, stat->offloaded, stat->coalesced,
+              stat->offload_fail);
     __timer_dump();
     PR_NOTICE("---------timer queue dump end---------");
 }
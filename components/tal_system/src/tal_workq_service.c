@@ -49,8 +49,31 @@
 #define STACK_SIZE_MSG_QUEUE (4 * 1024)
 #endif
 
+// keep one worker by default, existing handlers rely on being serialized
+#ifndef WORKQ_SYSTEM_WORKER_NUM
+#define WORKQ_SYSTEM_WORKER_NUM 1
+#endif
+
+#ifndef WORKQ_HIGHPRI_WORKER_NUM
+#define WORKQ_HIGHPRI_WORKER_NUM 1
+#endif
+
+// 0 folds WORKQ_NETWORK into WORKQ_SYSTEM and saves the thread
+#ifndef WORKQ_NETWORK_WORKER_NUM
+#define WORKQ_NETWORK_WORKER_NUM 1
+#endif
+
+#ifndef MAX_NODE_NUM_NETWORK_QUEUE
+#define MAX_NODE_NUM_NETWORK_QUEUE 16
+#endif
+
+#ifndef STACK_SIZE_NETWORK_QUEUE
+#define STACK_SIZE_NETWORK_QUEUE (4 * 1024)
+#endif
+
 static WORKQUEUE_HANDLE wq_system;
 static WORKQUEUE_HANDLE wq_highpri;
+static WORKQUEUE_HANDLE wq_network;
 
 /**
  * @brief init ty work queue
@@ -73,7 +96,8 @@ OPERATE_RET tal_workq_init(void)
     thread_cfg.stackDepth += 1024;
 #endif
     thread_cfg.thrdname = "wq_system";
-    TUYA_CALL_ERR_GOTO(tal_workqueue_create(MAX_NODE_NUM_WORK_QUEUE, &thread_cfg, &wq_system), ERR_EXIT);
+    TUYA_CALL_ERR_GOTO(
+        tal_workqueue_create_pool(MAX_NODE_NUM_WORK_QUEUE, WORKQ_SYSTEM_WORKER_NUM, &thread_cfg, &wq_system), ERR_EXIT);
 
     thread_cfg.priority = THREAD_PRIO_1;
     thread_cfg.stackDepth = STACK_SIZE_MSG_QUEUE;
@@ -81,7 +105,21 @@ OPERATE_RET tal_workq_init(void)
     thread_cfg.stackDepth += 1024;
 #endif
     thread_cfg.thrdname = "wq_highpri";
-    TUYA_CALL_ERR_GOTO(tal_workqueue_create(MAX_NODE_NUM_MSG_QUEUE, &thread_cfg, &wq_highpri), ERR_EXIT);
+    TUYA_CALL_ERR_GOTO(
+        tal_workqueue_create_pool(MAX_NODE_NUM_MSG_QUEUE, WORKQ_HIGHPRI_WORKER_NUM, &thread_cfg, &wq_highpri),
+        ERR_EXIT);
+
+#if (WORKQ_NETWORK_WORKER_NUM > 0)
+    thread_cfg.priority = THREAD_PRIO_2;
+    thread_cfg.stackDepth = STACK_SIZE_NETWORK_QUEUE;
+#if defined(TUYA_SECURITY_LEVEL) && (TUYA_SECURITY_LEVEL >= TUYA_SL_1)
+    thread_cfg.stackDepth += 1024;
+#endif
+    thread_cfg.thrdname = "wq_network";
+    TUYA_CALL_ERR_GOTO(tal_workqueue_create_pool(MAX_NODE_NUM_NETWORK_QUEUE, WORKQ_NETWORK_WORKER_NUM, &thread_cfg,
+                                                 &wq_network),
+                       ERR_EXIT);
+#endif
 
     return OPRT_OK;
 
@@ -96,6 +134,11 @@ ERR_EXIT:
         wq_highpri = NULL;
     }
 
+    if (wq_network) {
+        tal_workqueue_release(wq_network);
+        wq_network = NULL;
+    }
+
     return rt;
 }
 
@@ -114,6 +157,8 @@ WORKQUEUE_HANDLE tal_workq_get_handle(WORKQ_SERVICE_E service)
         handle = wq_system;
     } else if (WORKQ_HIGHTPRI == service) {
         handle = wq_highpri;
+    } else if (WORKQ_NETWORK == service) {
+        handle = wq_network ? wq_network : wq_system;
     }
 
     return handle;
@@ -151,6 +196,22 @@ OPERATE_RET tal_workq_schedule_instant(WORKQ_SERVICE_E service, WORKQUEUE_CB cb,
     return tal_workqueue_schedule_instant(tal_workq_get_handle(service), cb, data);
 }
 
+/**
+ * @brief put work task in workqueue, ordered with the work of the same key
+ *
+ * @param[in] service the workqueue service
+ * @param[in] key the ordering key, 0 for unordered work
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_ordered(WORKQ_SERVICE_E service, uint32_t key, WORKQUEUE_CB cb, void *data)
+{
+    return tal_workqueue_schedule_ordered(tal_workq_get_handle(service), key, cb, data);
+}
+
 /**
  * @brief cancel work task in workqueue
  *
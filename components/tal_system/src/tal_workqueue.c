@@ -40,36 +40,80 @@
 #include "tal_workqueue.h"
 #include "tal_sw_timer.h"
 
+#ifndef WORKQUEUE_WORKER_MAX
+#define WORKQUEUE_WORKER_MAX 8
+#endif
+
+typedef struct {
+    WORK_ITEM_T item; // must be first, traverse callbacks see WORK_ITEM_T
+    uint32_t key;
+} WORK_ENTRY_T;
+
 typedef struct {
-    TUYA_QUEUE_HANDLE queue;
+    void *workqueue;
+    TUYA_QUEUE_HANDLE ordered; // keyed work, only run by this worker, NULL with a single worker
+    TUYA_QUEUE_HANDLE local;   // unkeyed work, may be stolen by idle workers
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
+    BOOL_T idle; // read by submitters on other threads, accessed with __atomic
+    char name[16];
     WORKQUEUE_CB last_cb; // used to debug which cb is blocked
+} WORKQUEUE_WORKER_T;
+
+typedef struct {
+    uint8_t worker_num;
+    uint8_t next;    // round robin start for unkeyed work, accessed with __atomic
+    uint32_t stolen; // accessed with __atomic
+    WORKQUEUE_WORKER_T worker[];
 } TAL_WORKQUEUE_T;
 
+static BOOL_T __work_fetch(WORKQUEUE_WORKER_T *worker, WORK_ENTRY_T *entry)
+{
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)worker->workqueue;
+    uint8_t self = worker - workqueue->worker;
+    uint8_t i;
+
+    if (worker->ordered && OPRT_OK == tuya_queue_output(worker->ordered, entry)) {
+        return TRUE;
+    }
+    if (OPRT_OK == tuya_queue_output(worker->local, entry)) {
+        return TRUE;
+    }
+
+    // own queues are empty, steal unkeyed work from a busy worker
+    for (i = 1; i < workqueue->worker_num; i++) {
+        WORKQUEUE_WORKER_T *victim = &workqueue->worker[(self + i) % workqueue->worker_num];
+        if (OPRT_OK == tuya_queue_output(victim->local, entry)) {
+            __atomic_fetch_add(&workqueue->stolen, 1, __ATOMIC_RELAXED);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 static void __work_thread_cb(void *data)
 {
     OPERATE_RET op_ret = OPRT_OK;
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)data;
-    WORK_ITEM_T work_item = {0};
+    WORKQUEUE_WORKER_T *worker = (WORKQUEUE_WORKER_T *)data;
+    WORK_ENTRY_T entry = {0};
 
-    while (THREAD_STATE_RUNNING == tal_thread_get_state(workqueue->thread)) {
-        op_ret = tal_semaphore_wait(workqueue->sem, SEM_WAIT_FOREVER);
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(worker->thread)) {
+        __atomic_store_n(&worker->idle, TRUE, __ATOMIC_RELAXED);
+        op_ret = tal_semaphore_wait(worker->sem, SEM_WAIT_FOREVER);
         if (OPRT_OK != op_ret) {
             tal_system_sleep(10);
             continue;
         }
-
-        op_ret = tuya_queue_output(workqueue->queue, &work_item);
-        if (OPRT_OK != op_ret) {
-            tal_system_sleep(10);
-            continue;
-        }
-
-        if (work_item.cb) {
-            workqueue->last_cb = work_item.cb;
-            work_item.cb(work_item.data);
-            workqueue->last_cb = NULL;
+        __atomic_store_n(&worker->idle, FALSE, __ATOMIC_RELAXED);
+
+        // a wakeup may find the work already stolen, that is fine
+        while (__work_fetch(worker, &entry)) {
+            if (entry.item.cb) {
+                worker->last_cb = entry.item.cb;
+                entry.item.cb(entry.item.data);
+                worker->last_cb = NULL;
+            }
         }
     }
 }
@@ -97,6 +141,115 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
     return TRUE;
 }
 
+static WORKQUEUE_WORKER_T *__work_pick(TAL_WORKQUEUE_T *workqueue, uint32_t key)
+{
+    uint8_t start, i;
+
+    if (1 == workqueue->worker_num) {
+        return &workqueue->worker[0];
+    }
+
+    // same key, same worker: keeps the keyed work in order and never concurrent
+    if (key) {
+        return &workqueue->worker[((key * 2654435761u) >> 16) % workqueue->worker_num];
+    }
+
+    start = __atomic_fetch_add(&workqueue->next, 1, __ATOMIC_RELAXED) % workqueue->worker_num;
+    for (i = 0; i < workqueue->worker_num; i++) {
+        WORKQUEUE_WORKER_T *worker = &workqueue->worker[(start + i) % workqueue->worker_num];
+        // only a hint, a worker that just went busy still gets the work
+        if (__atomic_load_n(&worker->idle, __ATOMIC_RELAXED)) {
+            return worker;
+        }
+    }
+
+    return &workqueue->worker[start];
+}
+
+static OPERATE_RET __work_submit(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data, BOOL_T instant)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+
+    if ((NULL == handle) || (NULL == cb)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    WORK_ENTRY_T entry = {.item = {.cb = cb, .data = data}, .key = key};
+    WORKQUEUE_WORKER_T *worker = __work_pick(workqueue, key);
+    // a single worker keeps everything in one fifo, as before
+    TUYA_QUEUE_HANDLE queue = (key && worker->ordered) ? worker->ordered : worker->local;
+    uint8_t i, self = worker - workqueue->worker;
+
+    if (instant) {
+        op_ret = tuya_queue_input_instant(queue, &entry);
+    } else {
+        op_ret = tuya_queue_input(queue, &entry);
+    }
+    // unkeyed work may run on any worker, try the others before failing
+    for (i = 1; (OPRT_OK != op_ret) && !key && (i < workqueue->worker_num); i++) {
+        worker = &workqueue->worker[(self + i) % workqueue->worker_num];
+        if (instant) {
+            op_ret = tuya_queue_input_instant(worker->local, &entry);
+        } else {
+            op_ret = tuya_queue_input(worker->local, &entry);
+        }
+    }
+    if (OPRT_OK == op_ret) {
+        // the count may exceed the backlog after steals, a failed post still leaves the worker awake
+        tal_semaphore_post(worker->sem);
+    }
+
+    return op_ret;
+}
+
+/**
+ * @brief stop all workers and wait for their threads to exit
+ *
+ * Every worker may steal from every other worker's queue, so no queue may be
+ * freed before all threads are gone.
+ */
+static void __work_workers_stop(TAL_WORKQUEUE_T *workqueue)
+{
+    uint32_t count = 1;
+    uint8_t i;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        WORKQUEUE_WORKER_T *worker = &workqueue->worker[i];
+        if (worker->thread && OPRT_OK == tal_thread_delete(worker->thread)) {
+            tal_semaphore_post(worker->sem);
+        } else {
+            worker->thread = NULL;
+        }
+    }
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        WORKQUEUE_WORKER_T *worker = &workqueue->worker[i];
+        if (NULL == worker->thread) {
+            continue;
+        }
+        while (THREAD_STATE_DELETE != tal_thread_get_state(worker->thread)) {
+            tal_system_sleep(10);
+            if ((count++) % 500 == 0) {
+                PR_NOTICE("%p still running", worker->thread);
+            }
+        }
+    }
+}
+
+static void __work_worker_free(WORKQUEUE_WORKER_T *worker)
+{
+    if (worker->ordered) {
+        tuya_queue_release(worker->ordered);
+    }
+    if (worker->local) {
+        tuya_queue_release(worker->local);
+    }
+    if (worker->sem) {
+        tal_semaphore_release(worker->sem);
+    }
+}
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -110,41 +263,75 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle)
 {
-    OPERATE_RET op_ret = OPRT_OK;
+    return tal_workqueue_create_pool(queue_len, 1, thread_cfg, handle);
+}
+
+/**
+ * @brief create and initialize a workqueue served by a pool of threads
+ *
+ * @param[in] queue_len the maximum number of items per worker
+ * @param[in] worker_num number of worker threads, 1 to WORKQUEUE_WORKER_MAX
+ * @param[in] thread_cfg thread param, shared by all workers
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint16_t queue_len, uint8_t worker_num, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle)
+{
+    OPERATE_RET rt = OPRT_OK;
     TAL_WORKQUEUE_T *workqueue = NULL;
+    THREAD_CFG_T cfg;
+    uint8_t i;
 
-    if ((0 == queue_len) || (NULL == thread_cfg) || (NULL == handle)) {
+    if ((0 == queue_len) || (0 == worker_num) || (worker_num > WORKQUEUE_WORKER_MAX) || (NULL == thread_cfg) ||
+        (NULL == handle)) {
         return OPRT_INVALID_PARM;
     }
 
-    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T));
+    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T) + worker_num * sizeof(WORKQUEUE_WORKER_T));
     if (NULL == workqueue) {
         return OPRT_MALLOC_FAILED;
     }
+    workqueue->worker_num = worker_num;
 
-    op_ret = tuya_queue_create(queue_len, sizeof(WORK_ITEM_T), &workqueue->queue);
-    if (OPRT_OK != op_ret) {
-        tal_free((void *)workqueue);
-        return op_ret;
+    for (i = 0; i < worker_num; i++) {
+        WORKQUEUE_WORKER_T *worker = &workqueue->worker[i];
+        worker->workqueue = workqueue;
+        worker->idle = TRUE;
+
+        TUYA_CALL_ERR_GOTO(tuya_queue_create(queue_len, sizeof(WORK_ENTRY_T), &worker->local), __err_exit);
+        // keyed work only needs its own queue when it could otherwise be stolen
+        if (worker_num > 1) {
+            TUYA_CALL_ERR_GOTO(tuya_queue_create(queue_len, sizeof(WORK_ENTRY_T), &worker->ordered), __err_exit);
+        }
+        TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&worker->sem, 0, 2 * queue_len), __err_exit);
     }
 
-    op_ret = tal_semaphore_create_init(&workqueue->sem, 0, queue_len);
-    if (OPRT_OK != op_ret) {
-        tuya_queue_release(workqueue->queue);
-        tal_free((void *)workqueue);
-        return op_ret;
+    for (i = 0; i < worker_num; i++) {
+        WORKQUEUE_WORKER_T *worker = &workqueue->worker[i];
+        cfg = *thread_cfg;
+        if (worker_num > 1 && thread_cfg->thrdname) {
+            snprintf(worker->name, sizeof(worker->name), "%.12s_%d", thread_cfg->thrdname, i);
+            cfg.thrdname = worker->name;
+        }
+        TUYA_CALL_ERR_GOTO(tal_thread_create_and_start(&worker->thread, NULL, NULL, __work_thread_cb, worker, &cfg),
+                           __err_exit);
     }
 
-    op_ret = tal_thread_create_and_start(&workqueue->thread, NULL, NULL, __work_thread_cb, workqueue, thread_cfg);
-    if (OPRT_OK != op_ret) {
-        tal_semaphore_release(workqueue->sem);
-        tuya_queue_release(workqueue->queue);
-        tal_free((void *)workqueue);
-    } else {
-        *handle = workqueue;
+    *handle = workqueue;
+
+    return OPRT_OK;
+
+__err_exit:
+    __work_workers_stop(workqueue);
+    for (i = 0; i < worker_num; i++) {
+        __work_worker_free(&workqueue->worker[i]);
     }
+    tal_free((void *)workqueue);
 
-    return op_ret;
+    return rt;
 }
 
 /**
@@ -159,21 +346,7 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
  */
 OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
-    if ((NULL == handle) || (NULL == cb)) {
-        return OPRT_INVALID_PARM;
-    }
-
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
-
-    op_ret = tuya_queue_input(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
-    }
-
-    return op_ret;
+    return __work_submit(handle, 0, cb, data, FALSE);
 }
 
 /**
@@ -188,21 +361,23 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
-    if ((NULL == handle) || (NULL == cb)) {
-        return OPRT_INVALID_PARM;
-    }
-
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
-
-    op_ret = tuya_queue_input_instant(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
-    }
+    return __work_submit(handle, 0, cb, data, TRUE);
+}
 
-    return op_ret;
+/**
+ * @brief put work task in workqueue, ordered with the work of the same key
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] key the ordering key, 0 for unordered work
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_ordered(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data)
+{
+    return __work_submit(handle, key, cb, data, FALSE);
 }
 
 /**
@@ -223,8 +398,16 @@ OPERATE_RET tal_workqueue_cancel(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
     WORK_ITEM_T work_item = {.cb = cb, .data = data};
+    uint8_t i;
 
-    return tuya_queue_traverse(workqueue->queue, __work_cancel_traverse, &work_item);
+    for (i = 0; i < workqueue->worker_num; i++) {
+        if (workqueue->worker[i].ordered) {
+            tuya_queue_traverse(workqueue->worker[i].ordered, __work_cancel_traverse, &work_item);
+        }
+        tuya_queue_traverse(workqueue->worker[i].local, __work_cancel_traverse, &work_item);
+    }
+
+    return OPRT_OK;
 }
 
 /**
@@ -244,7 +427,16 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return tuya_queue_traverse(workqueue->queue, (TRAVERSE_CB)cb, ctx);
+    uint8_t i;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        if (workqueue->worker[i].ordered) {
+            tuya_queue_traverse(workqueue->worker[i].ordered, (TRAVERSE_CB)cb, ctx);
+        }
+        tuya_queue_traverse(workqueue->worker[i].local, (TRAVERSE_CB)cb, ctx);
+    }
+
+    return OPRT_OK;
 }
 
 /**
@@ -261,12 +453,25 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    uint32_t num = 0;
+    uint8_t i;
 
-    if (workqueue->last_cb) {
-        PR_NOTICE("%p:last_cb %p", workqueue->thread, workqueue->last_cb);
+    for (i = 0; i < workqueue->worker_num; i++) {
+        WORKQUEUE_WORKER_T *worker = &workqueue->worker[i];
+        if (worker->last_cb) {
+            PR_NOTICE("%p:last_cb %p", worker->thread, worker->last_cb);
+        }
+        if (worker->ordered) {
+            num += tuya_queue_get_used_num(worker->ordered);
+        }
+        num += tuya_queue_get_used_num(worker->local);
+    }
+    uint32_t stolen = __atomic_load_n(&workqueue->stolen, __ATOMIC_RELAXED);
+    if (stolen) {
+        PR_NOTICE("%p:stolen %u", workqueue, stolen);
     }
 
-    return tuya_queue_get_used_num(workqueue->queue);
+    return num;
 }
 
 /**
@@ -283,26 +488,13 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
         return OPRT_INVALID_PARM;
     }
 
-    OPERATE_RET op_ret = OPRT_OK;
-    uint32_t count = 1;
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    uint8_t i;
 
-    op_ret = tal_thread_delete(workqueue->thread);
-    if (OPRT_OK != op_ret) {
-        return op_ret;
+    __work_workers_stop(workqueue);
+    for (i = 0; i < workqueue->worker_num; i++) {
+        __work_worker_free(&workqueue->worker[i]);
     }
-
-    tal_semaphore_post(workqueue->sem);
-
-    while (THREAD_STATE_DELETE != tal_thread_get_state(workqueue->thread)) {
-        tal_system_sleep(10);
-        if ((count++) % 500 == 0) {
-            PR_NOTICE("%p still running", workqueue->thread);
-        }
-    }
-
-    tuya_queue_release(workqueue->queue);
-    tal_semaphore_release(workqueue->sem);
     tal_free((void *)workqueue);
 
     return OPRT_OK;
@@ -313,7 +505,7 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
  *
  * @param[in] handle the workqueue handle
  *
- * @return thread handle
+ * @return thread handle of the first worker
  */
 THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
 {
@@ -322,7 +514,7 @@ THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return workqueue->thread;
+    return workqueue->worker[0].thread;
 }
 
 typedef struct {
@@ -332,11 +524,21 @@ typedef struct {
     WORKQUEUE_HANDLE handle;
 } DELAYED_WORK_T;
 
+static uint32_t __delayed_work_key(DELAYED_WORK_T *p_delayed_work)
+{
+    uint64_t addr = (uint64_t)(uintptr_t)p_delayed_work;
+
+    // fold the high half in so 64-bit pointers do not collide, never 0 which means unordered
+    return (uint32_t)(addr ^ (addr >> 32)) | 1u;
+}
+
 void __delayed_work_cb(TIMER_ID timer_id, void *arg)
 {
     DELAYED_WORK_T *p_delayed_work = (DELAYED_WORK_T *)arg;
 
-    tal_workqueue_schedule(p_delayed_work->handle, p_delayed_work->cb, p_delayed_work->data);
+    // keyed by the delayed work so a cyclic work never overlaps itself on a pool
+    tal_workqueue_schedule_ordered(p_delayed_work->handle, __delayed_work_key(p_delayed_work), p_delayed_work->cb,
+                                   p_delayed_work->data);
 }
 
 /**
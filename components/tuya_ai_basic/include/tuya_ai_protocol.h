@@ -481,6 +481,20 @@ OPERATE_RET tuya_ai_basic_connect(void);
  */
 void tuya_ai_basic_disconnect(void);
 
+/**
+ * @brief get the socket fd of the ai connection
+ *
+ * @return the socket fd, -1 if not connected
+ */
+int tuya_ai_basic_get_fd(void);
+
+/**
+ * @brief check without blocking whether received data is waiting
+ *
+ * @return TRUE if a read would not block
+ */
+BOOL_T tuya_ai_basic_readable(void);
+
 /**
  * @brief ai basic refresh req
  *
@@ -30,6 +30,8 @@
 #include "tal_sw_timer.h"
 #include "tal_workq_service.h"
 #include "tal_memory.h"
+#include "tal_network.h"
+#include "tal_net_reactor.h"
 #include "tuya_ai_client.h"
 #include "tuya_ai_biz.h"
 #include "netmgr.h"
@@ -69,6 +71,12 @@ typedef struct {
     TIMER_ID alive_timeout_timer;
     uint8_t heartbeat_lost_cnt;
     AI_BASIC_DATA_HANDLE cb;
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    BOOL_T reactor;    // the net reactor watches the socket while running
+    int reactor_fd;    // fd watched by the reactor, -1 if none
+    BOOL_T readable;   // set by the reactor, which stops watching the fd until it is read
+    SEM_HANDLE wakeup; // posted on state change and readability
+#endif
 } AI_BASIC_CLIENT_T;
 
 static AI_BASIC_CLIENT_T *ai_basic_client = NULL;
@@ -82,6 +90,11 @@ static void __ai_client_set_state(AI_CLIENT_STATE_E state)
 {
     PR_NOTICE("***** ai client state %d -> %d *****", ai_basic_client->state, state);
     ai_basic_client->state = state;
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    if (ai_basic_client->wakeup) {
+        tal_semaphore_post(ai_basic_client->wakeup);
+    }
+#endif
 }
 
 static OPERATE_RET __ai_connect()
@@ -285,6 +298,49 @@ static OPERATE_RET __ai_running(void)
     return rt;
 }
 
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+static void __ai_reactor_ready(int fd, uint8_t events, void *arg)
+{
+    // reading may block for a whole packet, leave it to the ai thread and keep the shared reactor free
+    tal_net_reactor_del(fd);
+    __atomic_store_n(&ai_basic_client->readable, TRUE, __ATOMIC_RELEASE);
+    tal_semaphore_post(ai_basic_client->wakeup);
+}
+
+static OPERATE_RET __ai_reactor_running(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (ai_basic_client->reactor_fd < 0) {
+        int fd = tuya_ai_basic_get_fd();
+        if ((fd < 0) || (OPRT_OK != tal_net_reactor_add(fd, TAL_NET_POLL_READ, __ai_reactor_ready, NULL))) {
+            return __ai_running();
+        }
+        ai_basic_client->reactor_fd = fd;
+    }
+
+    // park until the socket is readable or the state changes
+    tal_semaphore_wait(ai_basic_client->wakeup, SEM_WAIT_FOREVER);
+    if (AI_STATE_RUNNING != ai_basic_client->state) {
+        tal_net_reactor_del(ai_basic_client->reactor_fd);
+        ai_basic_client->reactor_fd = -1;
+        __atomic_store_n(&ai_basic_client->readable, FALSE, __ATOMIC_RELAXED);
+        return OPRT_OK;
+    }
+    if (!__atomic_exchange_n(&ai_basic_client->readable, FALSE, __ATOMIC_ACQUIRE)) {
+        return OPRT_OK;
+    }
+
+    // the reactor dropped the fd, drain what is buffered and watch it again on the next round
+    ai_basic_client->reactor_fd = -1;
+    do {
+        rt = __ai_running();
+    } while ((OPRT_OK == rt) && (AI_STATE_RUNNING == ai_basic_client->state) && tuya_ai_basic_readable());
+
+    return rt;
+}
+#endif
+
 static OPERATE_RET __ai_idle()
 {
     netmgr_status_e status = NETMGR_LINK_DOWN;
@@ -329,6 +385,14 @@ static void __ai_basic_client_deinit(void)
     if (ai_basic_client->alive_work) {
         tal_workq_stop_delayed(ai_basic_client->alive_work);
     }
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    if (ai_basic_client->reactor_fd >= 0) {
+        tal_net_reactor_del(ai_basic_client->reactor_fd);
+    }
+    if (ai_basic_client->wakeup) {
+        tal_semaphore_release(ai_basic_client->wakeup);
+    }
+#endif
     Free(ai_basic_client);
     ai_basic_client = NULL;
     return;
@@ -358,6 +422,12 @@ static void __ai_client_thread_cb(void *args)
             rt = __ai_auth_resp();
             break;
         case AI_STATE_RUNNING:
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+            if (ai_basic_client->reactor) {
+                rt = __ai_reactor_running();
+                break;
+            }
+#endif
             rt = __ai_running();
             break;
         default:
@@ -455,12 +525,21 @@ OPERATE_RET tuya_ai_client_init(void)
     TUYA_CHECK_NULL_RETURN(ai_basic_client, OPRT_MALLOC_FAILED);
 
     memset(ai_basic_client, 0, sizeof(AI_BASIC_CLIENT_T));
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    ai_basic_client->reactor_fd = -1;
+#endif
     ai_basic_client->heartbeat_interval = 30;
     AI_RECONN_TIME_T reconn[AI_RECONN_TIME_NUM] = {{5, 10},   {10, 20},   {20, 40},  {40, 80},
                                                    {80, 160}, {160, 320}, {320, 640}};
     memcpy(ai_basic_client->reconn, reconn, sizeof(reconn));
     tuya_ai_biz_init();
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__ai_conn_refresh, NULL, &ai_basic_client->tid), EXIT);
+    //! the refresh request is a blocking TLS send, keep it off the timer thread and WORKQ_SYSTEM
+    tal_sw_timer_set_dispatch(ai_basic_client->tid, TAL_TIMER_DISPATCH_WORKQ, WORKQ_NETWORK);
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ai_basic_client->wakeup, 0, 1), EXIT);
+    ai_basic_client->reactor = (OPRT_OK == tal_net_reactor_start());
+#endif
     TUYA_CALL_ERR_GOTO(__ai_client_create_task(), EXIT);
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__ai_alive_timeout, NULL, &ai_basic_client->alive_timeout_timer), EXIT);
     TUYA_CALL_ERR_GOTO(tal_workq_init_delayed(WORKQ_HIGHTPRI, __ai_ping, NULL, &ai_basic_client->alive_work), EXIT);
@@ -1361,6 +1361,23 @@ void tuya_ai_basic_disconnect(void)
     __ai_basic_proto_deinit();
 }
 
+int tuya_ai_basic_get_fd(void)
+{
+    if ((NULL == ai_basic_proto) || (NULL == ai_basic_proto->transporter)) {
+        return -1;
+    }
+    return tuya_transporter_get_fd(ai_basic_proto->transporter);
+}
+
+BOOL_T tuya_ai_basic_readable(void)
+{
+    if ((NULL == ai_basic_proto) || (NULL == ai_basic_proto->transporter)) {
+        return FALSE;
+    }
+    // also true for records already buffered by tls
+    return tuya_transporter_poll_read(ai_basic_proto->transporter, 0) > 0;
+}
+
 OPERATE_RET tuya_ai_basic_conn_close(AI_STATUS_CODE code)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -10,6 +10,7 @@
 
 #include "ble_cryption.h"
 #include "tal_api.h"
+#include "tal_security.h"
 #include "mix_method.h"
 #include "tuya_iot.h"
 
@@ -232,7 +233,11 @@ int tuya_ble_rsp_id_encrypt(uint8_t *key, uint8_t key_len, uint8_t *in_buf, uint
  * @param in_buf            Pointer to the input buffer.
  * @param in_len            Length of the input buffer.
  * @param out_len           Pointer to store the length of the output buffer.
- * @param out_buf           Pointer to the output buffer.
+ * @param out_buf           Pointer to the output buffer, may be in_buf to
+ *                          encrypt in place.
+ *
+ * @note The PKCS padding is written behind the input in in_buf, which must have
+ *       room for up to 15 more bytes.
  *
  * @return                  0 if encryption is successful.
  *                          2 if the encryption mode is invalid.
@@ -250,7 +255,9 @@ uint8_t tuya_ble_encryption(ble_crypto_param_t *p, uint8_t encryption_mode, uint
     }
 
     if (encryption_mode == ENCRYPTION_MODE_NONE) {
-        memcpy((void *)out_buf, in_buf, in_len);
+        if (out_buf != in_buf) {
+            memmove((void *)out_buf, in_buf, in_len);
+        }
         *out_len = in_len;
         return 0;
     } else {
@@ -281,7 +288,8 @@ uint8_t tuya_ble_encryption(ble_crypto_param_t *p, uint8_t encryption_mode, uint
  * @param out_len   Pointer to a variable that will store the length of the
  *                  decrypted data.
  * @param out_buf   Pointer to the output buffer where the decrypted data will
- *                  be stored.
+ *                  be stored. It may overlap the payload in in_buf, in which
+ *                  case the frame is decrypted in place.
  *
  * @return          Returns `0` on success, or an error code if decryption
  * fails.
@@ -294,7 +302,7 @@ uint8_t tuya_ble_decryption(ble_crypto_param_t *p, uint8_t *in_buf, uint32_t in_
     uint8_t IV[16];
     uint8_t mode = 0;
 
-    if (in_len < 17) {
+    if (in_len < TUYA_BLE_CRYPTION_HEAD_LEN) {
         return 1;
     }
 
@@ -304,12 +312,12 @@ uint8_t tuya_ble_decryption(ble_crypto_param_t *p, uint8_t *in_buf, uint32_t in_
 
     if (in_buf[0] == ENCRYPTION_MODE_NONE) {
         len = in_len - 1;
-        memcpy((void *)out_buf, in_buf + 1, len);
+        memmove((void *)out_buf, in_buf + 1, len);
         *out_len = len;
         return 0;
     }
 
-    len = in_len - 17;
+    len = in_len - TUYA_BLE_CRYPTION_HEAD_LEN;
 
     memset(key, 0, sizeof(key));
     memset(IV, 0, sizeof(IV));
@@ -322,7 +330,7 @@ uint8_t tuya_ble_decryption(ble_crypto_param_t *p, uint8_t *in_buf, uint32_t in_
     if (ble_key_generate(p, mode, key)) {
         memcpy((void *)IV, in_buf + 1, 16);
         *out_len = len;
-        int rt = tal_aes128_cbc_decode_raw((uint8_t *)(in_buf + 17), len, key, IV, out_buf);
+        int rt = tal_aes128_cbc_decode_raw((uint8_t *)(in_buf + TUYA_BLE_CRYPTION_HEAD_LEN), len, key, IV, out_buf);
         return rt == OPRT_OK ? 0 : 3;
     }
 
@@ -48,6 +48,9 @@ typedef enum {
     ENCRYPTION_MODE_MAX,           // Maximum encryption mode
 } ble_key_mode_t;
 
+// encryption mode flag and iv in front of an encrypted frame
+#define TUYA_BLE_CRYPTION_HEAD_LEN 17
+
 typedef struct {
     uint8_t *auth_key;
     uint8_t *user_rand;
@@ -75,6 +78,10 @@ uint8_t tuya_ble_encryption(ble_crypto_param_t *p, uint8_t encryption_mode, uint
  * output buffer.
  * @param out_buf Pointer to the output buffer.
  *
+ * @note The frame may be decrypted in place: out_buf may point at the payload
+ * inside in_buf, in_buf + TUYA_BLE_CRYPTION_HEAD_LEN, or in_buf + 1 for
+ * ENCRYPTION_MODE_NONE. in_buf[0] is left untouched.
+ *
  * @return Returns 0 on success, or an error code on failure.
  */
 uint8_t tuya_ble_decryption(ble_crypto_param_t *p, uint8_t *in_buf, uint32_t in_len, uint32_t *out_len,
@@ -37,6 +37,22 @@
 #define BLE_CONN_MONITOR_TIME 30000
 /* ID  (id == uuid)*/
 #define BLE_ID_LEN 16
+/* ATT MTU asked for on connect, 247 fills one data length extended LL packet */
+#ifndef BLE_ATT_MTU_MAX
+#define BLE_ATT_MTU_MAX 247
+#endif
+/* ATT notification header, a notification carries ATT_MTU - 3 bytes */
+#define BLE_ATT_HEADER_LEN 3
+/* subpackets handed to the stack before waiting for a notify tx event */
+#ifndef BLE_SEND_WINDOW
+#define BLE_SEND_WINDOW 4
+#endif
+/* pacing of a full window while the stack reports no notify tx events */
+#define BLE_SEND_PACE_MS 20
+/* longest wait for a notify tx event before the window is counted as sent */
+#define BLE_SEND_TX_TIMEOUT_MS 500
+/* retries of a subpackage the stack could not queue */
+#define BLE_SEND_RETRY 3
 typedef struct {
     ble_session_fn_t function;
     void *priv_data;
@@ -45,9 +61,7 @@ typedef struct {
 typedef struct {
     ble_frame_trsmitr_t *trsmitr;
     uint32_t raw_len;
-    uint8_t raw_buf[TUYA_BLE_AIR_FRAME_MAX];
-    uint32_t dec_len;
-    uint8_t dec_buf[TUYA_BLE_AIR_FRAME_MAX];
+    uint8_t raw_buf[TUYA_BLE_AIR_FRAME_MAX]; // frame, decrypted in place
 } ble_packet_recv_t;
 
 typedef struct {
@@ -76,6 +90,12 @@ typedef struct {
     uint32_t recv_sn;
     ble_packet_recv_t *packet_recv;
     ble_session_t session[BLE_SESSION_MAX];
+    //! packet send
+    uint16_t att_mtu;         // negotiated ATT MTU, 0 until the stack reports it
+    bool tx_evt;              // the stack reports notify tx events
+    uint8_t tx_inflight;      // subpackets handed to the stack and not reported yet
+    SEM_HANDLE tx_sem;        // posted on each notify tx event
+    MUTEX_HANDLE send_mutex;  // one frame at a time, its subpackets must not interleave
 } tuya_ble_mgr_t;
 
 static tuya_ble_mgr_t *s_ble_mgr = NULL;
@@ -210,7 +230,6 @@ static uint32_t ble_packet_trsmitr(ble_packet_recv_t *packet_recv, uint8_t *buf,
     int rt = ble_frame_trsmitr_recv_pkg_decode(packet_recv->trsmitr, buf, len);
     if (OPRT_OK != rt && OPRT_SVC_BT_API_TRSMITR_CONTINUE != rt) { // decode error
         packet_recv->raw_len = 0;
-        memset(packet_recv->raw_buf, 0, sizeof(packet_recv->raw_buf));
         return rt;
     }
     // For the first packet of a multi-packet transmission, or in the case of a
@@ -218,7 +237,6 @@ static uint32_t ble_packet_trsmitr(ble_packet_recv_t *packet_recv, uint8_t *buf,
     if (BLE_FRAME_PKG_FIRST == packet_recv->trsmitr->pkg_desc ||
         (BLE_FRAME_PKG_END == packet_recv->trsmitr->pkg_desc && 0 == packet_recv->trsmitr->subpkg_num)) {
         packet_recv->raw_len = 0;
-        memset(packet_recv->raw_buf, 0, sizeof(packet_recv->raw_buf));
         pack_no = 0;
     }
     pack_no++;
@@ -226,6 +244,7 @@ static uint32_t ble_packet_trsmitr(ble_packet_recv_t *packet_recv, uint8_t *buf,
     PR_DEBUG("ble recv sub_pkg desc:%d, no:%d, pack_len:%d, total_len:%d", packet_recv->trsmitr->pkg_desc, pack_no,
              subpkg_len, packet_recv->raw_len + subpkg_len);
 
+    // the only copy of the payload, straight from the received subpackage
     if ((packet_recv->raw_len + subpkg_len) <= TUYA_BLE_AIR_FRAME_MAX) {
         memcpy((void *)packet_recv->raw_buf + packet_recv->raw_len, ble_frame_subpacket_get(packet_recv->trsmitr), subpkg_len);
     } else {
@@ -260,10 +279,18 @@ static uint32_t ble_packet_trsmitr(ble_packet_recv_t *packet_recv, uint8_t *buf,
 #define BLE_PACKET_CRC16_LEN  (2)
 #define BLE_PACKET_MIN_LEN    (BLE_PACKET_CRC16_IND + BLE_PACKET_CRC16_LEN)
 
+/**
+ * @brief Receives one subpacket and decodes the frame once it is complete.
+ *
+ * The frame is decrypted in place in the receive buffer, packet->data points
+ * into it and stays valid until the next subpacket is received.
+ */
 static int ble_packet_recv(tuya_ble_mgr_t *ble, uint8_t *buf, uint16_t len, ble_packet_t *packet)
 {
     int rt = OPRT_OK;
     ble_packet_recv_t *packet_recv = s_ble_mgr->packet_recv;
+    uint8_t *dec_buf = NULL;
+    uint32_t dec_len = 0;
 
     rt = ble_packet_trsmitr(packet_recv, buf, len);
     if (OPRT_OK != rt) {
@@ -283,35 +310,43 @@ static int ble_packet_recv(tuya_ble_mgr_t *ble, uint8_t *buf, uint16_t len, ble_
         return OPRT_INVALID_PARM;
     }
     tuya_ble_raw_print("ble raw packet", 32, packet_recv->raw_buf, packet_recv->raw_len);
-    rt = tuya_ble_decryption(&ble->crypto_param, packet_recv->raw_buf, packet_recv->raw_len, &packet_recv->dec_len,
-                             packet_recv->dec_buf);
+    if (ENCRYPTION_MODE_NONE == packet_recv->raw_buf[0]) {
+        dec_buf = packet_recv->raw_buf + 1;
+    } else {
+        dec_buf = packet_recv->raw_buf + TUYA_BLE_CRYPTION_HEAD_LEN;
+    }
+    rt = tuya_ble_decryption(&ble->crypto_param, packet_recv->raw_buf, packet_recv->raw_len, &dec_len, dec_buf);
     if (rt != 0) {
         PR_ERR("ble packet decrypt err:%d", rt);
         return OPRT_INVALID_PARM;
     }
-    tuya_ble_raw_print("ble dec packet", 32, packet_recv->dec_buf, packet_recv->dec_len);
+    tuya_ble_raw_print("ble dec packet", 32, dec_buf, dec_len);
+    if (dec_len < BLE_PACKET_MIN_LEN) {
+        PR_ERR("ble packet len err:%d", dec_len);
+        return OPRT_INVALID_PARM;
+    }
     uint16_t data_len = 0;
-    data_len = packet_recv->dec_buf[BLE_PACKET_DLEN_IND] << 8;
-    data_len += packet_recv->dec_buf[BLE_PACKET_DLEN_IND + 1];
-    if (data_len + BLE_PACKET_MIN_LEN > TUYA_BLE_AIR_FRAME_MAX) {
+    data_len = dec_buf[BLE_PACKET_DLEN_IND] << 8;
+    data_len += dec_buf[BLE_PACKET_DLEN_IND + 1];
+    if (data_len + BLE_PACKET_MIN_LEN > dec_len) {
         PR_ERR("ble packet len err:%d", (data_len + BLE_PACKET_MIN_LEN));
         return OPRT_INVALID_PARM;
     }
     // crc check
     uint16_t our_crc = 0;
-    our_crc = packet_recv->dec_buf[BLE_PACKET_CRC16_IND + data_len] << 8;
-    our_crc += packet_recv->dec_buf[BLE_PACKET_CRC16_IND + data_len + 1];
-    uint16_t his_crc = get_crc_16(packet_recv->dec_buf, data_len + BLE_PACKET_DATA_IND);
+    our_crc = dec_buf[BLE_PACKET_CRC16_IND + data_len] << 8;
+    our_crc += dec_buf[BLE_PACKET_CRC16_IND + data_len + 1];
+    uint16_t his_crc = get_crc_16(dec_buf, data_len + BLE_PACKET_DATA_IND);
     if (our_crc != his_crc) {
         PR_ERR("ble packet crc err:0x%04x, 0x%04x", our_crc, his_crc);
         return OPRT_INVALID_PARM;
     }
     // sn check
     uint32_t recv_sn = 0;
-    recv_sn = packet_recv->dec_buf[BLE_PACKET_SN_IND] << 24;
-    recv_sn += packet_recv->dec_buf[BLE_PACKET_SN_IND + 1] << 16;
-    recv_sn += packet_recv->dec_buf[BLE_PACKET_SN_IND + 2] << 8;
-    recv_sn += packet_recv->dec_buf[BLE_PACKET_SN_IND + 3];
+    recv_sn = dec_buf[BLE_PACKET_SN_IND] << 24;
+    recv_sn += dec_buf[BLE_PACKET_SN_IND + 1] << 16;
+    recv_sn += dec_buf[BLE_PACKET_SN_IND + 2] << 8;
+    recv_sn += dec_buf[BLE_PACKET_SN_IND + 3];
     PR_NOTICE("ble sn:%d recv sn %d", recv_sn, ble->recv_sn);
     if (recv_sn <= ble->recv_sn) {
         PR_ERR("ble recv sn err");
@@ -320,20 +355,12 @@ static int ble_packet_recv(tuya_ble_mgr_t *ble, uint8_t *buf, uint16_t len, ble_
     } else {
         ble->recv_sn = recv_sn;
     }
-    packet->type = packet_recv->dec_buf[BLE_PACKET_CMD_IND] << 8;
-    packet->type += packet_recv->dec_buf[BLE_PACKET_CMD_IND + 1];
+    packet->type = dec_buf[BLE_PACKET_CMD_IND] << 8;
+    packet->type += dec_buf[BLE_PACKET_CMD_IND + 1];
     packet->len = data_len;
     packet->sn = recv_sn;
-    packet->data = NULL;
+    packet->data = (0 != packet->len) ? &dec_buf[BLE_PACKET_DATA_IND] : NULL;
     packet->encrypt_mode = packet_recv->raw_buf[0];
-    if (0 != packet->len) {
-        packet->data = (uint8_t *)tal_malloc(packet->len);
-        if (packet->data == NULL) {
-            PR_DEBUG("ble packet malloc err");
-            return OPRT_MALLOC_FAILED;
-        }
-        memcpy((void *)packet->data, &packet_recv->dec_buf[BLE_PACKET_DATA_IND], packet->len);
-    }
 
     return OPRT_OK;
 }
@@ -490,19 +517,37 @@ int tuya_ble_session_del(ble_seesion_type_t type)
     return OPRT_INVALID_PARM;
 }
 
+/**
+ * @brief Builds and encrypts a frame in one pooled buffer.
+ *
+ * The frame is laid out behind the encryption flag and iv and encrypted in
+ * place, the caller puts *outbuf back with ble_frame_buf_put().
+ */
 static int ble_packet_encode(tuya_ble_mgr_t *ble, ble_packet_t *packet, uint8_t **outbuf, uint32_t *outlen)
 {
-    uint8_t *ble_frame = NULL;
     uint8_t *enc_buf = NULL;
+    uint8_t *ble_frame = NULL;
+    uint32_t frame_len = BLE_PACKET_MIN_LEN + packet->len;
+
+    //! flag + iv = 17, the frame is padded to a whole block
+    uint32_t padding_len = TUYA_BLE_CRYPTION_HEAD_LEN;
+    if (frame_len % 16) {
+        padding_len += 16 - frame_len % 16;
+    }
+    if ((frame_len + padding_len) > TUYA_BLE_AIR_FRAME_MAX) {
+        PR_ERR("ble packet len exceed");
+        return OPRT_COM_ERROR;
+    }
 
-    ble_frame = tal_malloc(TUYA_BLE_AIR_FRAME_MAX);
-    enc_buf = tal_malloc(TUYA_BLE_AIR_FRAME_MAX);
-    if (NULL == enc_buf || NULL == ble_frame) {
+    enc_buf = ble_frame_buf_get(TUYA_BLE_AIR_FRAME_MAX);
+    if (NULL == enc_buf) {
         PR_ERR("ble enc_buf malloc err");
-        goto __exit;
+        return OPRT_COM_ERROR;
     }
+    ble_frame = &enc_buf[TUYA_BLE_CRYPTION_HEAD_LEN];
+
     uint32_t send_sn = ble->send_sn++;
-    uint32_t frame_len = 0;
+    frame_len = 0;
     //! SN offset = 0
     ble_frame[frame_len++] = send_sn >> 24;
     ble_frame[frame_len++] = send_sn >> 16;
@@ -528,86 +573,131 @@ static int ble_packet_encode(tuya_ble_mgr_t *ble, ble_packet_t *packet, uint8_t
     uint16_t crc16 = get_crc_16(ble_frame, frame_len);
     ble_frame[frame_len++] = crc16 >> 8;
     ble_frame[frame_len++] = crc16;
-    //! flag + iv = 17
+
     enc_buf[0] = packet->encrypt_mode;
-    uint16_t padding_len = 17;
-    if (frame_len % 16) {
-        padding_len += 16 - frame_len % 16;
-    }
-    if ((frame_len + padding_len) > TUYA_BLE_AIR_FRAME_MAX) {
-        PR_ERR("ble packet len exceed");
-        goto __exit;
-    }
     uint32_t enc_len = 0;
     uint8_t iv[16];
     uni_random_bytes(iv, 16);
     memcpy((void *)&enc_buf[1], iv, 16);
     if (tuya_ble_encryption(&ble->crypto_param, packet->encrypt_mode, iv, ble_frame, frame_len, &enc_len,
-                            &enc_buf[17]) == 0) {
-        *outbuf = enc_buf;
-        *outlen = enc_len + 17;
-    } else {
+                            ble_frame) != 0) {
         PR_ERR("ble frame encrypt err");
-        goto __exit;
+        ble_frame_buf_put(enc_buf);
+        return OPRT_COM_ERROR;
     }
-    tal_free((void *)ble_frame);
+    *outbuf = enc_buf;
+    *outlen = enc_len + TUYA_BLE_CRYPTION_HEAD_LEN;
+
     return OPRT_OK;
+}
 
-__exit:
-    if (ble_frame) {
-        tal_free((void *)ble_frame);
+static uint16_t ble_send_subpkg_len(tuya_ble_mgr_t *ble)
+{
+    uint16_t len = ble_frame_packet_len_get();
+
+    // the app asks for the subpackage length, the link may carry less
+    if (ble->att_mtu > BLE_ATT_HEADER_LEN && len > ble->att_mtu - BLE_ATT_HEADER_LEN) {
+        len = ble->att_mtu - BLE_ATT_HEADER_LEN;
     }
-    if (enc_buf) {
-        tal_free((void *)enc_buf);
+
+    return len;
+}
+
+/**
+ * @brief Waits until one more subpackage may be handed to the stack.
+ *
+ * Up to BLE_SEND_WINDOW subpackets are in flight, each notify tx event
+ * returns one. Until the stack has reported a notify tx event the window is
+ * one subpackage, so stacks without these events are paced by
+ * BLE_SEND_PACE_MS per subpackage as before. When no event comes in time the
+ * window is counted as sent.
+ */
+static void ble_send_credit_wait(tuya_ble_mgr_t *ble)
+{
+    uint8_t window = ble->tx_evt ? BLE_SEND_WINDOW : 1;
+
+    // collect the events already reported
+    while (ble->tx_inflight && OPRT_OK == tal_semaphore_wait(ble->tx_sem, 0)) {
+        ble->tx_inflight--;
+    }
+    if (ble->tx_inflight < window) {
+        return;
+    }
+
+    if (OPRT_OK == tal_semaphore_wait(ble->tx_sem, ble->tx_evt ? BLE_SEND_TX_TIMEOUT_MS : BLE_SEND_PACE_MS)) {
+        ble->tx_inflight--;
+        return;
     }
 
-    return OPRT_COM_ERROR;
+    // drop the events of the window given up on
+    ble->tx_inflight = 0;
+    while (OPRT_OK == tal_semaphore_wait(ble->tx_sem, 0)) {
+    }
+}
+
+static int ble_subpkg_send(tuya_ble_mgr_t *ble, TAL_BLE_DATA_T *ble_data)
+{
+    int rt = OPRT_OK;
+    int retry = 0;
+
+    for (;;) {
+        ble_send_credit_wait(ble);
+        rt = tal_ble_server_common_send(ble_data);
+        if (OPRT_OK == rt) {
+            ble->tx_inflight++;
+            return OPRT_OK;
+        }
+        if (++retry > BLE_SEND_RETRY) {
+            return rt;
+        }
+        // the stack queue is full, wait for it to drain
+        PR_DEBUG("ble send busy:%d, retry:%d", rt, retry);
+        ble->tx_inflight = BLE_SEND_WINDOW;
+    }
 }
 
 static int ble_packet_resp(tuya_ble_mgr_t *ble, ble_packet_t *resp)
 {
     int rt = OPRT_OK;
     uint8_t *pbuf = NULL;
-    ble_frame_trsmitr_t *trsmitr = NULL;
+    ble_frame_trsmitr_t trsmitr;
     uint8_t *outbuf = NULL;
     uint32_t outlen;
 
+    tal_mutex_lock(ble->send_mutex);
     TUYA_CALL_ERR_GOTO(ble_packet_encode(ble, resp, &outbuf, &outlen), __exit);
-    uint16_t buf_len = ble_frame_packet_len_get();
+    uint16_t buf_len = ble_send_subpkg_len(ble);
     rt = OPRT_MALLOC_FAILED;
-    TUYA_CHECK_NULL_GOTO(pbuf = (uint8_t *)tal_malloc(buf_len), __exit);
-    memset(pbuf, 0, buf_len);
-    TUYA_CHECK_NULL_GOTO(trsmitr = ble_frame_trsmitr_create(), __exit);
+    TUYA_CHECK_NULL_GOTO(pbuf = ble_frame_buf_get(buf_len), __exit);
+    memset(&trsmitr, 0, sizeof(trsmitr));
     do {
-        rt = ble_frame_trsmitr_send_pkg_encode(trsmitr, TUYA_BLE_PROTOCOL_VERSION_HIGN, outbuf, outlen);
+        // each subpackage is encoded straight into the buffer handed to the stack
+        rt = ble_frame_trsmitr_send_pkg_encode_to(&trsmitr, TUYA_BLE_PROTOCOL_VERSION_HIGN, outbuf, outlen, pbuf,
+                                                  buf_len);
         if (OPRT_OK != rt && OPRT_SVC_BT_API_TRSMITR_CONTINUE != rt) {
             PR_ERR("ble_send_data_to_app  pkg_encode error %d", rt);
             goto __exit;
         }
-        uint32_t send_len = ble_frame_subpacket_len_get(trsmitr);
-        memcpy((void *)pbuf, ble_frame_subpacket_get(trsmitr), send_len);
-        // tuya_ble_raw_print("ble trsmitr pbuf", 32, pbuf, send_len);
+        // tuya_ble_raw_print("ble trsmitr pbuf", 32, pbuf, ble_frame_subpacket_len_get(&trsmitr));
         TAL_BLE_DATA_T ble_data;
 
         ble_data.p_data = pbuf;
-        ble_data.len = send_len;
+        ble_data.len = ble_frame_subpacket_len_get(&trsmitr);
 
-        TUYA_CALL_ERR_GOTO(tal_ble_server_common_send(&ble_data), __exit);
-        tal_system_sleep(20);
+        int send_rt = ble_subpkg_send(ble, &ble_data);
+        if (OPRT_OK != send_rt) {
+            PR_ERR("ble subpackage send err:%d", send_rt);
+            rt = send_rt;
+            goto __exit;
+        }
     } while (rt == OPRT_SVC_BT_API_TRSMITR_CONTINUE);
 
-    PR_DEBUG("ble resp finish. len:%d, rt:0x%x", outlen, rt);
+    PR_DEBUG("ble resp finish. len:%d, subpkg:%d, rt:0x%x", outlen, buf_len, rt);
 
 __exit:
-    if (outbuf) {
-        tal_free((void *)outbuf);
-    }
-    if (pbuf) {
-        tal_free((void *)pbuf);
-    }
-    if (trsmitr) {
-        ble_frame_trsmitr_delete(trsmitr);
-    }
+    tal_mutex_unlock(ble->send_mutex);
+    ble_frame_buf_put(outbuf);
+    ble_frame_buf_put(pbuf);
 
     return rt;
 }
@@ -807,17 +897,6 @@ static int ble_dev_info_req(ble_packet_t *req, void *priv_data)
     // Gets the Bluetooth subcontract length from the protocol
     uint16_t pkg_len = (req->data[0] << 8 & 0xff00) + (req->data[1] & 0xff);
     ble_frame_packet_len_set(pkg_len);
-    ble_frame_trsmitr_t *trsmitr = ble->packet_recv->trsmitr;
-    if (trsmitr->subpkg) {
-        tal_free((void *)trsmitr->subpkg);
-        trsmitr->subpkg = NULL;
-    }
-    trsmitr->subpkg = (uint8_t *)tal_malloc(pkg_len);
-    if (trsmitr->subpkg == NULL) {
-        PR_ERR("malloc err:%d", pkg_len);
-        return OPRT_MALLOC_FAILED;
-    }
-    memset(trsmitr->subpkg, 0, pkg_len);
     PR_NOTICE("ble dev info: state:%d, pkg_len:%d", *ble->is_bound, ble_frame_packet_len_get());
 
     pbuf = (uint8_t *)tal_malloc(buf_len);
@@ -905,15 +984,25 @@ static void tal_ble_event_callback(void *data)
             memcpy((void *)&ble->peer_info, &msg->ble_event.connect.peer, sizeof(TAL_BLE_PEER_INFO_T));
             ble->recv_sn = 0;
             ble->send_sn = 1;
+            ble->att_mtu = 0;
             tal_sw_timer_start(ble->pair_timer, BLE_CONN_MONITOR_TIME, TAL_TIMER_ONCE);
-            PR_NOTICE("Ble Connected");
+            // the negotiated MTU is reported by TAL_BLE_EVT_MTU_REQUEST/RSP
+            OPERATE_RET mtu_rt = tal_ble_server_exchange_mtu_reply(ble->peer_info, BLE_ATT_MTU_MAX);
+            PR_NOTICE("Ble Connected, mtu exchange:%d", mtu_rt);
         } else {
             memset(&ble->peer_info, 0, sizeof(TAL_BLE_PEER_INFO_T));
         }
     } break;
 
+    case TAL_BLE_EVT_MTU_REQUEST:
+    case TAL_BLE_EVT_MTU_RSP: {
+        ble->att_mtu = msg->ble_event.exchange_mtu.mtu;
+        PR_NOTICE("ble mtu:%d, subpkg len:%d", ble->att_mtu, ble_send_subpkg_len(ble));
+    } break;
+
     case TAL_BLE_EVT_DISCONNECT: {
         memset(&ble->peer_info, 0x00, sizeof(TAL_BLE_PEER_INFO_T));
+        ble->att_mtu = 0;
         memset(ble->pair_rand, 0x00, sizeof(ble->pair_rand));
         tal_sw_timer_stop(ble->pair_timer);
         ble->is_paired = false;
@@ -946,7 +1035,6 @@ static void tal_ble_event_callback(void *data)
                     ble->session[i].function(&packet, ble->session[i].priv_data);
                 }
             }
-            tal_free((void *)packet.data);
         }
     } break;
 
@@ -995,6 +1083,13 @@ int tuya_ble_deinit(void)
     tuya_ble_session_del(BLE_SESSION_CHANNEL);
     tuya_ble_session_del(BLE_SESSION_DP);
     tal_ble_bt_deinit(ble->role);
+    ble_frame_buf_pool_deinit();
+    if (ble->tx_sem) {
+        tal_semaphore_release(ble->tx_sem);
+    }
+    if (ble->send_mutex) {
+        tal_mutex_release(ble->send_mutex);
+    }
     tal_free((void *)ble);
     s_ble_mgr = NULL;
 
@@ -1005,6 +1100,15 @@ static void tal_ble_event_on_worq(TAL_BLE_EVT_PARAMS_T *msg)
 {
     TAL_BLE_EVT_PARAMS_T *data;
 
+    // returned send credits are counted here, the sender may be holding the workqueue
+    if (TAL_BLE_EVT_NOTIFY_TX == msg->type) {
+        if (s_ble_mgr && s_ble_mgr->tx_sem) {
+            s_ble_mgr->tx_evt = true;
+            tal_semaphore_post(s_ble_mgr->tx_sem);
+        }
+        return;
+    }
+
     data = tal_malloc(sizeof(TAL_BLE_EVT_PARAMS_T));
     if (data) {
         memcpy((void *)data, (TAL_BLE_EVT_PARAMS_T *)msg, sizeof(TAL_BLE_EVT_PARAMS_T));
@@ -1048,6 +1152,9 @@ int tuya_ble_init(tuya_ble_cfg_t *cfg)
     }
     s_ble_mgr = ble;
     memcpy((void *)&ble->cfg, cfg, sizeof(tuya_ble_cfg_t));
+    TUYA_CALL_ERR_GOTO(ble_frame_buf_pool_init(), __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ble->tx_sem, 0, BLE_SEND_WINDOW), __exit);
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ble->send_mutex), __exit);
     ble->is_bound = &ble->cfg.client->is_activated;
     if (strlen(ble->cfg.client->config.uuid) >= 20) {
         tuya_ble_id_compress((uint8_t *)ble->cfg.client->config.uuid, ble->id);
@@ -0,0 +1,573 @@
+/**
+ * @file ble_perf.c
+ * @brief BLE provisioning and DP latency benchmark over the loopback link.
+ *
+ * The peer side of the benchmark is a minimal app: it builds, encrypts and
+ * subpackages its frames the way the device expects them and derives the
+ * session keys from the same device credentials, so the device runs its
+ * normal session without knowing it is talking to the same process.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tal_api.h"
+#include "tal_security.h"
+#include "tuya_iot.h"
+#include "ble_protocol.h"
+#include "ble_trsmitr.h"
+#include "ble_cryption.h"
+#include "ble_channel.h"
+#include "ble_perf.h"
+#include "crc_16.h"
+#include "uni_random.h"
+
+#if defined(ENABLE_BLE_LOOPBACK) && (ENABLE_BLE_LOOPBACK == 1)
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+// SN(4) + ACK_SN(4) + CMD(2) + LEN(2)
+#define BLE_PERF_FRAME_HEAD_LEN 12
+// head + CRC16(2)
+#define BLE_PERF_FRAME_MIN_LEN  (BLE_PERF_FRAME_HEAD_LEN + 2)
+
+#define BLE_PERF_ID_LEN   16
+#define BLE_PERF_KEY_LEN  16
+#define BLE_PERF_RESP_MAX 128
+
+// dp type and value length of a boolean, as in ble_dp.c
+#define BLE_PERF_DT_BOOL     1
+#define BLE_PERF_DT_BOOL_LEN 1
+
+// pair results of FRM_PAIR_REQ
+#define BLE_PERF_PAIR_OK       0
+#define BLE_PERF_PAIR_BOUND_OK 2
+
+// connect retry while the device starts advertising
+#define BLE_PERF_CONNECT_RETRY_MS 100
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    MUTEX_HANDLE mutex;
+    SEM_HANDLE sem;
+    const tuya_ble_perf_cfg_t *cfg;
+    bool bound;
+
+    /* keys of the session */
+    uint8_t id[BLE_PERF_ID_LEN];
+    uint8_t key11[BLE_PERF_KEY_LEN];
+    uint8_t key12[BLE_PERF_KEY_LEN];
+    uint8_t key14[BLE_PERF_KEY_LEN];
+    uint8_t key15[BLE_PERF_KEY_LEN];
+    uint32_t send_sn;
+
+    /* link state, written on the link thread */
+    uint16_t mtu;
+    bool mtu_done;
+    bool disconnected;
+
+    /* the response waited for */
+    uint16_t wait_type;
+    uint32_t wait_ack_sn;
+    bool wait_ack;
+    bool got;
+    uint8_t resp[BLE_PERF_RESP_MAX];
+    uint16_t resp_len;
+    SYS_TIME_T resp_time;
+
+    /* receive, only used on the link thread */
+    ble_frame_trsmitr_t trsmitr;
+    uint32_t raw_len;
+    uint8_t raw[TUYA_BLE_AIR_FRAME_MAX];
+
+    /* send, only used by the benchmark */
+    uint8_t tx[TUYA_BLE_AIR_FRAME_MAX];
+} ble_perf_peer_t;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint8_t *__peer_key(ble_perf_peer_t *peer, uint8_t mode)
+{
+    switch (mode) {
+    case ENCRYPTION_MODE_KEY_11:
+        return peer->key11;
+    case ENCRYPTION_MODE_KEY_12:
+        return peer->key12;
+    case ENCRYPTION_MODE_KEY_14:
+        return peer->key14;
+    case ENCRYPTION_MODE_SESSION_KEY15:
+        return peer->key15;
+    default:
+        return NULL;
+    }
+}
+
+static uint8_t __peer_mode(ble_perf_peer_t *peer, uint16_t type)
+{
+    if (FRM_QRY_DEV_INFO_REQ == type) {
+        return peer->bound ? ENCRYPTION_MODE_KEY_14 : ENCRYPTION_MODE_KEY_11;
+    }
+    return peer->bound ? ENCRYPTION_MODE_SESSION_KEY15 : ENCRYPTION_MODE_KEY_12;
+}
+
+static void __peer_keys_init(ble_perf_peer_t *peer, tuya_iot_client_t *client)
+{
+    uint8_t key_in[LOGIN_KEY_LEN_16 + SECRET_KEY_LEN];
+
+    if (strlen(client->config.uuid) >= 20) {
+        tuya_ble_id_compress((uint8_t *)client->config.uuid, peer->id);
+    } else {
+        memcpy(peer->id, client->config.uuid, BLE_PERF_ID_LEN);
+    }
+
+    //! KEY14 = md5(login key + secret key)
+    memcpy(key_in, client->activate.localkey, LOGIN_KEY_LEN_16);
+    memcpy(key_in + LOGIN_KEY_LEN_16, client->activate.seckey, SECRET_KEY_LEN);
+    tal_md5_ret(key_in, sizeof(key_in), peer->key14);
+}
+
+static void __peer_session_keys_init(ble_perf_peer_t *peer, tuya_iot_client_t *client, uint8_t *pair_rand)
+{
+    uint8_t key_in[LOGIN_KEY_LEN_16 + SECRET_KEY_LEN + PAIR_RANDOM_LEN];
+
+    //! KEY12 = md5(key11 + pair rand)
+    memcpy(key_in, peer->key11, BLE_PERF_KEY_LEN);
+    memcpy(key_in + BLE_PERF_KEY_LEN, pair_rand, PAIR_RANDOM_LEN);
+    tal_md5_ret(key_in, BLE_PERF_KEY_LEN + PAIR_RANDOM_LEN, peer->key12);
+
+    //! KEY15 = md5(login key + secret key + pair rand)
+    memcpy(key_in, client->activate.localkey, LOGIN_KEY_LEN_16);
+    memcpy(key_in + LOGIN_KEY_LEN_16, client->activate.seckey, SECRET_KEY_LEN);
+    memcpy(key_in + LOGIN_KEY_LEN_16 + SECRET_KEY_LEN, pair_rand, PAIR_RANDOM_LEN);
+    tal_md5_ret(key_in, sizeof(key_in), peer->key15);
+}
+
+static void __peer_frame_handle(ble_perf_peer_t *peer, uint8_t *raw, uint32_t raw_len)
+{
+    uint8_t iv[16];
+    uint8_t *key = __peer_key(peer, raw[0]);
+    uint8_t *frame = raw + TUYA_BLE_CRYPTION_HEAD_LEN;
+    uint32_t frame_len = raw_len - TUYA_BLE_CRYPTION_HEAD_LEN;
+
+    if (NULL == key || raw_len < TUYA_BLE_CRYPTION_HEAD_LEN + 16 || frame_len % 16) {
+        PR_ERR("ble perf frame dropped, mode:%d len:%d", raw[0], raw_len);
+        return;
+    }
+    memcpy(iv, raw + 1, sizeof(iv));
+    if (OPRT_OK != tal_aes128_cbc_decode_raw(frame, frame_len, key, iv, frame)) {
+        PR_ERR("ble perf frame decrypt err");
+        return;
+    }
+
+    uint16_t data_len = (frame[10] << 8) + frame[11];
+    if ((uint32_t)(BLE_PERF_FRAME_MIN_LEN + data_len) > frame_len) {
+        PR_ERR("ble perf frame len err:%d", data_len);
+        return;
+    }
+    uint16_t crc = (frame[BLE_PERF_FRAME_HEAD_LEN + data_len] << 8) + frame[BLE_PERF_FRAME_HEAD_LEN + data_len + 1];
+    if (crc != get_crc_16(frame, BLE_PERF_FRAME_HEAD_LEN + data_len)) {
+        PR_ERR("ble perf frame crc err");
+        return;
+    }
+    uint32_t ack_sn = ((uint32_t)frame[4] << 24) + (frame[5] << 16) + (frame[6] << 8) + frame[7];
+    uint16_t type = (frame[8] << 8) + frame[9];
+
+    tal_mutex_lock(peer->mutex);
+    if (!peer->got && type == peer->wait_type && (!peer->wait_ack || ack_sn == peer->wait_ack_sn)) {
+        peer->resp_time = tal_system_get_millisecond();
+        peer->resp_len = data_len > BLE_PERF_RESP_MAX ? BLE_PERF_RESP_MAX : data_len;
+        memcpy(peer->resp, frame + BLE_PERF_FRAME_HEAD_LEN, peer->resp_len);
+        peer->got = true;
+        tal_semaphore_post(peer->sem);
+    }
+    tal_mutex_unlock(peer->mutex);
+}
+
+static void __peer_recv(ble_perf_peer_t *peer, uint8_t *data, uint16_t len)
+{
+    int rt = ble_frame_trsmitr_recv_pkg_decode(&peer->trsmitr, data, len);
+    if (OPRT_OK != rt && OPRT_SVC_BT_API_TRSMITR_CONTINUE != rt) {
+        peer->raw_len = 0;
+        return;
+    }
+    if (BLE_FRAME_PKG_FIRST == peer->trsmitr.pkg_desc ||
+        (BLE_FRAME_PKG_END == peer->trsmitr.pkg_desc && 0 == peer->trsmitr.subpkg_num)) {
+        peer->raw_len = 0;
+    }
+
+    uint32_t subpkg_len = ble_frame_subpacket_len_get(&peer->trsmitr);
+    if (peer->raw_len + subpkg_len > TUYA_BLE_AIR_FRAME_MAX) {
+        PR_ERR("ble perf unpack overflow");
+        peer->raw_len = 0;
+        return;
+    }
+    memcpy(peer->raw + peer->raw_len, ble_frame_subpacket_get(&peer->trsmitr), subpkg_len);
+    peer->raw_len += subpkg_len;
+
+    if (OPRT_OK == rt) {
+        __peer_frame_handle(peer, peer->raw, peer->raw_len);
+        peer->raw_len = 0;
+    }
+}
+
+static void __peer_event_cb(TKL_BLE_LOOPBACK_EVT_E evt, uint8_t *data, uint16_t len, void *arg)
+{
+    ble_perf_peer_t *peer = (ble_perf_peer_t *)arg;
+
+    switch (evt) {
+    case TKL_BLE_LOOPBACK_EVT_MTU:
+        tal_mutex_lock(peer->mutex);
+        peer->mtu = len;
+        peer->mtu_done = true;
+        tal_mutex_unlock(peer->mutex);
+        tal_semaphore_post(peer->sem);
+        break;
+
+    case TKL_BLE_LOOPBACK_EVT_NOTIFY:
+        __peer_recv(peer, data, len);
+        break;
+
+    case TKL_BLE_LOOPBACK_EVT_DISCONNECTED:
+        PR_NOTICE("ble perf disconnected, reason:0x%02x", len);
+        tal_mutex_lock(peer->mutex);
+        peer->disconnected = true;
+        tal_mutex_unlock(peer->mutex);
+        tal_semaphore_post(peer->sem);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Waits until the flag is set by the link thread.
+ */
+static int __peer_wait(ble_perf_peer_t *peer, bool *flag)
+{
+    bool done, disconnected;
+    SYS_TIME_T now = tal_system_get_millisecond();
+    SYS_TIME_T deadline = now + peer->cfg->timeout_ms;
+
+    for (;;) {
+        tal_mutex_lock(peer->mutex);
+        done = *flag;
+        disconnected = peer->disconnected;
+        tal_mutex_unlock(peer->mutex);
+        if (done) {
+            return OPRT_OK;
+        }
+        if (disconnected) {
+            return OPRT_COM_ERROR;
+        }
+        now = tal_system_get_millisecond();
+        if (now >= deadline) {
+            return OPRT_TIMEOUT;
+        }
+        tal_semaphore_wait(peer->sem, deadline - now);
+    }
+}
+
+/**
+ * @brief Subpackages a frame to the ATT payload and writes it, waiting while
+ * the link queue is full.
+ */
+static int __peer_write(ble_perf_peer_t *peer, uint8_t *buf, uint32_t len)
+{
+    int rt, result;
+    ble_frame_trsmitr_t trsmitr;
+    uint8_t subpkg[TKL_BLE_LOOPBACK_MTU_MAX];
+    SYS_TIME_T deadline = tal_system_get_millisecond() + peer->cfg->timeout_ms;
+
+    memset(&trsmitr, 0, sizeof(trsmitr));
+    do {
+        rt = ble_frame_trsmitr_send_pkg_encode_to(&trsmitr, TUYA_BLE_PROTOCOL_VERSION_HIGN, buf, len, subpkg,
+                                                  peer->mtu - 3);
+        if (OPRT_OK != rt && OPRT_SVC_BT_API_TRSMITR_CONTINUE != rt) {
+            return rt;
+        }
+        while (OPRT_OS_ADAPTER_BLE_BUSY == (result = tkl_ble_loopback_write(subpkg, trsmitr.subpkg_len))) {
+            if (tal_system_get_millisecond() >= deadline) {
+                return OPRT_TIMEOUT;
+            }
+            tal_system_sleep(peer->cfg->link.conn_interval_ms);
+        }
+        if (OPRT_OK != result) {
+            return result;
+        }
+    } while (OPRT_SVC_BT_API_TRSMITR_CONTINUE == rt);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Builds, encrypts and writes one frame.
+ */
+static int __peer_send(ble_perf_peer_t *peer, uint16_t type, const uint8_t *data, uint16_t len)
+{
+    uint8_t iv[16];
+    uint8_t mode = __peer_mode(peer, type);
+    uint8_t *frame = &peer->tx[TUYA_BLE_CRYPTION_HEAD_LEN];
+    uint32_t frame_len = 0;
+    uint32_t enc_len = BLE_PERF_FRAME_MIN_LEN + len;
+
+    if (enc_len % 16) {
+        enc_len += 16 - enc_len % 16;
+    }
+    if (TUYA_BLE_CRYPTION_HEAD_LEN + enc_len > TUYA_BLE_AIR_FRAME_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    uint32_t sn = peer->send_sn++;
+    //! SN
+    frame[frame_len++] = sn >> 24;
+    frame[frame_len++] = sn >> 16;
+    frame[frame_len++] = sn >> 8;
+    frame[frame_len++] = sn;
+    //! ACK_SN, the app does not ack
+    memset(&frame[frame_len], 0, 4);
+    frame_len += 4;
+    //! CMD
+    frame[frame_len++] = type >> 8;
+    frame[frame_len++] = type;
+    //! LEN
+    frame[frame_len++] = len >> 8;
+    frame[frame_len++] = len;
+    //! DATA
+    if (len) {
+        memcpy(&frame[frame_len], data, len);
+        frame_len += len;
+    }
+    //! CRC16
+    uint16_t crc = get_crc_16(frame, frame_len);
+    frame[frame_len++] = crc >> 8;
+    frame[frame_len++] = crc;
+    //! PKCS padding
+    while (frame_len < enc_len) {
+        frame[frame_len++] = enc_len - BLE_PERF_FRAME_MIN_LEN - len;
+    }
+
+    peer->tx[0] = mode;
+    uni_random_bytes(&peer->tx[1], sizeof(iv));
+    if (ENCRYPTION_MODE_KEY_11 == mode) {
+        //! KEY11 = md5(auth key + id + iv), the device takes the iv as the server rand
+        uint8_t key_in[AUTH_KEY_LEN + BLE_PERF_ID_LEN + 16];
+        memcpy(key_in, tuya_iot_client_get()->config.authkey, AUTH_KEY_LEN);
+        memcpy(key_in + AUTH_KEY_LEN, peer->id, BLE_PERF_ID_LEN);
+        memcpy(key_in + AUTH_KEY_LEN + BLE_PERF_ID_LEN, &peer->tx[1], 16);
+        tal_md5_ret(key_in, sizeof(key_in), peer->key11);
+    }
+    // the iv is updated by the cipher
+    memcpy(iv, &peer->tx[1], sizeof(iv));
+    if (OPRT_OK != tal_aes128_cbc_encode_raw(frame, enc_len, __peer_key(peer, mode), iv, frame)) {
+        PR_ERR("ble perf frame encrypt err");
+        return OPRT_COM_ERROR;
+    }
+
+    return __peer_write(peer, peer->tx, TUYA_BLE_CRYPTION_HEAD_LEN + enc_len);
+}
+
+/**
+ * @brief Sends a request and waits for the response of resp_type. A response
+ * of the same type must ack the request.
+ */
+static int __peer_request(ble_perf_peer_t *peer, uint16_t type, const uint8_t *data, uint16_t len,
+                          uint16_t resp_type)
+{
+    int rt = OPRT_OK;
+
+    tal_mutex_lock(peer->mutex);
+    peer->wait_type = resp_type;
+    peer->wait_ack = (resp_type == type);
+    peer->wait_ack_sn = peer->send_sn;
+    peer->got = false;
+    tal_mutex_unlock(peer->mutex);
+
+    TUYA_CALL_ERR_RETURN(__peer_send(peer, type, data, len));
+    rt = __peer_wait(peer, &peer->got);
+    if (OPRT_OK != rt) {
+        PR_ERR("ble perf no response to 0x%04x, rt:%d", type, rt);
+    }
+
+    return rt;
+}
+
+static int __perf_session(ble_perf_peer_t *peer, tuya_iot_client_t *client, tuya_ble_perf_result_t *res)
+{
+    int rt = OPRT_OK;
+    SYS_TIME_T start, sent;
+    uint8_t buf[BLE_PERF_ID_LEN];
+    uint32_t rtt, rtt_sum = 0;
+
+    // the device may still be starting to advertise
+    SYS_TIME_T deadline = tal_system_get_millisecond() + peer->cfg->timeout_ms;
+    while (OPRT_OK != (rt = tkl_ble_loopback_connect())) {
+        if (tal_system_get_millisecond() >= deadline) {
+            PR_ERR("ble perf connect err:%d, is the device advertising?", rt);
+            return rt;
+        }
+        tal_system_sleep(BLE_PERF_CONNECT_RETRY_MS);
+    }
+    start = tal_system_get_millisecond();
+
+    //! MTU, started by the device on connect
+    if (OPRT_OK != __peer_wait(peer, &peer->mtu_done)) {
+        PR_WARN("ble perf no mtu exchange");
+        peer->mtu = tkl_ble_loopback_mtu_get();
+    }
+    res->mtu = peer->mtu;
+    res->mtu_ms = tal_system_get_millisecond() - start;
+
+    //! device info, the subpackage length follows the MTU
+    uint16_t pkg_len = peer->mtu - 3;
+    buf[0] = pkg_len >> 8;
+    buf[1] = pkg_len;
+    TUYA_CALL_ERR_RETURN(__peer_request(peer, FRM_QRY_DEV_INFO_REQ, buf, 2, FRM_QRY_DEV_INFO_REQ));
+    if (peer->resp_len < 6 + PAIR_RANDOM_LEN) {
+        PR_ERR("ble perf dev info len err:%d", peer->resp_len);
+        return OPRT_COM_ERROR;
+    }
+    __peer_session_keys_init(peer, client, &peer->resp[6]);
+
+    //! pair
+    memcpy(buf, peer->id, BLE_PERF_ID_LEN);
+    TUYA_CALL_ERR_RETURN(__peer_request(peer, FRM_PAIR_REQ, buf, BLE_PERF_ID_LEN, FRM_PAIR_REQ));
+    if (BLE_PERF_PAIR_OK != peer->resp[0] && BLE_PERF_PAIR_BOUND_OK != peer->resp[0]) {
+        PR_ERR("ble perf pair err:%d", peer->resp[0]);
+        return OPRT_COM_ERROR;
+    }
+    res->pair_ms = peer->resp_time - start;
+    res->provision_ms = res->pair_ms;
+
+    //! network config, answered on the transparent uplink
+    if (peer->cfg->netcfg) {
+        uint32_t json_len = strlen(peer->cfg->netcfg) + 1;
+        if (4 + json_len > TUYA_BLE_TRANSMISSION_MAX_DATA_LEN) {
+            return OPRT_INVALID_PARM;
+        }
+        uint8_t *netcfg = tal_malloc(4 + json_len);
+        if (NULL == netcfg) {
+            return OPRT_MALLOC_FAILED;
+        }
+        netcfg[0] = 0x00; // not subpacket
+        netcfg[1] = 0x00;
+        netcfg[2] = BLE_CHANNLE_NETCFG >> 8;
+        netcfg[3] = BLE_CHANNLE_NETCFG & 0xff;
+        memcpy(&netcfg[4], peer->cfg->netcfg, json_len);
+        rt = __peer_request(peer, FRM_DOWNLINK_TRANSPARENT_REQ, netcfg, 4 + json_len, FRM_UPLINK_TRANSPARENT_REQ);
+        tal_free(netcfg);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+        if (peer->resp_len < 5 || FRM_DATA_TRANS_SUBCMD_BT_NETCFG != peer->resp[3] || 0 != peer->resp[4]) {
+            PR_ERR("ble perf netcfg err:%d", peer->resp_len < 5 ? -1 : peer->resp[4]);
+            return OPRT_COM_ERROR;
+        }
+        res->provision_ms = peer->resp_time - start;
+    }
+
+    //! DP round trips, timed to the ack of the device
+    uint8_t dp[5 + 4 + BLE_PERF_DT_BOOL_LEN];
+    uint16_t i;
+    for (i = 0; i < peer->cfg->dp_rounds; i++) {
+        dp[0] = 0; // version
+        dp[1] = i >> 24;
+        dp[2] = i >> 16;
+        dp[3] = i >> 8;
+        dp[4] = i;
+        dp[5] = peer->cfg->dp_id;
+        dp[6] = BLE_PERF_DT_BOOL;
+        dp[7] = 0;
+        dp[8] = BLE_PERF_DT_BOOL_LEN;
+        dp[9] = i & 0x01;
+        sent = tal_system_get_millisecond();
+        TUYA_CALL_ERR_RETURN(__peer_request(peer, FRM_DP_CMD_SEND_V4, dp, sizeof(dp), FRM_DP_CMD_SEND_V4));
+        rtt = peer->resp_time - sent;
+        if (0 == res->dp_rounds || rtt < res->dp_rtt_min_ms) {
+            res->dp_rtt_min_ms = rtt;
+        }
+        if (rtt > res->dp_rtt_max_ms) {
+            res->dp_rtt_max_ms = rtt;
+        }
+        rtt_sum += rtt;
+        res->dp_rounds++;
+        res->dp_rtt_avg_ms = rtt_sum / res->dp_rounds;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Runs the benchmark once and prints the result through the log.
+ *
+ * @param[in] cfg The benchmark config.
+ * @param[out] result The measured times, may be NULL.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_ble_perf_test(const tuya_ble_perf_cfg_t *cfg, tuya_ble_perf_result_t *result)
+{
+    int rt = OPRT_OK;
+    ble_perf_peer_t *peer = NULL;
+    tuya_ble_perf_result_t res;
+    tuya_iot_client_t *client = tuya_iot_client_get();
+
+    if (NULL == cfg || NULL == client || 0 == cfg->timeout_ms || NULL == client->config.uuid ||
+        NULL == client->config.authkey) {
+        return OPRT_INVALID_PARM;
+    }
+
+    peer = (ble_perf_peer_t *)tal_malloc(sizeof(ble_perf_peer_t));
+    if (NULL == peer) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(peer, 0, sizeof(ble_perf_peer_t));
+    memset(&res, 0, sizeof(res));
+    peer->cfg = cfg;
+    peer->bound = client->is_activated;
+    peer->send_sn = 1;
+    peer->mtu = TKL_BLE_LOOPBACK_MTU_MIN;
+    __peer_keys_init(peer, client);
+
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&peer->mutex), __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&peer->sem, 0, 1), __exit);
+    TUYA_CALL_ERR_GOTO(tkl_ble_loopback_config(&cfg->link), __exit);
+    TUYA_CALL_ERR_GOTO(tkl_ble_loopback_peer_register(__peer_event_cb, peer), __exit);
+
+    rt = __perf_session(peer, client, &res);
+    tkl_ble_loopback_stat_get(&res.link);
+    tkl_ble_loopback_disconnect();
+    tkl_ble_loopback_peer_register(NULL, NULL);
+    // let a delivery in flight on the link thread finish before the peer is freed
+    tal_system_sleep(2 * cfg->link.conn_interval_ms);
+
+    PR_NOTICE("ble perf %s, interval:%dms latency:%dms loss:%d%% mtu:%d", OPRT_OK == rt ? "done" : "failed",
+              cfg->link.conn_interval_ms, cfg->link.latency_ms, cfg->link.loss_percent, res.mtu);
+    PR_NOTICE("ble perf mtu:%dms pair:%dms provision:%dms", res.mtu_ms, res.pair_ms, res.provision_ms);
+    PR_NOTICE("ble perf dp rounds:%d rtt min:%dms avg:%dms max:%dms", res.dp_rounds, res.dp_rtt_min_ms,
+              res.dp_rtt_avg_ms, res.dp_rtt_max_ms);
+    PR_NOTICE("ble perf link write:%d/%dB notify:%d/%dB busy:%d retrans:%d events:%d", res.link.write_pkts,
+              res.link.write_bytes, res.link.notify_pkts, res.link.notify_bytes, res.link.notify_busy,
+              res.link.retrans, res.link.conn_events);
+
+    if (result) {
+        *result = res;
+    }
+
+__exit:
+    if (peer->sem) {
+        tal_semaphore_release(peer->sem);
+    }
+    if (peer->mutex) {
+        tal_mutex_release(peer->mutex);
+    }
+    tal_free(peer);
+
+    return rt;
+}
+
+#endif
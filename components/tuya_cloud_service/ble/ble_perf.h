@@ -0,0 +1,67 @@
+/**
+ * @file ble_perf.h
+ * @brief BLE provisioning and DP latency benchmark over the loopback link.
+ *
+ * The benchmark plays the app on the peer side of the loopback BLE link: it
+ * connects to the advertising device, waits for the MTU exchange, queries the
+ * device info, pairs, optionally sends the network config and then measures
+ * DP command round trips. Every frame goes through the real ble_mgr path,
+ * subpackaging, encryption and the tal_bluetooth layer, only the radio is
+ * emulated. Only available with ENABLE_BLE_LOOPBACK.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __BLE_PERF_H__
+#define __BLE_PERF_H__
+
+#include "tuya_cloud_types.h"
+
+#if defined(ENABLE_BLE_LOOPBACK) && (ENABLE_BLE_LOOPBACK == 1)
+#include "tkl_ble_loopback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    TKL_BLE_LOOPBACK_CFG_T link; // link model
+    uint16_t dp_rounds;          // DP command round trips after pairing, 0 skips them
+    uint8_t dp_id;               // boolean DP the round trips set
+    const char *netcfg;          // JSON with ssid, pwd and token sent after pairing, NULL skips it
+    uint32_t timeout_ms;         // longest wait for the device in each step
+} tuya_ble_perf_cfg_t;
+
+typedef struct {
+    uint16_t mtu;           // ATT MTU of the link
+    uint32_t mtu_ms;        // connect to the settled MTU
+    uint32_t pair_ms;       // connect to the pair response
+    uint32_t provision_ms;  // connect to the network config response, pair_ms without netcfg
+    uint16_t dp_rounds;     // DP commands answered
+    uint32_t dp_rtt_min_ms; // DP command to its response
+    uint32_t dp_rtt_avg_ms;
+    uint32_t dp_rtt_max_ms;
+    TKL_BLE_LOOPBACK_STAT_T link; // link counters of the run
+} tuya_ble_perf_result_t;
+
+/**
+ * @brief Runs the benchmark once and prints the result through the log.
+ *
+ * The device must be advertising, i.e. tuya_ble_init() is done and the
+ * device is not connected to the cloud. It blocks, so it must not be called
+ * from the workqueue the BLE events are handled on.
+ *
+ * @param[in] cfg The benchmark config.
+ * @param[out] result The measured times, may be NULL.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_ble_perf_test(const tuya_ble_perf_cfg_t *cfg, tuya_ble_perf_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#endif
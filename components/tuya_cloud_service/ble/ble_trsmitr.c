@@ -23,18 +23,156 @@
 /***********************************************************
 *************************variable define********************
 ***********************************************************/
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    bool busy;
+} ble_frame_buf_t;
+
 static ble_frame_seq_t s_ble_frame_seq = 0;
 static uint16_t s_ble_frame_packet_len = 1024;
+static MUTEX_HANDLE s_ble_frame_buf_mutex = NULL;
+static ble_frame_buf_t s_ble_frame_buf[BLE_FRAME_BUF_POOL_NUM];
 
 /***********************************************************
 *************************function define********************
 ***********************************************************/
+/**
+ * @brief Initializes the subpackage buffer pool.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int ble_frame_buf_pool_init(void)
+{
+    if (s_ble_frame_buf_mutex) {
+        return OPRT_OK;
+    }
+    memset(s_ble_frame_buf, 0, sizeof(s_ble_frame_buf));
+
+    return tal_mutex_create_init(&s_ble_frame_buf_mutex);
+}
+
+/**
+ * @brief Frees the idle buffers of the subpackage buffer pool.
+ *
+ * Buffers still in use are detached from the pool, ble_frame_buf_put() frees
+ * them when they are put back.
+ */
+void ble_frame_buf_pool_deinit(void)
+{
+    int i;
+
+    if (NULL == s_ble_frame_buf_mutex) {
+        return;
+    }
+    tal_mutex_lock(s_ble_frame_buf_mutex);
+    for (i = 0; i < BLE_FRAME_BUF_POOL_NUM; i++) {
+        if (!s_ble_frame_buf[i].busy && s_ble_frame_buf[i].buf) {
+            tal_free((void *)s_ble_frame_buf[i].buf);
+        }
+    }
+    memset(s_ble_frame_buf, 0, sizeof(s_ble_frame_buf));
+    tal_mutex_unlock(s_ble_frame_buf_mutex);
+    tal_mutex_release(s_ble_frame_buf_mutex);
+    s_ble_frame_buf_mutex = NULL;
+}
+
+/**
+ * @brief Gets a buffer of at least size bytes from the subpackage buffer pool.
+ *
+ * The smallest idle buffer that fits is reused. Otherwise an idle slot is
+ * refilled with a new buffer, and when every slot is busy, or the pool is not
+ * initialized, the buffer is allocated outside the pool.
+ *
+ * @param size The required buffer size.
+ * @return The buffer, or NULL if memory allocation fails.
+ */
+uint8_t *ble_frame_buf_get(uint32_t size)
+{
+    int i;
+    ble_frame_buf_t *fit = NULL;
+    ble_frame_buf_t *idle = NULL;
+    uint8_t *buf = NULL;
+
+    if (NULL == s_ble_frame_buf_mutex) {
+        return (uint8_t *)tal_malloc(size);
+    }
+
+    tal_mutex_lock(s_ble_frame_buf_mutex);
+    for (i = 0; i < BLE_FRAME_BUF_POOL_NUM; i++) {
+        ble_frame_buf_t *slot = &s_ble_frame_buf[i];
+        if (slot->busy) {
+            continue;
+        }
+        if (slot->buf && slot->size >= size) {
+            if (NULL == fit || slot->size < fit->size) {
+                fit = slot;
+            }
+        } else if (NULL == idle || (idle->buf && (NULL == slot->buf || slot->size < idle->size))) {
+            // prefer an empty slot, then the smallest buffer
+            idle = slot;
+        }
+    }
+
+    if (NULL == fit && idle) {
+        buf = (uint8_t *)tal_malloc(size);
+        if (buf) {
+            if (idle->buf) {
+                tal_free((void *)idle->buf);
+            }
+            idle->buf = buf;
+            idle->size = size;
+            fit = idle;
+        }
+    }
+
+    if (fit) {
+        fit->busy = true;
+        buf = fit->buf;
+    }
+    tal_mutex_unlock(s_ble_frame_buf_mutex);
+
+    if (NULL == buf) {
+        buf = (uint8_t *)tal_malloc(size);
+    }
+
+    return buf;
+}
+
+/**
+ * @brief Puts a buffer got by ble_frame_buf_get() back into the pool.
+ *
+ * @param buf The buffer, NULL is ignored.
+ */
+void ble_frame_buf_put(uint8_t *buf)
+{
+    int i;
+
+    if (NULL == buf) {
+        return;
+    }
+
+    if (s_ble_frame_buf_mutex) {
+        tal_mutex_lock(s_ble_frame_buf_mutex);
+        for (i = 0; i < BLE_FRAME_BUF_POOL_NUM; i++) {
+            if (s_ble_frame_buf[i].buf == buf) {
+                s_ble_frame_buf[i].busy = false;
+                tal_mutex_unlock(s_ble_frame_buf_mutex);
+                return;
+            }
+        }
+        tal_mutex_unlock(s_ble_frame_buf_mutex);
+    }
+
+    tal_free((void *)buf);
+}
+
 /**
  * @brief Creates a new instance of the ble_frame_trsmitr_t structure.
  *
  * This function allocates memory for the ble_frame_trsmitr_t structure and
- * initializes its members. It also allocates memory for the subpkg member based
- * on the value returned by ble_frame_packet_len_get().
+ * initializes its members. The subpackage buffer is taken from the buffer pool
+ * by ble_frame_trsmitr_send_pkg_encode() when a package is sent.
  *
  * @return A pointer to the newly created ble_frame_trsmitr_t structure, or NULL
  * if memory allocation fails.
@@ -47,13 +185,6 @@ ble_frame_trsmitr_t *ble_frame_trsmitr_create(void)
         return NULL;
     }
     memset(trsmitr, 0, sizeof(ble_frame_trsmitr_t));
-    trsmitr->subpkg = (uint8_t *)tal_malloc(ble_frame_packet_len_get());
-    if (trsmitr->subpkg == NULL) {
-        PR_ERR("malloc err:%d", ble_frame_packet_len_get());
-        tal_free((void *)trsmitr);
-        return NULL;
-    }
-    memset(trsmitr->subpkg, 0, ble_frame_packet_len_get());
 
     return trsmitr;
 }
@@ -61,14 +192,14 @@ ble_frame_trsmitr_t *ble_frame_trsmitr_create(void)
 /**
  * @brief Deletes a BLE frame transmitter.
  *
- * This function frees the memory allocated for a BLE frame transmitter and its
- * subpackage.
+ * This function frees the memory allocated for a BLE frame transmitter and
+ * puts its subpackage buffer back into the pool.
  *
  * @param trsmitr Pointer to the BLE frame transmitter to be deleted.
  */
 void ble_frame_trsmitr_delete(ble_frame_trsmitr_t *trsmitr)
 {
-    tal_free((void *)trsmitr->subpkg);
+    ble_frame_buf_put(trsmitr->subpkg);
     tal_free((void *)trsmitr);
 }
 
@@ -122,7 +253,7 @@ void ble_frame_packet_len_set(uint16_t len)
  */
 unsigned char *ble_frame_subpacket_get(ble_frame_trsmitr_t *trsmitr)
 {
-    return trsmitr->subpkg;
+    return trsmitr->subpkg_data;
 }
 
 static ble_frame_seq_t ble_frame_seq_get(void)
@@ -130,27 +261,49 @@ static ble_frame_seq_t ble_frame_seq_get(void)
     return (s_ble_frame_seq >= BLE_FRAME_SEQ_LMT) ? 0 : s_ble_frame_seq++;
 }
 
+static int ble_frame_len_encode(uint8_t *out, uint32_t value)
+{
+    int i;
+    int offset = 0;
+
+    for (i = 0; i < 4; i++) {
+        out[offset] = value % 0x80;
+        if ((value / 0x80)) {
+            out[offset] |= 0x80;
+        }
+        offset++;
+        value /= 0x80;
+        if (0 == value) {
+            break;
+        }
+    }
+
+    return offset;
+}
+
 /**
- * @brief Encodes and sends a package over BLE.
+ * @brief Encodes the next subpackage of a package straight into a caller
+ * buffer.
  *
- * This function encodes and sends a package over BLE. It takes the version,
- * buffer, and length of the package as input parameters. The function also
- * updates the package descriptor, subpackage number, and package transmission
- * count.
+ * The subpackage number, and for the first subpackage the frame length and
+ * version/seq byte, are written at the start of out and followed by as much
+ * package data as fits, so each subpackage is built where it is sent from.
  *
  * @param trsmitr Pointer to the ble_frame_trsmitr_t structure.
  * @param version The version of the package.
  * @param buf Pointer to the buffer containing the package data.
  * @param len The length of the package data.
- * @return Returns OPRT_INVALID_PARM if trsmitr is NULL, OPRT_COM_ERROR if the
- * subpackage number or length exceeds the limit,
- *         OPRT_SVC_BT_API_TRSMITR_CONTINUE if there are more subpackages to
+ * @param out The buffer the subpackage is written into.
+ * @param out_size The size of out.
+ * @return Returns OPRT_INVALID_PARM if a parameter is invalid or out cannot
+ * hold any data, OPRT_COM_ERROR if the subpackage number or length exceeds the
+ * limit, OPRT_SVC_BT_API_TRSMITR_CONTINUE if there are more subpackages to
  * send, or OPRT_OK if the package transmission is complete.
  */
-int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned char version, unsigned char *buf,
-                                      unsigned int len)
+int ble_frame_trsmitr_send_pkg_encode_to(ble_frame_trsmitr_t *trsmitr, uint8_t version, uint8_t *buf, uint32_t len,
+                                         uint8_t *out, uint32_t out_size)
 {
-    if (((void *)0) == trsmitr) {
+    if (NULL == trsmitr || NULL == out) {
         return OPRT_INVALID_PARM;
     }
 
@@ -166,54 +319,39 @@ int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned cha
         return OPRT_COM_ERROR;
     }
 
-    unsigned char sunpkg_offset = 0;
+    uint32_t pkg_max = ble_frame_packet_len_get();
+    if (out_size < pkg_max) {
+        pkg_max = out_size;
+    }
+    if (pkg_max <= BLE_FRAME_SUBPKG_HEAD_MAX) {
+        return OPRT_INVALID_PARM;
+    }
 
     // package code
     // subpackage num encode
-    int i;
-    unsigned int tmp = 0;
-    tmp = trsmitr->subpkg_num;
-    for (i = 0; i < 4; i++) {
-        trsmitr->subpkg[sunpkg_offset] = tmp % 0x80;
-        if ((tmp / 0x80)) {
-            trsmitr->subpkg[sunpkg_offset] |= 0x80;
-        }
-        sunpkg_offset++;
-        tmp /= 0x80;
-        if (0 == tmp) {
-            break;
-        }
-    }
+    uint32_t sunpkg_offset = ble_frame_len_encode(out, trsmitr->subpkg_num);
 
     // the first package include the frame total len
     if (0 == trsmitr->subpkg_num) {
         // frame len encode
-        tmp = len;
-        for (i = 0; i < 4; i++) {
-            trsmitr->subpkg[sunpkg_offset] = tmp % 0x80;
-            if ((tmp / 0x80)) {
-                trsmitr->subpkg[sunpkg_offset] |= 0x80;
-            }
-            sunpkg_offset++;
-            tmp /= 0x80;
-            if (0 == tmp) {
-                break;
-            }
-        }
+        sunpkg_offset += ble_frame_len_encode(&out[sunpkg_offset], len);
 
         // frame type and frame seq
-        trsmitr->subpkg[sunpkg_offset++] = (trsmitr->version << 0x04) | (trsmitr->seq & 0x0f);
+        out[sunpkg_offset++] = (trsmitr->version << 0x04) | (trsmitr->seq & 0x0f);
     }
 
     // frame data transfer
-    uint16_t send_data = (ble_frame_packet_len_get() - sunpkg_offset);
+    uint32_t send_data = pkg_max - sunpkg_offset;
     if ((len - trsmitr->pkg_trsmitr_cnt) < send_data) {
         send_data = len - trsmitr->pkg_trsmitr_cnt;
     }
 
-    PR_TRACE("pkg max len:%d, sunpkg_offset:%d, send_data:%d", ble_frame_packet_len_get(), sunpkg_offset, send_data);
+    PR_TRACE("pkg max len:%d, sunpkg_offset:%d, send_data:%d", pkg_max, sunpkg_offset, send_data);
 
-    memcpy((void *)&(trsmitr->subpkg[sunpkg_offset]), buf + trsmitr->pkg_trsmitr_cnt, send_data);
+    if (send_data) {
+        memcpy((void *)&out[sunpkg_offset], buf + trsmitr->pkg_trsmitr_cnt, send_data);
+    }
+    trsmitr->subpkg_data = out;
     trsmitr->subpkg_len = sunpkg_offset + send_data;
 
     trsmitr->pkg_trsmitr_cnt += send_data;
@@ -232,6 +370,45 @@ int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned cha
     return OPRT_OK;
 }
 
+/**
+ * @brief Encodes and sends a package over BLE.
+ *
+ * This function encodes and sends a package over BLE. It takes the version,
+ * buffer, and length of the package as input parameters. The function also
+ * updates the package descriptor, subpackage number, and package transmission
+ * count. The subpackage is built in the transmitter buffer, which is taken
+ * from the buffer pool at the start of each package.
+ *
+ * @param trsmitr Pointer to the ble_frame_trsmitr_t structure.
+ * @param version The version of the package.
+ * @param buf Pointer to the buffer containing the package data.
+ * @param len The length of the package data.
+ * @return Returns OPRT_INVALID_PARM if trsmitr is NULL, OPRT_COM_ERROR if the
+ * subpackage number or length exceeds the limit,
+ *         OPRT_SVC_BT_API_TRSMITR_CONTINUE if there are more subpackages to
+ * send, or OPRT_OK if the package transmission is complete.
+ */
+int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned char version, unsigned char *buf,
+                                      unsigned int len)
+{
+    if (((void *)0) == trsmitr) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // the packet length may have changed since the last package
+    if (BLE_FRAME_PKG_INIT == trsmitr->pkg_desc || NULL == trsmitr->subpkg) {
+        ble_frame_buf_put(trsmitr->subpkg);
+        trsmitr->subpkg = ble_frame_buf_get(ble_frame_packet_len_get());
+        if (NULL == trsmitr->subpkg) {
+            PR_ERR("malloc err:%d", ble_frame_packet_len_get());
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+
+    return ble_frame_trsmitr_send_pkg_encode_to(trsmitr, version, buf, len, trsmitr->subpkg,
+                                                ble_frame_packet_len_get());
+}
+
 /**
  * @brief Decodes the received package and updates the ble_frame_trsmitr_t
  * structure.
@@ -239,8 +416,9 @@ int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned cha
  * This function decodes the received package data and updates the fields of the
  * ble_frame_trsmitr_t structure. It checks for invalid parameters and validates
  * the subpackage number and package description. It also decodes the frame
- * length, frame type, and frame sequence. Finally, it copies the decoded data
- * to the transmitter subpackage buffer and updates the package transmit count.
+ * length, frame type, and frame sequence. Finally, it points the transmitter
+ * subpackage at the payload inside raw_data, without copying it, and updates
+ * the package transmit count.
  *
  * @param trsmitr Pointer to the ble_frame_trsmitr_t structure.
  * @param raw_data Pointer to the raw data of the received package.
@@ -336,13 +514,17 @@ int ble_frame_trsmitr_recv_pkg_decode(ble_frame_trsmitr_t *trsmitr, unsigned cha
         trsmitr->seq = raw_data[sunpkg_offset++] & BLE_FRAME_SEQ_OFFSET;
     }
 
+    if (sunpkg_offset > raw_data_len) {
+        return OPRT_INVALID_PARM;
+    }
+
     uint16_t recv_data = raw_data_len - sunpkg_offset;
     if ((trsmitr->total - trsmitr->pkg_trsmitr_cnt) < recv_data) {
         recv_data = trsmitr->total - trsmitr->pkg_trsmitr_cnt;
     }
 
-    // decode data cp to transmitter subpackage buf
-    memcpy((void *)trsmitr->subpkg, &raw_data[sunpkg_offset], recv_data);
+    // the payload is left in place, the caller copies it once into the frame
+    trsmitr->subpkg_data = &raw_data[sunpkg_offset];
     trsmitr->subpkg_len = recv_data;
     trsmitr->pkg_trsmitr_cnt += recv_data;
 
@@ -36,6 +36,15 @@ extern "C" {
 #define BLE_FRAME_SEQ_OFFSET     (0x0f << 0)
 #define BLE_FRAME_SEQ_LMT        16
 
+// subpackage header: up to 4 bytes subpackage num, 4 bytes frame len and the
+// version/seq byte
+#define BLE_FRAME_SUBPKG_HEAD_MAX 9
+
+// buffers kept by the subpackage buffer pool
+#ifndef BLE_FRAME_BUF_POOL_NUM
+#define BLE_FRAME_BUF_POOL_NUM 4
+#endif
+
 // frame total len
 typedef uint32_t ble_frame_total_t;
 // frame subpackage num
@@ -62,18 +71,53 @@ typedef struct {
     ble_frame_subpkg_num_t subpkg_num; // 4 bytes, current subpackage number
     uint32_t pkg_trsmitr_cnt;          // package process count, number of bytes sent
     ble_frame_subpkg_len_t subpkg_len; // 1 byte, data length in the current subpackage
-    uint8_t *subpkg;
+    uint8_t *subpkg;                   // pooled encode buffer, only used by ble_frame_trsmitr_send_pkg_encode
+    uint8_t *subpkg_data;              // current subpackage, the encoded subpackage on send or its payload
+                                       // inside the received data on receive
 } ble_frame_trsmitr_t;
 
 /***********************************************************
 *************************function define********************
 ***********************************************************/
+/**
+ * @brief Initializes the subpackage buffer pool.
+ *
+ * Buffers handed out by ble_frame_buf_get() are kept when they are put back
+ * and reused by the next frame, so sending and receiving do not allocate per
+ * frame once the pool is warm.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int ble_frame_buf_pool_init(void);
+
+/**
+ * @brief Frees the subpackage buffer pool, buffers still in use are freed when
+ * they are put back.
+ */
+void ble_frame_buf_pool_deinit(void);
+
+/**
+ * @brief Gets a buffer from the subpackage buffer pool.
+ *
+ * @param size The required buffer size.
+ * @return The buffer, or NULL if memory allocation fails.
+ */
+uint8_t *ble_frame_buf_get(uint32_t size);
+
+/**
+ * @brief Puts a buffer got by ble_frame_buf_get() back into the pool.
+ *
+ * @param buf The buffer, NULL is ignored.
+ */
+void ble_frame_buf_put(uint8_t *buf);
+
 /**
  * @brief Creates a new instance of the ble_frame_trsmitr_t structure.
  *
  * This function allocates memory for the ble_frame_trsmitr_t structure and
- * initializes its members. It also allocates memory for the subpkg member based
- * on the value returned by ble_frame_packet_len_get().
+ * initializes its members. The subpackage buffer used by
+ * ble_frame_trsmitr_send_pkg_encode() is taken from the buffer pool on first
+ * use, decoding needs no buffer.
  *
  * @return A pointer to the newly created ble_frame_trsmitr_t structure, or NULL
  * if memory allocation fails.
@@ -155,6 +199,28 @@ __BLE_TRSMITR_EXT
 int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned char version, unsigned char *buf,
                                       unsigned int len);
 
+/**
+ * @brief Encodes the next subpackage of a package straight into a caller
+ * buffer.
+ *
+ * Same as ble_frame_trsmitr_send_pkg_encode(), but the subpackage header and
+ * data are written into out, e.g. the buffer handed to the BLE stack, instead
+ * of the transmitter buffer. The transmitter may live on the stack, zero it
+ * before the first call.
+ *
+ * @param trsmitr Pointer to the ble_frame_trsmitr_t structure.
+ * @param version The version of the package.
+ * @param buf Pointer to the buffer containing the package data.
+ * @param len The length of the package data.
+ * @param out The buffer the subpackage is written into.
+ * @param out_size The size of out, the subpackage is also limited to
+ * ble_frame_packet_len_get().
+ * @return OPRT_SVC_BT_API_TRSMITR_CONTINUE if there are more subpackages to
+ * send, OPRT_OK if the package transmission is complete, or an error code.
+ */
+int ble_frame_trsmitr_send_pkg_encode_to(ble_frame_trsmitr_t *trsmitr, uint8_t version, uint8_t *buf, uint32_t len,
+                                         uint8_t *out, uint32_t out_size);
+
 /**
  * @brief Decodes the received package and updates the ble_frame_trsmitr_t
  * structure.
@@ -162,8 +228,9 @@ int ble_frame_trsmitr_send_pkg_encode(ble_frame_trsmitr_t *trsmitr, unsigned cha
  * This function decodes the received package data and updates the fields of the
  * ble_frame_trsmitr_t structure. It checks for invalid parameters and validates
  * the subpackage number and package description. It also decodes the frame
- * length, frame type, and frame sequence. Finally, it copies the decoded data
- * to the transmitter subpackage buffer and updates the package transmit count.
+ * length, frame type, and frame sequence. Finally, it points the transmitter
+ * subpackage at the payload inside raw_data, without copying it, and updates
+ * the package transmit count. The payload is valid as long as raw_data is.
  *
  * @param trsmitr Pointer to the ble_frame_trsmitr_t structure.
  * @param raw_data Pointer to the raw data of the received package.
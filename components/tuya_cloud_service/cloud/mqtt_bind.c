@@ -24,6 +24,10 @@
 #include "mqtt_service.h"
 #include "cJSON.h"
 #include "tal_system.h"
+#include "tal_semaphore.h"
+
+/* wait between connect attempts when no backoff is pending */
+#define MQTT_BIND_RETRY_WAIT_MS 1000
 
 typedef enum {
     STATE_MQTT_BIND_INIT,
@@ -42,6 +46,7 @@ typedef struct {
     tuya_mqtt_context_t mqctx;
     mqbind_state_t state;
     THREAD_HANDLE thread;
+    SEM_HANDLE wakeup; // cuts a retry wait short when the state is changed
 } mqtt_bind_t;
 
 static mqtt_bind_t *s_mqbind = NULL;
@@ -49,6 +54,9 @@ static mqtt_bind_t *s_mqbind = NULL;
 void mqtt_bind_free(void)
 {
     if (s_mqbind) {
+        if (s_mqbind->wakeup) {
+            tal_semaphore_release(s_mqbind->wakeup);
+        }
         tal_free((void *)s_mqbind);
         s_mqbind = NULL;
     }
@@ -60,6 +68,7 @@ static OPERATE_RET __mqbind_reset_event_cb(void *data)
     if (mqbind) {
         PR_DEBUG("__mqbind_reset_event_cb");
         mqbind->state = STATE_MQTT_BIND_COMPLETE;
+        tal_semaphore_post(mqbind->wakeup);
     }
 
     return OPRT_OK;
@@ -72,6 +81,7 @@ static OPERATE_RET __mqbind_link_activete_cb(void *data)
     if (mqbind) {
         PR_DEBUG("__mqbind_link_activete_cb");
         mqbind->state = STATE_MQTT_BIND_COMPLETE;
+        tal_semaphore_post(mqbind->wakeup);
     }
 
     return OPRT_OK;
@@ -128,6 +138,12 @@ static void mqtt_bind_activate_token_on(tuya_protocol_event_t *ev)
     mqbind->state = STATE_MQTT_BIND_COMPLETE;
 }
 
+static void mqtt_bind_retry_wait(mqtt_bind_t *mqbind)
+{
+    uint32_t remain = tuya_mqtt_retry_remain(&mqbind->mqctx);
+    tal_semaphore_wait(mqbind->wakeup, remain ? remain : MQTT_BIND_RETRY_WAIT_MS);
+}
+
 /**
  * @brief This function is a thread function that retrieves the MQTT bind token.
  *
@@ -187,9 +203,13 @@ void mqtt_bind_token_get_thread(void *args)
 
         case STATE_MQTT_BIND_CONNECT:
             rt = tuya_mqtt_start(&mqbind->mqctx);
-            if (OPRT_OK != rt) {
+            if (OPRT_RESOURCE_NOT_READY == rt) {
+                /* still in the reconnect backoff */
+                mqtt_bind_retry_wait(mqbind);
+                break;
+            } else if (OPRT_OK != rt) {
                 PR_ERR("tuya mqtt connect fail:%d, retry..", rt);
-                tal_system_sleep(1000);
+                mqtt_bind_retry_wait(mqbind);
                 break;
             }
             mqbind->state = STATE_MQTT_BIND_CONNECTED_WAIT;
@@ -211,6 +231,10 @@ void mqtt_bind_token_get_thread(void *args)
 
         case STATE_MQTT_BIND_TOKEN_WAIT:
             tuya_mqtt_loop(&mqbind->mqctx);
+            /* the loop returns at once while a reconnect is backed off */
+            if (!tuya_mqtt_connected(&mqbind->mqctx)) {
+                mqtt_bind_retry_wait(mqbind);
+            }
             break;
 
         case STATE_MQTT_BIND_COMPLETE:
@@ -261,13 +285,17 @@ int mqtt_bind_token_get(tuya_iot_config_t *config)
     memset(s_mqbind, 0, sizeof(mqtt_bind_t));
 
     s_mqbind->config = config;
+    rt = tal_semaphore_create_init(&s_mqbind->wakeup, 0, 1);
+    if (OPRT_OK != rt) {
+        mqtt_bind_free();
+        return rt;
+    }
 
     THREAD_CFG_T thread_cfg = {.priority = THREAD_PRIO_3, .stackDepth = 4096, .thrdname = "mqtt_bind"};
     rt = tal_thread_create_and_start(&s_mqbind->thread, NULL, NULL, mqtt_bind_token_get_thread, s_mqbind, &thread_cfg);
     if (OPRT_OK != rt) {
         PR_ERR("tuya cli create thread failed %d", rt);
-        tal_free((void *)s_mqbind);
-        s_mqbind = NULL;
+        mqtt_bind_free();
     }
 
     return rt;
@@ -307,6 +307,15 @@ static void on_subscribe_message_default(uint16_t msgid, const mqtt_client_messa
     }
 }
 
+static void mqtt_retry_backoff_set(tuya_mqtt_context_t *context, uint32_t backoff_ms)
+{
+    /* 0 means no backoff, nudge the deadline off it */
+    context->retry_time = (uint32_t)tal_system_get_millisecond() + backoff_ms;
+    if (context->retry_time == 0) {
+        context->retry_time = 1;
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /*                         MQTT Client event callback                         */
 /* -------------------------------------------------------------------------- */
@@ -320,6 +329,7 @@ static void mqtt_client_connected_cb(void *client, void *userdata)
                                                   userdata);
     PR_DEBUG("SUBSCRIBE sent for topic %s to broker.", context->signature.topic_in);
     context->is_connected = true;
+    context->retry_time = 0;
     if (context->on_connected) {
         context->on_connected(context, context->user_data);
     }
@@ -472,6 +482,10 @@ int tuya_mqtt_start(tuya_mqtt_context_t *context)
         return OPRT_INVALID_PARM;
     }
 
+    if (tuya_mqtt_retry_remain(context) > 0) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
     PR_INFO("clientid:%s", context->signature.clientid);
     PR_INFO("username:%s", context->signature.username);
     PR_DEBUG("password:%s", context->signature.password);
@@ -501,7 +515,7 @@ int tuya_mqtt_start(tuya_mqtt_context_t *context)
             PR_WARN("Connection to the MQTT server failed. Retrying "
                     "connection after %hu ms backoff.",
                     (unsigned short)nextRetryBackOff);
-            tal_system_sleep(nextRetryBackOff + 10000);
+            mqtt_retry_backoff_set(context, nextRetryBackOff + 10000);
         }
         return OPRT_COM_ERROR;
     }
@@ -687,6 +701,7 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
     handle->payload_length = payload_length;
     handle->payload = tal_malloc(payload_length);
     if (handle->payload == NULL) {
+        tal_free(handle);
         return OPRT_MALLOC_FAILED;
     }
     memcpy((void *)handle->payload, payload, payload_length);
@@ -852,6 +867,9 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
 
     /* reconnect */
     if (context->is_connected == false) {
+        if (tuya_mqtt_retry_remain(context) > 0) {
+            return rt;
+        }
         mqtt_status = mqtt_client_connect(context->mqtt_client);
         if (mqtt_status == MQTT_STATUS_NOT_AUTHORIZED) {
             if (context->on_unbind) {
@@ -866,7 +884,7 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
                 PR_WARN("Connection to the MQTT server failed. Retrying "
                         "connection after %hu ms backoff.",
                         (unsigned short)nextRetryBackOff);
-                tal_system_sleep(nextRetryBackOff);
+                mqtt_retry_backoff_set(context, nextRetryBackOff);
                 return rt;
             }
         }
@@ -945,6 +963,26 @@ bool tuya_mqtt_connected(tuya_mqtt_context_t *context)
     return context->is_connected;
 }
 
+/**
+ * @brief Gets the time left before the next connect attempt is allowed.
+ *
+ * @param context The MQTT context.
+ * @return The remaining backoff in milliseconds, 0 if a connect may be tried.
+ */
+uint32_t tuya_mqtt_retry_remain(tuya_mqtt_context_t *context)
+{
+    if (context == NULL || context->retry_time == 0) {
+        return 0;
+    }
+
+    int32_t remain = (int32_t)(context->retry_time - (uint32_t)tal_system_get_millisecond());
+    if (remain <= 0) {
+        context->retry_time = 0;
+        return 0;
+    }
+    return (uint32_t)remain;
+}
+
 /**
  * @brief Reports the progress of an upgrade operation over MQTT.
  *
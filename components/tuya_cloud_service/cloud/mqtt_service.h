@@ -173,6 +173,7 @@ typedef struct {
     BackoffAlgorithmContext_t backoff_algorithm;
     uint32_t sequence_in;
     uint32_t sequence_out;
+    uint32_t retry_time;
     bool manual_disconnect;
     bool is_inited;
     bool is_connected;
@@ -247,6 +248,18 @@ int tuya_mqtt_destory(tuya_mqtt_context_t *context);
  */
 bool tuya_mqtt_connected(tuya_mqtt_context_t *context);
 
+/**
+ * @brief Gets the time left before the next connect attempt is allowed.
+ *
+ * A failed connect arms a backoff, tuya_mqtt_start() and tuya_mqtt_loop()
+ * do not try to connect again until it has elapsed. The caller can block on
+ * its own event source for this long instead of calling them in a loop.
+ *
+ * @param context Pointer to the MQTT context.
+ * @return The remaining backoff in milliseconds, 0 if a connect may be tried.
+ */
+uint32_t tuya_mqtt_retry_remain(tuya_mqtt_context_t *context);
+
 /**
  * @brief Registers a MQTT protocol with the given context.
  *
@@ -0,0 +1,360 @@
+/**
+ * @file tuya_cert_cache.c
+ * @brief Implementation of the host certificate cache.
+ *
+ * Each cached host takes one slot, kept in memory and saved through tal_kv
+ * under "cert.<slot>". A slot holds the host, port, expiry and the
+ * certificate as returned by iot-dns. A miss or an expired slot queries
+ * iot-dns and replaces the slot of the same host, an empty slot or the least
+ * recently used one. Certificates saved before the time was synced get their
+ * expiry once it is.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cert_cache.h"
+#include "iotdns.h"
+#include "http_parser.h"
+#include "tuya_tls.h"
+#include "tal_api.h"
+#include "tal_kv.h"
+#include "tal_time_service.h"
+
+#define CERT_CACHE_KEY_FMT "cert.%d"
+
+typedef struct {
+    /* posix time, 0 when saved before the time was synced */
+    uint32_t expire;
+    uint16_t port;
+    uint16_t cert_len;
+    char host[TUYA_CERT_CACHE_HOST_MAX + 1];
+} cert_cache_record_t;
+
+typedef struct {
+    cert_cache_record_t rec;
+    uint8_t *cert;
+    uint32_t last_used;
+} cert_cache_entry_t;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    uint32_t tick;
+    cert_cache_entry_t entry[TUYA_CERT_CACHE_NUM];
+} cert_cache_mgr_t;
+
+static cert_cache_mgr_t s_cert_cache;
+
+static void __cert_cache_drop(int idx)
+{
+    char key[16];
+    cert_cache_entry_t *entry = &s_cert_cache.entry[idx];
+
+    if (entry->cert) {
+        tal_free((void *)entry->cert);
+    }
+    memset(entry, 0, sizeof(cert_cache_entry_t));
+
+    snprintf(key, sizeof(key), CERT_CACHE_KEY_FMT, idx);
+    tal_kv_del(key);
+}
+
+static void __cert_cache_load(int idx)
+{
+    char key[16];
+    uint8_t *value = NULL;
+    size_t len = 0;
+    cert_cache_entry_t *entry = &s_cert_cache.entry[idx];
+
+    snprintf(key, sizeof(key), CERT_CACHE_KEY_FMT, idx);
+    if (OPRT_OK != tal_kv_get(key, &value, &len)) {
+        return;
+    }
+
+    cert_cache_record_t *rec = (cert_cache_record_t *)value;
+    if (len <= sizeof(cert_cache_record_t) || rec->cert_len != len - sizeof(cert_cache_record_t) ||
+        rec->host[TUYA_CERT_CACHE_HOST_MAX] != 0) {
+        PR_WARN("cert cache %d invalid, drop", idx);
+        tal_kv_free(value);
+        __cert_cache_drop(idx);
+        return;
+    }
+
+    entry->cert = tal_malloc(rec->cert_len);
+    if (entry->cert) {
+        memcpy(&entry->rec, rec, sizeof(cert_cache_record_t));
+        memcpy(entry->cert, value + sizeof(cert_cache_record_t), rec->cert_len);
+        PR_DEBUG("cert cache load %s:%d", entry->rec.host, entry->rec.port);
+    }
+    tal_kv_free(value);
+}
+
+static int __cert_cache_save(int idx)
+{
+    char key[16];
+    cert_cache_entry_t *entry = &s_cert_cache.entry[idx];
+    size_t len = sizeof(cert_cache_record_t) + entry->rec.cert_len;
+
+    uint8_t *value = tal_malloc(len);
+    if (NULL == value) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memcpy(value, &entry->rec, sizeof(cert_cache_record_t));
+    memcpy(value + sizeof(cert_cache_record_t), entry->cert, entry->rec.cert_len);
+
+    snprintf(key, sizeof(key), CERT_CACHE_KEY_FMT, idx);
+    int rt = tal_kv_set(key, value, len);
+    tal_free((void *)value);
+
+    return rt;
+}
+
+static int __cert_cache_find(const char *host, uint16_t port)
+{
+    for (int i = 0; i < TUYA_CERT_CACHE_NUM; i++) {
+        cert_cache_entry_t *entry = &s_cert_cache.entry[i];
+        if (entry->cert && entry->rec.port == port && 0 == strcmp(entry->rec.host, host)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool __cert_cache_expired(cert_cache_entry_t *entry)
+{
+    /* Without a synced time the expiry cannot be told, keep using it */
+    if (OPRT_OK != tal_time_check_time_sync()) {
+        return false;
+    }
+
+    uint32_t now = (uint32_t)tal_time_get_posix();
+    if (0 == entry->rec.expire) {
+        entry->rec.expire = now + TUYA_CERT_CACHE_TTL_S;
+        return false;
+    }
+
+    return now >= entry->rec.expire;
+}
+
+static void __cert_cache_store(const char *host, uint16_t port, const uint8_t *cert, uint16_t cert_len)
+{
+    uint8_t *copy = tal_malloc(cert_len);
+    if (NULL == copy) {
+        return;
+    }
+    memcpy(copy, cert, cert_len);
+
+    tal_mutex_lock(s_cert_cache.mutex);
+    /* the same host, an empty slot, or the least recently used one */
+    int idx = __cert_cache_find(host, port);
+    if (idx < 0) {
+        idx = 0;
+        for (int i = 0; i < TUYA_CERT_CACHE_NUM; i++) {
+            if (NULL == s_cert_cache.entry[i].cert) {
+                idx = i;
+                break;
+            }
+            if (s_cert_cache.entry[i].last_used < s_cert_cache.entry[idx].last_used) {
+                idx = i;
+            }
+        }
+    }
+
+    cert_cache_entry_t *entry = &s_cert_cache.entry[idx];
+    if (entry->cert) {
+        tal_free((void *)entry->cert);
+    }
+    memset(entry, 0, sizeof(cert_cache_entry_t));
+    strcpy(entry->rec.host, host);
+    entry->rec.port = port;
+    entry->rec.cert_len = cert_len;
+    if (OPRT_OK == tal_time_check_time_sync()) {
+        entry->rec.expire = (uint32_t)tal_time_get_posix() + TUYA_CERT_CACHE_TTL_S;
+    }
+    entry->cert = copy;
+    entry->last_used = ++s_cert_cache.tick;
+
+    if (OPRT_OK != __cert_cache_save(idx)) {
+        PR_WARN("cert cache %s:%d save fail", host, port);
+    }
+    tal_mutex_unlock(s_cert_cache.mutex);
+}
+
+static void __cert_cache_tls_event_cb(tuya_tls_event_t event, void *p_args)
+{
+    char host[TUYA_CERT_CACHE_HOST_MAX + 1 + 6];
+    uint16_t port = 443;
+
+    if (event != TUYA_TLS_CERT_EXPIRED || NULL == p_args) {
+        return;
+    }
+
+    /* "host" or "host:port" */
+    snprintf(host, sizeof(host), "%s", (const char *)p_args);
+    char *p_port = strrchr(host, ':');
+    if (p_port) {
+        *p_port = 0;
+        port = (uint16_t)atoi(p_port + 1);
+    }
+
+    PR_NOTICE("cert of %s:%d not trusted, drop", host, port);
+    tuya_cert_cache_remove(host, port);
+}
+
+/**
+ * @brief Initializes the certificate cache.
+ *
+ * This function loads the certificates saved by an earlier boot and registers
+ * for TLS verification failures, so a stale certificate is dropped.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_cert_cache_init(void)
+{
+    if (s_cert_cache.mutex) {
+        return OPRT_OK;
+    }
+
+    int rt = tal_mutex_create_init(&s_cert_cache.mutex);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    for (int i = 0; i < TUYA_CERT_CACHE_NUM; i++) {
+        __cert_cache_load(i);
+    }
+    tuya_tls_register_event_cb(__cert_cache_tls_event_cb);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the CA certificate of a host.
+ *
+ * This function answers from the cache while the certificate has not
+ * expired, otherwise it queries iot-dns and caches the answer.
+ *
+ * @param[in] host The host name.
+ * @param[in] port The port number.
+ * @param[out] cacert The certificate, the caller frees it with tal_free().
+ * @param[out] cacert_len The certificate length.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_cert_cache_get(const char *host, uint16_t port, uint8_t **cacert, uint16_t *cacert_len)
+{
+    int rt = OPRT_OK;
+
+    if (NULL == host || NULL == cacert || NULL == cacert_len) {
+        return OPRT_INVALID_PARM;
+    }
+    *cacert = NULL;
+    *cacert_len = 0;
+
+    if (strlen(host) > TUYA_CERT_CACHE_HOST_MAX || OPRT_OK != tuya_cert_cache_init()) {
+        return tuya_iotdns_query_host_certs((char *)host, port, cacert, cacert_len);
+    }
+
+    tal_mutex_lock(s_cert_cache.mutex);
+    int idx = __cert_cache_find(host, port);
+    if (idx >= 0 && __cert_cache_expired(&s_cert_cache.entry[idx])) {
+        PR_DEBUG("cert cache %s:%d expired", host, port);
+        __cert_cache_drop(idx);
+        idx = -1;
+    }
+    if (idx >= 0) {
+        cert_cache_entry_t *entry = &s_cert_cache.entry[idx];
+        *cacert = tal_malloc(entry->rec.cert_len);
+        if (*cacert) {
+            memcpy(*cacert, entry->cert, entry->rec.cert_len);
+            *cacert_len = entry->rec.cert_len;
+            entry->last_used = ++s_cert_cache.tick;
+        } else {
+            rt = OPRT_MALLOC_FAILED;
+        }
+        tal_mutex_unlock(s_cert_cache.mutex);
+        return rt;
+    }
+    tal_mutex_unlock(s_cert_cache.mutex);
+
+    rt = tuya_iotdns_query_host_certs((char *)host, port, cacert, cacert_len);
+    if (OPRT_OK != rt || NULL == *cacert || 0 == *cacert_len) {
+        if (*cacert) {
+            tal_free((void *)*cacert);
+            *cacert = NULL;
+        }
+        *cacert_len = 0;
+        return (OPRT_OK != rt) ? rt : OPRT_COM_ERROR;
+    }
+
+    __cert_cache_store(host, port, *cacert, *cacert_len);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the CA certificate of the host in a URL.
+ *
+ * @param[in] url The URL, e.g. "https://host:port/path".
+ * @param[out] cacert The certificate, the caller frees it with tal_free().
+ * @param[out] cacert_len The certificate length.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_cert_cache_get_by_url(const char *url, uint8_t **cacert, uint16_t *cacert_len)
+{
+    struct http_parser_url purl;
+    char host[TUYA_CERT_CACHE_HOST_MAX + 1];
+    uint16_t port = 443;
+
+    if (NULL == url) {
+        return OPRT_INVALID_PARM;
+    }
+
+    http_parser_url_init(&purl);
+    if (0 != http_parser_parse_url(url, strlen(url), 0, &purl) || !(purl.field_set & (1 << UF_HOST))) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if ((purl.field_set & (1 << UF_SCHEMA)) && 0 == strncmp("http", url + purl.field_data[UF_SCHEMA].off,
+                                                            purl.field_data[UF_SCHEMA].len)) {
+        port = 80;
+    }
+    if (purl.field_set & (1 << UF_PORT)) {
+        port = purl.port;
+    }
+
+    /* longer hosts skip the cache */
+    if (purl.field_data[UF_HOST].len > TUYA_CERT_CACHE_HOST_MAX) {
+        return tuya_iotdns_query_domain_certs((char *)url, cacert, cacert_len);
+    }
+    memcpy(host, url + purl.field_data[UF_HOST].off, purl.field_data[UF_HOST].len);
+    host[purl.field_data[UF_HOST].len] = 0;
+
+    return tuya_cert_cache_get(host, port, cacert, cacert_len);
+}
+
+/**
+ * @brief Drops the cached certificate of a host.
+ *
+ * @param[in] host The host name, NULL drops all.
+ * @param[in] port The port number.
+ */
+void tuya_cert_cache_remove(const char *host, uint16_t port)
+{
+    if (NULL == s_cert_cache.mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_cert_cache.mutex);
+    for (int i = 0; i < TUYA_CERT_CACHE_NUM; i++) {
+        cert_cache_entry_t *entry = &s_cert_cache.entry[i];
+        if (NULL == entry->cert) {
+            continue;
+        }
+        if (NULL == host || (entry->rec.port == port && 0 == strcmp(entry->rec.host, host))) {
+            __cert_cache_drop(i);
+        }
+    }
+    tal_mutex_unlock(s_cert_cache.mutex);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file tuya_cert_cache.h
+ * @brief Host certificate cache for Tuya HTTPS connections.
+ *
+ * Certificates of hosts that are not the Tuya cloud endpoint, such as the
+ * firmware download server, are queried from the iot-dns service. The cache
+ * keeps the answer per host and port with an expiry and saves it through
+ * tal_kv, so OTA retries and later boots connect without the extra HTTPS
+ * round trip. A certificate that fails verification is dropped through the
+ * tuya_tls event callback and queried again on the next connect.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __TUYA_CERT_CACHE_H_
+#define __TUYA_CERT_CACHE_H_
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* number of cached hosts, each one is a tal_kv key */
+#ifndef TUYA_CERT_CACHE_NUM
+#define TUYA_CERT_CACHE_NUM 3
+#endif
+
+/* lifetime of a cached certificate in seconds */
+#ifndef TUYA_CERT_CACHE_TTL_S
+#define TUYA_CERT_CACHE_TTL_S (7 * 24 * 3600)
+#endif
+
+/* longest host that is cached, longer ones are always queried */
+#define TUYA_CERT_CACHE_HOST_MAX 64
+
+/**
+ * @brief Initializes the certificate cache and loads the saved certificates.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_cert_cache_init(void);
+
+/**
+ * @brief Gets the CA certificate of a host, querying iot-dns on a miss.
+ *
+ * @param[in] host The host name.
+ * @param[in] port The port number.
+ * @param[out] cacert The certificate, the caller frees it with tal_free().
+ * @param[out] cacert_len The certificate length.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_cert_cache_get(const char *host, uint16_t port, uint8_t **cacert, uint16_t *cacert_len);
+
+/**
+ * @brief Gets the CA certificate of the host in a URL.
+ *
+ * @param[in] url The URL, e.g. "https://host:port/path".
+ * @param[out] cacert The certificate, the caller frees it with tal_free().
+ * @param[out] cacert_len The certificate length.
+ *
+ * @return OPRT_OK on success, or an error code on failure.
+ */
+int tuya_cert_cache_get_by_url(const char *url, uint8_t **cacert, uint16_t *cacert_len);
+
+/**
+ * @brief Drops the cached certificate of a host.
+ *
+ * @param[in] host The host name, NULL drops all.
+ * @param[in] port The port number.
+ */
+void tuya_cert_cache_remove(const char *host, uint16_t port);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
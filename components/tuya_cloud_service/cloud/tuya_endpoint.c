@@ -41,17 +41,31 @@ static int tuya_region_regist_key_write(const char *region, const char *regist_k
         return OPRT_INVALID_PARM;
     }
 
-    /* Write kv storage */
+    /* Write kv storage, both keys or none */
     int ret = 0;
-    ret = tal_kv_set("region", (const uint8_t *)region, strlen(region));
+    KV_BATCH_HANDLE batch = NULL;
+    ret = tal_kv_batch_begin(&batch);
+    if (ret != OPRT_OK) {
+        return ret;
+    }
+
+    ret = tal_kv_batch_set(batch, "region", (const uint8_t *)region, strlen(region));
     if (ret != OPRT_OK) {
         PR_ERR("tal_kv_set region, error:0x%02x", ret);
+        tal_kv_batch_abort(batch);
         return OPRT_KVS_WR_FAIL;
     }
 
-    ret = tal_kv_set("regist_key", (const uint8_t *)regist_key, strlen(regist_key));
+    ret = tal_kv_batch_set(batch, "regist_key", (const uint8_t *)regist_key, strlen(regist_key));
     if (ret != OPRT_OK) {
         PR_ERR("tal_kv_set regist_key, error:0x%02x", ret);
+        tal_kv_batch_abort(batch);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    ret = tal_kv_batch_commit(batch);
+    if (ret != OPRT_OK) {
+        PR_ERR("tal_kv_batch_commit, error:0x%02x", ret);
         return OPRT_KVS_WR_FAIL;
     }
 
@@ -245,12 +259,18 @@ int tuya_endpoint_region_regist_set(const char *region, const char *regist_key)
  */
 int tuya_endpoint_remove(void)
 {
-    tal_kv_del("region");
-    tal_kv_del("regist_key");
-    tal_kv_del("endpoint.cert");
-    tal_kv_del("endpoint.domain");
+    KV_BATCH_HANDLE batch = NULL;
+    int ret = tal_kv_batch_begin(&batch);
+    if (ret != OPRT_OK) {
+        return ret;
+    }
 
-    return OPRT_OK;
+    tal_kv_batch_del(batch, "region");
+    tal_kv_batch_del(batch, "regist_key");
+    tal_kv_batch_del(batch, "endpoint.cert");
+    tal_kv_batch_del(batch, "endpoint.domain");
+
+    return tal_kv_batch_commit(batch);
 }
 
 /**
@@ -298,6 +318,7 @@ int tuya_endpoint_update(void)
     if (endpoint_mgr.endpoint.cert != NULL) {
         PR_TRACE("Free endpoint already exist cert.");
         tal_free((void *)endpoint_mgr.endpoint.cert);
+        endpoint_mgr.endpoint.cert = NULL;
     }
     /* Try to get the iot-dns domain data */
     ret = iotdns_cloud_endpoint_get(endpoint_mgr.region, endpoint_mgr.regist_key, &endpoint_mgr.endpoint);
@@ -324,12 +345,47 @@ int tuya_endpoint_update_auto_region(void)
     if (endpoint_mgr.endpoint.cert != NULL) {
         PR_TRACE("Free endpoint already exist cert.");
         tal_free((void *)endpoint_mgr.endpoint.cert);
+        endpoint_mgr.endpoint.cert = NULL;
     }
     /* Try to get the iot-dns domain data */
     ret = iotdns_cloud_endpoint_get(NULL, endpoint_mgr.regist_key, &endpoint_mgr.endpoint);
     return ret;
 }
 
+/**
+ * @brief Loads the stored Tuya endpoint.
+ *
+ * This function reads the certificate and domain saved by the last
+ * activation or endpoint update. When they are already in memory, e.g. on a
+ * client restart, they are reused without reading the storage again.
+ *
+ * @return The result of the operation. Returns 0 on success, or an error code
+ * on failure.
+ */
+int tuya_endpoint_load(void)
+{
+    tuya_endpoint_t *endpoint = &endpoint_mgr.endpoint;
+
+    if (endpoint->cert != NULL && endpoint->atop.host[0] && endpoint->mqtt.host[0]) {
+        PR_DEBUG("Reuse loaded endpoint.");
+        return OPRT_OK;
+    }
+
+    if (endpoint->cert != NULL) {
+        tal_free((void *)endpoint->cert);
+        endpoint->cert = NULL;
+    }
+
+    int ret = tuya_endpoint_cert_get(endpoint);
+    ret |= tuya_endpoint_domain_get(endpoint);
+    if (ret != OPRT_OK && endpoint->cert != NULL) {
+        tal_free((void *)endpoint->cert);
+        endpoint->cert = NULL;
+    }
+
+    return ret;
+}
+
 /**
  * @brief Retrieves the Tuya endpoint.
  *
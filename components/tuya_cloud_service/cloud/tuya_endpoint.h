@@ -107,6 +107,18 @@ int tuya_endpoint_update(void);
  */
 int tuya_endpoint_update_auto_region(void);
 
+/**
+ * @brief Loads the stored Tuya endpoint.
+ *
+ * This function loads the certificate and domain saved in the storage, an
+ * endpoint already loaded is reused.
+ *
+ * @return An integer value indicating the status of the load process.
+ *         - 0: Load successful.
+ *         - Other values: No valid endpoint is stored.
+ */
+int tuya_endpoint_load(void);
+
 /**
  * @brief Retrieves the Tuya endpoint.
  *
@@ -18,6 +18,7 @@
 
 #include "tuya_endpoint.h"
 #include "tal_kv.h"
+#include "tal_dns_cache.h"
 #include "atop_base.h"
 #include "atop_service.h"
 #include "mqtt_bind.h"
@@ -27,8 +28,10 @@
 #include "tuya_iot_dp.h"
 #include "tuya_register_center.h"
 #include "tuya_tls.h"
+#include "tuya_cert_cache.h"
 #include "netmgr.h"
 #include "tuya_health.h"
+#include "tuya_json_writer.h"
 typedef enum {
     STATE_IDLE,
     STATE_START,
@@ -50,6 +53,25 @@ typedef enum {
     STATE_EXIT,
 } tuya_run_state_t;
 
+/* longest wait of tuya_iot_yield() in a state that is left on a wakeup */
+#ifndef IOT_IDLE_WAIT_MS
+#define IOT_IDLE_WAIT_MS (5 * 1000)
+#endif
+
+/* longest wait before the network or a failed cloud request is checked again */
+#ifndef IOT_RETRY_WAIT_MS
+#define IOT_RETRY_WAIT_MS 1000
+#endif
+
+/* the startup version update runs on its own thread, in parallel with the MQTT connect */
+#ifndef IOT_STARTUP_STACK_SIZE
+#define IOT_STARTUP_STACK_SIZE (6 * 1024)
+#endif
+
+static const char *const s_boot_phase_name[TUYA_BOOT_PHASE_MAX] = {
+    "start", "network up", "activated", "endpoint ready", "mqtt connected", "version updated", "first dp",
+};
+
 static tuya_iot_client_t *s_iot_client_solo;
 
 /* -------------------------------------------------------------------------- */
@@ -240,13 +262,22 @@ static int activate_response_parse(atop_base_response_t *response)
         return OPRT_CJSON_GET_ERR;
     }
 
+    // schema and activate info are saved together, a half-written activation
+    // would otherwise leave a schema without its device
+    KV_BATCH_HANDLE batch = NULL;
+    ret = tal_kv_batch_begin(&batch);
+    if (ret != OPRT_OK) {
+        return ret;
+    }
+
     // cJSON object to string save
     char *schemaId = cJSON_GetObjectItem(result_root, "schemaId")->valuestring;
     cJSON *schema_obj = cJSON_DetachItemFromObject(result_root, "schema");
-    ret = tal_kv_set(schemaId, (const uint8_t *)schema_obj->valuestring, strlen(schema_obj->valuestring));
+    ret = tal_kv_batch_set(batch, schemaId, (const uint8_t *)schema_obj->valuestring, strlen(schema_obj->valuestring));
     cJSON_Delete(schema_obj);
     if (ret != OPRT_OK) {
         PR_ERR("activate data save error:%d", ret);
+        tal_kv_batch_abort(batch);
         return OPRT_KVS_WR_FAIL;
     }
 
@@ -254,10 +285,17 @@ static int activate_response_parse(atop_base_response_t *response)
     char *result_string = cJSON_PrintUnformatted(result_root);
     const char *activate_data_key = client->config.storage_namespace;
     PR_DEBUG("result len %d :%s", (int)strlen(result_string), result_string);
-    ret = tal_kv_set(activate_data_key, (const uint8_t *)result_string, strlen(result_string));
+    ret = tal_kv_batch_set(batch, activate_data_key, (const uint8_t *)result_string, strlen(result_string));
     tal_free((void *)result_string);
     if (ret != OPRT_OK) {
         PR_ERR("activate data save error:%d", ret);
+        tal_kv_batch_abort(batch);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    ret = tal_kv_batch_commit(batch);
+    if (ret != OPRT_OK) {
+        PR_ERR("activate data commit error:%d", ret);
         return OPRT_KVS_WR_FAIL;
     }
 
@@ -451,6 +489,38 @@ static void mqtt_service_upgrade_notify_on(tuya_mqtt_event_t *ev)
     }
 }
 
+static void iot_boot_phase_mark(tuya_iot_client_t *client, tuya_boot_phase_t phase)
+{
+    if (client->boot_time[phase]) {
+        return;
+    }
+
+    uint32_t elapsed = (uint32_t)(tal_system_get_millisecond() - client->boot_start);
+    /* 0 means not reached */
+    client->boot_time[phase] = elapsed ? elapsed : 1;
+    PR_INFO("boot phase %s: %u ms", s_boot_phase_name[phase], elapsed);
+}
+
+static void iot_wait(tuya_iot_client_t *client, uint32_t timeout_ms)
+{
+    if (timeout_ms == 0) {
+        return;
+    }
+    tal_semaphore_wait(client->wakeup, timeout_ms);
+}
+
+static void iot_mqtt_retry_wait(tuya_iot_client_t *client)
+{
+    uint32_t remain = tuya_mqtt_retry_remain(&client->mqctx);
+    iot_wait(client, remain ? remain : IOT_RETRY_WAIT_MS);
+}
+
+static int iot_link_status_changed_evt(void *data)
+{
+    tuya_iot_wakeup(tuya_iot_client_get());
+    return OPRT_OK;
+}
+
 static void mqtt_client_connected_on(void *context, void *user_data)
 {
     tuya_iot_client_t *client = (tuya_iot_client_t *)user_data;
@@ -464,10 +534,14 @@ static void mqtt_client_connected_on(void *context, void *user_data)
         tal_sw_timer_start(client->check_upgrade_timer, 1000 * 1, TAL_TIMER_ONCE);
     }
 
+    iot_boot_phase_mark(client, TUYA_BOOT_PHASE_MQTT_CONNECTED);
+
     /* Send connected event*/
     client->event.id = TUYA_EVENT_MQTT_CONNECTED;
     client->event.type = TUYA_DATE_TYPE_UNDEFINED;
     iot_dispatch_event(client);
+
+    tuya_iot_wakeup(client);
 }
 
 static void mqtt_client_disconnect_on(void *context, void *user_data)
@@ -481,6 +555,8 @@ static void mqtt_client_disconnect_on(void *context, void *user_data)
     client->event.id = TUYA_EVENT_MQTT_DISCONNECT;
     client->event.type = TUYA_DATE_TYPE_UNDEFINED;
     iot_dispatch_event(client);
+
+    tuya_iot_wakeup(client);
 }
 
 static void mqtt_client_unbind_on(void *context, void *user_data)
@@ -492,6 +568,7 @@ static void mqtt_client_unbind_on(void *context, void *user_data)
 
     /* Reset activated data */
     client->nextstate = STATE_RESET;
+    tuya_iot_wakeup(client);
 
     /* DP event send */
     client->event.id = TUYA_EVENT_RESET;
@@ -522,12 +599,51 @@ static void check_auto_upgrade_timeout_on(TIMER_ID timer, void *user_data)
 /*                       Internal machine state process                       */
 /* -------------------------------------------------------------------------- */
 
+static void iot_startup_update_task(void *args)
+{
+    tuya_iot_client_t *client = (tuya_iot_client_t *)args;
+
+    if (OPRT_OK == tuya_iot_version_update_sync(client)) {
+        iot_boot_phase_mark(client, TUYA_BOOT_PHASE_VERSION_UPDATED);
+    }
+
+    /* the client may be torn down as soon as the semaphore is posted */
+    THREAD_HANDLE thread = client->startup_thread;
+    tal_semaphore_post(client->startup_done);
+    tal_thread_delete(thread);
+}
+
+/* Waits for the startup version update, the client must not be torn down
+ * while it runs. Returns false if it is still running after timeout ms */
+static bool iot_startup_join(tuya_iot_client_t *client, uint32_t timeout)
+{
+    if (client->startup_thread) {
+        if (OPRT_OK != tal_semaphore_wait(client->startup_done, timeout)) {
+            return false;
+        }
+        client->startup_thread = NULL;
+    }
+    return true;
+}
+
 static int run_state_startup_update(tuya_iot_client_t *client)
 {
     int rt = OPRT_OK;
 
-    /* Update client version */
-    tuya_iot_version_update_sync(client);
+    /* Update client version, the request has its own TLS session and does not
+     * hold up the MQTT connect */
+    if (iot_startup_join(client, 0)) {
+        THREAD_CFG_T thread_cfg = {
+            .priority = THREAD_PRIO_2, .stackDepth = IOT_STARTUP_STACK_SIZE, .thrdname = "iot_startup"};
+        if (client->startup_done == NULL ||
+            OPRT_OK != tal_thread_create_and_start(&client->startup_thread, NULL, NULL, iot_startup_update_task,
+                                                   client, &thread_cfg)) {
+            client->startup_thread = NULL;
+            if (OPRT_OK == tuya_iot_version_update_sync(client)) {
+                iot_boot_phase_mark(client, TUYA_BOOT_PHASE_VERSION_UPDATED);
+            }
+        }
+    }
 
     /* MQTT Client Init */
     const tuya_endpoint_t *endpoint = tuya_endpoint_get();
@@ -552,7 +668,9 @@ static int run_state_startup_update(tuya_iot_client_t *client)
 static int run_state_mqtt_connect_start(tuya_iot_client_t *client)
 {
     int rt = tuya_mqtt_start(&client->mqctx);
-    if (OPRT_OK != rt) {
+    if (OPRT_RESOURCE_NOT_READY == rt) {
+        return rt;
+    } else if (OPRT_OK != rt) {
         PR_ERR("tuya mqtt start error:%d", rt);
         return rt;
     }
@@ -577,6 +695,9 @@ static int run_state_reset(tuya_iot_client_t *client)
 {
     PR_WARN("CLIENT RESET...");
 
+    /* The version update reads the activation data removed below */
+    iot_startup_join(client, SEM_WAIT_FOREVER);
+
     /* Stop MQTT service */
     if (client->is_activated && tuya_mqtt_connected(&client->mqctx)) {
         tuya_mqtt_stop(&client->mqctx);
@@ -635,6 +756,9 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     PR_DEBUG("authkey:%s", client->config.authkey);
 
     tal_semaphore_create_init(&client->token_get.sem, 0, 1);
+    tal_semaphore_create_init(&client->wakeup, 0, 1);
+    tal_semaphore_create_init(&client->startup_done, 0, 1);
+    client->boot_start = tal_system_get_millisecond();
 
     /* Default storage namespace */
     if (client->config.storage_namespace == NULL) {
@@ -642,9 +766,19 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     }
     /* Software timer Init */
     tuya_tls_init();
+    /* Certificates of download hosts saved by an earlier boot */
+    tuya_cert_cache_init();
     tuya_register_center_init();
     /* Load Tuya cloud endpoint config */
     tuya_endpoint_init();
+    /* Keep resolved cloud hosts across reboots, so a warm boot connects without waiting for DNS */
+    TAL_DNS_CACHE_CFG_T dns_cfg = {
+        .ttl_s = TAL_DNS_CACHE_TTL_S,
+        .negative_ttl_s = TAL_DNS_CACHE_NEGATIVE_TTL_S,
+        .stale_s = TAL_DNS_CACHE_STALE_S,
+        .persist = TRUE,
+    };
+    tal_dns_cache_config(&dns_cfg);
     /* Try to read the local activation data.
      * If the reading is successful, the device has been activated. */
     if (activated_data_read(client->config.storage_namespace, &client->activate) == OPRT_OK) {
@@ -668,8 +802,13 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     if (OPRT_OK != ret) {
         return ret;
     }
+    //! the upgrade query builds and publishes an MQTT request, keep it off the timer thread
+    tal_sw_timer_set_dispatch(client->check_upgrade_timer, TAL_TIMER_DISPATCH_WORKQ, WORKQ_SYSTEM);
     s_iot_client_solo = client;
 
+    /* Handle network up/down as soon as netmgr reports it */
+    tal_event_subscribe(EVENT_LINK_STATUS_CHG, "iot", iot_link_status_changed_evt, SUBSCRIBE_TYPE_NORMAL);
+
     client->state = STATE_IDLE;
     client->nextstate = STATE_IDLE;
     return ret;
@@ -692,6 +831,8 @@ int tuya_iot_start(tuya_iot_client_t *client)
         return OPRT_COM_ERROR;
     }
     client->nextstate = STATE_START;
+    iot_boot_phase_mark(client, TUYA_BOOT_PHASE_START);
+    tuya_iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -699,6 +840,8 @@ int tuya_iot_start(tuya_iot_client_t *client)
  * @brief Stops the Tuya IoT client.
  *
  * This function sets the next state of the Tuya IoT client to STATE_STOP.
+ * The stop waits for a startup version update still in progress before the
+ * MQTT client is torn down.
  *
  * @param client Pointer to the Tuya IoT client structure.
  * @return OPRT_OK if the operation is successful, otherwise an error code.
@@ -706,6 +849,7 @@ int tuya_iot_start(tuya_iot_client_t *client)
 int tuya_iot_stop(tuya_iot_client_t *client)
 {
     client->nextstate = STATE_STOP;
+    tuya_iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -726,9 +870,28 @@ int tuya_iot_reconnect(tuya_iot_client_t *client)
         return OPRT_COM_ERROR;
     }
     client->nextstate = STATE_MQTT_RECONNECT;
+    tuya_iot_wakeup(client);
     return OPRT_OK;
 }
 
+/**
+ * @brief Wakes up tuya_iot_yield().
+ *
+ * tuya_iot_yield() blocks while it waits for the network, for a retry or for
+ * the client to be started. This function ends the wait, so the state machine
+ * handles the change right away.
+ *
+ * @param client The Tuya IoT client.
+ * @return OPRT_OK on success, otherwise an error code.
+ */
+int tuya_iot_wakeup(tuya_iot_client_t *client)
+{
+    if (client == NULL || client->wakeup == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+    return tal_semaphore_post(client->wakeup);
+}
+
 /**
  * @brief Resets the Tuya IoT client.
  *
@@ -765,6 +928,7 @@ int tuya_iot_reset(tuya_iot_client_t *client)
         client->token_get.result = OPRT_COM_ERROR;
         tal_semaphore_post(client->token_get.sem);
     }
+    tuya_iot_wakeup(client);
 
     return ret;
 }
@@ -773,6 +937,7 @@ int tuya_iot_reset(tuya_iot_client_t *client)
  * @brief Destroys the Tuya IoT client.
  *
  * This function destroys the Tuya IoT client and frees any allocated resources.
+ * It waits for a startup version update still in progress.
  *
  * @param client Pointer to the Tuya IoT client structure.
  * @return OPRT_OK if the client is successfully destroyed, otherwise an error
@@ -780,6 +945,11 @@ int tuya_iot_reset(tuya_iot_client_t *client)
  */
 int tuya_iot_destroy(tuya_iot_client_t *client)
 {
+    if (client == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    iot_startup_join(client, SEM_WAIT_FOREVER);
     return OPRT_OK;
 }
 
@@ -841,10 +1011,14 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_MQTT_YIELD:
         tuya_mqtt_loop(&client->mqctx);
         matop_serice_yield(&client->matop);
+        /* Reconnect failed, wait out the backoff */
+        if (!tuya_mqtt_connected(&client->mqctx)) {
+            iot_mqtt_retry_wait(client);
+        }
         break;
 
     case STATE_IDLE:
-        tal_system_sleep(500);
+        iot_wait(client, IOT_IDLE_WAIT_MS);
         break;
 
     case STATE_START:
@@ -910,14 +1084,14 @@ int tuya_iot_yield(tuya_iot_client_t *client)
         if (client->config.network_check && client->config.network_check()) {
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = client->is_activated ? STATE_ENDPOINT_GET : STATE_ENDPOINT_UPDATE;
+            iot_boot_phase_mark(client, TUYA_BOOT_PHASE_NETWORK_UP);
         } else {
-            tal_system_sleep(1000);
+            iot_wait(client, IOT_RETRY_WAIT_MS);
         }
         break;
 
     case STATE_ENDPOINT_GET:
-        ret = tuya_endpoint_cert_get((tuya_endpoint_t *)tuya_endpoint_get());
-        ret |= tuya_endpoint_domain_get((tuya_endpoint_t *)tuya_endpoint_get());
+        ret = tuya_endpoint_load();
         if (OPRT_OK != ret) {
             PR_WARN("tuya endpoint get error %d; need update", ret);
             client->nextstate = STATE_ENDPOINT_UPDATE;
@@ -929,7 +1103,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_ENDPOINT_UPDATE:
         ret = tuya_endpoint_update();
         if (ret != OPRT_OK) {
-            tal_system_sleep(1000);
+            iot_wait(client, IOT_RETRY_WAIT_MS);
             break;
         }
         if (client->is_activated) {
@@ -947,7 +1121,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_ACTIVATING:
         ret = client_activate_process(client, client->binding->token);
         if (ret != OPRT_OK) {
-            tal_system_sleep(1000);
+            iot_wait(client, IOT_RETRY_WAIT_MS);
             break;
         }
 
@@ -969,6 +1143,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
             PR_WARN("tuya endpoint set error %d; need restart update", ret);
         }
         client->is_activated = true;
+        iot_boot_phase_mark(client, TUYA_BOOT_PHASE_ACTIVATED);
 
         /* Retry to load activate */
         client->nextstate = STATE_STARTUP_UPDATE;
@@ -979,6 +1154,8 @@ int tuya_iot_yield(tuya_iot_client_t *client)
         break;
 
     case STATE_STARTUP_UPDATE:
+        iot_boot_phase_mark(client, TUYA_BOOT_PHASE_ENDPOINT_READY);
+
         /* DP event send */
         client->event.id = TUYA_EVENT_BINDED_NOTIFY;
         client->event.type = TUYA_DATE_TYPE_UNDEFINED;
@@ -992,6 +1169,8 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_MQTT_CONNECT_START:
         if (run_state_mqtt_connect_start(client) == OPRT_OK) {
             client->nextstate = STATE_MQTT_CONNECTING;
+        } else {
+            iot_mqtt_retry_wait(client);
         }
         break;
 
@@ -1019,7 +1198,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = STATE_MQTT_CONNECT_START;
         } else {
-            tal_system_sleep(1000);
+            iot_wait(client, IOT_RETRY_WAIT_MS);
         }
         break;
 
@@ -1034,6 +1213,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
         break;
 
     case STATE_STOP:
+        iot_startup_join(client, SEM_WAIT_FOREVER);
         tuya_mqtt_stop(&client->mqctx);
         tuya_mqtt_destory(&client->mqctx);
         client->nextstate = STATE_IDLE;
@@ -1081,8 +1261,12 @@ int tuya_iot_activated_data_remove(tuya_iot_client_t *client)
 
     /* Clean client local data */
     dp_schema_delete(client->activate.devid);
-    tal_kv_del((const char *)(client->activate.schemaId));
-    tal_kv_del((const char *)(client->config.storage_namespace));
+    KV_BATCH_HANDLE batch = NULL;
+    if (OPRT_OK == tal_kv_batch_begin(&batch)) {
+        tal_kv_batch_del(batch, (const char *)(client->activate.schemaId));
+        tal_kv_batch_del(batch, (const char *)(client->config.storage_namespace));
+        tal_kv_batch_commit(batch);
+    }
     tuya_endpoint_remove();
     client->is_activated = false;
     PR_INFO("Activated data remove successed");
@@ -1094,6 +1278,43 @@ int tuya_iot_activated_data_remove(tuya_iot_client_t *client)
     return OPRT_OK;
 }
 
+/**
+ * @brief Publishes an already enveloped DP report without repackaging it.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param json The enveloped report, e.g. {"dps":{..},"devId":".."}.
+ * @param len Length of the report, at most 0xFFFF.
+ * @param cb The callback function to be called when the report is completed.
+ * @param user_data User-defined data to be passed to the callback function.
+ * @param timeout_ms The timeout for the report operation in milliseconds.
+ * @param async Publish asynchronously.
+ *
+ * @return 0 if the report operation is successful, otherwise a negative error
+ * code.
+ */
+int tuya_iot_dp_report_packed(tuya_iot_client_t *client, const char *json, size_t len, tuya_dp_notify_cb_t cb,
+                              void *user_data, int timeout_ms, bool async)
+{
+    if (client == NULL || json == NULL || 0 == len) {
+        PR_ERR("param error");
+        return OPRT_INVALID_PARM;
+    }
+    //! the MQTT publish length is 16 bits
+    if (len > 0xFFFF) {
+        PR_ERR("dp report too long %u", (uint32_t)len);
+        return OPRT_INVALID_PARM;
+    }
+
+    int rt = tuya_mqtt_protocol_data_publish_common(&client->mqctx, PRO_DATA_PUSH, (const uint8_t *)json,
+                                                    (uint16_t)len, (mqtt_publish_notify_cb_t)cb, user_data, timeout_ms,
+                                                    async);
+    if (OPRT_OK == rt && client->boot_time[TUYA_BOOT_PHASE_FIRST_DP] == 0) {
+        iot_boot_phase_mark(client, TUYA_BOOT_PHASE_FIRST_DP);
+        tuya_iot_boot_report(client);
+    }
+    return rt;
+}
+
 static int tuya_iot_dp_report_json_common(tuya_iot_client_t *client, const char *dps, const char *time,
                                           tuya_dp_notify_cb_t cb, void *user_data, int timeout_ms, bool async)
 {
@@ -1103,34 +1324,39 @@ static int tuya_iot_dp_report_json_common(tuya_iot_client_t *client, const char
     }
 
     int ret;
-    int printlen = 0;
+    uint32_t printlen = 0;
     char *buffer = NULL;
     size_t buffer_size = 0;
+    size_t dps_len = strlen(dps);
+    size_t time_len = time ? strlen(time) : 0;
+    tuya_json_writer_t w;
 
     /* Package JSON format */
+    buffer_size = dps_len + time_len + tuya_json_str_escaped_len(client->activate.devid) + 32;
+    buffer = tal_malloc(buffer_size);
+    TUYA_CHECK_NULL_RETURN(buffer, OPRT_MALLOC_FAILED);
+
+    tuya_json_writer_init(&w, buffer, buffer_size);
+    tuya_json_writer_obj_begin(&w);
+    tuya_json_writer_key(&w, "devId");
+    tuya_json_writer_str(&w, client->activate.devid);
+    tuya_json_writer_key(&w, "dps");
+    tuya_json_writer_raw(&w, dps, dps_len);
     if (time) {
-        buffer_size = strlen(dps) + strlen(time) + strlen(client->activate.devid) + 64;
-        buffer = tal_malloc(buffer_size);
-        TUYA_CHECK_NULL_RETURN(buffer, OPRT_MALLOC_FAILED);
-        printlen = snprintf(buffer, buffer_size, "{\"devId\":\"%s\",\"dps\":%s,\"t\":%s}", client->activate.devid, dps, time);
-    } else {
-        buffer_size = strlen(dps) + strlen(client->activate.devid) + 64;
-        buffer = tal_malloc(buffer_size);
-        TUYA_CHECK_NULL_RETURN(buffer, OPRT_MALLOC_FAILED);
-        printlen = snprintf(buffer, buffer_size, "{\"devId\":\"%s\",\"dps\":%s}", client->activate.devid, dps);
+        tuya_json_writer_key(&w, "t");
+        tuya_json_writer_raw(&w, time, time_len);
     }
+    tuya_json_writer_obj_end(&w);
 
     /* Check for truncation */
-    if (printlen >= buffer_size) {
+    if (OPRT_OK != tuya_json_writer_finish(&w, &printlen)) {
         PR_ERR("Buffer too small for JSON data");
         tal_free((void *)buffer);
-        return OPRT_MALLOC_FAILED;
+        return OPRT_BUFFER_NOT_ENOUGH;
     }
 
     /* Report buffer */
-    ret = tuya_mqtt_protocol_data_publish_common(&client->mqctx, PRO_DATA_PUSH, (const uint8_t *)buffer,
-                                                 (uint16_t)printlen, (mqtt_publish_notify_cb_t)cb, user_data,
-                                                 timeout_ms, async);
+    ret = tuya_iot_dp_report_packed(client, buffer, printlen, cb, user_data, timeout_ms, async);
     tal_free((void *)buffer);
     return ret;
 }
@@ -1465,4 +1691,40 @@ bool tuya_iot_is_connected(void)
 int tuya_iot_dispatch_event(tuya_iot_client_t *client)
 {
     return iot_dispatch_event(client);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Gets the time a boot phase was reached.
+ *
+ * @param client Pointer to the Tuya IoT client structure.
+ * @param phase The boot phase.
+ * @return Milliseconds from tuya_iot_init(), 0 if the phase is not reached.
+ */
+uint32_t tuya_iot_boot_phase_time(tuya_iot_client_t *client, tuya_boot_phase_t phase)
+{
+    if (client == NULL || phase >= TUYA_BOOT_PHASE_MAX) {
+        return 0;
+    }
+    return client->boot_time[phase];
+}
+
+/**
+ * @brief Logs the boot phase timing.
+ *
+ * Every phase reached is logged with its time from tuya_iot_init().
+ *
+ * @param client Pointer to the Tuya IoT client structure.
+ */
+void tuya_iot_boot_report(tuya_iot_client_t *client)
+{
+    if (client == NULL) {
+        return;
+    }
+
+    PR_INFO("boot report, init at %u ms uptime:", (uint32_t)client->boot_start);
+    for (int i = 0; i < TUYA_BOOT_PHASE_MAX; i++) {
+        if (client->boot_time[i]) {
+            PR_INFO("  %-16s %6u ms", s_boot_phase_name[i], client->boot_time[i]);
+        }
+    }
+}
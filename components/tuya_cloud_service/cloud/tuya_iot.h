@@ -133,6 +133,18 @@ typedef enum {
     TUYA_RESET_TYPE_DATA_FACTORY,
 } tuya_reset_type_t;
 
+/* boot phases timed from tuya_iot_init(), each is recorded the first time it is reached */
+typedef enum {
+    TUYA_BOOT_PHASE_START,
+    TUYA_BOOT_PHASE_NETWORK_UP,
+    TUYA_BOOT_PHASE_ACTIVATED,
+    TUYA_BOOT_PHASE_ENDPOINT_READY,
+    TUYA_BOOT_PHASE_MQTT_CONNECTED,
+    TUYA_BOOT_PHASE_VERSION_UPDATED,
+    TUYA_BOOT_PHASE_FIRST_DP,
+    TUYA_BOOT_PHASE_MAX,
+} tuya_boot_phase_t;
+
 typedef enum {
     TUYA_DATE_TYPE_UNDEFINED,
     TUYA_DATE_TYPE_BOOLEAN,
@@ -223,8 +235,13 @@ struct tuya_iot_client_handle {
     matop_context_t matop;
     tuya_event_msg_t event;
     tuya_token_get_t token_get;
+    SEM_HANDLE wakeup;
     tuya_binding_info_t *binding;
     TIMER_ID check_upgrade_timer;
+    THREAD_HANDLE startup_thread;
+    SEM_HANDLE startup_done;
+    SYS_TIME_T boot_start;
+    uint32_t boot_time[TUYA_BOOT_PHASE_MAX];
     uint8_t status;
     uint8_t state;
     uint8_t nextstate;
@@ -282,6 +299,18 @@ int tuya_iot_reset(tuya_iot_client_t *client);
  */
 int tuya_iot_reconnect(tuya_iot_client_t *client);
 
+/**
+ * @brief Wake up tuya_iot_yield() when it is waiting for the next state.
+ *
+ * Network link changes, MQTT connect/disconnect and the tuya_iot_xxx control
+ * calls already wake it up. A custom network_check that is not backed by
+ * netmgr should call this when the network comes up.
+ *
+ * @param client - The Tuya client context.
+ * @return int - OPRT_OK successful or error code.
+ */
+int tuya_iot_wakeup(tuya_iot_client_t *client);
+
 /**
  * @brief Destroy the Tuya client and release resources.
  *
@@ -345,6 +374,26 @@ int tuya_iot_dp_report_json_async(tuya_iot_client_t *client, const char *dps, co
 int tuya_iot_dp_report_json_with_notify(tuya_iot_client_t *client, const char *dps, const char *time,
                                         tuya_dp_notify_cb_t cb, void *user_data, int timeout_ms);
 
+/**
+ * @brief Report an already enveloped DP message to the cloud.
+ *
+ * The message carries the full report envelope, e.g.
+ * "{"dps":{"101":true},"devId":"xxx"}", and is published as is.
+ *
+ * @param client - The Tuya client context.
+ * @param json - enveloped DP report.
+ * @param len - length of json, at most 0xFFFF.
+ * @param cb - report result callback, result: OPRT_OK or OPRT_TIMEOUT, or NULL.
+ * It is only called when OPRT_OK is returned, user_data stays with the caller
+ * otherwise.
+ * @param user_data - user context data.
+ * @param timeout_ms - timeout setting uint ms.
+ * @param async - publish asynchronously.
+ * @return int - OPRT_OK successful, OPRT_INVALID_PARM if len exceeds 0xFFFF, or error code.
+ */
+int tuya_iot_dp_report_packed(tuya_iot_client_t *client, const char *json, size_t len, tuya_dp_notify_cb_t cb,
+                              void *user_data, int timeout_ms, bool async);
+
 /**
  * @brief Is Tuya client has been activated?
  *
@@ -451,6 +500,23 @@ bool tuya_iot_is_connected(void);
  */
 int tuya_iot_dispatch_event(tuya_iot_client_t *client);
 
+/**
+ * @brief Get the time a boot phase was reached.
+ *
+ * @param client - The Tuya client context.
+ * @param phase - The boot phase.
+ * @return uint32_t - milliseconds from tuya_iot_init(), 0 if not reached yet.
+ */
+uint32_t tuya_iot_boot_phase_time(tuya_iot_client_t *client, tuya_boot_phase_t phase);
+
+/**
+ * @brief Log the boot phase timing, it is logged once when the first DP is
+ * reported.
+ *
+ * @param client - The Tuya client context.
+ */
+void tuya_iot_boot_report(tuya_iot_client_t *client);
+
 #ifdef __cplusplus
 }
 #endif
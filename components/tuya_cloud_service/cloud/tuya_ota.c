@@ -19,6 +19,7 @@
 #include "tuya_cloud_com_defs.h"
 #include "tuya_endpoint.h"
 #include "iotdns.h"
+#include "tuya_cert_cache.h"
 #include "mix_method.h"
 #include "tal_hash.h"
 
@@ -168,7 +169,7 @@ static void ota_process_thread_func(void *arg)
     uint8_t *cert = NULL;
     uint16_t cert_len = 0;
 
-    tuya_iotdns_query_domain_certs(ota->msg.fw_url, &cert, &cert_len);
+    tuya_cert_cache_get_by_url(ota->msg.fw_url, &cert, &cert_len);
 
     http_download_config_t download_cfg;
     download_cfg.file_size = ota->msg.file_size;
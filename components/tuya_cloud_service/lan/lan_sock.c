@@ -28,6 +28,7 @@
 #include "lan_sock.h"
 #include "tal_api.h"
 #include "tal_network.h"
+#include "tal_net_reactor.h"
 #include "tuya_lan.h"
 
 #pragma pack(1)
@@ -40,6 +41,9 @@ typedef struct LAN_SLOOP_S {
     sloop_sock_t *readers;
     BOOL_T terminate;
     QUEUE_HANDLE queue;
+    BOOL_T reactor; // readers are served by the net reactor instead of the thread
+    int tick_timer;
+    BOOL_T exit_pending; // the exit could not be posted to the reactor, run it on the next tick
 } LAN_SLOOP_S, *P_LAN_SLOOP_S;
 #pragma pack()
 
@@ -50,6 +54,9 @@ static P_LAN_SLOOP_S g_sloop = NULL;
 #define STACK_SIZE_LAN (4 * 1024)
 #endif
 
+/* interval of the pre_select callbacks on the net reactor */
+#define LAN_REACTOR_TICK_MS 1000
+
 static uint32_t __ty_sock_get_reader_num(void)
 {
     return (LAN_UDP_READER_CNT + tuya_lan_get_client_num());
@@ -90,6 +97,9 @@ void __ty_sock_loop_deinit(void)
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
             if (g_sloop->readers[idx].sock != -1) {
                 PR_DEBUG("deinit lan sock %d and close it", g_sloop->readers[idx].sock);
+                if (g_sloop->reactor) {
+                    tal_net_reactor_del(g_sloop->readers[idx].sock);
+                }
                 tal_net_close(g_sloop->readers[idx].sock);
                 g_sloop->readers[idx].sock = -1;
                 g_sloop->readers[idx].pre_select = NULL;
@@ -105,6 +115,9 @@ void __ty_sock_loop_deinit(void)
     if (g_sloop->queue) {
         tal_queue_free(g_sloop->queue);
     }
+    if (g_sloop->reactor) {
+        tal_net_reactor_timer_stop(g_sloop->tick_timer);
+    }
     if (g_sloop->thread) {
         tal_thread_delete(g_sloop->thread);
     }
@@ -114,7 +127,7 @@ void __ty_sock_loop_deinit(void)
     return;
 }
 
-void __ty_add_sock_reader(sloop_sock_t sock_info)
+OPERATE_RET __ty_add_sock_reader(sloop_sock_t sock_info)
 {
     if (sock_info.sock > g_sloop->max_sock) {
         g_sloop->max_sock = sock_info.sock;
@@ -143,11 +156,12 @@ void __ty_add_sock_reader(sloop_sock_t sock_info)
     }
 
     if (idx == __ty_sock_get_reader_num()) {
-        PR_ERR("out of range");
-        return;
+        PR_ERR("out of range, close lan sock %d", sock_info.sock);
+        tal_net_close(sock_info.sock);
+        return OPRT_EXCEED_UPPER_LIMIT;
     }
 
-    return;
+    return OPRT_OK;
 }
 
 void __ty_del_sock_reader(int sock)
@@ -156,6 +170,9 @@ void __ty_del_sock_reader(int sock)
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         if (g_sloop->readers[idx].sock == sock) {
             PR_DEBUG("unreg lan sock %d and close it", sock);
+            if (g_sloop->reactor) {
+                tal_net_reactor_del(g_sloop->readers[idx].sock);
+            }
             tal_net_close(g_sloop->readers[idx].sock);
             g_sloop->readers[idx].sock = -1;
             // g_sloop->readers[idx].pre_select = NULL;
@@ -280,6 +297,126 @@ Err:
     return;
 }
 
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+static void __ty_sock_reactor_ready(int sock, uint8_t events, void *arg)
+{
+    int idx;
+
+    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+        if (g_sloop->readers[idx].sock == sock) {
+            break;
+        }
+    }
+    if (idx == __ty_sock_get_reader_num()) {
+        return;
+    }
+
+    if ((events & TAL_NET_POLL_ERR) && g_sloop->readers[idx].err) {
+        PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), sock, idx);
+        g_sloop->readers[idx].err(sock);
+    }
+    // the err callback may have unregistered the socket
+    if ((events & TAL_NET_POLL_READ) && (g_sloop->readers[idx].sock == sock) && g_sloop->readers[idx].read) {
+        g_sloop->readers[idx].read(sock);
+    }
+}
+
+static void __ty_sock_reactor_exit(void *arg);
+
+static void __ty_sock_reactor_tick(void *arg)
+{
+    int idx;
+
+    if (__atomic_load_n(&g_sloop->exit_pending, __ATOMIC_ACQUIRE)) {
+        __ty_sock_reactor_exit(NULL);
+        return;
+    }
+
+    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+        if (g_sloop->readers[idx].pre_select) {
+            g_sloop->readers[idx].pre_select();
+        }
+    }
+}
+
+static void __ty_sock_reactor_update(void *arg)
+{
+    sloop_sock_t *sock_info = (sloop_sock_t *)arg;
+
+    // posted before the loop was torn down
+    if (NULL == g_sloop) {
+        tal_free(sock_info);
+        return;
+    }
+
+    if (sock_info->read) {
+        // an updated reader is already watched, a dropped one is closed
+        if (OPRT_OK == __ty_add_sock_reader(*sock_info)) {
+            tal_net_reactor_add(sock_info->sock, TAL_NET_POLL_READ, __ty_sock_reactor_ready, NULL);
+        }
+    } else {
+        __ty_del_sock_reader(sock_info->sock);
+    }
+    tal_free(sock_info);
+}
+
+static void __ty_sock_reactor_exit(void *arg)
+{
+    int idx;
+
+    if (NULL == g_sloop) {
+        return;
+    }
+
+    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+        if (g_sloop->readers[idx].quit) {
+            g_sloop->readers[idx].quit();
+        }
+    }
+
+    tuya_lan_exit();
+    __ty_sock_loop_deinit();
+}
+
+static OPERATE_RET __ty_sock_reactor_post(sloop_sock_t *sock_info)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    sloop_sock_t *info = tal_malloc(sizeof(sloop_sock_t));
+    if (NULL == info) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memcpy(info, sock_info, sizeof(sloop_sock_t));
+
+    op_ret = tal_net_reactor_call(__ty_sock_reactor_update, info);
+    if (OPRT_OK != op_ret) {
+        PR_ERR("reactor post err");
+        tal_free(info);
+        return op_ret;
+    }
+    PR_DEBUG("reg post reactor %d", sock_info->sock);
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ty_sock_reactor_init(void)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+
+    op_ret = tal_net_reactor_start();
+    if (OPRT_OK != op_ret) {
+        return op_ret;
+    }
+
+    op_ret = tal_net_reactor_timer_start(LAN_REACTOR_TICK_MS, TRUE, __ty_sock_reactor_tick, NULL,
+                                         &g_sloop->tick_timer);
+    if (OPRT_OK != op_ret) {
+        return op_ret;
+    }
+    g_sloop->reactor = TRUE;
+
+    return OPRT_OK;
+}
+#endif
+
 /**
  * @brief Initializes the socket loop for LAN communication.
  *
@@ -323,6 +460,15 @@ OPERATE_RET tuya_sock_loop_init(void)
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         g_sloop->readers[idx].sock = -1;
     }
+
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    if (OPRT_OK == __ty_sock_reactor_init()) {
+        PR_DEBUG("init sock loop on net reactor");
+        return OPRT_OK;
+    }
+    PR_WARN("net reactor unavailable, use sock loop thread");
+#endif
+
     THREAD_CFG_T thread_cfg = {.priority = THREAD_PRIO_2, .stackDepth = STACK_SIZE_LAN, .thrdname = "lan_sock_loop"};
 
     op_ret = tal_thread_create_and_start(&g_sloop->thread, NULL, NULL, tuya_sock_loop_run, NULL, &thread_cfg);
@@ -355,6 +501,11 @@ Err:
 OPERATE_RET tuya_reg_lan_sock(sloop_sock_t sock_info)
 {
     OPERATE_RET op_ret = OPRT_OK;
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    if (g_sloop->reactor) {
+        return __ty_sock_reactor_post(&sock_info);
+    }
+#endif
     op_ret = tal_queue_post(g_sloop->queue, &sock_info, 0);
     if (OPRT_OK != op_ret) {
         PR_ERR("queue post err");
@@ -380,6 +531,11 @@ OPERATE_RET tuya_unreg_lan_sock(int sock)
     OPERATE_RET op_ret = OPRT_OK;
     sloop_sock_t sock_info = {0};
     sock_info.sock = sock;
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    if (g_sloop->reactor) {
+        return __ty_sock_reactor_post(&sock_info);
+    }
+#endif
     op_ret = tal_queue_post(g_sloop->queue, &sock_info, 0);
     if (OPRT_OK != op_ret) {
         PR_ERR("queue post err");
@@ -402,6 +558,13 @@ void tuya_sock_loop_disable(void)
     }
 
     g_sloop->terminate = FALSE;
+#if defined(ENABLE_NET_REACTOR) && (ENABLE_NET_REACTOR == 1)
+    if (g_sloop->reactor && (OPRT_OK != tal_net_reactor_call(__ty_sock_reactor_exit, NULL))) {
+        // the call ring is full, the next tick runs the exit once the pending calls are drained
+        PR_WARN("reactor busy, defer lan exit");
+        __atomic_store_n(&g_sloop->exit_pending, TRUE, __ATOMIC_RELEASE);
+    }
+#endif
 }
 
 /**
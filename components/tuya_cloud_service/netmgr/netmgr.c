@@ -107,12 +107,13 @@ static void __netmgr_event_cb(netmgr_type_e type, netmgr_status_e status)
                      s_netmgr.active, s_netmgr.status);
             s_netmgr.status = active_status;
             s_netmgr.active = active_conn;
-            tal_event_publish(EVENT_LINK_STATUS_CHG, (void *)s_netmgr.status);
+            // called from the link driver thread, keep subscribers off it
+            tal_event_publish_async(EVENT_LINK_STATUS_CHG, (void *)s_netmgr.status, 0);
         } else if (active_conn == s_netmgr.active) {
             // active_status changed
             PR_DEBUG("netmgr status changed to %d, old %d, active %d", active_status, s_netmgr.status, s_netmgr.active);
             s_netmgr.status = active_status;
-            tal_event_publish(EVENT_LINK_STATUS_CHG, (void *)s_netmgr.status);
+            tal_event_publish_async(EVENT_LINK_STATUS_CHG, (void *)s_netmgr.status, 0);
         } else if (active_status == s_netmgr.status) {
             // active_conn changed
             PR_DEBUG("netmgr active changed to %d, old %d, status %d", active_conn, s_netmgr.active, s_netmgr.status);
@@ -17,23 +17,54 @@
 #include "cJSON.h"
 #include "mix_method.h"
 #include "tal_api.h"
+#include "tuya_json_writer.h"
 
 #define MAX_ITEM_LEN 1024
 
 #define MAX_TRANS_TYPE_NUM (DTT_SCT_SCENE + 1)
 
+#ifndef DP_SCHEMA_NUM_MAX
 #define DP_SCHEMA_NUM_MAX 1
+#endif
+
+// devId hash buckets, must be a power of two
+#define DP_SCHEMA_HASH_SIZE 16
+
+// unchanged dps are reported again after this period, 0 disables it
+#ifndef DP_REPT_FORCE_PERIOD_S
+#define DP_REPT_FORCE_PERIOD_S 0
+#endif
 
 typedef struct {
     // DELAYED_WORK_HANDLE tmm_dp_sync;
     uint16_t serial_no;
     MUTEX_HANDLE mutex;
     uint8_t schema_num;
-    dp_schema_t *schema_list[DP_SCHEMA_NUM_MAX];
+    dp_schema_t *schema_hash[DP_SCHEMA_HASH_SIZE];
 } dp_schema_mgr_t;
 
 static dp_schema_mgr_t s_dsmgr = {0};
 
+static uint32_t s_rept_force_period = DP_REPT_FORCE_PERIOD_S;
+
+/**
+ * @brief FNV-1a hash of a device id.
+ *
+ * @param devid The device ID.
+ * @return The hash value.
+ */
+static uint32_t dp_schema_hash(const char *devid)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*devid) {
+        hash ^= (uint8_t)*devid++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
 /**
  * @brief Appends a JSON string to the given data with the specified time, type,
  * and repetition sequence.
@@ -60,52 +91,49 @@ int dp_rept_json_append(dp_schema_t *schema, char *data, char *time, char *type,
         return OPRT_INVALID_PARM;
     }
 
-    int len = 0;
+    OPERATE_RET op_ret = OPRT_OK;
+    uint32_t data_len = strlen(data);
+    uint32_t time_len = time ? strlen(time) : 0;
+    uint32_t len = data_len + time_len + (type ? tuya_json_str_escaped_len(type) : 0) + DEV_ID_LEN + 64;
+    tuya_json_writer_t w;
 
-    if (NULL == time) {
-        len = strlen(data) + 128;
-    } else {
-        len = strlen(data) + strlen(time) + 128;
-    }
     char *tmp = tal_malloc(len);
     if (NULL == tmp) {
         PR_ERR("tal_malloc err:%d", len);
         return OPRT_MALLOC_FAILED;
     }
-    memset(tmp, 0, len);
 
-    int offset = 0;
-    offset += sprintf(tmp + offset, "{\"dps\":%s,\"devId\":\"%s\"", data, schema->devid);
-    if (offset <= 0) {
-        goto __err_exit;
-    }
+    tuya_json_writer_init(&w, tmp, len);
+    tuya_json_writer_obj_begin(&w);
+    tuya_json_writer_key(&w, "dps");
+    tuya_json_writer_raw(&w, data, data_len);
+    tuya_json_writer_key(&w, "devId");
+    tuya_json_writer_str(&w, schema->devid);
     if (time) {
-        offset += sprintf(tmp + offset, ",\"t\":%s", time);
-        if (offset <= 0) {
-            goto __err_exit;
-        }
+        tuya_json_writer_key(&w, "t");
+        tuya_json_writer_raw(&w, time, time_len);
     }
     if (rept_seq > 0) {
-        offset += sprintf(tmp + offset, ",\"seq\":\"%u\"", rept_seq);
-        if (offset <= 0) {
-            goto __err_exit;
-        }
+        char seq[4];
+        snprintf(seq, sizeof(seq), "%u", rept_seq);
+        tuya_json_writer_key(&w, "seq");
+        tuya_json_writer_str(&w, seq);
     }
     if (type) {
-        offset += sprintf(tmp + offset, ",\"type\":\"%s\"", type);
-        if (offset <= 0) {
-            goto __err_exit;
-        }
+        tuya_json_writer_key(&w, "type");
+        tuya_json_writer_str(&w, type);
+    }
+    tuya_json_writer_obj_end(&w);
+
+    op_ret = tuya_json_writer_finish(&w, NULL);
+    if (OPRT_OK != op_ret) {
+        tal_free((void *)tmp);
+        PR_ERR("json write %d", op_ret);
+        return op_ret;
     }
-    tmp[offset] = '}';
     *pp_out = tmp;
 
     return OPRT_OK;
-
-__err_exit:
-    tal_free((void *)tmp);
-    PR_ERR("sprintf %d", offset);
-    return OPRT_COM_ERROR;
 }
 
 /**
@@ -117,16 +145,11 @@ __err_exit:
  */
 dp_node_t *dp_node_find(dp_schema_t *schema, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
-
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
+    if (id < 0 || id > DP_ID_MAX || 0 == schema->index[id]) {
+        return NULL;
     }
-    return dpnode;
+
+    return &schema->node[schema->index[id] - 1];
 }
 
 /**
@@ -137,19 +160,17 @@ dp_node_t *dp_node_find(dp_schema_t *schema, int id)
  */
 dp_schema_t *dp_schema_find(const char *devid)
 {
-    int i = 0;
-
     PR_TRACE("try to find schema devid %s", devid);
     dp_schema_mgr_t *dsmgr = &s_dsmgr;
-    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
-        if (NULL == dsmgr->schema_list[i]) {
-            continue;
-        }
-        if (0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
-            return dsmgr->schema_list[i];
+    uint32_t hash = dp_schema_hash(devid);
+    dp_schema_t *schema = dsmgr->schema_hash[hash & (DP_SCHEMA_HASH_SIZE - 1)];
+
+    for (; schema != NULL; schema = schema->hash_next) {
+        if (schema->hash == hash && 0 == strcmp(devid, schema->devid)) {
+            return schema;
         }
 
-        PR_TRACE("find schema devid %s, not match!", dsmgr->schema_list[i]->devid);
+        PR_TRACE("find schema devid %s, not match!", schema->devid);
     }
 
     return NULL;
@@ -167,20 +188,12 @@ dp_schema_t *dp_schema_find(const char *devid)
  */
 dp_node_t *dp_node_find_by_devid(char *devid, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
-
     dp_schema_t *schema = dp_schema_find(devid);
     if (NULL == schema) {
         return NULL;
     }
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
-    }
-    return dpnode;
+
+    return dp_node_find(schema, id);
 }
 
 static OPERATE_RET dp_obj_equal_resp(dp_schema_t *schema, uint8_t *dpid, uint8_t num, dp_cmd_type_t cmd_tp)
@@ -385,6 +398,8 @@ int dp_data_recv_parse(dp_recv_msg_t *msg, dp_recv_cb_t dp_recv_cb)
         }
 
         dpnode->pv_stat = PV_STAT_LOCAL;
+        //! the cloud expects the state to be echoed even if it is unchanged
+        dpnode->dirty = true;
 
         switch (dpnode->desc.prop_tp) {
         case PROP_BOOL: {
@@ -508,22 +523,85 @@ void dp_pv_stat_set(dp_schema_t *schema, uint8_t id, dp_pv_stat_t pv_stat)
     }
 }
 
+/**
+ * @brief Sets the period after which an unchanged DP is reported again.
+ *
+ * @param period_s The force report period in seconds, 0 to disable.
+ */
+void dp_rept_force_period_set(uint32_t period_s)
+{
+    s_rept_force_period = period_s;
+}
+
+/**
+ * @brief Clears the dirty bit of the DPs that are about to be reported.
+ *
+ * The cached node value becomes the last reported shadow. A DP that fails to
+ * reach the cloud keeps its PV_STAT_LOCAL status and is resent by the local
+ * state sync.
+ *
+ * @param schema The DP schema.
+ * @param dpvalid The DPs put into the report.
+ */
+static void dp_rept_mark_clean(dp_schema_t *schema, dp_rept_valid_t *dpvalid)
+{
+    uint32_t now = (uint32_t)(tal_system_get_millisecond() / 1000);
+    int i;
+
+    tal_mutex_lock(schema->mutex);
+    for (i = 0; i < dpvalid->num; i++) {
+        dp_node_t *dpnode = dp_node_find(schema, dpvalid->dpid[i]);
+        if (dpnode) {
+            dpnode->dirty = false;
+            dpnode->rept_time = now;
+        }
+    }
+    tal_mutex_unlock(schema->mutex);
+}
+
+/**
+ * @brief Marks the DPs of a report that did not reach the cloud as changed
+ * again.
+ *
+ * @param dpvalid The DPs of the failed report.
+ */
+void dp_rept_mark_dirty(dp_rept_valid_t *dpvalid)
+{
+    dp_schema_t *schema = dpvalid->schema;
+    int i;
+
+    if (NULL == schema) {
+        return;
+    }
+
+    tal_mutex_lock(schema->mutex);
+    for (i = 0; i < dpvalid->num; i++) {
+        dp_node_t *dpnode = dp_node_find(schema, dpvalid->dpid[i]);
+        if (dpnode) {
+            dpnode->dirty = true;
+        }
+    }
+    tal_mutex_unlock(schema->mutex);
+}
+
 static bool dp_rept_update(dp_rept_type_t rept_type, dp_obj_t *dp, dp_node_t *dpnode, int flags)
 {
     bool is_need_update = FALSE;
 
     switch (dpnode->desc.type) {
-    case T_OBJ: {                                  /* obj type */
-        if ((PV_STAT_INVALID == dpnode->pv_stat)   /* Local data status is invalid */
-            || (PV_STAT_LOCAL == dpnode->pv_stat)  /* Local data status not uploaded */
-            || (TRIG_DIRECT == dpnode->desc.trig)  /* Forced upload type */
-            || (rept_type == T_STAT_REPT)          /* Statistical type */
-            || (DP_REPT_NO_FILTER_FLAG & flags)) { /* User forced upload */
+    case T_OBJ: {                                 /* obj type */
+        if ((PV_STAT_INVALID == dpnode->pv_stat)  /* Local data status is invalid */
+            || (dpnode->dirty)                    /* Changed since the last report */
+            || (TRIG_DIRECT == dpnode->desc.trig) /* Forced upload type */
+            || (rept_type == T_STAT_REPT)         /* Statistical type */
+            || (DP_REPT_NO_FILTER_FLAG & flags)   /* User forced upload */
+            || (s_rept_force_period &&            /* Force report period elapsed */
+                (uint32_t)(tal_system_get_millisecond() / 1000) - dpnode->rept_time >= s_rept_force_period)) {
             is_need_update = TRUE;
         }
-        PR_DEBUG("dp<%d> check. need_update:%d pv_stat:%d trig_t:%d type:%d "
+        PR_DEBUG("dp<%d> check. need_update:%d pv_stat:%d dirty:%d trig_t:%d type:%d "
                  "force_send:%d prop_tp:%d",
-                 dpnode->desc.id, is_need_update, dpnode->pv_stat, dpnode->desc.trig, rept_type,
+                 dpnode->desc.id, is_need_update, dpnode->pv_stat, dpnode->dirty, dpnode->desc.trig, rept_type,
                  DP_REPT_NO_FILTER_FLAG & flags, dpnode->desc.prop_tp);
 
         switch (dpnode->desc.prop_tp) {
@@ -783,7 +861,7 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
         }
 
         case PROP_STR: {
-            dpvalid->len += 2 * strlen(dp->value.dp_str) + 15;
+            dpvalid->len += tuya_json_str_escaped_len(dp->value.dp_str) + 8;
         } break;
 
         case PROP_ENUM: {
@@ -792,7 +870,7 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
                 tal_mutex_unlock(schema->mutex);
                 return OPRT_SVC_DP_TYPE_PROP_ILLEGAL;
             }
-            dpvalid->len += strlen(dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]) + 15;
+            dpvalid->len += tuya_json_str_escaped_len(dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]) + 8;
         } break;
 
         default: {
@@ -814,54 +892,17 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
     }
 
     dpvalid->schema = schema;
+    dp_rept_mark_clean(schema, dpvalid);
 
     return OPRT_OK;
 }
 
-/**
- * @brief Outputs the JSON representation of a device property (DP) schema.
- *
- * This function takes a DP schema, input data, validation information, and
- * output data as parameters. It generates the JSON representation of the DP
- * schema based on the provided input data and validation information, and
- * stores the result in the output data structure.
- *
- * @param schema Pointer to the DP schema structure.
- * @param dpin Pointer to the input data structure.
- * @param dpvalid Pointer to the validation information structure.
- * @param dpout Pointer to the output data structure.
- * @return Integer value indicating the success or failure of the operation.
- */
-int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout)
+static int dp_rept_dps_write(tuya_json_writer_t *w, dp_schema_t *schema, dp_rept_in_t *dpin,
+                             dp_rept_valid_t *dpvalid)
 {
     uint16_t i, j;
-    uint16_t offset = 0;
-    uint16_t time_offset = 0;
-    OPERATE_RET op_ret = OPRT_OK;
-    char *dpstr = NULL;
-    char *dptimestr = NULL;
-    bool is_need_time = false;
-
-    dpstr = (char *)tal_malloc(dpvalid->len);
-    if (NULL == dpstr) {
-        PR_ERR("malloc err:%d", dpvalid->len);
-        return OPRT_MALLOC_FAILED;
-    }
-    // STAT type DP needs to assemble a timestamp
-    if ((T_STAT_REPT == dpin->rept_type) && dpvalid->timelen && dpout->timejson) {
-        dptimestr = (char *)tal_malloc(dpvalid->timelen);
-        if (NULL == dptimestr) {
-            PR_ERR("malloc err:%d", dpvalid->timelen);
-            op_ret = OPRT_MALLOC_FAILED;
-            goto __err_exit;
-        }
-        is_need_time = true;
-    }
-    dpstr[offset++] = '{';
-    if (is_need_time) {
-        dptimestr[time_offset++] = '{';
-    }
 
+    tuya_json_writer_obj_begin(w);
     for (i = 0; i < dpvalid->num; i++) {
         dp_obj_t *dp = NULL;
         for (j = 0; j < dpin->dpscnt; j++) {
@@ -872,74 +913,127 @@ int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
         }
         if (NULL == dp) {
             PR_DEBUG("dp not found");
-            op_ret = OPRT_SVC_DP_ID_NOT_FOUND;
-            goto __err_exit;
+            return OPRT_SVC_DP_ID_NOT_FOUND;
         }
-        // dp_obj_t  *dp     = &dpin->dps[dpvalid->dpid[i]];
         dp_node_t *dpnode = dp_node_find(schema, dp->id);
         if (NULL == dpnode) {
             PR_DEBUG("dp->id = %d not found", dp->id);
-            op_ret = OPRT_SVC_DP_ID_NOT_FOUND;
-            goto __err_exit;
+            return OPRT_SVC_DP_ID_NOT_FOUND;
         }
 
         if (dp->type != dpnode->desc.prop_tp) {
-            op_ret = OPRT_SVC_DP_TP_NOT_MATCH;
-            goto __err_exit;
+            return OPRT_SVC_DP_TP_NOT_MATCH;
         }
 
+        tuya_json_writer_key_int(w, dp->id);
         switch (dp->type) {
         case PROP_BOOL: {
-            if (TRUE == dp->value.dp_bool) {
-                offset += sprintf(dpstr + offset, "\"%d\":true,", dp->id);
-            } else {
-                offset += sprintf(dpstr + offset, "\"%d\":false,", dp->id);
-            }
+            tuya_json_writer_bool(w, TRUE == dp->value.dp_bool);
             break;
         }
 
         case PROP_VALUE: {
-            offset += sprintf(dpstr + offset, "\"%d\":%d,", dp->id, dp->value.dp_value);
+            tuya_json_writer_int(w, dp->value.dp_value);
             break;
         }
 
         case PROP_BITMAP: {
-            offset += sprintf(dpstr + offset, "\"%d\":%d,", dp->id, dp->value.dp_bitmap);
+            tuya_json_writer_uint(w, dp->value.dp_bitmap);
             break;
         }
 
         case PROP_STR: {
-            cJSON *temp_str = cJSON_CreateString(dp->value.dp_str);
-            char *tmp_data = cJSON_PrintUnformatted(temp_str);
-            if (tmp_data) {
-                offset += sprintf(dpstr + offset, "\"%d\":%s,", dp->id, tmp_data);
-            }
-            tal_free((void *)tmp_data);
-            cJSON_Delete(temp_str);
+            tuya_json_writer_str(w, dp->value.dp_str);
             break;
         }
 
         case PROP_ENUM: {
-            offset +=
-                sprintf(dpstr + offset, "\"%d\":\"%s\",", dp->id, dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]);
+            tuya_json_writer_str(w, dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]);
         } break;
+
+        default: {
+            return OPRT_SVC_DP_TYPE_PROP_ILLEGAL;
         }
+        }
+    }
+    tuya_json_writer_obj_end(w);
+
+    return OPRT_OK;
+}
+
+static void dp_rept_time_write(tuya_json_writer_t *w, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid)
+{
+    uint16_t i, j;
 
-        if (is_need_time && dp->time_stamp) {
-            time_offset += sprintf(dptimestr + time_offset, "\"%d\":%u,", dp->id, dp->time_stamp);
+    tuya_json_writer_obj_begin(w);
+    for (i = 0; i < dpvalid->num; i++) {
+        for (j = 0; j < dpin->dpscnt; j++) {
+            if (dpvalid->dpid[i] == dpin->dps[j].id && dpin->dps[j].time_stamp) {
+                tuya_json_writer_key_int(w, dpin->dps[j].id);
+                tuya_json_writer_uint(w, dpin->dps[j].time_stamp);
+                break;
+            }
         }
     }
+    tuya_json_writer_obj_end(w);
+}
 
-    dpstr[offset - 1] = '}';
-    dpstr[offset] = 0;
+/**
+ * @brief Outputs the JSON representation of a device property (DP) schema.
+ *
+ * This function takes a DP schema, input data, validation information, and
+ * output data as parameters. It generates the JSON representation of the DP
+ * schema based on the provided input data and validation information, and
+ * stores the result in the output data structure.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpin Pointer to the input data structure.
+ * @param dpvalid Pointer to the validation information structure.
+ * @param dpout Pointer to the output data structure.
+ * @return Integer value indicating the success or failure of the operation.
+ */
+int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    char *dpstr = NULL;
+    char *dptimestr = NULL;
+    bool is_need_time = false;
+    uint32_t size = dpvalid->len + 3;
+    tuya_json_writer_t w;
+
+    dpstr = (char *)tal_malloc(size);
+    if (NULL == dpstr) {
+        PR_ERR("malloc err:%d", size);
+        return OPRT_MALLOC_FAILED;
+    }
+    // STAT type DP needs to assemble a timestamp
+    if ((T_STAT_REPT == dpin->rept_type) && dpvalid->timelen && dpout->timejson) {
+        dptimestr = (char *)tal_malloc(dpvalid->timelen + 3);
+        if (NULL == dptimestr) {
+            PR_ERR("malloc err:%d", dpvalid->timelen);
+            op_ret = OPRT_MALLOC_FAILED;
+            goto __err_exit;
+        }
+        is_need_time = true;
+    }
+
+    tuya_json_writer_init(&w, dpstr, size);
+    op_ret = dp_rept_dps_write(&w, schema, dpin, dpvalid);
+    if (OPRT_OK == op_ret) {
+        op_ret = tuya_json_writer_finish(&w, NULL);
+    }
+    if (OPRT_OK != op_ret) {
+        goto __err_exit;
+    }
 
     dpout->dpsjson = dpstr;
 
     PR_DEBUG("dp rept out: %s", dpstr);
 
     if (is_need_time) {
-        dptimestr[time_offset - 1] = '}';
-        dptimestr[time_offset] = 0;
+        tuya_json_writer_init(&w, dptimestr, dpvalid->timelen + 3);
+        dp_rept_time_write(&w, dpin, dpvalid);
+        tuya_json_writer_finish(&w, NULL);
         PR_DEBUG("dptimestr:%s", dptimestr);
         dpout->timejson = dptimestr;
     }
@@ -955,92 +1049,249 @@ __err_exit:
     return op_ret;
 }
 
-// int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin,
-// dp_rept_out_t *dpout)
-// {
-//     OPERATE_RET op_ret = OPRT_OK;
-
-//     if (NULL == schema || NULL == dpin || NULL == dpout) {
-//         return OPRT_INVALID_PARM;
-//     }
-
-//     dp_rept_valid_t *dpvaild = (dp_rept_valid_t
-//     *)tal_malloc(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpin->dpscnt);
-//     if (NULL == dpvaild) {
-//         return OPRT_MALLOC_FAILED;
-//     }
-//     memset(dpvaild, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) *
-//     dpin->dpscnt);
-
-//     op_ret = dp_obj_valid_check(schema, dpin, dpvaild);
-//     if (OPRT_OK != op_ret) {
-//         goto __err_exit;
-//     }
-
-//     //! TODO:
-//     op_ret = dp_obj_output_to_json(schema, dpin, dpvaild, dpout);
-//     if (OPRT_OK != op_ret) {
-//         goto __err_exit;
-//     }
-
-// __err_exit:
-//     if (dpvaild) {
-//         tal_free((void *)dpvaild);
-//     }
-
-//     return op_ret;
-// }
-
-static int dp_obj_json_create(cJSON *root, dp_node_t *dpnode)
+/**
+ * @brief Returns the buffer size dp_rept_json_write() needs for a report.
+ *
+ * @param dpvalid Pointer to the validation information structure.
+ * @param flags DP_APPEND_HEADER_FLAG to account for the report envelope.
+ * @return The buffer size in bytes, including the terminating null.
+ */
+uint32_t dp_rept_json_size(dp_rept_valid_t *dpvalid, int flags)
+{
+    uint32_t size = dpvalid->len + 3;
+
+    if (flags & DP_APPEND_HEADER_FLAG) {
+        size += dpvalid->timelen + 3 + DEV_ID_LEN + 32;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Serializes the valid DPs of a report into a caller-provided buffer.
+ *
+ * The DPs are written in a single pass. With DP_APPEND_HEADER_FLAG the report
+ * envelope {"dps":{..},"devId":"..","t":{..}} is written around them, the
+ * timestamps are only added for T_STAT_REPT reports.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpin Pointer to the input data structure.
+ * @param dpvalid Pointer to the validation information structure.
+ * @param flags DP_APPEND_HEADER_FLAG to write the report envelope.
+ * @param buf Output buffer.
+ * @param size Size of the output buffer, see dp_rept_json_size().
+ * @param out_len Optional, length of the output.
+ * @return Integer value indicating the success or failure of the operation.
+ */
+int dp_rept_json_write(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, int flags, char *buf,
+                       uint32_t size, uint32_t *out_len)
 {
-    int length = 0;
+    OPERATE_RET op_ret = OPRT_OK;
+    bool header = (flags & DP_APPEND_HEADER_FLAG) ? true : false;
+    tuya_json_writer_t w;
+
+    tuya_json_writer_init(&w, buf, size);
+    if (header) {
+        tuya_json_writer_obj_begin(&w);
+        tuya_json_writer_key(&w, "dps");
+    }
+
+    op_ret = dp_rept_dps_write(&w, schema, dpin, dpvalid);
+    if (OPRT_OK != op_ret) {
+        return op_ret;
+    }
 
-    char dpid[10] = {0};
-    snprintf(dpid, 10, "%d", dpnode->desc.id);
+    if (header) {
+        tuya_json_writer_key(&w, "devId");
+        tuya_json_writer_str(&w, schema->devid);
+        if ((T_STAT_REPT == dpin->rept_type) && dpvalid->timelen) {
+            tuya_json_writer_key(&w, "t");
+            dp_rept_time_write(&w, dpin, dpvalid);
+        }
+        tuya_json_writer_obj_end(&w);
+    }
+
+    op_ret = tuya_json_writer_finish(&w, out_len);
+    if (OPRT_OK != op_ret) {
+        PR_ERR("dp rept json write err:%d size:%d", op_ret, size);
+        return op_ret;
+    }
+
+    PR_DEBUG("dp rept out: %s", buf);
+
+    return OPRT_OK;
+}
+
+static uint32_t dp_obj_json_len(dp_node_t *dpnode)
+{
+    uint32_t length = 0;
 
+    switch (dpnode->desc.prop_tp) {
+    case PROP_BOOL:
+    case PROP_VALUE:
+    case PROP_BITMAP: {
+        length += 20;
+        break;
+    }
+
+    case PROP_STR: {
+        tal_mutex_lock(dpnode->prop.prop_str.dp_str_mutex);
+        if (dpnode->prop.prop_str.value) {
+            length += (8 + tuya_json_str_escaped_len(dpnode->prop.prop_str.value));
+        }
+        tal_mutex_unlock(dpnode->prop.prop_str.dp_str_mutex);
+        break;
+    }
+
+    case PROP_ENUM: {
+        int value = dpnode->prop.prop_enum.value;
+        length += (8 + tuya_json_str_escaped_len(dpnode->prop.prop_enum.pp_enum[value]));
+        break;
+    }
+
+    default: {
+        break;
+    }
+    }
+
+    return length;
+}
+
+static bool dp_obj_json_write(tuya_json_writer_t *w, dp_node_t *dpnode)
+{
     switch (dpnode->desc.prop_tp) {
     case PROP_BOOL: {
-        length += 10;
-        cJSON_AddBoolToObject(root, dpid, dpnode->prop.prop_bool.value);
+        tuya_json_writer_key_int(w, dpnode->desc.id);
+        tuya_json_writer_bool(w, dpnode->prop.prop_bool.value);
         break;
     }
 
     case PROP_VALUE: {
-        length += 10;
-        cJSON_AddNumberToObject(root, dpid, dpnode->prop.prop_int.value);
+        tuya_json_writer_key_int(w, dpnode->desc.id);
+        tuya_json_writer_int(w, dpnode->prop.prop_int.value);
         break;
     }
 
     case PROP_STR: {
+        bool written = false;
         tal_mutex_lock(dpnode->prop.prop_str.dp_str_mutex);
         if (dpnode->prop.prop_str.value) {
-            length += (10 + strlen(dpnode->prop.prop_str.value));
-            cJSON_AddStringToObject(root, dpid, dpnode->prop.prop_str.value);
+            tuya_json_writer_key_int(w, dpnode->desc.id);
+            tuya_json_writer_str(w, dpnode->prop.prop_str.value);
+            written = true;
         }
         tal_mutex_unlock(dpnode->prop.prop_str.dp_str_mutex);
-        break;
+        return written;
     }
 
     case PROP_ENUM: {
         int value = dpnode->prop.prop_enum.value;
-        length += (10 + strlen(dpnode->prop.prop_enum.pp_enum[value]));
-        cJSON_AddStringToObject(root, dpid, dpnode->prop.prop_enum.pp_enum[value]);
+        tuya_json_writer_key_int(w, dpnode->desc.id);
+        tuya_json_writer_str(w, dpnode->prop.prop_enum.pp_enum[value]);
         break;
     }
 
     case PROP_BITMAP: {
-        length += 10;
-        cJSON_AddNumberToObject(root, dpid, dpnode->prop.prop_bitmap.value);
+        tuya_json_writer_key_int(w, dpnode->desc.id);
+        tuya_json_writer_uint(w, dpnode->prop.prop_bitmap.value);
         break;
     }
 
     default: {
         PR_ERR("dp type err:%d", dpnode->desc.prop_tp);
-        break;
+        return false;
     }
     }
 
-    return length;
+    return true;
+}
+
+/**
+ * @brief Serializes the current DP values of a schema.
+ *
+ * @param schema The DP schema.
+ * @param local_only Only dump object DPs not yet synchronized to the cloud.
+ * @param flags DP_APPEND_HEADER_FLAG to write the report envelope.
+ * @param dpvalid Optional, receives the ids of the dumped DPs.
+ * @param max_num Capacity of dpvalid->dpid.
+ * @param pp_out Receives the JSON string, freed by the caller.
+ * @return Integer value indicating the success or failure of the operation.
+ */
+static int dp_obj_json_dump(dp_schema_t *schema, bool local_only, int flags, dp_rept_valid_t *dpvalid,
+                            uint8_t max_num, char **pp_out)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    uint32_t size = 3;
+    uint8_t num = 0;
+    char *buf = NULL;
+    tuya_json_writer_t w;
+    int i;
+
+    for (i = 0; i < schema->num; i++) {
+        dp_node_t *dpnode = &(schema->node[i]);
+        if (local_only && (T_OBJ != dpnode->desc.type || PV_STAT_CLOUD == dpnode->pv_stat)) {
+            continue;
+        }
+        size += dp_obj_json_len(dpnode);
+    }
+    if (flags & DP_APPEND_HEADER_FLAG) {
+        size += DEV_ID_LEN + 32;
+    }
+
+    buf = tal_malloc(size);
+    if (NULL == buf) {
+        PR_ERR("malloc err:%d", size);
+        return OPRT_MALLOC_FAILED;
+    }
+
+    tuya_json_writer_init(&w, buf, size);
+    if (flags & DP_APPEND_HEADER_FLAG) {
+        tuya_json_writer_obj_begin(&w);
+        tuya_json_writer_key(&w, "dps");
+    }
+    tuya_json_writer_obj_begin(&w);
+    for (i = 0; i < schema->num; i++) {
+        dp_node_t *dpnode = &(schema->node[i]);
+        if (local_only && (T_OBJ != dpnode->desc.type || PV_STAT_CLOUD == dpnode->pv_stat)) {
+            continue;
+        }
+        if (dpvalid && dpvalid->num >= max_num) {
+            break;
+        }
+        if (!dp_obj_json_write(&w, dpnode)) {
+            continue;
+        }
+        num++;
+        if (dpvalid) {
+            dpvalid->dpid[dpvalid->num++] = dpnode->desc.id;
+        }
+    }
+    tuya_json_writer_obj_end(&w);
+    if (flags & DP_APPEND_HEADER_FLAG) {
+        tuya_json_writer_key(&w, "devId");
+        tuya_json_writer_str(&w, schema->devid);
+        tuya_json_writer_obj_end(&w);
+    }
+
+    if (0 == num) {
+        PR_DEBUG("Nothing To Pack");
+        op_ret = OPRT_SVC_DP_ID_NOT_FOUND;
+        goto __err_exit;
+    }
+
+    op_ret = tuya_json_writer_finish(&w, NULL);
+    if (OPRT_OK != op_ret) {
+        PR_ERR("Json err:%d", op_ret);
+        goto __err_exit;
+    }
+
+    *pp_out = buf;
+
+    return OPRT_OK;
+
+__err_exit:
+    tal_free((void *)buf);
+    return op_ret;
 }
 
 /**
@@ -1065,19 +1316,20 @@ static int dp_obj_json_create(cJSON *root, dp_node_t *dpnode)
 int dp_obj_dump_stat_local_json(char *devid, dp_rept_valid_t **outdpvalid, char **outjson, int flags)
 {
     int i;
-    size_t length = 0;
+    OPERATE_RET op_ret = OPRT_OK;
+    char *jsonstr = NULL;
     dp_schema_t *schema = dp_schema_find(devid);
     uint8_t dp_stat_local_num = 0;
 
+    if (NULL == schema) {
+        PR_ERR("schema err");
+        return OPRT_INVALID_PARM;
+    }
+
     for (i = 0; i < schema->num; i++) {
         dp_node_t *dpnode = &(schema->node[i]);
-        if (dpnode == NULL) {
-            PR_DEBUG("dpnode NULL");
-            break;
-        }
         if (T_OBJ == dpnode->desc.type && PV_STAT_CLOUD != dpnode->pv_stat) {
             dp_stat_local_num++;
-            continue;
         }
     }
 
@@ -1085,54 +1337,19 @@ int dp_obj_dump_stat_local_json(char *devid, dp_rept_valid_t **outdpvalid, char
         return OPRT_OK;
     }
 
-    cJSON *cjson = cJSON_CreateObject();
-    if (NULL == cjson) {
-        PR_ERR("json err");
-        return OPRT_MALLOC_FAILED;
-    }
-
     dp_rept_valid_t *dpvaild = tal_malloc(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dp_stat_local_num);
     if (NULL == dpvaild) {
-        cJSON_Delete(cjson);
         return OPRT_MALLOC_FAILED;
     }
     memset(dpvaild, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dp_stat_local_num);
     dpvaild->schema = schema;
 
-    for (i = 0; i < schema->num; i++) {
-        dp_node_t *dpnode = &(schema->node[i]);
-        if (dpnode == NULL) {
-            PR_DEBUG("dpnode NULL");
-            break;
-        }
-        if (T_OBJ == dpnode->desc.type && PV_STAT_CLOUD == dpnode->pv_stat) {
-            continue;
-        }
-        if (dpvaild->num < dp_stat_local_num) {
-            dpvaild->dpid[dpvaild->num++] = dpnode->desc.id;
-            length += dp_obj_json_create(cjson, dpnode);
-        }
-    }
-
-    if (length == 0) {
-        PR_DEBUG("Nothing To Pack");
-        cJSON_Delete(cjson);
-        return OPRT_SVC_DP_ID_NOT_FOUND;
-    }
-    char *jsonstr = cJSON_PrintUnformatted(cjson);
-    cJSON_Delete(cjson);
-    if (NULL == jsonstr) {
+    op_ret = dp_obj_json_dump(schema, true, flags, dpvaild, dp_stat_local_num, &jsonstr);
+    if (OPRT_OK != op_ret) {
         tal_free((void *)dpvaild);
-        PR_ERR("Json err");
-        return OPRT_CR_CJSON_ERR;
-    }
-
-    if (flags & DP_APPEND_HEADER_FLAG) {
-        char *out = NULL;
-        dp_rept_json_append(schema, jsonstr, NULL, NULL, 0, &out);
-        tal_free((void *)jsonstr);
-        jsonstr = out;
+        return op_ret;
     }
+    dp_rept_mark_clean(schema, dpvaild);
 
     if (outjson) {
         *outjson = jsonstr;
@@ -1164,55 +1381,17 @@ int dp_obj_dump_stat_local_json(char *devid, dp_rept_valid_t **outdpvalid, char
  */
 char *dp_obj_dump_all_json(char *devid, int flags)
 {
-    cJSON *cjson = cJSON_CreateObject();
-    if (NULL == cjson) {
-        PR_ERR("json err");
-        return NULL;
-    }
-
-    size_t length = 0;
+    char *out = NULL;
     dp_schema_t *schema = dp_schema_find(devid);
     if (NULL == schema) {
-        cJSON_Delete(cjson);
         PR_ERR("schema err");
         return NULL;
     }
 
-    int i;
-
-    for (i = 0; i < schema->num; i++) {
-        dp_node_t *dpnode = &(schema->node[i]);
-        if (dpnode == NULL) {
-            PR_DEBUG("dpnode NULL");
-            break;
-        }
-        if (DP_DUMP_STAT_LOCAL_FLAG & flags) {
-            if (T_OBJ == dpnode->desc.type && PV_STAT_CLOUD == dpnode->pv_stat) {
-                continue;
-            }
-        }
-        length += dp_obj_json_create(cjson, dpnode);
-    } /* end of for */
-
-    if (length == 0) {
-        PR_DEBUG("Nothing To Pack");
-        cJSON_Delete(cjson);
-        return NULL;
-    }
-
-    char *tmp = cJSON_PrintUnformatted(cjson);
-    cJSON_Delete(cjson);
-    if (NULL == tmp) {
-        PR_ERR("Json err");
+    if (OPRT_OK != dp_obj_json_dump(schema, (DP_DUMP_STAT_LOCAL_FLAG & flags) ? true : false, flags, NULL, 0, &out)) {
         return NULL;
     }
 
-    char *out = tmp;
-
-    if (flags & DP_APPEND_HEADER_FLAG) {
-        dp_rept_json_append(schema, out, NULL, NULL, 0, &out);
-    }
-
     return out;
 }
 
@@ -1563,11 +1742,20 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
     dp_schema->actv.preprocess = other_attr.preprocess;
     dp_schema->actv.attach_dp_if = TRUE;
     strncpy(dp_schema->devid, devid, DEV_ID_LEN);
+    // dense dp id index, the first node wins on duplicated ids
+    int i;
+    for (i = nodenum - 1; i >= 0; i--) {
+        dp_schema->index[dp_schema->node[i].desc.id] = i + 1;
+    }
     if (dp_schema_out) {
         *dp_schema_out = dp_schema;
     }
     if (s_dsmgr.schema_num < DP_SCHEMA_NUM_MAX) {
-        s_dsmgr.schema_list[s_dsmgr.schema_num] = dp_schema;
+        uint32_t bucket;
+        dp_schema->hash = dp_schema_hash(dp_schema->devid);
+        bucket = dp_schema->hash & (DP_SCHEMA_HASH_SIZE - 1);
+        dp_schema->hash_next = s_dsmgr.schema_hash[bucket];
+        s_dsmgr.schema_hash[bucket] = dp_schema;
         s_dsmgr.schema_num++;
     }
     PR_DEBUG("create dp_schema Success ");
@@ -1594,19 +1782,17 @@ __exit:
  */
 int dp_schema_delete(char *devid)
 {
-    int i = 0;
-
     PR_TRACE("try to delete schema devid %s", devid);
     dp_schema_mgr_t *dsmgr = &s_dsmgr;
-    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
-        if (NULL == dsmgr->schema_list[i]) {
-            continue;
-        }
-
-        if (0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
-            tal_mutex_release(dsmgr->schema_list[i]->mutex);
-            tal_free((void *)dsmgr->schema_list[i]);
-            dsmgr->schema_list[i] = NULL;
+    uint32_t hash = dp_schema_hash(devid);
+    dp_schema_t **pos = &dsmgr->schema_hash[hash & (DP_SCHEMA_HASH_SIZE - 1)];
+
+    for (; *pos != NULL; pos = &(*pos)->hash_next) {
+        dp_schema_t *schema = *pos;
+        if (schema->hash == hash && 0 == strcmp(devid, schema->devid)) {
+            *pos = schema->hash_next;
+            tal_mutex_release(schema->mutex);
+            tal_free((void *)schema);
             dsmgr->schema_num--;
             return OPRT_OK;
         }
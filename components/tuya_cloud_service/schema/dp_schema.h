@@ -27,6 +27,8 @@ extern "C" {
 
 #define DEV_ID_LEN 25
 
+#define DP_ID_MAX 255
+
 /**
  * @brief  Definition of dp property type
  */
@@ -299,6 +301,10 @@ typedef struct {
     dp_prop_vaule_t prop;
     /** cache status, see dp_pv_stat_t */
     dp_pv_stat_t pv_stat;
+    /** value changed or requested since it was last put into a report */
+    bool dirty;
+    /** uptime in seconds when the dp was last put into a report */
+    uint32_t rept_time;
     uint8_t uling_cnt;
     /** see DP_REPT_FLOW_CTRL */
     // DP_REPT_FLOW_CTRL rept_flow_ctrl;
@@ -321,13 +327,19 @@ typedef struct {
 
 // typedef struct dev_cntl_n_s {
 
-typedef struct {
+typedef struct dp_schema {
     /** virtual id */
     char devid[DEV_ID_LEN + 1];
     /** device attribute, see DEV_ACTV_ATTR_S */
     dp_prop_actv_t actv;
     /** exclusive access to dp */
     MUTEX_HANDLE mutex;
+    /** hash of devid */
+    uint32_t hash;
+    /** next schema in the same devid hash bucket */
+    struct dp_schema *hash_next;
+    /** dp id to node position + 1, 0 if the dp id is not in the schema */
+    uint8_t index[DP_ID_MAX + 1];
     /** count of dp */
     uint8_t num;
     /** dp info */
@@ -466,8 +478,19 @@ int dp_data_recv_parse(dp_recv_msg_t *msg, dp_recv_cb_t dp_recv_cb);
  *         - 0: The data point is valid.
  *         - Other values: The data point is invalid, and the value indicates
  * the specific error code.
+ *
+ * @note On success the DPs in dpvalid are marked clean. A report that then
+ * fails to go out must give them back with dp_rept_mark_dirty().
  */
 int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid);
+
+/**
+ * @brief Marks the DPs of a report that did not reach the cloud as changed
+ * again, so the next report of the same values is not elided.
+ *
+ * @param dpvalid The DPs of the failed report, dpvalid->schema must be set.
+ */
+void dp_rept_mark_dirty(dp_rept_valid_t *dpvalid);
 /**
  * @brief Outputs the JSON representation of a device property (DP) report.
  *
@@ -484,6 +507,32 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
  */
 int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout);
 
+/**
+ * @brief Returns the buffer size needed to serialize a DP report.
+ *
+ * @param dpvalid The validation information for the DP report.
+ * @param flags DP_APPEND_HEADER_FLAG to account for the report envelope.
+ * @return The buffer size in bytes, including the terminating null.
+ */
+uint32_t dp_rept_json_size(dp_rept_valid_t *dpvalid, int flags);
+
+/**
+ * @brief Serializes a DP report into a caller-provided buffer in one pass.
+ *
+ * @param schema The DP schema structure.
+ * @param dpin The input data for the DP report.
+ * @param dpvalid The validation information for the DP report.
+ * @param flags DP_APPEND_HEADER_FLAG to write the {"dps":..,"devId":..}
+ * envelope around the DPs.
+ * @param buf The output buffer.
+ * @param size The size of the output buffer, see dp_rept_json_size().
+ * @param out_len Optional, receives the length of the output.
+ * @return Returns 0 on success, OPRT_BUFFER_NOT_ENOUGH if the buffer is too
+ * small, or another negative error code on failure.
+ */
+int dp_rept_json_write(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, int flags, char *buf,
+                       uint32_t size, uint32_t *out_len);
+
 /**
  * Appends a JSON string to the given data point schema.
  *
@@ -523,6 +572,17 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
  */
 int dp_schema_delete(char *devid);
 
+/**
+ * @brief Sets the period after which an unchanged DP is reported again.
+ *
+ * Object DPs whose value equals the last reported one are dropped from
+ * reports before serialization. Once period_s seconds have passed since a DP
+ * was last reported it is sent again even if unchanged.
+ *
+ * @param period_s The force report period in seconds, 0 to disable.
+ */
+void dp_rept_force_period_set(uint32_t period_s);
+
 /**
  * @brief Dumps all the JSON objects for the specified device ID.
  *
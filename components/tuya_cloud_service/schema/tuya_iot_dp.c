@@ -24,6 +24,7 @@
 #include "tuya_lan.h"
 #include "tal_api.h"
 #include "mix_method.h"
+#include "tuya_json_writer.h"
 
 #ifdef ENABLE_BLUETOOTH
 #include "ble_mgr.h"
@@ -34,19 +35,36 @@ static DELAYED_WORK_HANDLE s_tmm_dp_sync = NULL;
 
 int tuya_iot_dp_sync_start(tuya_iot_client_t *client, uint32_t timeout_s);
 
+/**
+ * @brief Handles a report that did not go out, the DPs were marked clean when
+ * the report was built.
+ *
+ * The DPs get their dirty bit back, the local state sync is scheduled to
+ * resend them and dpvalid is released.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param dpvalid The DPs of the failed report.
+ */
+static void dp_rept_fail(tuya_iot_client_t *client, dp_rept_valid_t *dpvalid)
+{
+    dp_rept_mark_dirty(dpvalid);
+    tal_free((void *)dpvalid);
+    tuya_iot_dp_sync_start(client, 5);
+}
+
 static void dp_sync_cb(int result, void *user_data)
 {
     dp_rept_valid_t *dpvalid = (dp_rept_valid_t *)user_data;
 
-    if (OPRT_OK == result) {
-        for (int i = 0; i < dpvalid->num; i++) {
-            dp_pv_stat_set(dpvalid->schema, dpvalid->dpid[i], PV_STAT_CLOUD);
-        }
-    } else {
+    if (OPRT_OK != result) {
         //! start mqtt cloud sync
-        tuya_iot_dp_sync_start(tuya_iot_client_get(), 5);
+        dp_rept_fail(tuya_iot_client_get(), dpvalid);
+        return;
     }
 
+    for (int i = 0; i < dpvalid->num; i++) {
+        dp_pv_stat_set(dpvalid->schema, dpvalid->dpid[i], PV_STAT_CLOUD);
+    }
     tal_free((void *)dpvalid);
 }
 
@@ -71,14 +89,22 @@ void tuya_iot_dp_sync_process(void *data)
     dp_rept_valid_t *dpvalid = NULL;
     char *dpsjson = NULL;
 
-    int ret = dp_obj_dump_stat_local_json(client->activate.devid, &dpvalid, &dpsjson, 0);
+    int ret = dp_obj_dump_stat_local_json(client->activate.devid, &dpvalid, &dpsjson, DP_APPEND_HEADER_FLAG);
     if (OPRT_OK != ret) {
         PR_ERR("dp sync stat local failed %d", ret);
         tal_workq_start_delayed(s_tmm_dp_sync, 5000, LOOP_ONCE);
         return;
     }
+    if (NULL == dpsjson) {
+        return;
+    }
 
-    tuya_iot_dp_report_json_async(client, dpsjson, NULL, dp_sync_cb, dpvalid, 5000);
+    //! dp_sync_cb owns dpvalid only once the publish is queued
+    ret = tuya_iot_dp_report_packed(client, dpsjson, strlen(dpsjson), dp_sync_cb, dpvalid, 5000, true);
+    if (OPRT_OK != ret) {
+        PR_ERR("dp sync report failed %d", ret);
+        dp_rept_fail(client, dpvalid);
+    }
     tal_free((void *)dpsjson);
 }
 
@@ -234,7 +260,7 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     if (NULL == dpvalid) {
         return OPRT_MALLOC_FAILED;
     }
-    memset(dpvalid, 0, sizeof(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt));
+    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt);
 
     PR_DEBUG("dp report: devid %s, dps 0x%08x, dpscnt %d, flags %d", devid ? devid : "null", dps, dpscnt, flags);
 
@@ -258,7 +284,7 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
 
         ble_dpin = tal_malloc(sizeof(dp_rept_in_t) + sizeof(dp_obj_t) * dpvalid->num);
         if (NULL == ble_dpin) {
-            tal_free((void *)dpvalid);
+            dp_rept_fail(client, dpvalid);
             return OPRT_MALLOC_FAILED;
         }
         ble_dpin->flags = flags;
@@ -278,6 +304,10 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
         PR_DEBUG("ble channel report");
         ret = tuya_ble_dp_report(ble_dpin);
         tal_free((void *)ble_dpin);
+        if (OPRT_OK != ret) {
+            dp_rept_fail(client, dpvalid);
+            return ret;
+        }
         tal_free((void *)dpvalid);
         tuya_iot_dp_sync_start(client, 5);
 
@@ -285,37 +315,47 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     }
 #endif
 
-    dp_rept_out_t dpout;
-
-    memset(&dpout, 0, sizeof(dpout));
+    //! envelope and dps are serialized in one pass into a single buffer
+    uint32_t out_len = 0;
+    uint32_t out_size = dp_rept_json_size(dpvalid, DP_APPEND_HEADER_FLAG);
+    char *out = tal_malloc(out_size);
+    if (NULL == out) {
+        dp_rept_fail(client, dpvalid);
+        return OPRT_MALLOC_FAILED;
+    }
 
-    ret = dp_rept_json_output(schema, &dpin, dpvalid, &dpout);
+    ret = dp_rept_json_write(schema, &dpin, dpvalid, DP_APPEND_HEADER_FLAG, out, out_size, &out_len);
     if (OPRT_OK != ret) {
-        PR_DEBUG("dp rept json output error %d", ret);
+        PR_DEBUG("dp rept json write error %d", ret);
+        tal_free((void *)out);
+        dp_rept_fail(client, dpvalid);
         return ret;
     }
 
     if (tuya_lan_is_connected()) {
-        char *out = NULL;
         PR_DEBUG("lan channel report");
-        dp_rept_json_append(schema, dpout.dpsjson, NULL, NULL, 0, &out);
         ret = tuya_lan_dp_report(out);
-        tal_free((void *)out);
-        tal_free((void *)dpvalid);
-        tuya_iot_dp_sync_start(client, 5);
+        if (OPRT_OK != ret) {
+            dp_rept_fail(client, dpvalid);
+        } else {
+            tal_free((void *)dpvalid);
+            tuya_iot_dp_sync_start(client, 5);
+        }
     } else if (tuya_iot_is_connected()) {
         PR_DEBUG("mqtt channel report");
-        ret = tuya_iot_dp_report_json_with_notify(client, dpout.dpsjson, NULL, dp_sync_cb, dpvalid, 5000);
+        //! dp_sync_cb owns dpvalid only once the publish is queued
+        ret = tuya_iot_dp_report_packed(client, out, out_len, dp_sync_cb, dpvalid, 5000, false);
+        if (OPRT_OK != ret) {
+            PR_ERR("dp report publish failed %d", ret);
+            dp_rept_fail(client, dpvalid);
+        }
     } else {
         PR_ERR("no channel for connect");
+        //! elided from later reports, resend the local state once connected
+        dp_rept_fail(client, dpvalid);
     }
 
-    if (dpout.dpsjson) {
-        tal_free((void *)dpout.dpsjson);
-    }
-    if (dpout.timejson) {
-        tal_free((void *)dpout.timejson);
-    }
+    tal_free((void *)out);
 
     return ret;
 }
@@ -414,36 +454,50 @@ int tuya_iot_dp_raw_report(tuya_iot_client_t *client, const char *devid, dp_raw_
     }
 #endif
 
-    uint32_t encode_len = (dp->len / 3) * 4 + ((dp->len % 3) ? 4 : 0) + 20 + 1;
+    //! {"dps":{"id":"base64"},"devId":"xxx"}
+    uint32_t encode_len = (dp->len / 3) * 4 + ((dp->len % 3) ? 4 : 0) + 1;
+    uint32_t out_size = encode_len + DEV_ID_LEN + 48;
+    uint32_t out_len = 0;
+    char *out = tal_malloc(out_size);
+    char *b64 = NULL;
+    tuya_json_writer_t w;
 
-    dp_rept_out_t dpout;
-
-    memset(&dpout, 0, sizeof(dpout));
-
-    dpout.dpsjson = tal_malloc(encode_len);
-
-    if (NULL == dpout.dpsjson) {
+    if (NULL == out) {
         return OPRT_MALLOC_FAILED;
     }
 
-    uint32_t offset = sprintf(dpout.dpsjson, "{\"%d\":\"", dp->id);
-    tuya_base64_encode(dp->data, dpout.dpsjson + offset, dp->len);
-    strcpy(dpout.dpsjson + strlen(dpout.dpsjson), "\"}");
+    tuya_json_writer_init(&w, out, out_size);
+    tuya_json_writer_obj_begin(&w);
+    tuya_json_writer_key(&w, "dps");
+    tuya_json_writer_obj_begin(&w);
+    tuya_json_writer_key_int(&w, dp->id);
+    tuya_json_writer_raw(&w, "\"", 1);
+    b64 = tuya_json_writer_reserve(&w, encode_len);
+    if (b64) {
+        tuya_base64_encode(dp->data, b64, dp->len);
+        tuya_json_writer_commit(&w, strlen(b64));
+    }
+    tuya_json_writer_raw(&w, "\"", 1);
+    tuya_json_writer_obj_end(&w);
+    tuya_json_writer_key(&w, "devId");
+    tuya_json_writer_str(&w, schema->devid);
+    tuya_json_writer_obj_end(&w);
+
+    ret = tuya_json_writer_finish(&w, &out_len);
+    if (OPRT_OK != ret) {
+        tal_free((void *)out);
+        return ret;
+    }
 
     if (tuya_lan_is_connected()) {
-        char *out = NULL;
-        dp_rept_json_append(schema, dpout.dpsjson, NULL, NULL, 0, &out);
         ret = tuya_lan_dp_report(out);
-        tal_free((void *)out);
     } else if (tuya_iot_is_connected()) {
-        ret = tuya_iot_dp_report_json_async(client, dpout.dpsjson, NULL, dp_raw_async_cb, NULL, timeout);
+        ret = tuya_iot_dp_report_packed(client, out, out_len, dp_raw_async_cb, NULL, timeout, true);
     } else {
         PR_ERR("no channel for connect");
     }
 
-    if (dpout.dpsjson) {
-        tal_free((void *)dpout.dpsjson);
-    }
+    tal_free((void *)out);
 
     return ret;
 }
@@ -47,7 +47,7 @@ typedef ANY_T *ANY_T_ITER;
 /**
  * @brief create a new empty hashmap
  * 
- * @param[in] table_size the hash table size
+ * @param[in] table_size the initial number of slots, the table grows when it fills up
  * @return a new empty hashmap 
  */
 MAP_T tuya_hashmap_new(uint32_t table_size);
@@ -84,6 +84,7 @@ int tuya_hashmap_get(MAP_T in, const char* key, ANY_T *arg);
  * @return MAP_OK on success, others on failed, please refer to the define of hashmap error code  
  * 
  * @note if arg_iterator is NULL, fetch the first element, otherwise, fetch the next element
+ * @warning the iterator is invalidated by tuya_hashmap_put and tuya_hashmap_remove
  */
 int tuya_hashmap_data_traversal(MAP_T in, const char* key, ANY_T_ITER *arg_iterator);
 
@@ -124,6 +125,19 @@ void tuya_hashmap_free(MAP_T in);
  */
 int tuya_hashmap_length(MAP_T in);
 
+/**
+ * @brief measure put, lookup and remove for key_num keys
+ *
+ * Runs from initial tables of 64 and 1024 slots, which grow on the way, and
+ * from one presized for key_num. Results are printed through the log in ns
+ * per op, only available with ENABLE_TUYA_HASHMAP_PERF_TEST.
+ *
+ * @param[in] key_num the number of keys
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_hashmap_perf_test(uint32_t key_num);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
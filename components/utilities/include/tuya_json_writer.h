@@ -0,0 +1,165 @@
+/**
+ * @file tuya_json_writer.h
+ * @brief Streaming JSON writer into a caller-provided, size-bounded buffer.
+ *
+ * The writer appends tokens directly into the buffer, inserting separators
+ * and escaping strings on the fly, so small documents such as DP reports can
+ * be produced without building a cJSON tree or allocating intermediate
+ * strings. Any write that does not fit marks the writer as overflowed and
+ * later writes are ignored; the result is checked once in
+ * tuya_json_writer_finish().
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __TUYA_JSON_WRITER_H__
+#define __TUYA_JSON_WRITER_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    /** output buffer */
+    char *buf;
+    /** buffer size, including the terminating null */
+    uint32_t size;
+    /** current length */
+    uint32_t len;
+    /** no member written yet at the current nesting level */
+    bool first;
+    /** a write did not fit into the buffer */
+    bool overflow;
+} tuya_json_writer_t;
+
+/**
+ * @brief Initializes a writer on a caller-provided buffer.
+ *
+ * @param w Pointer to the writer.
+ * @param buf Output buffer.
+ * @param size Size of the output buffer in bytes.
+ */
+void tuya_json_writer_init(tuya_json_writer_t *w, char *buf, uint32_t size);
+
+/**
+ * @brief Opens an object, as a top-level value or after a key.
+ *
+ * @param w Pointer to the writer.
+ */
+void tuya_json_writer_obj_begin(tuya_json_writer_t *w);
+
+/**
+ * @brief Closes the current object.
+ *
+ * @param w Pointer to the writer.
+ */
+void tuya_json_writer_obj_end(tuya_json_writer_t *w);
+
+/**
+ * @brief Writes an object key. The key is escaped.
+ *
+ * @param w Pointer to the writer.
+ * @param key The key string.
+ */
+void tuya_json_writer_key(tuya_json_writer_t *w, const char *key);
+
+/**
+ * @brief Writes a numeric object key, e.g. a DP id.
+ *
+ * @param w Pointer to the writer.
+ * @param key The key value.
+ */
+void tuya_json_writer_key_int(tuya_json_writer_t *w, int key);
+
+/**
+ * @brief Writes an escaped string value.
+ *
+ * @param w Pointer to the writer.
+ * @param str The string value, NULL is written as null.
+ */
+void tuya_json_writer_str(tuya_json_writer_t *w, const char *str);
+
+/**
+ * @brief Writes a signed integer value.
+ *
+ * @param w Pointer to the writer.
+ * @param value The value.
+ */
+void tuya_json_writer_int(tuya_json_writer_t *w, int32_t value);
+
+/**
+ * @brief Writes an unsigned integer value.
+ *
+ * @param w Pointer to the writer.
+ * @param value The value.
+ */
+void tuya_json_writer_uint(tuya_json_writer_t *w, uint32_t value);
+
+/**
+ * @brief Writes a boolean value.
+ *
+ * @param w Pointer to the writer.
+ * @param value The value.
+ */
+void tuya_json_writer_bool(tuya_json_writer_t *w, bool value);
+
+/**
+ * @brief Writes an already serialized JSON value verbatim.
+ *
+ * @param w Pointer to the writer.
+ * @param raw The serialized value.
+ * @param len Length of the value.
+ */
+void tuya_json_writer_raw(tuya_json_writer_t *w, const char *raw, uint32_t len);
+
+/**
+ * @brief Reserves space at the end of the output for in-place encoding.
+ *
+ * The caller writes at most size bytes at the returned pointer and then calls
+ * tuya_json_writer_commit() with the number of bytes actually produced.
+ *
+ * @param w Pointer to the writer.
+ * @param size Number of bytes to reserve.
+ *
+ * @return Pointer into the output buffer, or NULL if the space is not
+ * available.
+ */
+char *tuya_json_writer_reserve(tuya_json_writer_t *w, uint32_t size);
+
+/**
+ * @brief Commits bytes written into space returned by
+ * tuya_json_writer_reserve().
+ *
+ * @param w Pointer to the writer.
+ * @param len Number of bytes written.
+ */
+void tuya_json_writer_commit(tuya_json_writer_t *w, uint32_t len);
+
+/**
+ * @brief Null-terminates the output and reports the result.
+ *
+ * @param w Pointer to the writer.
+ * @param out_len Optional, length of the output without the terminating null.
+ *
+ * @return OPRT_OK on success, OPRT_BUFFER_NOT_ENOUGH if the output was
+ * truncated.
+ */
+OPERATE_RET tuya_json_writer_finish(tuya_json_writer_t *w, uint32_t *out_len);
+
+/**
+ * @brief Returns the length of a string once escaped and quoted.
+ *
+ * @param str The string.
+ *
+ * @return The escaped length including both quotes.
+ */
+uint32_t tuya_json_str_escaped_len(const char *str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TUYA_JSON_WRITER_H__ */
@@ -19,6 +19,24 @@
 typedef void* TUYA_QUEUE_HANDLE;
 typedef BOOL_T (*TRAVERSE_CB)(void*item, void *ctx);
 
+#define TUYA_QUEUE_WAIT_FOREVER 0xFFFFFFFF
+
+/**
+ * @brief queue concurrency mode
+ *
+ * All modes are fixed-capacity rings allocated at creation, enqueue and
+ * dequeue never allocate.
+ */
+typedef enum {
+    /** lock protected, supports every API, the default */
+    TUYA_QUEUE_LOCKED,
+    /** lock-free, one producer and one consumer thread */
+    TUYA_QUEUE_SPSC,
+    /** lock-free, any number of producers and consumers */
+    TUYA_QUEUE_MPMC,
+    TUYA_QUEUE_MODE_MAX
+} TUYA_QUEUE_MODE_E;
+
 /**
  * @brief create and initialize a queue (FIFO)
  * 
@@ -32,6 +50,24 @@ typedef BOOL_T (*TRAVERSE_CB)(void*item, void *ctx);
  */
 OPERATE_RET tuya_queue_create(const uint32_t queue_len, const uint32_t item_size, TUYA_QUEUE_HANDLE *handle);
 
+/**
+ * @brief create and initialize a queue (FIFO) with the given concurrency mode
+ *
+ * @param[in] queue_len the maximum number of items that the queue can contain,
+ * rounded up to a power of two for the lock-free modes.
+ * @param[in] item_size the number of bytes each item in the queue will require.
+ * @param[in] mode the concurrency mode
+ * @param[out] handle the queue handle
+ *
+ * @note the lock-free modes do not support tuya_queue_input_instant and
+ * tuya_queue_traverse, TUYA_QUEUE_MPMC also not tuya_queue_peek and
+ * tuya_queue_get_batch, they return OPRT_NOT_SUPPORTED.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_queue_create_ex(const uint32_t queue_len, const uint32_t item_size, TUYA_QUEUE_MODE_E mode,
+                                 TUYA_QUEUE_HANDLE *handle);
+
 /**
  * @brief enqueue, append to the tail
  *
@@ -52,6 +88,19 @@ OPERATE_RET tuya_queue_input(TUYA_QUEUE_HANDLE handle, const void *item);
  */
 OPERATE_RET tuya_queue_input_instant(TUYA_QUEUE_HANDLE handle, const void *item);
 
+/**
+ * @brief enqueue, wait for a free slot if the queue is full
+ *
+ * @param[in] handle the queue handle
+ * @param[in] item pointer to the item that is to be placed on the queue.
+ * @param[in] timeout_ms the max wait time, TUYA_QUEUE_WAIT_FOREVER to wait forever
+ *
+ * @note works in every mode, without an OS it does not wait
+ *
+ * @return OPRT_OK on success, OPRT_TIMEOUT on timeout. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_queue_input_wait(TUYA_QUEUE_HANDLE handle, const void *item, const uint32_t timeout_ms);
+
 /**
  * @brief dequeue
  *
@@ -62,6 +111,31 @@ OPERATE_RET tuya_queue_input_instant(TUYA_QUEUE_HANDLE handle, const void *item)
  */
 OPERATE_RET tuya_queue_output(TUYA_QUEUE_HANDLE handle, const void *item);
 
+/**
+ * @brief dequeue, wait for an item if the queue is empty
+ *
+ * @param[in] handle the queue handle
+ * @param[in] item the dequeue item buffer, NULL indicates discard the item
+ * @param[in] timeout_ms the max wait time, TUYA_QUEUE_WAIT_FOREVER to wait forever
+ *
+ * @note works in every mode, without an OS it does not wait
+ *
+ * @return OPRT_OK on success, OPRT_TIMEOUT on timeout. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_queue_output_wait(TUYA_QUEUE_HANDLE handle, const void *item, const uint32_t timeout_ms);
+
+/**
+ * @brief dequeue up to num items at once
+ *
+ * @param[in] handle the queue handle
+ * @param[out] items the item buffer, at least num items long
+ * @param[in] num the max item counts
+ * @param[out] out_num the dequeued item counts
+ *
+ * @return OPRT_OK if any item was dequeued, OPRT_NOT_FOUND if the queue is empty
+ */
+OPERATE_RET tuya_queue_output_batch(TUYA_QUEUE_HANDLE handle, void *items, const uint32_t num, uint32_t *out_num);
+
 /**
  * @brief get the peek item(not dequeue)
  *
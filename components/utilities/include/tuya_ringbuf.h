@@ -29,6 +29,9 @@ typedef enum {
 /**
  * @brief ringbuff create
  *
+ * The ringbuff is safe for one writer and one reader working in parallel
+ * without a lock. The length is rounded up to a power of 2.
+ *
  * @param[in]   len:      ringbuff length
  * @param[in]   type:     ringbuff type
  * @param[in]   ringbuff: ringbuff handle
@@ -100,6 +103,49 @@ uint32_t tuya_ring_buff_peek(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
  */
 uint32_t tuya_ring_buff_write(TUYA_RINGBUFF_T ringbuff, const void *data, uint32_t len);
 
+/**
+ * @brief reserve a contiguous region for writing in place
+ * the region is published by tuya_ring_buff_write_commit
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[out]  data:     start of the region
+ * @param[in]   len:      wanted len
+ * @return  length of the region, may be less than len at the end of the buff
+ *
+ * @note for OVERFLOW_COVERAGE_TYPE the oldest data is dropped to make room
+ */
+uint32_t tuya_ring_buff_write_reserve(TUYA_RINGBUFF_T ringbuff, void **data, uint32_t len);
+
+/**
+ * @brief publish data written into a reserved region
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[in]   len:      written len, not more than reserved
+ * @return  OPRT_OK on success, OPRT_INVALID_PARM if len is more than reserved
+ */
+OPERATE_RET tuya_ring_buff_write_commit(TUYA_RINGBUFF_T ringbuff, uint32_t len);
+
+/**
+ * @brief get the contiguous region of unread data without copying
+ * the region is released by tuya_ring_buff_consume
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[out]  data:     start of the region
+ * @return  length of the region, the rest of the data follows at the start of the buff
+ */
+uint32_t tuya_ring_buff_peek_region(TUYA_RINGBUFF_T ringbuff, void **data);
+
+/**
+ * @brief release data read through tuya_ring_buff_peek_region
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[in]   len:      consumed len
+ * @return  OPRT_OK on success, OPRT_INVALID_PARM if len is more than the unread data,
+ *          OPRT_COM_ERROR for OVERFLOW_COVERAGE_TYPE if the writer overwrote the
+ *          region meanwhile, peek again in that case
+ */
+OPERATE_RET tuya_ring_buff_consume(TUYA_RINGBUFF_T ringbuff, uint32_t len);
+
 
 #ifdef __cplusplus
 }
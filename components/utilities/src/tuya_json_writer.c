@@ -0,0 +1,221 @@
+/**
+ * @file tuya_json_writer.c
+ * @brief Streaming JSON writer into a caller-provided, size-bounded buffer.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tuya_json_writer.h"
+
+static const char s_hex[] = "0123456789abcdef";
+
+static void __json_put(tuya_json_writer_t *w, const char *data, uint32_t len)
+{
+    if (w->overflow) {
+        return;
+    }
+    // keep one byte for the terminating null
+    if (w->len + len >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void __json_putc(tuya_json_writer_t *w, char c)
+{
+    __json_put(w, &c, 1);
+}
+
+static void __json_separator(tuya_json_writer_t *w)
+{
+    if (!w->first) {
+        __json_putc(w, ',');
+    }
+    w->first = false;
+}
+
+static void __json_escape(tuya_json_writer_t *w, const char *str)
+{
+    const char *run = str;
+    char esc[6] = {'\\', 'u', '0', '0', 0, 0};
+
+    __json_putc(w, '"');
+    for (; *str; str++) {
+        uint8_t c = (uint8_t)*str;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        __json_put(w, run, str - run);
+        run = str + 1;
+
+        switch (c) {
+        case '"':
+            __json_put(w, "\\\"", 2);
+            break;
+        case '\\':
+            __json_put(w, "\\\\", 2);
+            break;
+        case '\b':
+            __json_put(w, "\\b", 2);
+            break;
+        case '\f':
+            __json_put(w, "\\f", 2);
+            break;
+        case '\n':
+            __json_put(w, "\\n", 2);
+            break;
+        case '\r':
+            __json_put(w, "\\r", 2);
+            break;
+        case '\t':
+            __json_put(w, "\\t", 2);
+            break;
+        default:
+            esc[4] = s_hex[c >> 4];
+            esc[5] = s_hex[c & 0x0f];
+            __json_put(w, esc, sizeof(esc));
+            break;
+        }
+    }
+    __json_put(w, run, str - run);
+    __json_putc(w, '"');
+}
+
+void tuya_json_writer_init(tuya_json_writer_t *w, char *buf, uint32_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->first = true;
+    w->overflow = (NULL == buf || 0 == size);
+}
+
+void tuya_json_writer_obj_begin(tuya_json_writer_t *w)
+{
+    __json_putc(w, '{');
+    w->first = true;
+}
+
+void tuya_json_writer_obj_end(tuya_json_writer_t *w)
+{
+    __json_putc(w, '}');
+    // the closed object counts as a member of its parent
+    w->first = false;
+}
+
+void tuya_json_writer_key(tuya_json_writer_t *w, const char *key)
+{
+    __json_separator(w);
+    __json_escape(w, key);
+    __json_putc(w, ':');
+}
+
+void tuya_json_writer_key_int(tuya_json_writer_t *w, int key)
+{
+    char tmp[16];
+    int len = snprintf(tmp, sizeof(tmp), "\"%d\":", key);
+
+    __json_separator(w);
+    __json_put(w, tmp, len);
+}
+
+void tuya_json_writer_str(tuya_json_writer_t *w, const char *str)
+{
+    if (NULL == str) {
+        __json_put(w, "null", 4);
+        return;
+    }
+    __json_escape(w, str);
+}
+
+void tuya_json_writer_int(tuya_json_writer_t *w, int32_t value)
+{
+    char tmp[12];
+    int len = snprintf(tmp, sizeof(tmp), "%d", (int)value);
+
+    __json_put(w, tmp, len);
+}
+
+void tuya_json_writer_uint(tuya_json_writer_t *w, uint32_t value)
+{
+    char tmp[12];
+    int len = snprintf(tmp, sizeof(tmp), "%u", (unsigned int)value);
+
+    __json_put(w, tmp, len);
+}
+
+void tuya_json_writer_bool(tuya_json_writer_t *w, bool value)
+{
+    if (value) {
+        __json_put(w, "true", 4);
+    } else {
+        __json_put(w, "false", 5);
+    }
+}
+
+void tuya_json_writer_raw(tuya_json_writer_t *w, const char *raw, uint32_t len)
+{
+    __json_put(w, raw, len);
+}
+
+char *tuya_json_writer_reserve(tuya_json_writer_t *w, uint32_t size)
+{
+    if (w->overflow) {
+        return NULL;
+    }
+    if (w->len + size >= w->size) {
+        w->overflow = true;
+        return NULL;
+    }
+
+    return w->buf + w->len;
+}
+
+void tuya_json_writer_commit(tuya_json_writer_t *w, uint32_t len)
+{
+    if (w->overflow) {
+        return;
+    }
+    w->len += len;
+}
+
+OPERATE_RET tuya_json_writer_finish(tuya_json_writer_t *w, uint32_t *out_len)
+{
+    if (w->overflow) {
+        if (w->buf && w->size) {
+            w->buf[0] = 0;
+        }
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+
+    w->buf[w->len] = 0;
+    if (out_len) {
+        *out_len = w->len;
+    }
+
+    return OPRT_OK;
+}
+
+uint32_t tuya_json_str_escaped_len(const char *str)
+{
+    uint32_t len = 2;
+
+    for (; *str; str++) {
+        uint8_t c = (uint8_t)*str;
+        if (c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t') {
+            len += 2;
+        } else if (c < 0x20) {
+            len += 6;
+        } else {
+            len += 1;
+        }
+    }
+
+    return len;
+}
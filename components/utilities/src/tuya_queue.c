@@ -3,15 +3,14 @@
  * @brief tuya common queue module
  * @version 1.0
  * @date 2019-10-30
- * 
+ *
  * @copyright Copyright 2021-2025 Tuya Inc. All Rights Reserved.
- * 
+ *
  */
 
 #include "tkl_system.h"
 #include "tkl_memory.h"
 
-#include "tuya_list.h"
 #include "tuya_queue.h"
 
 #if defined(OPERATING_SYSTEM) && (SYSTEM_NON_OS == OPERATING_SYSTEM)
@@ -21,13 +20,22 @@
 #define QUEUE_UNLOCK(queue) TKL_EXIT_CRITICAL()
 #else
 #include "tkl_mutex.h"
+#include "tkl_semaphore.h"
 
 #define QUEUE_CREATE_LOCK(queue)  tkl_mutex_create_init(&queue->mutex)
 #define QUEUE_RELEASE_LOCK(queue) tkl_mutex_release(queue->mutex)
 #define QUEUE_LOCK(queue)   tkl_mutex_lock(queue->mutex)
 #define QUEUE_UNLOCK(queue) tkl_mutex_unlock(queue->mutex)
+#define QUEUE_BLOCKING_SUPPORT
+#endif
+
+// producer and consumer indexes are kept this far apart to avoid false sharing
+#ifndef QUEUE_CACHE_LINE_SIZE
+#define QUEUE_CACHE_LINE_SIZE 64
 #endif
 
+#define QUEUE_ALIGN4(x) (((x) + 3) & ~3u)
+
 typedef enum {
     POLICY_SEND_TO_BACK,
     POLICY_SEND_TO_FRONT,
@@ -35,82 +43,351 @@ typedef enum {
 }ENQUEUE_POLICY_E;
 
 typedef struct {
-    LIST_HEAD node;
-    uint8_t data[];
-}QUEUE_ITEM_T;
+    TUYA_QUEUE_MODE_E mode;
+    uint32_t item_size;
+    uint32_t slot_size;
+    uint32_t queue_len;
+    uint32_t mask;
 
-typedef struct {
-#if defined(OPERATING_SYSTEM) && (SYSTEM_NON_OS != OPERATING_SYSTEM)
+#if defined(QUEUE_BLOCKING_SUPPORT)
     TKL_MUTEX_HANDLE mutex;
+    TKL_SEM_HANDLE not_empty;
+    TKL_SEM_HANDLE not_full;
+    uint32_t get_waiters;
+    uint32_t put_waiters;
 #endif
 
-    uint32_t item_size;
-    uint32_t queue_len;
-    uint32_t queue_free;
-    
-    LIST_HEAD head;
+    // TUYA_QUEUE_LOCKED, protected by the lock
+    uint32_t head;
+    uint32_t count;
+
+    // TUYA_QUEUE_SPSC / TUYA_QUEUE_MPMC, free running positions
+    uint8_t pad0[QUEUE_CACHE_LINE_SIZE];
+    uint32_t enq_pos;
+    uint8_t pad1[QUEUE_CACHE_LINE_SIZE];
+    uint32_t deq_pos;
+    uint8_t pad2[QUEUE_CACHE_LINE_SIZE];
+
+    uint8_t slots[];
 }TUYA_QUEUE_T;
 
-static OPERATE_RET __enqueue(TUYA_QUEUE_HANDLE handle, const void *item, ENQUEUE_POLICY_E policy)
+// TUYA_QUEUE_MPMC slot, the sequence tells whether the slot is free or filled for a position
+typedef struct {
+    uint32_t seq;
+    uint8_t data[];
+}QUEUE_CELL_T;
+
+#define QUEUE_SLOT(queue, index) ((queue)->slots + (size_t)(index) * (queue)->slot_size)
+
+static uint32_t __roundup_pow2(uint32_t value)
 {
-    OPERATE_RET op_ret = OPRT_OK;
+    uint32_t pow2 = 1;
 
-    if(NULL == handle || NULL == item || policy >= POLICY_MAX) {
-        return OPRT_INVALID_PARM;
+    while(pow2 < value) {
+        pow2 <<= 1;
     }
 
-    TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
-    
-    QUEUE_ITEM_T *queue_item = (QUEUE_ITEM_T *)tkl_system_malloc(sizeof(QUEUE_ITEM_T) + queue->item_size);
-    if(NULL == queue_item) {
-        return OPRT_MALLOC_FAILED;
-    }
+    return pow2;
+}
 
-    INIT_LIST_HEAD(&(queue_item->node));
-    memcpy(queue_item->data, (void *)item, queue->item_size);
+static OPERATE_RET __locked_enqueue(TUYA_QUEUE_T *queue, const void *item, ENQUEUE_POLICY_E policy)
+{
+    OPERATE_RET op_ret = OPRT_OK;
 
     QUEUE_LOCK(queue);
-    if(queue->queue_free > 0) {
+    if(queue->count < queue->queue_len) {
+        uint32_t index = 0;
         if(POLICY_SEND_TO_BACK == policy) {
-            tuya_list_add_tail(&(queue_item->node), &(queue->head));
-        } else if(POLICY_SEND_TO_FRONT == policy){
-            tuya_list_add(&(queue_item->node), &(queue->head));
+            index = (queue->head + queue->count) % queue->queue_len;
+        } else {
+            queue->head = (queue->head + queue->queue_len - 1) % queue->queue_len;
+            index = queue->head;
         }
-        queue->queue_free--;
+        memcpy(QUEUE_SLOT(queue, index), item, queue->item_size);
+        queue->count++;
     } else {
-        tkl_system_free(queue_item);
         op_ret = OPRT_EXCEED_UPPER_LIMIT;
     }
     QUEUE_UNLOCK(queue);
 
     return op_ret;
+}
+
+static uint32_t __locked_dequeue(TUYA_QUEUE_T *queue, void *items, uint32_t num)
+{
+    uint32_t count = 0;
+
+    QUEUE_LOCK(queue);
+    while(count < num && queue->count > 0) {
+        if(items) {
+            memcpy((uint8_t *)items + count * queue->item_size, QUEUE_SLOT(queue, queue->head), queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->queue_len;
+        queue->count--;
+        count++;
+    }
+    QUEUE_UNLOCK(queue);
+
+    return count;
+}
+
+static OPERATE_RET __spsc_enqueue(TUYA_QUEUE_T *queue, const void *item)
+{
+    uint32_t tail = __atomic_load_n(&queue->enq_pos, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&queue->deq_pos, __ATOMIC_ACQUIRE);
+
+    if(tail - head >= queue->queue_len) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    memcpy(QUEUE_SLOT(queue, tail & queue->mask), item, queue->item_size);
+    __atomic_store_n(&queue->enq_pos, tail + 1, __ATOMIC_RELEASE);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __spsc_dequeue(TUYA_QUEUE_T *queue, void *item, BOOL_T peek)
+{
+    uint32_t head = __atomic_load_n(&queue->deq_pos, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&queue->enq_pos, __ATOMIC_ACQUIRE);
+
+    if(head == tail) {
+        return OPRT_NOT_FOUND;
+    }
+
+    if(item) {
+        memcpy(item, QUEUE_SLOT(queue, head & queue->mask), queue->item_size);
+    }
+    if(!peek) {
+        __atomic_store_n(&queue->deq_pos, head + 1, __ATOMIC_RELEASE);
+    }
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __mpmc_enqueue(TUYA_QUEUE_T *queue, const void *item)
+{
+    QUEUE_CELL_T *cell = NULL;
+    uint32_t pos = __atomic_load_n(&queue->enq_pos, __ATOMIC_RELAXED);
+
+    for(;;) {
+        cell = (QUEUE_CELL_T *)QUEUE_SLOT(queue, pos & queue->mask);
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+        if(0 == diff) {
+            // slot is free for this position, claim it
+            if(__atomic_compare_exchange_n(&queue->enq_pos, &pos, pos + 1, TRUE, __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if(diff < 0) {
+            // slot still holds the item of the previous lap
+            return OPRT_EXCEED_UPPER_LIMIT;
+        } else {
+            pos = __atomic_load_n(&queue->enq_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(cell->data, item, queue->item_size);
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __mpmc_dequeue(TUYA_QUEUE_T *queue, void *item)
+{
+    QUEUE_CELL_T *cell = NULL;
+    uint32_t pos = __atomic_load_n(&queue->deq_pos, __ATOMIC_RELAXED);
+
+    for(;;) {
+        cell = (QUEUE_CELL_T *)QUEUE_SLOT(queue, pos & queue->mask);
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+        if(0 == diff) {
+            if(__atomic_compare_exchange_n(&queue->deq_pos, &pos, pos + 1, TRUE, __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if(diff < 0) {
+            return OPRT_NOT_FOUND;
+        } else {
+            pos = __atomic_load_n(&queue->deq_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    if(item) {
+        memcpy(item, cell->data, queue->item_size);
+    }
+    // hand the slot to the producer of the next lap
+    __atomic_store_n(&cell->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+
+    return OPRT_OK;
+}
+
+#if defined(QUEUE_BLOCKING_SUPPORT)
+static void __wakeup(uint32_t *waiters, TKL_SEM_HANDLE sem)
+{
+    // pairs with the fence in __wait, either the waiter sees the change or we see the waiter
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(waiters, __ATOMIC_RELAXED) > 0) {
+        tkl_semaphore_post(sem);
+    }
+}
+#endif
+
+static OPERATE_RET __enqueue(TUYA_QUEUE_HANDLE handle, const void *item, ENQUEUE_POLICY_E policy)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+
+    if(NULL == handle || NULL == item || policy >= POLICY_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
+
+    if(TUYA_QUEUE_LOCKED == queue->mode) {
+        op_ret = __locked_enqueue(queue, item, policy);
+    } else if(POLICY_SEND_TO_FRONT == policy) {
+        return OPRT_NOT_SUPPORTED;
+    } else if(TUYA_QUEUE_SPSC == queue->mode) {
+        op_ret = __spsc_enqueue(queue, item);
+    } else {
+        op_ret = __mpmc_enqueue(queue, item);
+    }
+
+#if defined(QUEUE_BLOCKING_SUPPORT)
+    if(OPRT_OK == op_ret) {
+        __wakeup(&queue->get_waiters, queue->not_empty);
+    }
+#endif
+
+    return op_ret;
+}
+
+static uint32_t __dequeue(TUYA_QUEUE_T *queue, void *items, uint32_t num)
+{
+    uint32_t count = 0;
+
+    if(TUYA_QUEUE_LOCKED == queue->mode) {
+        count = __locked_dequeue(queue, items, num);
+    } else {
+        while(count < num) {
+            void *item = items ? (uint8_t *)items + count * queue->item_size : NULL;
+            OPERATE_RET op_ret = (TUYA_QUEUE_SPSC == queue->mode) ? __spsc_dequeue(queue, item, FALSE)
+                                                                   : __mpmc_dequeue(queue, item);
+            if(OPRT_OK != op_ret) {
+                break;
+            }
+            count++;
+        }
+    }
+
+#if defined(QUEUE_BLOCKING_SUPPORT)
+    if(count) {
+        __wakeup(&queue->put_waiters, queue->not_full);
+    }
+#endif
+
+    return count;
+}
+
+#if defined(QUEUE_BLOCKING_SUPPORT)
+typedef OPERATE_RET (*QUEUE_TRY_CB)(TUYA_QUEUE_T *queue, void *item);
+
+static OPERATE_RET __try_input(TUYA_QUEUE_T *queue, void *item)
+{
+    return __enqueue(queue, item, POLICY_SEND_TO_BACK);
+}
 
+static OPERATE_RET __try_output(TUYA_QUEUE_T *queue, void *item)
+{
+    return __dequeue(queue, item, 1) ? OPRT_OK : OPRT_NOT_FOUND;
 }
 
+static OPERATE_RET __wait(TUYA_QUEUE_T *queue, QUEUE_TRY_CB try_cb, void *item, uint32_t *waiters,
+                          TKL_SEM_HANDLE sem, uint32_t timeout_ms)
+{
+    OPERATE_RET op_ret = try_cb(queue, item);
+    SYS_TIME_T start = tkl_system_get_millisecond();
+    uint32_t elapsed = 0;
+
+    while((OPRT_OK != op_ret) && (OPRT_NOT_SUPPORTED != op_ret)) {
+        if(elapsed >= timeout_ms) {
+            return OPRT_TIMEOUT;
+        }
+
+        __atomic_fetch_add(waiters, 1, __ATOMIC_SEQ_CST);
+        // check again after announcing ourselves, a post may already have been skipped
+        op_ret = try_cb(queue, item);
+        if(OPRT_OK != op_ret) {
+            tkl_semaphore_wait(sem, (TUYA_QUEUE_WAIT_FOREVER == timeout_ms) ? TKL_SEM_WAIT_FOREVER : timeout_ms - elapsed);
+            op_ret = try_cb(queue, item);
+        }
+        __atomic_fetch_sub(waiters, 1, __ATOMIC_SEQ_CST);
+
+        if(TUYA_QUEUE_WAIT_FOREVER != timeout_ms) {
+            elapsed = (uint32_t)(tkl_system_get_millisecond() - start);
+        }
+    }
+
+    return op_ret;
+}
+#endif
+
 /**
  * @brief create and initialize a queue (FIFO)
- * 
+ *
  * @param[in] queue_len the maximum number of items that the queue can contain.
  * @param[in] item_size the number of bytes each item in the queue will require.
  * @param[out] handle the queue handle
- * 
+ *
  * @note items are queued by copy, not by reference. Each item on the queue must be the same size.
  *
  * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
  */
 OPERATE_RET tuya_queue_create(const uint32_t queue_len, const uint32_t item_size, TUYA_QUEUE_HANDLE *handle)
+{
+    return tuya_queue_create_ex(queue_len, item_size, TUYA_QUEUE_LOCKED, handle);
+}
+
+/**
+ * @brief create and initialize a queue (FIFO) with the given concurrency mode
+ *
+ * @param[in] queue_len the maximum number of items that the queue can contain.
+ * @param[in] item_size the number of bytes each item in the queue will require.
+ * @param[in] mode the concurrency mode, see TUYA_QUEUE_MODE_E
+ * @param[out] handle the queue handle
+ *
+ * @note all slots are allocated here, enqueue and dequeue never allocate.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_queue_create_ex(const uint32_t queue_len, const uint32_t item_size, TUYA_QUEUE_MODE_E mode,
+                                 TUYA_QUEUE_HANDLE *handle)
 {
     OPERATE_RET op_ret = OPRT_OK;
     TUYA_QUEUE_T *queue = NULL;
+    uint32_t slot_num = queue_len;
+    uint32_t slot_size = item_size;
+    uint32_t i = 0;
 
-    if((NULL == handle) || (0 == queue_len) || (0 == item_size)) {
+    if((NULL == handle) || (0 == queue_len) || (0 == item_size) || (mode >= TUYA_QUEUE_MODE_MAX)) {
         return OPRT_INVALID_PARM;
     }
 
-    queue = (TUYA_QUEUE_T *)tkl_system_malloc(sizeof(TUYA_QUEUE_T));
+    if(TUYA_QUEUE_LOCKED != mode) {
+        if(queue_len > 0x80000000u) {
+            return OPRT_INVALID_PARM;
+        }
+        slot_num = __roundup_pow2(queue_len);
+    }
+    if(TUYA_QUEUE_MPMC == mode) {
+        slot_size = sizeof(QUEUE_CELL_T) + QUEUE_ALIGN4(item_size);
+    }
+
+    queue = (TUYA_QUEUE_T *)tkl_system_malloc(sizeof(TUYA_QUEUE_T) + (size_t)slot_num * slot_size);
     if(!queue) {
         return OPRT_MALLOC_FAILED;
     }
+    memset(queue, 0, sizeof(TUYA_QUEUE_T));
 
     op_ret = QUEUE_CREATE_LOCK(queue);
     if(OPRT_OK != op_ret) {
@@ -118,10 +395,24 @@ OPERATE_RET tuya_queue_create(const uint32_t queue_len, const uint32_t item_size
         return OPRT_COM_ERROR;
     }
 
+#if defined(QUEUE_BLOCKING_SUPPORT)
+    if((OPRT_OK != tkl_semaphore_create_init(&queue->not_empty, 0, slot_num)) ||
+       (OPRT_OK != tkl_semaphore_create_init(&queue->not_full, 0, slot_num))) {
+        tuya_queue_release(queue);
+        return OPRT_COM_ERROR;
+    }
+#endif
+
+    queue->mode = mode;
     queue->item_size = item_size;
-    queue->queue_len = queue_len;
-    queue->queue_free = queue_len;
-    INIT_LIST_HEAD(&(queue->head));
+    queue->slot_size = slot_size;
+    queue->queue_len = slot_num;
+    queue->mask = slot_num - 1;
+    if(TUYA_QUEUE_MPMC == mode) {
+        for(i = 0; i < slot_num; i++) {
+            ((QUEUE_CELL_T *)QUEUE_SLOT(queue, i))->seq = i;
+        }
+    }
 
     *handle = (TUYA_QUEUE_HANDLE)queue;
 
@@ -154,6 +445,30 @@ OPERATE_RET tuya_queue_input_instant(TUYA_QUEUE_HANDLE handle, const void *item)
     return __enqueue(handle, item, POLICY_SEND_TO_FRONT);
 }
 
+/**
+ * @brief enqueue, wait for a free slot if the queue is full
+ *
+ * @param[in] handle the queue handle
+ * @param[in] item pointer to the item that is to be placed on the queue.
+ * @param[in] timeout_ms the max wait time, TUYA_QUEUE_WAIT_FOREVER to wait forever
+ *
+ * @return OPRT_OK on success, OPRT_TIMEOUT on timeout. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_queue_input_wait(TUYA_QUEUE_HANDLE handle, const void *item, const uint32_t timeout_ms)
+{
+    if(NULL == handle || NULL == item) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if defined(QUEUE_BLOCKING_SUPPORT)
+    TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
+
+    return __wait(queue, __try_input, (void *)item, &queue->put_waiters, queue->not_full, timeout_ms);
+#else
+    return __enqueue(handle, item, POLICY_SEND_TO_BACK);
+#endif
+}
+
 /**
  * @brief dequeue
  *
@@ -164,29 +479,61 @@ OPERATE_RET tuya_queue_input_instant(TUYA_QUEUE_HANDLE handle, const void *item)
  */
 OPERATE_RET tuya_queue_output(TUYA_QUEUE_HANDLE handle, const void *item)
 {
-    OPERATE_RET op_ret = OPRT_OK;
+    if(NULL == handle) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return __dequeue((TUYA_QUEUE_T *)handle, (void *)item, 1) ? OPRT_OK : OPRT_NOT_FOUND;
+}
 
+/**
+ * @brief dequeue, wait for an item if the queue is empty
+ *
+ * @param[in] handle the queue handle
+ * @param[in] item the dequeue item buffer, NULL indicates discard the item
+ * @param[in] timeout_ms the max wait time, TUYA_QUEUE_WAIT_FOREVER to wait forever
+ *
+ * @return OPRT_OK on success, OPRT_TIMEOUT on timeout. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_queue_output_wait(TUYA_QUEUE_HANDLE handle, const void *item, const uint32_t timeout_ms)
+{
     if(NULL == handle) {
         return OPRT_INVALID_PARM;
     }
 
+#if defined(QUEUE_BLOCKING_SUPPORT)
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
 
-    QUEUE_LOCK(queue);
-    if(queue->queue_free < queue->queue_len) {
-        QUEUE_ITEM_T *queue_item = tuya_list_entry(queue->head.next, QUEUE_ITEM_T, node);
-        if(item) {
-            memcpy((void *)item, queue_item->data, queue->item_size);
-        }
-        tuya_list_del(&(queue_item->node));
-        tkl_system_free(queue_item);
-        queue->queue_free++;
-    } else {
-        op_ret = OPRT_NOT_FOUND;
+    return __wait(queue, __try_output, (void *)item, &queue->get_waiters, queue->not_empty, timeout_ms);
+#else
+    return tuya_queue_output(handle, item);
+#endif
+}
+
+/**
+ * @brief dequeue up to num items at once
+ *
+ * @param[in] handle the queue handle
+ * @param[out] items the item buffer, at least num items long
+ * @param[in] num the max item counts
+ * @param[out] out_num the dequeued item counts
+ *
+ * @return OPRT_OK if any item was dequeued, OPRT_NOT_FOUND if the queue is empty
+ */
+OPERATE_RET tuya_queue_output_batch(TUYA_QUEUE_HANDLE handle, void *items, const uint32_t num, uint32_t *out_num)
+{
+    uint32_t count = 0;
+
+    if(NULL == handle || NULL == items || 0 == num) {
+        return OPRT_INVALID_PARM;
     }
-    QUEUE_UNLOCK(queue);
 
-    return op_ret;
+    count = __dequeue((TUYA_QUEUE_T *)handle, items, num);
+    if(out_num) {
+        *out_num = count;
+    }
+
+    return count ? OPRT_OK : OPRT_NOT_FOUND;
 }
 
 /**
@@ -207,10 +554,15 @@ OPERATE_RET tuya_queue_peek(TUYA_QUEUE_HANDLE handle, const void *item)
 
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
 
+    if(TUYA_QUEUE_SPSC == queue->mode) {
+        return __spsc_dequeue(queue, (void *)item, TRUE);
+    } else if(TUYA_QUEUE_MPMC == queue->mode) {
+        return OPRT_NOT_SUPPORTED;
+    }
+
     QUEUE_LOCK(queue);
-    if(queue->queue_free < queue->queue_len) {
-        QUEUE_ITEM_T *queue_item = tuya_list_entry(queue->head.next, QUEUE_ITEM_T, node);
-        memcpy((void *)item, queue_item->data, queue->item_size);
+    if(queue->count > 0) {
+        memcpy((void *)item, QUEUE_SLOT(queue, queue->head), queue->item_size);
     } else {
         op_ret = OPRT_NOT_FOUND;
     }
@@ -233,13 +585,15 @@ OPERATE_RET tuya_queue_traverse(TUYA_QUEUE_HANDLE handle, TRAVERSE_CB cb, void *
     }
 
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
-    struct tuya_list_head *p = NULL;
-    QUEUE_ITEM_T *queue_item = NULL;
+    uint32_t i = 0;
+
+    if(TUYA_QUEUE_LOCKED != queue->mode) {
+        return OPRT_NOT_SUPPORTED;
+    }
 
     QUEUE_LOCK(queue);
-    tuya_list_for_each(p, &(queue->head)) {
-        queue_item = tuya_list_entry(p, QUEUE_ITEM_T, node);
-        if(!cb(queue_item->data, ctx)) {
+    for(i = 0; i < queue->count; i++) {
+        if(!cb(QUEUE_SLOT(queue, (queue->head + i) % queue->queue_len), ctx)) {
             break;
         }
     }
@@ -253,7 +607,7 @@ OPERATE_RET tuya_queue_traverse(TUYA_QUEUE_HANDLE handle, TRAVERSE_CB cb, void *
  *
  * @param[in] handle the queue handle
  *
- * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h 
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
  */
 OPERATE_RET tuya_queue_clear(TUYA_QUEUE_HANDLE handle)
 {
@@ -262,18 +616,9 @@ OPERATE_RET tuya_queue_clear(TUYA_QUEUE_HANDLE handle)
     }
 
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
-    struct tuya_list_head *p = NULL;
-    struct tuya_list_head *n = NULL;
-    QUEUE_ITEM_T *queue_item = NULL;
 
-    QUEUE_LOCK(queue);
-    tuya_list_for_each_safe(p, n, &(queue->head)) {
-        queue_item = tuya_list_entry(p, QUEUE_ITEM_T, node);
-        tuya_list_del(&queue_item->node);
-        tkl_system_free(queue_item);
-    }
-    queue->queue_free = queue->queue_len;
-    QUEUE_UNLOCK(queue);
+    // lock-free modes drain as a consumer, so only the consumer side may clear them
+    __dequeue(queue, NULL, 0xFFFFFFFF);
 
     return OPRT_OK;
 }
@@ -295,29 +640,36 @@ OPERATE_RET tuya_queue_get_batch(TUYA_QUEUE_HANDLE handle, const uint32_t start,
     }
 
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
-    struct tuya_list_head *p = NULL;
-    QUEUE_ITEM_T *queue_item = NULL;
-    uint32_t index = 0;
     uint32_t count = 0;
 
-    QUEUE_LOCK(queue);
-    tuya_list_for_each(p, &(queue->head)) {
-        if(index < start) {
-            index++;
-            continue;
-        }
+    if(TUYA_QUEUE_MPMC == queue->mode) {
+        return OPRT_NOT_SUPPORTED;
+    }
 
-        if(count >= num) {
-            break;
+    if(TUYA_QUEUE_SPSC == queue->mode) {
+        // only the consumer may look ahead, the producer never touches filled slots
+        uint32_t head = __atomic_load_n(&queue->deq_pos, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&queue->enq_pos, __ATOMIC_ACQUIRE);
+        if((tail - head) < start || (tail - head) - start < num) {
+            return OPRT_NOT_FOUND;
         }
+        for(count = 0; count < num; count++) {
+            memcpy((uint8_t *)items + count * queue->item_size, QUEUE_SLOT(queue, (head + start + count) & queue->mask),
+                   queue->item_size);
+        }
+        return OPRT_OK;
+    }
 
-        queue_item = tuya_list_entry(p, QUEUE_ITEM_T, node);
-        memcpy((uint8_t*)items + count * queue->item_size, queue_item->data, queue->item_size);
-        count++;
+    QUEUE_LOCK(queue);
+    if(queue->count >= start && queue->count - start >= num) {
+        for(count = 0; count < num; count++) {
+            memcpy((uint8_t *)items + count * queue->item_size,
+                   QUEUE_SLOT(queue, (queue->head + start + count) % queue->queue_len), queue->item_size);
+        }
     }
     QUEUE_UNLOCK(queue);
 
-    if(index != start || count != num) {
+    if(count != num) {
         return OPRT_NOT_FOUND;
     }
 
@@ -363,7 +715,7 @@ uint32_t tuya_queue_get_free_num(TUYA_QUEUE_HANDLE handle)
 
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
 
-    return queue->queue_free;
+    return queue->queue_len - tuya_queue_get_used_num(handle);
 }
 
 /**
@@ -371,7 +723,7 @@ uint32_t tuya_queue_get_free_num(TUYA_QUEUE_HANDLE handle)
  *
  * @param[in] handle the queue handle
  *
- * @return the current item counts 
+ * @return the current item counts
  */
 uint32_t tuya_queue_get_used_num(TUYA_QUEUE_HANDLE handle)
 {
@@ -382,8 +734,19 @@ uint32_t tuya_queue_get_used_num(TUYA_QUEUE_HANDLE handle)
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
     uint32_t used_num = 0;
 
+    if(TUYA_QUEUE_LOCKED != queue->mode) {
+        // a snapshot, both positions may move while we read them
+        uint32_t head = __atomic_load_n(&queue->deq_pos, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&queue->enq_pos, __ATOMIC_ACQUIRE);
+        used_num = tail - head;
+        if((int32_t)used_num < 0) {
+            used_num = 0;
+        }
+        return (used_num > queue->mask + 1) ? queue->mask + 1 : used_num;
+    }
+
     QUEUE_LOCK(queue);
-    used_num = queue->queue_len - queue->queue_free;
+    used_num = queue->count;
     QUEUE_UNLOCK(queue);
 
     return used_num;
@@ -394,7 +757,7 @@ uint32_t tuya_queue_get_used_num(TUYA_QUEUE_HANDLE handle)
  *
  * @param[in] handle the queue handle
  *
- * @return the current item counts 
+ * @return the current item counts
  */
 uint32_t tuya_queue_get_max_num(TUYA_QUEUE_HANDLE handle)
 {
@@ -424,11 +787,17 @@ OPERATE_RET tuya_queue_release(TUYA_QUEUE_HANDLE handle)
 
     TUYA_QUEUE_T *queue = (TUYA_QUEUE_T *)handle;
 
-    tuya_queue_clear(handle);
+#if defined(QUEUE_BLOCKING_SUPPORT)
+    if(queue->not_empty) {
+        tkl_semaphore_release(queue->not_empty);
+    }
+    if(queue->not_full) {
+        tkl_semaphore_release(queue->not_full);
+    }
+#endif
 
     op_ret = QUEUE_RELEASE_LOCK(queue);
     tkl_system_free(queue);
 
     return op_ret;
 }
-
@@ -1,3 +1,5 @@
+
+#include <string.h>
 #include "tkl_memory.h"
 #include "tuya_ringbuf.h"
 
@@ -9,27 +11,107 @@
 #define GET_MIN(x, y)   ((x) < (y) ? (x) : (y))
 #define GET_MAX(x, y)   ((x) > (y) ? (x) : (y))
 
+// upper bits of the type are left to platforms, e.g. to place the buffer in PSRAM
+#define RINGBUFF_TYPE_MASK 0x0F
+
+// producer and consumer positions are kept this far apart to avoid false sharing
+#ifndef RINGBUFF_CACHE_LINE_SIZE
+#define RINGBUFF_CACHE_LINE_SIZE 64
+#endif
 
 /*
  * ringbuff structure
+ *
+ * in and out are free running, the buffer position is in & mask and the used
+ * size is in - out. One producer and one consumer can work in parallel: only
+ * the producer moves in and only the consumer moves out, except that in
+ * OVERFLOW_COVERAGE_TYPE the producer pushes out forward to drop the oldest
+ * data. The consumer then confirms its read with a CAS on out and retries if
+ * the data was overwritten meanwhile.
 */
 typedef struct {
     RINGBUFF_TYPE_E type;   ///< ringbuff type
-    uint8_t  reserved;      ///< Reserved
+    uint32_t size;          ///< length of buff data, power of 2
+    uint32_t mask;          ///< size - 1
+    uint32_t peek_out;      ///< out seen by the last peek region, consumer only
+    uint8_t pad0[RINGBUFF_CACHE_LINE_SIZE];
     uint32_t in;            ///< position of input
+    uint8_t pad1[RINGBUFF_CACHE_LINE_SIZE];
     uint32_t out;           ///< position of output
-    uint32_t len;           ///< length of buff data
+    uint8_t pad2[RINGBUFF_CACHE_LINE_SIZE];
     uint8_t buff[];         ///< ring buff
 } __RINGBUFF_T;
 
 #define RINGBUFF_SIZE   sizeof(__RINGBUFF_T)
 
 
-static void __ringbuff_init(__RINGBUFF_T *ringbuff, uint32_t len)
+static void __ringbuff_init(__RINGBUFF_T *ringbuff)
+{
+    __atomic_store_n(&ringbuff->in, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ringbuff->out, 0, __ATOMIC_RELAXED);
+    ringbuff->peek_out = 0;
+}
+
+static void __ringbuff_copy_in(__RINGBUFF_T *rbuff, uint32_t pos, const uint8_t *data, uint32_t len)
 {
-    ringbuff->in = 0;
-    ringbuff->out = 0;
-    ringbuff->len = len;
+    uint32_t idx = pos & rbuff->mask;
+    uint32_t tmp_len = GET_MIN(rbuff->size - idx, len);
+
+    memcpy(&rbuff->buff[idx], data, tmp_len);
+    if (len > tmp_len) {
+        memcpy(rbuff->buff, data + tmp_len, len - tmp_len);
+    }
+}
+
+static void __ringbuff_copy_out(__RINGBUFF_T *rbuff, uint32_t pos, uint8_t *data, uint32_t len)
+{
+    uint32_t idx = pos & rbuff->mask;
+    uint32_t tmp_len = GET_MIN(rbuff->size - idx, len);
+
+    memcpy(data, &rbuff->buff[idx], tmp_len);
+    if (len > tmp_len) {
+        memcpy(data + tmp_len, rbuff->buff, len - tmp_len);
+    }
+}
+
+/* consistent in/out pair as seen by the consumer, returns the used size */
+static uint32_t __ringbuff_used(__RINGBUFF_T *rbuff, uint32_t *out)
+{
+    uint32_t used;
+
+    do {
+        *out = __atomic_load_n(&rbuff->out, __ATOMIC_ACQUIRE);
+        used = __atomic_load_n(&rbuff->in, __ATOMIC_ACQUIRE) - *out;
+        // only possible when the producer overwrote data between the two loads
+    } while (used > rbuff->size);
+
+    return used;
+}
+
+/* producer side, drop the oldest data so that len more bytes fit */
+static void __ringbuff_make_room(__RINGBUFF_T *rbuff, uint32_t in, uint32_t len)
+{
+    uint32_t out = __atomic_load_n(&rbuff->out, __ATOMIC_ACQUIRE);
+    uint32_t need = in + len - rbuff->size;
+
+    while ((int32_t)(need - out) > 0) {
+        if (__atomic_compare_exchange_n(&rbuff->out, &out, need, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+}
+
+/* consumer side, move out past len bytes read at out, FALSE if they were overwritten meanwhile */
+static BOOL_T __ringbuff_advance_out(__RINGBUFF_T *rbuff, uint32_t out, uint32_t len)
+{
+    if (OVERFLOW_COVERAGE_TYPE == rbuff->type) {
+        return __atomic_compare_exchange_n(&rbuff->out, &out, out + len, FALSE, __ATOMIC_SEQ_CST,
+                                           __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&rbuff->out, out + len, __ATOMIC_RELEASE);
+
+    return TRUE;
 }
 
 
@@ -37,22 +119,25 @@ OPERATE_RET tuya_ring_buff_create(uint32_t len, RINGBUFF_TYPE_E type, TUYA_RINGB
 {
     __RINGBUFF_T *rbuff = NULL;
     __RINGBUFF_T **out_ring_buff = (__RINGBUFF_T **)ringbuff;
-    
+    uint32_t size = 1;
 
-    if(type == OVERFLOW_COVERAGE_TYPE) {
-        return OPRT_NOT_SUPPORTED;
+    type &= RINGBUFF_TYPE_MASK;
+    if (ringbuff == NULL || len == 0 || len > 0x80000000 || type > OVERFLOW_COVERAGE_TYPE) {
+        return OPRT_INVALID_PARM;
     }
 
-    if(ringbuff == NULL || len == 0) {
-        return OPRT_INVALID_PARM;
+    while (size < len) {
+        size <<= 1;
     }
-    
-    rbuff = (__RINGBUFF_T *)RINGBUFF_MALLOC(RINGBUFF_SIZE+len);
-    if(rbuff == NULL) {
+
+    rbuff = (__RINGBUFF_T *)RINGBUFF_MALLOC(RINGBUFF_SIZE + size);
+    if (rbuff == NULL) {
         return OPRT_MALLOC_FAILED;
     }
     rbuff->type = type;
-    __ringbuff_init(rbuff, len);
+    rbuff->size = size;
+    rbuff->mask = size - 1;
+    __ringbuff_init(rbuff);
     *out_ring_buff = rbuff;
 
     return OPRT_OK;
@@ -78,158 +163,198 @@ OPERATE_RET tuya_ring_buff_reset(TUYA_RINGBUFF_T ringbuff)
     if (rbuff == NULL) {
         return OPRT_INVALID_PARM;
     }
-    __ringbuff_init(rbuff, rbuff->len);
+    __ringbuff_init(rbuff);
 
     return OPRT_OK;
 }
 
 uint32_t tuya_ring_buff_free_size_get(TUYA_RINGBUFF_T ringbuff)
 {
-    uint32_t size, in, out;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t out;
 
-    if(rbuff == NULL) {
+    if (rbuff == NULL) {
         return 0;
     }
 
-    in = rbuff->in;
-    out = rbuff->out;
-    if(in == out) {
-        size = rbuff->len;
-    }
-    else if (out > in) {
-        size = out - in;
-    }
-    else {
-        size = rbuff->len - (in - out);
+    return rbuff->size - __ringbuff_used(rbuff, &out);
+}
+
+uint32_t tuya_ring_buff_used_size_get(TUYA_RINGBUFF_T ringbuff)
+{
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t out;
+
+    if (rbuff == NULL) {
+        return 0;
     }
 
-    return size - 1;
+    return __ringbuff_used(rbuff, &out);
 }
 
-uint32_t tuya_ring_buff_used_size_get(TUYA_RINGBUFF_T ringbuff)
+uint32_t tuya_ring_buff_write(TUYA_RINGBUFF_T ringbuff, const void *data, uint32_t len)
 {
-    uint32_t size, in, out;
+    const uint8_t *pdata = data;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t in, out;
+    uint32_t write_len;
 
-    if(rbuff == NULL) {
+    if (rbuff == NULL || data == NULL || len == 0) {
         return 0;
     }
 
-    in = rbuff->in;
-    out = rbuff->out;
-    if (in == out) {
-        size = 0;
-    } else if (in > out) {
-        size = in - out;
+    in = __atomic_load_n(&rbuff->in, __ATOMIC_RELAXED);
+    if (OVERFLOW_COVERAGE_TYPE == rbuff->type) {
+        // only the newest size bytes survive anyway
+        write_len = GET_MIN(len, rbuff->size);
+        pdata += len - write_len;
+        __ringbuff_make_room(rbuff, in, write_len);
     } else {
-        size = rbuff->len - (out - in);
+        out = __atomic_load_n(&rbuff->out, __ATOMIC_ACQUIRE);
+        write_len = len = GET_MIN(rbuff->size - (in - out), len);
+        if (len == 0) {
+            return 0;
+        }
     }
 
-    return size;
+    __ringbuff_copy_in(rbuff, in, pdata, write_len);
+    __atomic_store_n(&rbuff->in, in + write_len, __ATOMIC_RELEASE);
+
+    return len;
 }
 
-uint32_t tuya_ring_buff_write(TUYA_RINGBUFF_T ringbuff, const void *data, uint32_t len)
+uint32_t tuya_ring_buff_read(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
 {
-    uint32_t tmp_len;
-    uint32_t free_len;
-    const uint8_t* pdata = data;
+    uint32_t out;
+    uint32_t read_len;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
 
-    if(rbuff == NULL || data == NULL || len == 0) {
-        return 0;
-    }
-    // overwriting unread parts is not supported when the write is full
-    free_len = tuya_ring_buff_free_size_get(rbuff);
-    len = GET_MIN(free_len, len);
-    if(len == 0) {
+    if (rbuff == NULL || data == NULL || len == 0) {
         return 0;
     }
 
-    // write data to remaining buff
-    tmp_len = GET_MIN(rbuff->len - rbuff->in, len);
-    memcpy(&rbuff->buff[rbuff->in], pdata, tmp_len);
-    rbuff->in += tmp_len;
-    len -= tmp_len;
+    do {
+        read_len = __ringbuff_used(rbuff, &out);
+        read_len = GET_MIN(read_len, len);
+        if (read_len == 0) {
+            return 0;
+        }
+        __ringbuff_copy_out(rbuff, out, data, read_len);
+    } while (!__ringbuff_advance_out(rbuff, out, read_len));
 
-    // write remaining data to beginning of buffer
-    if (len > 0) {
-        memcpy(rbuff->buff, &pdata[tmp_len], len);
-        rbuff->in = len;
-    }
+    return read_len;
+}
+
+uint32_t tuya_ring_buff_peek(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
+{
+    uint32_t out;
+    uint32_t read_len;
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
 
-    // buff loopback check
-    if (rbuff->in >= rbuff->len) {
-        rbuff->in = 0;
+    if (rbuff == NULL || data == NULL || len == 0) {
+        return 0;
     }
 
-    return tmp_len + len;
+    do {
+        read_len = __ringbuff_used(rbuff, &out);
+        read_len = GET_MIN(read_len, len);
+        if (read_len == 0) {
+            return 0;
+        }
+        __ringbuff_copy_out(rbuff, out, data, read_len);
+        // out only moves under the consumer's feet when the producer overwrote the data
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&rbuff->out, __ATOMIC_RELAXED) != out);
+
+    return read_len;
 }
 
-uint32_t tuya_ring_buff_read(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
+uint32_t tuya_ring_buff_write_reserve(TUYA_RINGBUFF_T ringbuff, void **data, uint32_t len)
 {
-    uint32_t tmp_len;
-    uint32_t used_len;
-    uint8_t *pdata = data;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t in, out;
+    uint32_t idx;
 
-    if(rbuff == NULL || data == NULL || len == 0) {
+    if (rbuff == NULL || data == NULL) {
         return 0;
     }
 
-    used_len = tuya_ring_buff_used_size_get(rbuff);
-    len = GET_MIN(used_len, len);
-    if (len == 0) {
-        return 0;
+    in = __atomic_load_n(&rbuff->in, __ATOMIC_RELAXED);
+    idx = in & rbuff->mask;
+    *data = &rbuff->buff[idx];
+
+    len = GET_MIN(len, rbuff->size - idx);
+    if (OVERFLOW_COVERAGE_TYPE == rbuff->type) {
+        // the region must be free before the caller starts writing into it
+        __ringbuff_make_room(rbuff, in, len);
+    } else {
+        out = __atomic_load_n(&rbuff->out, __ATOMIC_ACQUIRE);
+        len = GET_MIN(len, rbuff->size - (in - out));
     }
 
-    // read data from linear part of buffer
-    tmp_len = GET_MIN(rbuff->len - rbuff->out, len);
-    memcpy(pdata, &rbuff->buff[rbuff->out], tmp_len);
-    rbuff->out += tmp_len;
-    len -= tmp_len;
+    return len;
+}
+
+OPERATE_RET tuya_ring_buff_write_commit(TUYA_RINGBUFF_T ringbuff, uint32_t len)
+{
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t in, out;
 
-    // read data from beginning of buffer (overflow part)
-    if (len > 0) {
-        memcpy(&pdata[tmp_len], rbuff->buff, len);
-        rbuff->out = len;
+    if (rbuff == NULL) {
+        return OPRT_INVALID_PARM;
     }
 
-    // check end of buffer
-    if (rbuff->out >= rbuff->len) {
-        rbuff->out = 0;
+    in = __atomic_load_n(&rbuff->in, __ATOMIC_RELAXED);
+    out = __atomic_load_n(&rbuff->out, __ATOMIC_ACQUIRE);
+    // more than reserved, the free size and the region end bound any reservation
+    if (len > rbuff->size - (in - out) || len > rbuff->size - (in & rbuff->mask)) {
+        return OPRT_INVALID_PARM;
     }
+    __atomic_store_n(&rbuff->in, in + len, __ATOMIC_RELEASE);
 
-    return tmp_len + len;
+    return OPRT_OK;
 }
 
-uint32_t tuya_ring_buff_peek(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
+uint32_t tuya_ring_buff_peek_region(TUYA_RINGBUFF_T ringbuff, void **data)
 {
-    uint32_t out;
-    uint32_t tmp_len;
-    uint32_t used_len;
-    uint8_t *pdata = data;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t out;
+    uint32_t used;
 
-    if(rbuff == NULL || data == NULL || len == 0) {
+    if (rbuff == NULL || data == NULL) {
         return 0;
     }
 
-    out = rbuff->out;
-    used_len = tuya_ring_buff_used_size_get(rbuff);
+    used = __ringbuff_used(rbuff, &out);
+    rbuff->peek_out = out;
+    *data = &rbuff->buff[out & rbuff->mask];
 
-    len = GET_MIN(len, used_len);
-    if (len == 0) {
-        return 0;
+    return GET_MIN(used, rbuff->size - (out & rbuff->mask));
+}
+
+OPERATE_RET tuya_ring_buff_consume(TUYA_RINGBUFF_T ringbuff, uint32_t len)
+{
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+    uint32_t out;
+
+    if (rbuff == NULL) {
+        return OPRT_INVALID_PARM;
     }
 
-    tmp_len = GET_MIN(rbuff->len - out, len);
-    memcpy(pdata, &rbuff->buff[out], tmp_len);
-    len -= tmp_len;
+    if (OVERFLOW_COVERAGE_TYPE == rbuff->type) {
+        // the region handed out by the last peek was overwritten if out moved since
+        out = rbuff->peek_out;
+        if (len > __atomic_load_n(&rbuff->in, __ATOMIC_ACQUIRE) - out) {
+            return OPRT_INVALID_PARM;
+        }
+        return __ringbuff_advance_out(rbuff, out, len) ? OPRT_OK : OPRT_COM_ERROR;
+    }
 
-    if (len > 0) {
-        memcpy(&pdata[tmp_len], rbuff->buff, len);
+    out = __atomic_load_n(&rbuff->out, __ATOMIC_RELAXED);
+    if (len > __atomic_load_n(&rbuff->in, __ATOMIC_ACQUIRE) - out) {
+        return OPRT_INVALID_PARM;
     }
-    
-    return tmp_len + len;
+    __ringbuff_advance_out(rbuff, out, len);
+
+    return OPRT_OK;
 }
@@ -115,9 +115,8 @@ static OPERATE_RET __ai_audio_player_mp3_playing(void)
         return OPRT_COM_ERROR;
     }
 
-    tal_mutex_lock(sg_player.spk_rb_mutex);
+    // the ring buffer is safe for one writer and one reader, the mutex only guards read against reset
     uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-    tal_mutex_unlock(sg_player.spk_rb_mutex);
     if (0 == rb_used_len && 0 == ctx->mp3_raw_used_len) {
         // PR_DEBUG("mp3 data is empty");
         rt = OPRT_RECV_DA_NOT_ENOUGH;
@@ -250,9 +249,7 @@ static void __ai_audio_player_task(void *arg)
                     tal_sw_timer_stop(ctx->tm_id);
                 }
             }
-            tal_mutex_lock(ctx->spk_rb_mutex);
             uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-            tal_mutex_unlock(ctx->spk_rb_mutex);
             if (rb_used_len == 0 && 0 == ctx->mp3_raw_used_len && ctx->is_eof) {
                 PR_DEBUG("app player end");
                 ctx->stat = AI_AUDIO_PLAYER_STAT_FINISH;
@@ -416,9 +413,7 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
                AI_AUDIO_PLAYER_STAT_START == sg_player.stat)) {
 
             sg_player.is_writing = true;
-            tal_mutex_lock(sg_player.spk_rb_mutex);
             uint32_t rb_free_len = tuya_ring_buff_free_size_get(sg_player.rb_hdl);
-            tal_mutex_unlock(sg_player.spk_rb_mutex);
             // PR_DEBUG("rb_feee_len: %d", rb_free_len);
             if(0 == rb_free_len) {
                 //need unlock mutex before sleep
@@ -430,9 +425,8 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
     
             write_len = GET_MIN_LEN(rb_free_len, (len - alreay_write_len));
     
-            tal_mutex_lock(sg_player.spk_rb_mutex);
+            // the writer is the only producer, reset waits for is_writing to clear
             tuya_ring_buff_write(sg_player.rb_hdl, data + alreay_write_len, write_len);
-            tal_mutex_unlock(sg_player.spk_rb_mutex);
     
             alreay_write_len += write_len;
         };
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cJSON.h"
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tal_kv.h"
+
+#include "tkl_output.h"
+
+#include "tuya_iot.h"
+#include "ble_mgr.h"
+#include "ble_perf.h"
+
+/* Tuya device handle */
+tuya_iot_client_t client;
+
+#define PROJECT_VERSION         "1.0.0"
+
+/**
+ * @brief default benchmark config: a typical phone link with a 247 byte MTU,
+ * a 30 ms connection interval and 4 packets per event, no added latency and
+ * no loss, followed by 20 round trips on the boolean DP 1. Network config is
+ * skipped, the device is not provisioned.
+ */
+static tuya_ble_perf_cfg_t perf_cfg = {
+    .link = {
+        .mtu = 247,
+        .conn_interval_ms = 30,
+        .latency_ms = 0,
+        .loss_percent = 0,
+        .pkts_per_event = 4,
+    },
+    .dp_rounds = 20,
+    .dp_id = 1,
+    .netcfg = NULL,
+    .timeout_ms = 5000,
+};
+
+static void user_usage(const char *name)
+{
+    printf("usage: %s [mtu] [conn_interval_ms] [latency_ms] [loss_percent] [pkts_per_event] [dp_rounds]\n", name);
+}
+
+/**
+ * @brief overrides the default config with the positional arguments given
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return OPRT_OK on success, OPRT_INVALID_PARM if a value is out of range
+ */
+static OPERATE_RET user_cfg_parse(int argc, char *argv[])
+{
+    if (argc > 1) {
+        perf_cfg.link.mtu = (uint16_t)atoi(argv[1]);
+    }
+    if (argc > 2) {
+        perf_cfg.link.conn_interval_ms = (uint16_t)atoi(argv[2]);
+    }
+    if (argc > 3) {
+        perf_cfg.link.latency_ms = (uint16_t)atoi(argv[3]);
+    }
+    if (argc > 4) {
+        perf_cfg.link.loss_percent = (uint8_t)atoi(argv[4]);
+    }
+    if (argc > 5) {
+        perf_cfg.link.pkts_per_event = (uint8_t)atoi(argv[5]);
+    }
+    if (argc > 6) {
+        perf_cfg.dp_rounds = (uint16_t)atoi(argv[6]);
+    }
+
+    if (perf_cfg.link.mtu < TKL_BLE_LOOPBACK_MTU_MIN || perf_cfg.link.mtu > TKL_BLE_LOOPBACK_MTU_MAX ||
+        0 == perf_cfg.link.conn_interval_ms || perf_cfg.link.loss_percent >= 100 ||
+        0 == perf_cfg.link.pkts_per_event || perf_cfg.link.pkts_per_event > TKL_BLE_LOOPBACK_PKTS_PER_EVENT_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return OPRT_OK;
+}
+
+int main(int argc, char *argv[])
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_iot_license_t license;
+    tuya_ble_perf_result_t result;
+
+    if (OPRT_OK != user_cfg_parse(argc, argv)) {
+        user_usage(argv[0]);
+        return -1;
+    }
+
+    cJSON_InitHooks(&(cJSON_Hooks){.malloc_fn = tal_malloc, .free_fn = tal_free});
+
+    /* basic init */
+    tal_log_init(TAL_LOG_LEVEL_INFO, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    tal_kv_init(&(tal_kv_cfg_t){
+        .seed = "vmlkasdh93dlvlcy",
+        .key = "dflfuap134ddlduq",
+    });
+    tal_sw_timer_init();
+    tal_workq_init();
+
+    license.uuid = TUYA_OPENSDK_UUID;
+    license.authkey = TUYA_OPENSDK_AUTHKEY;
+
+    /* Initialize Tuya device configuration */
+    rt = tuya_iot_init(&client, &(const tuya_iot_config_t){
+                                     .software_ver = PROJECT_VERSION,
+                                     .productkey = TUYA_PRODUCT_ID,
+                                     .uuid = license.uuid,
+                                     .authkey = license.authkey,
+                                 });
+    if (OPRT_OK != rt) {
+        PR_ERR("tuya_iot_init error:%d", rt);
+        return -1;
+    }
+
+    /* No netmgr and no tuya_iot_start, the device stays offline and keeps advertising */
+    rt = tuya_ble_init(&(tuya_ble_cfg_t){.client = tuya_iot_client_get(), .device_name = "TYBLE"});
+    if (OPRT_OK != rt) {
+        PR_ERR("tuya_ble_init error:%d", rt);
+        return -1;
+    }
+
+    /* The benchmark blocks, run it here and not on the workqueue the BLE events use */
+    rt = tuya_ble_perf_test(&perf_cfg, &result);
+    if (OPRT_OK != rt) {
+        PR_ERR("tuya_ble_perf_test error:%d", rt);
+        return -1;
+    }
+
+    printf("mtu %u, mtu %u ms, pair %u ms, dp %u rounds rtt min/avg/max %u/%u/%u ms\n", result.mtu,
+           (unsigned)result.mtu_ms, (unsigned)result.pair_ms, result.dp_rounds, (unsigned)result.dp_rtt_min_ms,
+           (unsigned)result.dp_rtt_avg_ms, (unsigned)result.dp_rtt_max_ms);
+
+    return 0;
+}
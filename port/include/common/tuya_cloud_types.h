@@ -1283,6 +1283,8 @@ typedef int TUYA_ERRNO;
 #define UNW_EHOSTDOWN     -26
 #define UNW_EHOSTUNREACH  -27
 #define UNW_EMSGSIZE      -29
+#define UNW_EINPROGRESS   -30
+#define UNW_EALREADY      -31
 #define TUYA_ERRNO_NOT_SUPPORT 255
 
 /** 
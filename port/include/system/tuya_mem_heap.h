@@ -30,6 +30,9 @@ typedef struct {
     unsigned long free_size; // current free heap size
     unsigned long free_watermark; // minimum ever free heap size
     unsigned long max_free_block_size; //size of the largest free block
+    unsigned long slab_size; // heap memory held by small object slabs
+    unsigned long slab_free; // free object bytes inside the slabs
+    unsigned int fragmentation; // free memory not in the largest block, in percent
 }heap_state_t;
 
 typedef void* HEAP_HANDLE;
@@ -43,6 +46,7 @@ void* tuya_mem_heap_realloc(HEAP_HANDLE handle, void *ptr, unsigned int size);
 void tuya_mem_heap_free(HEAP_HANDLE handle, void *ptr);
 void tuya_mem_heap_state(HEAP_HANDLE handle, heap_state_t *state);
 int tuya_mem_heap_available(HEAP_HANDLE handle);
+unsigned int tuya_mem_heap_usable_size(void *ptr);
 
 void* tuya_mem_heap_debug_malloc(HEAP_HANDLE handle, unsigned int size, char* filename, int line);
 void* tuya_mem_heap_debug_calloc(HEAP_HANDLE handle, unsigned int size, char* filename, int line);
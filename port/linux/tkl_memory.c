@@ -17,8 +17,16 @@
 
 #define MAX_HEAP_SIZE (512*10*1024)
 
+/* size of the managed heap, 0 serves every allocation from libc */
+#ifndef TKL_MEMORY_HEAP_SIZE
+#define TKL_MEMORY_HEAP_SIZE MAX_HEAP_SIZE
+#endif
+
 static pthread_mutex_t s_heap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t s_heap_once = PTHREAD_ONCE_INIT;
 static HEAP_HANDLE s_heap_handle = NULL;
+static char *s_heap_buf = NULL;
+static int s_libc_blocks = 0; // live blocks served by libc instead of the heap
 
 static void __heap_lock(void)
 {
@@ -37,9 +45,48 @@ static void __heap_init(void)
     ctx.enter_critical = __heap_lock;
     ctx.exit_critical = __heap_unlock;
 
-    char* buf = malloc(MAX_HEAP_SIZE);
+    if (0 == TKL_MEMORY_HEAP_SIZE) {
+        return;
+    }
+
+    char* buf = malloc(TKL_MEMORY_HEAP_SIZE);
+    if (NULL == buf) {
+        return;
+    }
+
     tuya_mem_heap_init(&ctx);
-    tuya_mem_heap_create(buf, MAX_HEAP_SIZE, &s_heap_handle);
+    if (0 != tuya_mem_heap_create(buf, TKL_MEMORY_HEAP_SIZE, &s_heap_handle)) {
+        s_heap_handle = NULL;
+        free(buf);
+        return;
+    }
+    s_heap_buf = buf;
+}
+
+static HEAP_HANDLE __heap_get(void)
+{
+    pthread_once(&s_heap_once, __heap_init);
+    return s_heap_handle;
+}
+
+static int __heap_owns(void *ptr)
+{
+    return s_heap_buf && ((char *)ptr >= s_heap_buf) && ((char *)ptr < s_heap_buf + TKL_MEMORY_HEAP_SIZE);
+}
+
+static void *__libc_malloc(size_t size)
+{
+    void *p = malloc(size);
+    if (p) {
+        __atomic_add_fetch(&s_libc_blocks, 1, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+static void __libc_free(void *ptr)
+{
+    __atomic_sub_fetch(&s_libc_blocks, 1, __ATOMIC_RELAXED);
+    free(ptr);
 }
 
 /**
@@ -47,20 +94,22 @@ static void __heap_init(void)
 *
 * @param[in] size: memory size
 *
-* @note This API is used to alloc memory of system.
+* @note This API is used to alloc memory of system. Allocations are served
+* from the managed heap, large ones or those that no longer fit fall back
+* to libc.
 *
 * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
 */
 void* tkl_system_malloc(const SIZE_T size)
 {
-    // if(!s_heap_handle) {
-    //     __heap_init();
-    // }
+    HEAP_HANDLE heap = __heap_get();
+    void *p = NULL;
 
-    // return tuya_mem_heap_malloc(s_heap_handle, size);
-    void * p = malloc(size);
-    // printf("=================p :%p\n", p);
-    return p;
+    if (heap && size <= TKL_MEMORY_HEAP_SIZE) {
+        p = tuya_mem_heap_malloc(heap, size);
+    }
+
+    return p ? p : __libc_malloc(size);
 }
 
 /**
@@ -74,11 +123,16 @@ void* tkl_system_malloc(const SIZE_T size)
 */
 void tkl_system_free(void* ptr)
 {
-    // if(ptr) {
-    //     tuya_mem_heap_free(s_heap_handle, ptr);
-    // }
+    if (NULL == ptr) {
+        return;
+    }
 
-    free(ptr);
+    if (__heap_owns(ptr)) {
+        tuya_mem_heap_free(s_heap_handle, ptr);
+        return;
+    }
+
+    __libc_free(ptr);
 }
 
 /**
@@ -89,9 +143,19 @@ void tkl_system_free(void* ptr)
  */
 void *tkl_system_calloc(size_t nitems, size_t size)
 {
-    // return tuya_mem_heap_calloc(s_heap_handle, nitems * size);
+    size_t total = nitems * size;
+    void *p;
+
+    if (size && total / size != nitems) {
+        return NULL;
+    }
+
+    p = tkl_system_malloc(total);
+    if (p) {
+        memset(p, 0, total);
+    }
 
-    return calloc(nitems, size);
+    return p;
 }
 
 /**
@@ -102,9 +166,42 @@ void *tkl_system_calloc(size_t nitems, size_t size)
  */
 void *tkl_system_realloc(void* ptr, size_t size)
 {
-    // return tuya_mem_heap_realloc(s_heap_handle, ptr, size);
+    void *p = NULL;
+    size_t old_size;
+
+    if (NULL == ptr) {
+        return tkl_system_malloc(size);
+    }
+    if (!__heap_owns(ptr)) {
+        if (0 == size) {
+            __libc_free(ptr);
+            return NULL;
+        }
+        return realloc(ptr, size);
+    }
+
+    if (0 == size) {
+        tkl_system_free(ptr);
+        return NULL;
+    }
+
+    if (size <= TKL_MEMORY_HEAP_SIZE) {
+        p = tuya_mem_heap_realloc(s_heap_handle, ptr, size);
+        if (p) {
+            return p;
+        }
+    }
 
-    return realloc(ptr, size);
+    // the heap is exhausted, move the block out to libc
+    p = __libc_malloc(size);
+    if (NULL == p) {
+        return NULL;
+    }
+    old_size = tuya_mem_heap_usable_size(ptr);
+    memcpy(p, ptr, (size < old_size) ? size : old_size);
+    tuya_mem_heap_free(s_heap_handle, ptr);
+
+    return p;
 }
 
 /**
@@ -112,15 +209,24 @@ void *tkl_system_realloc(void* ptr, size_t size)
 *
 * @param void
 *
-* @note This API is used for getting free heap size.
+* @note This API is used for getting free heap size. Free objects held by
+* the small object slabs are counted as free. While any block lives in libc
+* the arena is not the limit, so MAX_HEAP_SIZE is reported as when the heap
+* is disabled.
 *
 * @return size of free heap
 */
 int tkl_system_get_free_heap_size(void)
 {
-    // return tuya_mem_heap_available(s_heap_handle);
+    HEAP_HANDLE heap = __heap_get();
+    heap_state_t state;
+
+    if (NULL == heap || __atomic_load_n(&s_libc_blocks, __ATOMIC_RELAXED) > 0) {
+        return MAX_HEAP_SIZE;
+    }
 
-    return MAX_HEAP_SIZE;
+    tuya_mem_heap_state(heap, &state);
+    return (int)(state.free_size + state.slab_free);
 }
 
 /**
@@ -13,18 +13,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 typedef struct rpa_queue_t {
-    void **data;
-    volatile uint32_t nelts; /**< # elements */
+    uint8_t *data;           /**< bounds slots of msgsize bytes */
+    uint32_t msgsize;        /**< size of one element */
+    uint32_t nelts;          /**< # elements */
     uint32_t in;             /**< next empty location */
     uint32_t out;            /**< next filled location */
     uint32_t bounds;         /**< max size of queue */
     uint32_t full_waiters;
     uint32_t empty_waiters;
-    pthread_mutex_t *one_big_mutex;
-    pthread_cond_t *not_empty;
-    pthread_cond_t *not_full;
+    pthread_mutex_t one_big_mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
     int terminated;
 } rpa_queue_t;
 
@@ -34,74 +36,66 @@ typedef struct rpa_queue_t {
 #define rpa_queue_full(queue)  ((queue)->nelts == (queue)->bounds)
 #define rpa_queue_empty(queue) ((queue)->nelts == 0)
 
+/* the condvars run on CLOCK_MONOTONIC, so wall clock steps (SNTP) do not move the deadline */
 static void set_timeout(struct timespec *abstime, int wait_ms)
 {
-    clock_gettime(CLOCK_REALTIME, abstime);
-    /* add seconds */
+    clock_gettime(CLOCK_MONOTONIC, abstime);
     abstime->tv_sec += (wait_ms / 1000);
-    /* add and carry microseconds */
-    long ms = abstime->tv_nsec / 1000000L;
-    ms += wait_ms % 1000;
-    while (ms > 1000) {
-        ms -= 1000;
+    abstime->tv_nsec += (wait_ms % 1000) * 1000000L;
+    if (abstime->tv_nsec >= 1000000000L) {
         abstime->tv_sec += 1;
+        abstime->tv_nsec -= 1000000000L;
     }
-    abstime->tv_nsec = ms * 1000000L;
 }
 
 static void rpa_queue_destroy(rpa_queue_t *queue)
 {
     /* Ignore errors here, we can't do anything about them anyway. */
-    pthread_cond_destroy(queue->not_empty);
-    pthread_cond_destroy(queue->not_full);
-    pthread_mutex_destroy(queue->one_big_mutex);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_mutex_destroy(&queue->one_big_mutex);
+    free(queue);
 }
 
-static BOOL_T rpa_queue_create(rpa_queue_t **q, uint32_t queue_capacity)
+static BOOL_T rpa_queue_create(rpa_queue_t **q, uint32_t queue_capacity, uint32_t msgsize)
 {
     rpa_queue_t *queue;
-    queue = malloc(sizeof(rpa_queue_t));
+    pthread_condattr_t cond_attr;
+    int rv;
+
+    /* the slots follow the header, one allocation for the whole queue */
+    queue = malloc(sizeof(rpa_queue_t) + (size_t)queue_capacity * msgsize);
     if (!queue) {
         return false;
     }
-    *q = queue;
     memset(queue, 0, sizeof(rpa_queue_t));
 
-    if (!(queue->one_big_mutex = malloc(sizeof(pthread_mutex_t))))
-        return false;
-    if (!(queue->not_empty = malloc(sizeof(pthread_cond_t))))
-        return false;
-    if (!(queue->not_full = malloc(sizeof(pthread_cond_t))))
-        return false;
-
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-    int rv = pthread_mutex_init(queue->one_big_mutex, &attr);
+    /* never locked recursively, a plain mutex is cheaper */
+    rv = pthread_mutex_init(&queue->one_big_mutex, NULL);
     if (rv != 0) {
         goto error;
     }
 
-    rv = pthread_cond_init(queue->not_empty, NULL);
-    if (rv != 0) {
-        goto error;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    rv = pthread_cond_init(&queue->not_empty, &cond_attr);
+    if (rv == 0) {
+        rv = pthread_cond_init(&queue->not_full, &cond_attr);
+        if (rv != 0) {
+            pthread_cond_destroy(&queue->not_empty);
+        }
     }
-
-    rv = pthread_cond_init(queue->not_full, NULL);
+    pthread_condattr_destroy(&cond_attr);
     if (rv != 0) {
+        pthread_mutex_destroy(&queue->one_big_mutex);
         goto error;
     }
 
-    /* Set all the data in the queue to NULL */
-    queue->data          = malloc(queue_capacity * sizeof(void *));
-    queue->bounds        = queue_capacity;
-    queue->nelts         = 0;
-    queue->in            = 0;
-    queue->out           = 0;
-    queue->terminated    = 0;
-    queue->full_waiters  = 0;
-    queue->empty_waiters = 0;
+    queue->data    = (uint8_t *)(queue + 1);
+    queue->msgsize = msgsize;
+    queue->bounds  = queue_capacity;
 
+    *q = queue;
     return true;
 
 error:
@@ -109,25 +103,10 @@ error:
     return false;
 }
 
-static BOOL_T rpa_queue_trypush(rpa_queue_t *queue, void *data)
+/* called with the mutex held and the queue not full */
+static void rpa_queue_put(rpa_queue_t *queue, const void *data)
 {
-    BOOL_T rv;
-
-    if (queue->terminated) {
-        return false; /* no more elements ever again */
-    }
-
-    rv = pthread_mutex_lock(queue->one_big_mutex);
-    if (rv != 0) {
-        return false;
-    }
-
-    if (rpa_queue_full(queue)) {
-        rv = pthread_mutex_unlock(queue->one_big_mutex);
-        return false; // EAGAIN;
-    }
-
-    queue->data[queue->in] = data;
+    memcpy(queue->data + (size_t)queue->in * queue->msgsize, data, queue->msgsize);
     queue->in++;
     if (queue->in >= queue->bounds) {
         queue->in -= queue->bounds;
@@ -135,184 +114,91 @@ static BOOL_T rpa_queue_trypush(rpa_queue_t *queue, void *data)
     queue->nelts++;
 
     if (queue->empty_waiters) {
-        rv = pthread_cond_signal(queue->not_empty);
-        if (rv != 0) {
-            pthread_mutex_unlock(queue->one_big_mutex);
-            return false;
-        }
+        pthread_cond_signal(&queue->not_empty);
     }
-
-    pthread_mutex_unlock(queue->one_big_mutex);
-    return true;
 }
 
-static BOOL_T rpa_queue_timedpush(rpa_queue_t *queue, void *data, int wait_ms)
+/* called with the mutex held and the queue not empty */
+static void rpa_queue_get(rpa_queue_t *queue, void *data)
 {
-    BOOL_T rv;
-
-    if (wait_ms == RPA_WAIT_NONE)
-        return rpa_queue_trypush(queue, data);
-
-    if (queue->terminated) {
-        return false; /* no more elements ever again */
+    memcpy(data, queue->data + (size_t)queue->out * queue->msgsize, queue->msgsize);
+    queue->nelts--;
+    queue->out++;
+    if (queue->out >= queue->bounds) {
+        queue->out -= queue->bounds;
     }
 
-    rv = pthread_mutex_lock(queue->one_big_mutex);
-    if (rv != 0) {
-        return false;
+    if (queue->full_waiters) {
+        pthread_cond_signal(&queue->not_full);
     }
+}
 
-    if (rpa_queue_full(queue)) {
-        if (!queue->terminated) {
-            queue->full_waiters++;
-            if (wait_ms == RPA_WAIT_FOREVER) {
-                rv = pthread_cond_wait(queue->not_full, queue->one_big_mutex);
-            } else {
-                struct timespec abstime;
-                set_timeout(&abstime, wait_ms);
-                rv = pthread_cond_timedwait(queue->not_full, queue->one_big_mutex,
-                                            &abstime);
-            }
-            queue->full_waiters--;
-            if (rv != 0) {
-                pthread_mutex_unlock(queue->one_big_mutex);
-                return false;
-            }
-        }
-        /* If we wake up and it's still empty, then we were interrupted */
-        if (rpa_queue_full(queue)) {
-            rv = pthread_mutex_unlock(queue->one_big_mutex);
-            if (rv != 0) {
-                return false;
-            }
-            if (queue->terminated) {
-                return false; /* no more elements ever again */
-            } else {
-                return false; // EINTR;
-            }
-        }
-    }
+/* wait on cond until the predicate clears or the deadline passes, spurious wakeups keep waiting */
+static int rpa_queue_wait(rpa_queue_t *queue, pthread_cond_t *cond, uint32_t *waiters, int wait_ms, BOOL_T for_full)
+{
+    struct timespec abstime;
+    int rv = 0;
 
-    queue->data[queue->in] = data;
-    queue->in++;
-    if (queue->in >= queue->bounds) {
-        queue->in -= queue->bounds;
+    if (wait_ms != RPA_WAIT_FOREVER) {
+        set_timeout(&abstime, wait_ms);
     }
-    queue->nelts++;
 
-    if (queue->empty_waiters) {
-        rv = pthread_cond_signal(queue->not_empty);
+    (*waiters)++;
+    while (!queue->terminated && (for_full ? rpa_queue_full(queue) : rpa_queue_empty(queue))) {
+        if (wait_ms == RPA_WAIT_FOREVER) {
+            rv = pthread_cond_wait(cond, &queue->one_big_mutex);
+        } else {
+            rv = pthread_cond_timedwait(cond, &queue->one_big_mutex, &abstime);
+        }
         if (rv != 0) {
-            pthread_mutex_unlock(queue->one_big_mutex);
-            return false;
+            break;
         }
     }
+    (*waiters)--;
 
-    pthread_mutex_unlock(queue->one_big_mutex);
-    return true;
+    return rv;
 }
 
-static BOOL_T rpa_queue_trypop(rpa_queue_t *queue, void **data)
+static BOOL_T rpa_queue_timedpush(rpa_queue_t *queue, const void *data, int wait_ms)
 {
-    BOOL_T rv;
-
-    if (queue->terminated) {
-        return false; /* no more elements ever again */
-    }
-
-    rv = pthread_mutex_lock(queue->one_big_mutex);
-    if (rv != 0) {
+    if (pthread_mutex_lock(&queue->one_big_mutex) != 0) {
         return false;
     }
 
-    if (rpa_queue_empty(queue)) {
-        rv = pthread_mutex_unlock(queue->one_big_mutex);
-        return false; // EAGAIN;
+    if (rpa_queue_full(queue) && wait_ms != RPA_WAIT_NONE) {
+        rpa_queue_wait(queue, &queue->not_full, &queue->full_waiters, wait_ms, true);
     }
 
-    *data = queue->data[queue->out];
-    queue->nelts--;
-
-    queue->out++;
-    if (queue->out >= queue->bounds) {
-        queue->out -= queue->bounds;
-    }
-    if (queue->full_waiters) {
-        rv = pthread_cond_signal(queue->not_full);
-        if (rv != 0) {
-            pthread_mutex_unlock(queue->one_big_mutex);
-            return false;
-        }
+    /* still full on timeout, no more elements ever again once terminated */
+    if (queue->terminated || rpa_queue_full(queue)) {
+        pthread_mutex_unlock(&queue->one_big_mutex);
+        return false;
     }
 
-    pthread_mutex_unlock(queue->one_big_mutex);
+    rpa_queue_put(queue, data);
+
+    pthread_mutex_unlock(&queue->one_big_mutex);
     return true;
 }
 
-static BOOL_T rpa_queue_timedpop(rpa_queue_t *queue, void **data, int wait_ms)
+static BOOL_T rpa_queue_timedpop(rpa_queue_t *queue, void *data, int wait_ms)
 {
-    BOOL_T rv;
-
-    if (wait_ms == RPA_WAIT_NONE)
-        return rpa_queue_trypop(queue, data);
-
-    if (queue->terminated) {
-        return false; /* no more elements ever again */
-    }
-
-    rv = pthread_mutex_lock(queue->one_big_mutex);
-    if (rv != 0) {
+    if (pthread_mutex_lock(&queue->one_big_mutex) != 0) {
         return false;
     }
 
-    /* Keep waiting until we wake up and find that the queue is not empty. */
-    if (rpa_queue_empty(queue)) {
-        if (!queue->terminated) {
-            queue->empty_waiters++;
-            if (wait_ms == RPA_WAIT_FOREVER) {
-                rv = pthread_cond_wait(queue->not_empty, queue->one_big_mutex);
-            } else {
-                struct timespec abstime;
-                set_timeout(&abstime, wait_ms);
-                rv = pthread_cond_timedwait(queue->not_empty, queue->one_big_mutex,
-                                            &abstime);
-            }
-            queue->empty_waiters--;
-            if (rv != 0) {
-                pthread_mutex_unlock(queue->one_big_mutex);
-                return false;
-            }
-        }
-        /* If we wake up and it's still empty, then we were interrupted */
-        if (rpa_queue_empty(queue)) {
-            rv = pthread_mutex_unlock(queue->one_big_mutex);
-            if (rv != 0) {
-                return false;
-            }
-            if (queue->terminated) {
-                return false; /* no more elements ever again */
-            } else {
-                return false; // EINTR;
-            }
-        }
+    if (rpa_queue_empty(queue) && wait_ms != RPA_WAIT_NONE) {
+        rpa_queue_wait(queue, &queue->not_empty, &queue->empty_waiters, wait_ms, false);
     }
 
-    *data = queue->data[queue->out];
-    queue->nelts--;
-
-    queue->out++;
-    if (queue->out >= queue->bounds) {
-        queue->out -= queue->bounds;
-    }
-    if (queue->full_waiters) {
-        rv = pthread_cond_signal(queue->not_full);
-        if (rv != 0) {
-            pthread_mutex_unlock(queue->one_big_mutex);
-            return false;
-        }
+    if (queue->terminated || rpa_queue_empty(queue)) {
+        pthread_mutex_unlock(&queue->one_big_mutex);
+        return false;
     }
 
-    pthread_mutex_unlock(queue->one_big_mutex);
+    rpa_queue_get(queue, data);
+
+    pthread_mutex_unlock(&queue->one_big_mutex);
     return true;
 }
 
@@ -343,7 +229,8 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_queue_create_init(TKL_QUEUE_HANDLE *handle,
         return OPRT_MALLOC_FAILED;
     }
 
-    if (!rpa_queue_create(&queue->queue, msgcount)) {
+    if (!rpa_queue_create(&queue->queue, msgcount, msgsize)) {
+        free(queue);
         return OPRT_OS_ADAPTER_QUEUE_CREAT_FAILED;
     }
     queue->msgsize = msgsize;
@@ -371,20 +258,13 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_queue_post(const TKL_QUEUE_HANDLE handle, vo
     TKL_QUEUE_T *queue = (TKL_QUEUE_T *)handle;
     int wait_ms      = 0;
 
-    void *buf = (void *)malloc(queue->msgsize);
-    if (NULL == buf) {
-        return OPRT_MALLOC_FAILED;
-    }
-
-    memcpy(buf, (void *)data, queue->msgsize);
-
     if (timeout == TKL_QUEUE_WAIT_FROEVER) {
         wait_ms = RPA_WAIT_FOREVER;
     } else {
         wait_ms = timeout;
     }
 
-    if (!rpa_queue_timedpush(queue->queue, buf, wait_ms)) {
+    if (!rpa_queue_timedpush(queue->queue, data, wait_ms)) {
         return OPRT_OS_ADAPTER_QUEUE_SEND_FAIL;
     }
 
@@ -407,7 +287,6 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_queue_fetch(const TKL_QUEUE_HANDLE handle, v
     }
 
     TKL_QUEUE_T *queue = (TKL_QUEUE_T *)handle;
-    void *buf        = NULL;
     int wait_ms;
 
     if (timeout == TKL_QUEUE_WAIT_FROEVER) {
@@ -416,15 +295,10 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_queue_fetch(const TKL_QUEUE_HANDLE handle, v
         wait_ms = timeout;
     }
 
-    if (!rpa_queue_timedpop(queue->queue, (void **)&buf, wait_ms)) {
+    if (!rpa_queue_timedpop(queue->queue, msg, wait_ms)) {
         return OPRT_OS_ADAPTER_QUEUE_RECV_FAIL;
     }
 
-    if (buf) {
-        memcpy((void *)msg, buf, queue->msgsize);
-        free(buf);
-    }
-
     return OPRT_OK;
 }
 
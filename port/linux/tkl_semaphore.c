@@ -10,15 +10,49 @@
 
 #include "tkl_semaphore.h"
 #include "tkl_memory.h"
-#include <semaphore.h>
 #include <time.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
+/*
+ * count holds the available tokens and is also the futex word. Uncontended
+ * post and wait are a single atomic operation, the kernel is only entered
+ * when a waiter has to sleep or a sleeper has to be woken.
+ */
 typedef struct
 {
-    sem_t sem;
+    int32_t count;
+    int32_t waiters;
 }TKL_SEM_MANAGE,*P_TKL_SEM_MANAGE;
 
+static BOOL_T __sem_trywait(P_TKL_SEM_MANAGE sem_manage)
+{
+    int32_t count = __atomic_load_n(&sem_manage->count, __ATOMIC_RELAXED);
+
+    while (count > 0) {
+        if (__atomic_compare_exchange_n(&sem_manage->count, &count, count - 1, TRUE, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* sleep while count is 0, abstime is on CLOCK_MONOTONIC so wall clock steps do not matter */
+static int __futex_wait(int32_t *addr, const struct timespec *abstime)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, 0, abstime, NULL,
+                   FUTEX_BITSET_MATCH_ANY);
+}
+
+static void __futex_wake(int32_t *addr, int num)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, num, NULL, NULL, 0);
+}
+
 /**
 * @brief Create semaphore
 *
@@ -42,14 +76,9 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_semaphore_create_init(TKL_SEM_HANDLE *handle
         return OPRT_MALLOC_FAILED;
     }
 
-    int ret;
-    ret = sem_init(&sem_manage->sem, 0, sem_cnt);
-    if(ret != 0) {
-        tkl_system_free(sem_manage);
-        *handle = NULL;
-        return ret;
-    }
-    
+    sem_manage->count = (int32_t)sem_cnt;
+    sem_manage->waiters = 0;
+
     *handle = (TKL_SEM_HANDLE)sem_manage;
     return OPRT_OK;
 }
@@ -73,30 +102,42 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_semaphore_wait(const TKL_SEM_HANDLE handle,
     P_TKL_SEM_MANAGE sem_manage;
     sem_manage = (P_TKL_SEM_MANAGE)handle;
 
-    int ret;
-    if (timeout == TKL_SEM_WAIT_FOREVER) {
-        ret = sem_wait(&sem_manage->sem);
-    } else {
-        struct timespec ts = {0, 0};
+    if (__sem_trywait(sem_manage)) {
+        return OPRT_OK;
+    }
+    if (0 == timeout) {
+        return OPRT_OS_ADAPTER_SEM_WAIT_FAILED;
+    }
 
-        clock_gettime(CLOCK_REALTIME, &ts);
+    struct timespec ts = {0, 0};
+    if (timeout != TKL_SEM_WAIT_FOREVER) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
         ts.tv_sec += (timeout / 1000);
         ts.tv_nsec += ((timeout % 1000) * 1000000);
         if (ts.tv_nsec >= 1000000000) {
             ts.tv_sec += ts.tv_nsec / 1000000000;
             ts.tv_nsec = ts.tv_nsec % 1000000000;
         }
+    }
 
-        //ret = sem_timedwait(&pSemManage->sem, &ts);
-        while ((ret = sem_timedwait(&sem_manage->sem, &ts)) == -1 && errno == EINTR) {
-            continue;    /* Restart if interrupted by handler */
+    int ret = 0;
+    __atomic_fetch_add(&sem_manage->waiters, 1, __ATOMIC_SEQ_CST);
+    while (!__sem_trywait(sem_manage)) {
+        ret = __futex_wait(&sem_manage->count, (timeout == TKL_SEM_WAIT_FOREVER) ? NULL : &ts);
+        if ((-1 == ret) && (ETIMEDOUT == errno)) {
+            /* a post may have raced with the timeout */
+            ret = __sem_trywait(sem_manage) ? 0 : -1;
+            break;
         }
+        /* woken, count changed before we slept (EAGAIN) or interrupted (EINTR), try again */
+        ret = 0;
     }
-    
+    __atomic_fetch_sub(&sem_manage->waiters, 1, __ATOMIC_SEQ_CST);
+
     if (0 != ret) {
         return OPRT_OS_ADAPTER_SEM_WAIT_FAILED;
     }
-    
+
     return OPRT_OK;
 }
 
@@ -118,12 +159,15 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_semaphore_post(const TKL_SEM_HANDLE handle)
     P_TKL_SEM_MANAGE sem_manage;
     sem_manage = (P_TKL_SEM_MANAGE)handle;
 
-    int ret;
-    ret= sem_post(&(sem_manage->sem));
-    if(ret != 0) {
+    if (__atomic_load_n(&sem_manage->count, __ATOMIC_RELAXED) == INT32_MAX) {
         return OPRT_OS_ADAPTER_SEM_POST_FAILED;
     }
-    
+    __atomic_fetch_add(&sem_manage->count, 1, __ATOMIC_SEQ_CST);
+    /* pairs with the waiters increment, either we see the waiter or it sees the token */
+    if (__atomic_load_n(&sem_manage->waiters, __ATOMIC_SEQ_CST) > 0) {
+        __futex_wake(&sem_manage->count, 1);
+    }
+
     return OPRT_OK;
 }
 
@@ -145,13 +189,8 @@ TUYA_WEAK_ATTRIBUTE OPERATE_RET tkl_semaphore_release(const TKL_SEM_HANDLE handl
     P_TKL_SEM_MANAGE sem_manage;
     sem_manage = (P_TKL_SEM_MANAGE)handle;
 
-    int ret;
-    ret= sem_destroy(&(sem_manage->sem));
-    tkl_system_free(handle); // 释放信号量管理结构
-    if(ret != 0) {
-        return OPRT_OS_ADAPTER_SEM_RELEASE_FAILED;
-    }
-    
+    tkl_system_free(sem_manage); // 释放信号量管理结构
+
     return OPRT_OK;
 }
 
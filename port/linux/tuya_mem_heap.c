@@ -21,13 +21,28 @@
 
 #define MEM_DEBUG_FILL_VAL  (0xF7)
 #define MEM_BLOCK_MIN_SIZE  (24)
-#if defined(OPERATING_SYSTEM) && (SYSTEM_LINUX == OPERATING_SYSTEM)
+#if (defined(OPERATING_SYSTEM) && (SYSTEM_LINUX == OPERATING_SYSTEM)) || (UINTPTR_MAX > 0xFFFFFFFF)
 #define MEM_ALIGN_NUM  (8)
 #else
 #define MEM_ALIGN_NUM  (4)
 #endif
 #define FIT_FIND_DEPTH (3)
 
+/*
+ * Small allocations are served from per size class slabs: pages taken from
+ * the heap and cut into equal objects. They never walk the free list and
+ * do not split the heap into small holes.
+ */
+#ifndef MEM_SLAB_ENABLE
+#define MEM_SLAB_ENABLE (1)
+#endif
+#ifndef MEM_SLAB_PAGE_SIZE
+#define MEM_SLAB_PAGE_SIZE (4096)
+#endif
+#define MEM_SLAB_CLASS_NUM (8)
+#define MEM_SLAB_MAX_SIZE (256)
+#define MEM_SLAB_TAG (1) // low bit of the word in front of a slab object, block sizes are aligned
+
 
 #if MEM_BLOCK_MIN_SIZE < MEM_ALIGN_NUM
 #error "MEM_BLOCK_MIN_SIZE < MEM_ALIGN_NUM"
@@ -39,6 +54,27 @@ typedef struct MEM_HeapBlock_s
 	struct MEM_HeapBlock_s * next;
 }MEM_HeapBlock_t;
 
+typedef struct MEM_SlabObj_s
+{
+	struct MEM_SlabObj_s * next;
+}MEM_SlabObj_t;
+
+typedef struct MEM_SlabPage_s
+{
+	struct MEM_SlabPage_s * next;
+	struct MEM_SlabPage_s * prev;
+	MEM_SlabObj_t * free_list;
+	unsigned short cls;
+	unsigned short used;
+}MEM_SlabPage_t;
+
+typedef struct
+{
+	MEM_SlabPage_t * partial; // pages with free objects
+	unsigned long pages;
+	unsigned long free_obj;
+}MEM_SlabClass_t;
+
 typedef struct
 {
 	MEM_HeapBlock_t  * free_list;
@@ -46,6 +82,7 @@ typedef struct
 	unsigned long size;
 	unsigned long free;
 	unsigned long free_watermark;
+	MEM_SlabClass_t slab[MEM_SLAB_CLASS_NUM];
 }MEM_Heap_t;
 
 typedef struct
@@ -90,6 +127,8 @@ typedef struct
 #define MEM_DOG_ADDR(block)  (( unsigned char* )block + block->size - 1 )
 #define MEM_LEAK_DBG_ADDR(block) ( MEM_DbgLeak_t* ) ( ( unsigned long )(intptr_t)block + block->size - sizeof(MEM_DbgLeak_t) - MEM_ALIGN_NUM)
 
+static const unsigned short s_slab_size[MEM_SLAB_CLASS_NUM] = {16, 32, 48, 64, 96, 128, 192, 256};
+
 static MEM_Heap_t mem_heap_list[MEM_HEAP_LIST_NUM] = {0};
 static unsigned long s_heap_free_size = 0;
 static unsigned long s_heap_free_size_watermark = 0; // minimum free size ever
@@ -103,6 +142,7 @@ static int mem_heap_init ( MEM_Heap_t * heap, void * ptr, unsigned long size )
 
 	heap->base = ptr;
 	heap->size = size;
+	memset ( heap->slab, 0, sizeof ( heap->slab ) );
 
 	ptr   = ( void * ) (intptr_t)ALIGN_UP ( (intptr_t)ptr );
 	size -= ( unsigned long ) (intptr_t)ptr - ( unsigned long ) (intptr_t)heap->base;
@@ -270,7 +310,7 @@ static void MEM_HeapDelete ( MEM_Heap_t*heap )
 	s_heap_ctx.exit_critical();
 }
 
-static void * MEM_Allocate ( MEM_Heap_t * heap, unsigned long size)
+static void * MEM_BlockAllocate ( MEM_Heap_t * heap, unsigned long size)
 {
 	unsigned long new_size;
 	MEM_HeapBlock_t * block;
@@ -318,7 +358,7 @@ static void * MEM_AllocateDebug ( MEM_Heap_t * heap, unsigned long size , char*
 
 	MEM_DbgLeak_t* leak;
 	unsigned long new_size = ALIGN_UP ( size );
-	p = MEM_Allocate ( heap, new_size + sizeof ( MEM_DbgLeak_t ));
+	p = MEM_BlockAllocate ( heap, new_size + sizeof ( MEM_DbgLeak_t ));
 	if ( p )
 	{
 		block = ( MEM_HeapBlock_t* ) ( ( unsigned long ) (intptr_t)p - MEM_BLOCK_HEAD_SIZE );
@@ -334,7 +374,7 @@ static void * MEM_AllocateDebug ( MEM_Heap_t * heap, unsigned long size , char*
 	return p;
 }
 
-static void MEM_Deallocate ( MEM_Heap_t * heap, void*ptr)
+static void MEM_BlockDeallocate ( MEM_Heap_t * heap, void*ptr)
 {
 	MEM_HeapBlock_t * free_block;
 	MEM_HeapBlock_t * next_block;
@@ -437,6 +477,219 @@ static void MEM_Deallocate ( MEM_Heap_t * heap, void*ptr)
 	s_heap_ctx.exit_critical();
 }
 
+static unsigned long mem_slab_stride ( unsigned long cls )
+{
+	return sizeof ( unsigned long ) + s_slab_size[cls];
+}
+
+static MEM_SlabPage_t * mem_slab_page_of ( void * ptr )
+{
+	unsigned long tag = * ( unsigned long * ) ( ( unsigned long ) (intptr_t)ptr - sizeof ( unsigned long ) );
+
+	if ( ! ( tag & MEM_SLAB_TAG ) )
+	{
+		return NULL;
+	}
+
+	return ( MEM_SlabPage_t * ) (intptr_t)( tag & ~ ( unsigned long ) MEM_SLAB_TAG );
+}
+
+static void mem_slab_unlink ( MEM_SlabClass_t * slab, MEM_SlabPage_t * page )
+{
+	if ( page->prev )
+	{
+		page->prev->next = page->next;
+	}
+	else
+	{
+		slab->partial = page->next;
+	}
+
+	if ( page->next )
+	{
+		page->next->prev = page->prev;
+	}
+}
+
+static void mem_slab_link ( MEM_SlabClass_t * slab, MEM_SlabPage_t * page )
+{
+	page->prev = NULL;
+	page->next = slab->partial;
+	if ( slab->partial )
+	{
+		slab->partial->prev = page;
+	}
+	slab->partial = page;
+}
+
+/* cut a fresh heap block into objects of class cls */
+static void mem_slab_page_init ( MEM_SlabPage_t * page, unsigned long cls )
+{
+	unsigned long stride = mem_slab_stride ( cls );
+	unsigned long addr = ALIGN_UP ( ( unsigned long ) (intptr_t)page + sizeof ( MEM_SlabPage_t ) );
+	unsigned long end = ( unsigned long ) (intptr_t)page + MEM_SLAB_PAGE_SIZE;
+	MEM_SlabObj_t * obj;
+
+	memset ( page, 0, sizeof ( MEM_SlabPage_t ) );
+	page->cls = cls;
+
+	for ( ; addr + stride <= end; addr += stride )
+	{
+		* ( unsigned long * ) (intptr_t)addr = ( unsigned long ) (intptr_t)page | MEM_SLAB_TAG;
+		obj = ( MEM_SlabObj_t * ) (intptr_t)( addr + sizeof ( unsigned long ) );
+		obj->next = page->free_list;
+		page->free_list = obj;
+	}
+}
+
+static void * MEM_SlabAllocate ( MEM_Heap_t * heap, unsigned long cls )
+{
+	MEM_SlabClass_t * slab = &heap->slab[cls];
+	MEM_SlabPage_t * page;
+	MEM_SlabObj_t * obj;
+
+	s_heap_ctx.enter_critical();
+	if ( NULL == slab->partial )
+	{
+		s_heap_ctx.exit_critical();
+
+		page = MEM_BlockAllocate ( heap, MEM_SLAB_PAGE_SIZE );
+		if ( NULL == page )
+		{
+			return NULL;
+		}
+		mem_slab_page_init ( page, cls );
+
+		s_heap_ctx.enter_critical();
+		mem_slab_link ( slab, page );
+		slab->pages++;
+		slab->free_obj += ( MEM_SLAB_PAGE_SIZE - ALIGN_UP ( sizeof ( MEM_SlabPage_t ) ) ) / mem_slab_stride ( cls );
+	}
+
+	page = slab->partial;
+	obj = page->free_list;
+	page->free_list = obj->next;
+	page->used++;
+	slab->free_obj--;
+	if ( NULL == page->free_list )
+	{
+		mem_slab_unlink ( slab, page );
+	}
+	s_heap_ctx.exit_critical();
+
+	return obj;
+}
+
+static void MEM_SlabDeallocate ( MEM_Heap_t * heap, MEM_SlabPage_t * page, void * ptr )
+{
+	MEM_SlabClass_t * slab = &heap->slab[page->cls];
+	MEM_SlabObj_t * obj = ( MEM_SlabObj_t * ) ptr;
+
+#if defined(MEM_DEBUG_FREE_FILL) && (MEM_DEBUG_FREE_FILL == 1)
+	memset ( ptr, MEM_DEBUG_FILL_VAL, s_slab_size[page->cls] );
+#endif
+
+	s_heap_ctx.enter_critical();
+	if ( NULL == page->free_list )
+	{
+		mem_slab_link ( slab, page );
+	}
+	obj->next = page->free_list;
+	page->free_list = obj;
+	page->used--;
+	slab->free_obj++;
+
+	// give an empty page back to the heap, unless it is the only one left for the class
+	if ( 0 == page->used && ( page->prev || page->next ) )
+	{
+		mem_slab_unlink ( slab, page );
+		slab->pages--;
+		slab->free_obj -= ( MEM_SLAB_PAGE_SIZE - ALIGN_UP ( sizeof ( MEM_SlabPage_t ) ) ) / mem_slab_stride ( page->cls );
+	}
+	else
+	{
+		page = NULL;
+	}
+	s_heap_ctx.exit_critical();
+
+	if ( page )
+	{
+		MEM_BlockDeallocate ( heap, page );
+	}
+}
+
+static long mem_slab_class ( unsigned long size )
+{
+	long cls;
+
+	if ( size > MEM_SLAB_MAX_SIZE )
+	{
+		return -1;
+	}
+
+	for ( cls = 0; cls < MEM_SLAB_CLASS_NUM; cls++ )
+	{
+		if ( size <= s_slab_size[cls] )
+		{
+			return cls;
+		}
+	}
+
+	return -1;
+}
+
+static void * MEM_Allocate ( MEM_Heap_t * heap, unsigned long size )
+{
+#if defined(MEM_SLAB_ENABLE) && (MEM_SLAB_ENABLE == 1)
+	long cls = mem_slab_class ( size );
+
+	if ( heap && size && cls >= 0 )
+	{
+		void * ptr = MEM_SlabAllocate ( heap, cls );
+		if ( ptr )
+		{
+			return ptr;
+		}
+	}
+#endif
+
+	return MEM_BlockAllocate ( heap, size );
+}
+
+static void MEM_Deallocate ( MEM_Heap_t * heap, void*ptr)
+{
+	MEM_SlabPage_t * page;
+
+	if ( heap == NULL || ptr == NULL )
+	{
+		return ;
+	}
+
+	page = mem_slab_page_of ( ptr );
+	if ( page )
+	{
+		MEM_SlabDeallocate ( heap, page, ptr );
+		return;
+	}
+
+	MEM_BlockDeallocate ( heap, ptr );
+}
+
+/* usable size of an allocation */
+static unsigned long MEM_UsableSize ( void * ptr )
+{
+	MEM_SlabPage_t * page = mem_slab_page_of ( ptr );
+	MEM_HeapBlock_t * block;
+
+	if ( page )
+	{
+		return s_slab_size[page->cls];
+	}
+
+	block = ( MEM_HeapBlock_t * ) ( ( unsigned long ) (intptr_t)ptr - MEM_BLOCK_HEAD_SIZE );
+	return block->size - MEM_BLOCK_HEAD_SIZE - 1;
+}
+
 static void  MEM_HeapStatus ( MEM_Heap_t * heap, MEM_HeapStatus_t * status )
 {
 	MEM_HeapBlock_t  * freeBlockp = NULL;
@@ -623,6 +876,25 @@ void* tuya_mem_heap_realloc(HEAP_HANDLE handle, void *ptr, unsigned int size)
 		return tuya_mem_heap_malloc(handle, size);
 	}
 
+	MEM_SlabPage_t *page = mem_slab_page_of(ptr);
+	if(page) {
+		unsigned long obj_size = s_slab_size[page->cls];
+
+		// stay in the object unless it is growing out of it or shrinking below half of it
+		if((size <= obj_size) && (size > obj_size / 2)) {
+			return ptr;
+		}
+
+		void* tmp = tuya_mem_heap_malloc(handle, size);
+		if(NULL == tmp) {
+			return NULL;
+		}
+
+		memcpy(tmp, ptr, (size < obj_size) ? size : obj_size);
+		tuya_mem_heap_free(handle, ptr);
+		return tmp;
+	}
+
 	MEM_HeapBlock_t *old_block = ( MEM_HeapBlock_t * ) ( ( unsigned long ) (intptr_t)ptr - MEM_BLOCK_HEAD_SIZE );
 	unsigned char* pdog = MEM_DOG_ADDR(old_block);
 
@@ -673,6 +945,15 @@ void tuya_mem_heap_free(HEAP_HANDLE handle, void *ptr)
     }
 }
 
+unsigned int tuya_mem_heap_usable_size(void *ptr)
+{
+    if(NULL == ptr) {
+        return 0;
+    }
+
+    return MEM_UsableSize(ptr);
+}
+
 int tuya_mem_heap_available(HEAP_HANDLE handle)
 {
     if(0 == handle) {
@@ -682,6 +963,28 @@ int tuya_mem_heap_available(HEAP_HANDLE handle)
     }
 }
 
+/* largest free block and slab usage of one heap, accumulated into state */
+static void mem_heap_slab_state(MEM_Heap_t *heap, heap_state_t *state)
+{
+    MEM_HeapBlock_t *block;
+    unsigned long cls;
+    unsigned long largest;
+
+    s_heap_ctx.enter_critical();
+    for(block = heap->free_list; block; block = block->next) {
+        largest = block->size - MEM_BLOCK_HEAD_SIZE - 1;
+        if(largest > state->max_free_block_size) {
+            state->max_free_block_size = largest;
+        }
+    }
+
+    for(cls = 0; cls < MEM_SLAB_CLASS_NUM; cls++) {
+        state->slab_size += heap->slab[cls].pages * MEM_SLAB_PAGE_SIZE;
+        state->slab_free += heap->slab[cls].free_obj * s_slab_size[cls];
+    }
+    s_heap_ctx.exit_critical();
+}
+
 void tuya_mem_heap_state(HEAP_HANDLE handle, heap_state_t *state)
 {
     if(NULL == state) {
@@ -690,6 +993,8 @@ void tuya_mem_heap_state(HEAP_HANDLE handle, heap_state_t *state)
 
     MEM_Heap_t  * pHeap = (MEM_Heap_t *)handle;
 
+    memset(state, 0, sizeof(heap_state_t));
+
     if(0 == handle) {
         long idx = 0 ;
 
@@ -700,6 +1005,7 @@ void tuya_mem_heap_state(HEAP_HANDLE handle, heap_state_t *state)
             pHeap = &mem_heap_list[idx];
             if(pHeap->size > 0) {
                 state->total_size += pHeap->size;
+                mem_heap_slab_state(pHeap, state);
             } else {
                 break;
             }
@@ -708,6 +1014,12 @@ void tuya_mem_heap_state(HEAP_HANDLE handle, heap_state_t *state)
         state->total_size = pHeap->size;
         state->free_size = pHeap->free;
         state->free_watermark = pHeap->free_watermark;
+        mem_heap_slab_state(pHeap, state);
+    }
+
+    // share of the free memory that is not usable by one allocation
+    if(state->free_size > 0) {
+        state->fragmentation = 100 - (unsigned int)((unsigned long long)state->max_free_block_size * 100 / state->free_size);
     }
 }
 
@@ -755,7 +1067,12 @@ void* tuya_mem_heap_debug_realloc(HEAP_HANDLE handle, void *ptr, unsigned int si
 		return NULL;
 	}
 
-	memcpy(tmp, ptr, size);
+	if(NULL == ptr) {
+		return tmp;
+	}
+
+	unsigned long old_size = MEM_UsableSize(ptr);
+	memcpy(tmp, ptr, (size < old_size) ? size : old_size);
 	tuya_mem_heap_free(handle, ptr);
     return tmp;
 }